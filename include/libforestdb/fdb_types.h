@@ -78,7 +78,17 @@ enum {
      * Opening existing files which use CRC32C with this flag results
      * in FDB_RESULT_INVALID_ARGS.
      */
-    FDB_OPEN_WITH_LEGACY_CRC = 4
+    FDB_OPEN_WITH_LEGACY_CRC = 4,
+
+    /**
+     * Use XXH3 instead of CRC32-C for the block and document checksums of
+     * newly created files, including the new files written by compaction.
+     *
+     * Existing files are opened with the checksum mode they were written
+     * with, regardless of this flag. This flag cannot be used together with
+     * FDB_OPEN_WITH_LEGACY_CRC.
+     */
+    FDB_OPEN_WITH_XXH3_CHECKSUM = 8
 };
 
 /**
@@ -129,7 +139,33 @@ enum {
      * Asynchronous commit through the direct IO option to bypass
      * the OS page cache.
      */
-    FDB_DRB_ODIRECT_ASYNC = 0x3
+    FDB_DRB_ODIRECT_ASYNC = 0x3,
+    /**
+     * Synchronous commit through a separate sequential commit log.
+     * Non-transactional updates are appended to the commit log, and a commit
+     * only appends a commit marker and syncs the log. The WAL is flushed into
+     * the main index and a DB header is written lazily, once the log grows
+     * beyond 'commit_log_size'. Committed log entries that are not reflected
+     * in the DB file yet are replayed when the file is opened.
+     */
+    FDB_DRB_COMMIT_LOG = 0x4
+};
+
+/**
+ * I/O backends for ForestDB files.
+ */
+typedef uint8_t fdb_io_backend_t;
+enum {
+    /**
+     * Blocking system calls, and libaio for async reads if it is available.
+     */
+    FDB_IO_BACKEND_DEFAULT = 0x0,
+    /**
+     * Linux io_uring for async reads, with the file and the read buffers
+     * registered to the ring, and a single system call per batch of reads.
+     * Falls back to FDB_IO_BACKEND_DEFAULT if io_uring is not supported.
+     */
+    FDB_IO_BACKEND_IO_URING = 0x1
 };
 
 /**
@@ -229,6 +265,60 @@ typedef struct fdb_doc_struct {
 #define FDB_CUSTOM_SEQNUM 0x01
 } fdb_doc;
 
+/**
+ * Read-only view of a doc returned by fdb_get_pinned().
+ * The key, metadata, and body point directly into the block cache if the doc
+ * fits in a single cached block and its body is not compressed. Otherwise,
+ * they point to private copies. In both cases, they remain valid until the
+ * view is released by fdb_pinned_release().
+ */
+typedef struct {
+    /**
+     * key length.
+     */
+    size_t keylen;
+    /**
+     * metadata length.
+     */
+    size_t metalen;
+    /**
+     * doc body length.
+     */
+    size_t bodylen;
+    /**
+     * Sequence number assigned to a doc.
+     */
+    fdb_seqnum_t seqnum;
+    /**
+     * Offset to the doc (header + key + metadata + body) on disk.
+     */
+    uint64_t offset;
+    /**
+     * Pointer to doc's key.
+     */
+    const void *key;
+    /**
+     * Pointer to doc's metadata.
+     */
+    const void *meta;
+    /**
+     * Pointer to doc's body.
+     */
+    const void *body;
+    /**
+     * True if the doc is read in place from the block cache without copy.
+     */
+    bool zero_copy;
+    /**
+     * For internal use only: pinned block cache entry.
+     */
+    void *pin_handle;
+    /**
+     * For internal use only: key buffer allocated if the doc is copied.
+     */
+    void *key_buf;
+} fdb_pinned_doc;
+
 /**
  * Opaque reference to a ForestDB file handle, which is exposed in public APIs.
  */
@@ -593,6 +683,126 @@ typedef struct {
      * Flush limit in bytes for non-block aligned buffer cache
      */
     size_t bcache_flush_limit;
+    /**
+     * Flag to enable group commit. When enabled, a synchronous commit releases
+     * the file lock right after its header block is written, and the fsync
+     * for that header is shared with other handles committing to the same
+     * file concurrently: commits that arrive while an fsync is in flight are
+     * made durable together by the next fsync.
+     * This option has no effect on FDB_DRB_ASYNC durability modes.
+     */
+    bool group_commit;
+    /**
+     * Size of each commit log file in bytes, used when the durability option
+     * is FDB_DRB_COMMIT_LOG. A DB header commit (checkpoint) is performed
+     * once this amount of log has been appended since the last checkpoint.
+     */
+    uint64_t commit_log_size;
+    /**
+     * Number of bits per key of the Bloom filter used to skip index lookups
+     * for keys that do not exist in a file. The filter is disabled if this is
+     * set to zero (default). Files that were created without the filter start
+     * to maintain it after their next compaction.
+     */
+    uint32_t bloom_filter_bits_per_key;
+    /**
+     * I/O backend used for all the files that are not opened with custom file
+     * operations (FDB_IO_BACKEND_DEFAULT by default). This is a global config
+     * that is applied when ForestDB is initialized.
+     */
+    fdb_io_backend_t io_backend;
+    /**
+     * Number of threads that move documents from the current file to the new
+     * file within a single compaction (1 by default, i.e., no parallelism).
+     * Each thread reads and appends its own range of documents with its own
+     * read and write cursors, so that a compaction can use multiple cores
+     * and more of the disk bandwidth. This setting is ignored when the
+     * compaction callback asks for FDB_CS_MOVE_DOC.
+     * This is a local config to each ForestDB file.
+     */
+    size_t num_compaction_copy_threads;
+    /**
+     * Maximum rate in bytes per second of the blocks read from disk by
+     * foreground operations on a block cache miss (0, i.e., unlimited, by
+     * default). This is a global config that can be changed at runtime with
+     * fdb_set_io_rate_limit().
+     */
+    uint64_t fg_read_rate_limit;
+    /**
+     * Maximum rate in bytes per second of the dirty blocks written back to
+     * disk by foreground commits (0, i.e., unlimited, by default). This is a
+     * global config that can be changed at runtime with
+     * fdb_set_io_rate_limit().
+     */
+    uint64_t fg_commit_rate_limit;
+    /**
+     * Maximum rate in bytes per second of the writes issued by background
+     * tasks, i.e., compaction and background flushing (0, i.e., unlimited, by
+     * default). Background writes also give way to the foreground requests
+     * that are being throttled. This is a global config that can be changed
+     * at runtime with fdb_set_io_rate_limit().
+     */
+    uint64_t bg_write_rate_limit;
+    /**
+     * Flag to flush the WAL into the main index in the background (false by
+     * default). When the WAL exceeds wal_threshold, its items are frozen and
+     * flushed by a background task while the writers keep appending into the
+     * WAL; a writer waits only if the WAL grows beyond the threshold again
+     * before the previous flush is done. This option has no effect unless
+     * wal_flush_before_commit is enabled, or in auto commit mode.
+     * This is a local config to each ForestDB file.
+     */
+    bool background_wal_flush;
+    /**
+     * Number of threads that look up the index entries of the WAL items
+     * within a single WAL flush (1 by default, i.e., no parallelism). The
+     * items are partitioned by KV store (or by the first chunk of their keys
+     * in single KV instance mode), and the partitions are looked up by the
+     * flushing thread together with executor pool workers, before the index
+     * is updated in one pass.
+     * This is a local config to each ForestDB file.
+     */
+    size_t num_wal_flush_threads;
+    /**
+     * Maximum amount of cache memory in bytes that is warmed up when a DB file
+     * is opened. If it is non-zero, the IDs of the blocks (or the offsets of
+     * the B+tree nodes) of a file that are cached when the file is closed are
+     * saved in the order of their access score into a '.warm' file next to
+     * it, and the top of the list is read back into the cache by a background
+     * thread when the file is opened again, as long as the file has not been
+     * modified in between and the cache has free space. Zero disables the
+     * warm-up (default). This is a local config to each ForestDB file.
+     */
+    uint64_t cache_warmup_budget;
+    /**
+     * Path of a file on a local (ideally solid-state) device that is used as
+     * a second-level cache of the clean blocks and B+tree nodes evicted from
+     * the buffer cache. Blocks evicted from the buffer cache are written into
+     * it, and are read back from it instead of from the DB file on a buffer
+     * cache miss. The file is created (or truncated) when ForestDB is
+     * initialized and removed when it is shut down, so its content does not
+     * survive a restart. Blocks of encrypted files are never cached there.
+     * NULL disables the secondary cache (default).
+     * This is a global config that is configured across all ForestDB files.
+     */
+    const char* secondary_cache_path;
+    /**
+     * Size of the secondary cache file in bytes. Zero disables the secondary
+     * cache (default).
+     * This is a global config that is configured across all ForestDB files.
+     */
+    uint64_t secondary_cache_size;
+    /**
+     * Size in bytes of the compressed tier of the buffer cache, in addition
+     * to buffercache_size. Clean blocks evicted from the buffer cache are
+     * compressed and kept in this tier, and are decompressed on a hit; blocks
+     * that are hit repeatedly are promoted back to the uncompressed buffer
+     * cache. Zero disables the compressed tier (default). The tier is only
+     * available if ForestDB is built with snappy, and doesn't apply to the
+     * B+tree node cache of the BtreeV2 format.
+     * This is a global config that is configured across all ForestDB files.
+     */
+    uint64_t compressed_buffercache_size;
 
 } fdb_config;
 
@@ -669,6 +879,12 @@ enum {
  */
 typedef struct FdbIterator fdb_iterator;
 
+/**
+ * Opaque reference to ForestDB write batch structure definition, which is
+ * exposed in public APIs.
+ */
+typedef struct FdbWriteBatch fdb_write_batch;
+
 /**
  * Return type for the fdb_changes_since API's callback: fdb_changes_function_fn
  */
@@ -853,7 +1069,12 @@ enum {
     FDB_LATENCY_WAL_COMMIT   = 21, // wal_commit()
     FDB_LATENCY_WAL_FLUSH    = 22, // _wal_flush()
     FDB_LATENCY_WAL_RELEASE  = 23, // wal_release_flushed_items()
-    FDB_LATENCY_NUM_STATS    = 24  // Number of stats (keep as highest elem)
+    FDB_LATENCY_WAL_FLUSH_COMPACT = 24, // WAL flush by the compactor
+    FDB_LATENCY_BCACHE_EVICT = 25, // block cache eviction by a writer
+    FDB_LATENCY_BNODE_FLUSH  = 26, // bnode cache flush of dirty index nodes
+    FDB_LATENCY_FSYNC        = 27, // fsync() on the database file
+    FDB_LATENCY_HEADER_COMMIT = 28, // DB header commit (incl. flush & fsync)
+    FDB_LATENCY_NUM_STATS    = 29  // Number of stats (keep as highest elem)
 };
 
 /**
@@ -878,6 +1099,74 @@ typedef struct {
     uint32_t lat_avg;
 } fdb_latency_stat;
 
+/**
+ * Latency percentiles of a specific ForestDB api call or internal operation.
+ * Percentiles are accurate to within 1/16 of their value.
+ */
+typedef struct {
+    /**
+     * Total number this call was invoked.
+     */
+    uint64_t lat_count;
+    /**
+     * Median latency in micro seconds.
+     */
+    uint32_t lat_p50;
+    /**
+     * 90th percentile latency in micro seconds.
+     */
+    uint32_t lat_p90;
+    /**
+     * 99th percentile latency in micro seconds.
+     */
+    uint32_t lat_p99;
+    /**
+     * 99.9th percentile latency in micro seconds.
+     */
+    uint32_t lat_p999;
+    /**
+     * The slowest call took this amount of time in micro seconds.
+     */
+    uint32_t lat_max;
+} fdb_latency_percentiles;
+
+/**
+ * Classes of I/O requests that are paced by the I/O rate limiter.
+ */
+typedef uint8_t fdb_io_class;
+enum {
+    FDB_IO_FG_READ      = 0, // block reads by foreground operations
+    FDB_IO_FG_COMMIT    = 1, // block cache write-back by foreground commits
+    FDB_IO_BG_WRITE     = 2, // writes by compaction and background flushing
+    FDB_IO_NUM_CLASSES  = 3  // Number of classes (keep as highest elem)
+};
+
+/**
+ * Rate limit and throttling statistics of a class of I/O requests.
+ */
+typedef struct {
+    /**
+     * Current rate limit in bytes per second (0 if unlimited).
+     */
+    uint64_t rate_limit;
+    /**
+     * Total number of bytes charged to this class.
+     */
+    uint64_t bytes_requested;
+    /**
+     * Number of bytes of the requests that had to wait.
+     */
+    uint64_t bytes_throttled;
+    /**
+     * Number of requests that had to wait.
+     */
+    uint64_t num_throttled;
+    /**
+     * Total time spent waiting in micro seconds.
+     */
+    uint64_t wait_time_us;
+} fdb_io_rate_stats;
+
 /**
  * List of ForestDB KV store names
  */
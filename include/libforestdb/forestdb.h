@@ -245,6 +245,65 @@ LIBFDB_API
 fdb_status fdb_get_metaonly(fdb_kvs_handle *handle,
                             fdb_doc *doc);
 
+/**
+ * Retrieve the metadata and doc body for a given key without copying them,
+ * by pinning the block cache entry that contains the doc. The pinned block
+ * is kept in memory, and its content is not changed, until the view is
+ * released by fdb_pinned_release(), even if the doc is updated, deleted, or
+ * evicted from the block cache in the meantime. If the doc cannot be read in
+ * place (e.g., it spans multiple blocks or its body is compressed), it is
+ * copied into private buffers instead.
+ *
+ * WARNING: Every view should be released before its KV store handle is closed
+ *          and before fdb_shutdown() is called. As pinned blocks cannot be
+ *          reused, views should not be held for a long time.
+ *
+ * @param handle Pointer to ForestDB KV store handle.
+ * @param key Pointer to the key to be retrieved.
+ * @param keylen Length of the key.
+ * @param pinned_doc Pointer to the view to be populated as a result of this
+ *        API call.
+ * @return FDB_RESULT_SUCCESS on success.
+ */
+LIBFDB_API
+fdb_status fdb_get_pinned(fdb_kvs_handle *handle,
+                          const void *key,
+                          size_t keylen,
+                          fdb_pinned_doc *pinned_doc);
+
+/**
+ * Release a view returned by fdb_get_pinned().
+ *
+ * @param pinned_doc Pointer to the view to be released.
+ * @return FDB_RESULT_SUCCESS on success.
+ */
+LIBFDB_API
+fdb_status fdb_pinned_release(fdb_pinned_doc *pinned_doc);
+
+/**
+ * Retrieve the metadata and doc bodies for a batch of keys.
+ * Note that each FDB_DOC instance should be created by calling
+ * fdb_doc_create(doc, key, keylen, NULL, 0, NULL, 0) before using this API.
+ * This is equivalent to calling fdb_get for each doc, but the index lookups
+ * are done in key order and the doc bodies are read in file offset order
+ * (using async I/O if it is supported), which greatly reduces the latency
+ * of fan-out reads.
+ *
+ * @param handle Pointer to ForestDB KV store handle.
+ * @param docs Array of pointers to ForestDB doc instances whose metadata and
+ *        doc bodies are populated as a result of this API call.
+ * @param num_docs Number of doc instances in the array.
+ * @param results Array of num_docs status codes. Each of them is set to
+ *        FDB_RESULT_SUCCESS if the corresponding doc was found, or to
+ *        FDB_RESULT_KEY_NOT_FOUND or other error code otherwise.
+ * @return FDB_RESULT_SUCCESS if the batch was processed.
+ */
+LIBFDB_API
+fdb_status fdb_get_multi(fdb_kvs_handle *handle,
+                         fdb_doc **docs,
+                         size_t num_docs,
+                         fdb_status *results);
+
 /**
  * Retrieve the metadata and doc body for a given sequence number.
  * Note that FDB_DOC instance should be created by calling
@@ -373,6 +432,71 @@ LIBFDB_API
 fdb_status fdb_del_kv(fdb_kvs_handle *handle,
                       const void *key, size_t keylen);
 
+/**
+ * Create a new write batch, which collects set and delete operations to be
+ * applied to a KV store at once by fdb_write_batch_apply.
+ * The batch should be freed with fdb_write_batch_free API call.
+ *
+ * @param ptr_batch Pointer to the place where the write batch is instantiated
+ *        as result of this API call.
+ * @return FDB_RESULT_SUCCESS on success.
+ */
+LIBFDB_API
+fdb_status fdb_write_batch_create(fdb_write_batch **ptr_batch);
+
+/**
+ * Add an update of a key to a write batch.
+ * Note that the FDB_DOC instance is not copied, so it should not be freed or
+ * modified until the batch is applied.
+ *
+ * @param batch Pointer to the write batch.
+ * @param doc Pointer to ForestDB doc instance that is used to update a key.
+ * @return FDB_RESULT_SUCCESS on success.
+ */
+LIBFDB_API
+fdb_status fdb_write_batch_set(fdb_write_batch *batch,
+                               fdb_doc *doc);
+
+/**
+ * Add a deletion of a key to a write batch.
+ * Note that the FDB_DOC instance is not copied, so it should not be freed or
+ * modified until the batch is applied.
+ *
+ * @param batch Pointer to the write batch.
+ * @param doc Pointer to ForestDB doc instance that is used to delete a key.
+ * @return FDB_RESULT_SUCCESS on success.
+ */
+LIBFDB_API
+fdb_status fdb_write_batch_del(fdb_write_batch *batch,
+                               fdb_doc *doc);
+
+/**
+ * Apply all the operations in a write batch to a KV store, in the order they
+ * were added. This is equivalent to calling fdb_set or fdb_del for each of
+ * them, but the handle, the file and each WAL partition are locked only once
+ * for the whole batch. The sequence number, offset and on-disk size of each
+ * FDB_DOC instance in the batch are populated as a result of this API call.
+ * If an error occurs in the middle of the batch, the operations preceding the
+ * failed one remain applied.
+ *
+ * @param handle Pointer to ForestDB KV store handle.
+ * @param batch Pointer to the write batch to be applied.
+ * @return FDB_RESULT_SUCCESS on success.
+ */
+LIBFDB_API
+fdb_status fdb_write_batch_apply(fdb_kvs_handle *handle,
+                                 fdb_write_batch *batch);
+
+/**
+ * Free a write batch.
+ * Note that the FDB_DOC instances added to the batch are not freed.
+ *
+ * @param batch Pointer to the write batch to be freed.
+ * @return FDB_RESULT_SUCCESS on success.
+ */
+LIBFDB_API
+fdb_status fdb_write_batch_free(fdb_write_batch *batch);
+
 /**
  * Free memory allocated by fdb_get_kv:
  * Release the memory allocated by ForestDB when fdb_get_kv called.
@@ -776,6 +900,33 @@ fdb_status fdb_rekey(fdb_file_handle *fhandle,
 LIBFDB_API
 size_t fdb_get_buffer_cache_used();
 
+/**
+ * Change the rate limit of a class of I/O requests at runtime. The limits
+ * are shared by all the ForestDB files. Background writes (compaction and
+ * background flushing) also give way to the foreground requests that are
+ * being throttled.
+ *
+ * @param io_class Class of I/O requests whose limit is changed
+ * @param bytes_per_sec New limit in bytes per second, 0 for unlimited
+ * @return FDB_RESULT_SUCCESS on success.
+ */
+LIBFDB_API
+fdb_status fdb_set_io_rate_limit(fdb_io_class io_class,
+                                 uint64_t bytes_per_sec);
+
+/**
+ * Return the current rate limit of a class of I/O requests, with the number
+ * of bytes charged to it, the number of bytes and requests that were
+ * throttled, and the total time spent waiting.
+ *
+ * @param io_class Class of I/O requests
+ * @param stats Pointer to a fdb_io_rate_stats instance
+ * @return FDB_RESULT_SUCCESS on success.
+ */
+LIBFDB_API
+fdb_status fdb_get_io_rate_stats(fdb_io_class io_class,
+                                 fdb_io_rate_stats *stats);
+
 /**
  * Return the overall disk space actively used by a ForestDB file.
  * Note that this doesn't include the disk space used by stale btree nodes
@@ -846,13 +997,47 @@ fdb_status fdb_get_latency_stats(fdb_file_handle *fhandle,
                                  fdb_latency_stat *stats,
                                  fdb_latency_stat_type type);
 
+/**
+ * Return the latency percentiles (p50, p90, p99, p99.9 and max) of
+ * various forestdb api calls and internal operations on a ForestDB file
+ *
+ * @param fhandle Pointer to ForestDB file handle
+ * @param stats Pointer to a latency percentiles instance
+ * @param type Type of latency stat to be retrieved
+ * @return FDB_RESULT_SUCCESS on success.
+ */
+LIBFDB_API
+fdb_status fdb_get_latency_percentiles(fdb_file_handle *fhandle,
+                                       fdb_latency_percentiles *stats,
+                                       fdb_latency_stat_type type);
+
+/**
+ * Return the latency percentiles (p50, p90, p99, p99.9 and max) of the
+ * forestdb api calls made on a given KV store through any of its handles.
+ * Only set, get and iterator calls are tracked per KV store; other types
+ * return zero counts.
+ *
+ * @param handle Pointer to ForestDB KV store handle
+ * @param stats Pointer to a latency percentiles instance
+ * @param type Type of latency stat to be retrieved
+ * @return FDB_RESULT_SUCCESS on success.
+ */
+LIBFDB_API
+fdb_status fdb_get_kvs_latency_percentiles(fdb_kvs_handle *handle,
+                                           fdb_latency_percentiles *stats,
+                                           fdb_latency_stat_type type);
+
 /**
  * Returns a histogram of latencies for various forestdb api calls
- * (Works with Couchbase Server Build only)
+ * in the form of
+ * {count : N; p50 : Xµs; p90 : Xµs; p99 : Xµs; p99.9 : Xµs; max : Xµs;
+ *  (Xµs - Yµs) : N; ...}
+ * where only non-empty buckets are listed.
  *
  * @param fhandle Pointer to ForestDB file handle
- * @param stats Char pointer to stats (need to be freed from heap
- *              by client on SUCCESS)
+ * @param stats Char pointer to the NULL-terminated stats (need to be freed
+ *              from heap by client on SUCCESS), or NULL if there is no
+ *              sample for the given type
  * @param stats_length Pointer to the length of the buffer pointed to by the
  *                     stats pointer
  * @param type Type of latency stat to be retrieved
@@ -1176,7 +1361,8 @@ fdb_filemgr_ops_t* fdb_get_default_file_ops();
  *  4> Block_cache_misses           : Number of block cache misses
  *  5> Block_cache_num_items        : Number of block cache items
  *  6> Block_cache_num_victims      : Number of block cache victims (evictions)
- *  7> Block_cache_num_immutables   : Number of block cache immutables (eligible for eviction)
+ *  7> Block_cache_num_evictions    : Number of blocks evicted from block cache
+ *  8> Block_cache_num_immutables   : Number of block cache immutables (eligible for eviction)
  *
  */
 LIBFDB_API
@@ -64,6 +64,8 @@
 #define FDB_COMP_BUF_MAXSIZE (1073741824) // 1 GB, 128M offsets
 #define FDB_COMP_BATCHSIZE (131072) // 128K docs
 #define FDB_COMP_MOVE_UNIT (134217728) // 128 MB
+#define FDB_MULTI_GET_BATCHSIZE (4096) // 4K docs
+#define FDB_MULTI_GET_MOVE_UNIT (67108864) // 64 MB
 #define FDB_COMP_RATIO_MIN (40) // 40% (writer speed / compactor speed)
 #define FDB_COMP_RATIO_MAX (60) // 60% (writer speed / compactor speed)
 #define FDB_COMP_PROB_UNIT_INC (5) // 5% (probability delta unit for increase)
@@ -79,11 +81,22 @@
 
 #define FDB_DEFAULT_COMMIT_LOG_SIZE (16777216) // 16MB
 
+#define BLOOM_FILTER_INIT_LAYER_CAPACITY (4096) // keys in the first layer
+#define BLOOM_FILTER_MAX_LAYER_CAPACITY (1048576) // 1M keys per layer
+#define BLOOM_FILTER_MAX_LAYERS (1024)
+
 #define BCACHE_NBUCKET (4099) // a prime number
 #define BCACHE_NDICBUCKET (4099) // a prime number
 #define BCACHE_FLUSH_UNIT (1048576) // 1MB
 #define BCACHE_EVICT_UNIT (1)
+#define BCACHE_WINDOW_RATIO (0.01) // 1% of clean blocks in a shard
+#define BCACHE_PROTECTED_RATIO (0.8) // 80% of the main segments in a shard
+#define BCACHE_FREQ_SKETCH_DEPTH (4)
+#define BCACHE_FREQ_SAMPLE_FACTOR (10) // aging period per cached block
 #define BCACHE_MEMORY_THRESHOLD (0.8) // 80% of physical RAM
+#define BCACHE_COMPRESSED_NPARTITIONS (16)
+#define BCACHE_COMPRESSED_MAX_RATIO (0.75) // incompressible blocks are dropped
+#define BCACHE_COMPRESSED_PROMOTE_FREQ (3) // accesses to be promoted
 #define __BCACHE_SECOND_CHANCE
 
 #define FILEMGR_PREFETCH_UNIT (4194304) // 4MB
@@ -134,6 +147,14 @@
 #define DEFAULT_NUM_COMPACTOR_THREADS (4)
 #define MAX_NUM_COMPACTOR_THREADS (128)
 
+// Number of threads moving documents within a single compaction
+#define DEFAULT_NUM_COMPACTION_COPY_THREADS (1)
+#define MAX_NUM_COMPACTION_COPY_THREADS (64)
+
+// Number of threads looking up the index within a single WAL flush
+#define DEFAULT_NUM_WAL_FLUSH_THREADS (1)
+#define MAX_NUM_WAL_FLUSH_THREADS (64)
+
 #define DEFAULT_NUM_BGFLUSHER_THREADS (0) // temporarily disable bgflusher
 #define MAX_NUM_BGFLUSHER_THREADS (64)
 
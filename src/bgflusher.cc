@@ -33,6 +33,7 @@
 #include "avltree.h"
 #include "common.h"
 #include "bgflusher.h"
+#include "rate_limiter.h"
 #include "memleak.h"
 #include "time_utils.h"
 
@@ -82,6 +83,7 @@ void * BgFlusher::bgflusherThread()
     FileMgr *file;
     struct openfiles_elem *elem;
     ErrLogCallback *log_callback = NULL;
+    IoRateLimiter::BackgroundScope background_io;
 
     while (1) {
         uint64_t num_blocks = 0;
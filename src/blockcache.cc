@@ -22,6 +22,7 @@
 #if !defined(WIN32) && !defined(_WIN32)
 #include <sys/time.h>
 #endif
+#include <algorithm>
 #include <map>
 
 #include "hash_functions.h"
@@ -33,7 +34,12 @@
 #include "avltree.h"
 #include "atomic.h"
 #include "fdb_internal.h"
+#include "rate_limiter.h"
+#include "secondary_cache.h"
 #include "time_utils.h"
+#ifdef _DOC_COMP
+#include "snappy-c.h"
+#endif
 #include "memleak.h"
 
 #ifdef __DEBUG
@@ -52,14 +58,34 @@ std::mutex BlockCacheManager::instanceMutex;
 const uint64_t BlockCacheManager::defaultCacheSize = 134217728; // 128MB
 const uint32_t BlockCacheManager::defaultBlockSize = FDB_BLOCKSIZE; // 4KB
 
+// Set in the pin state of a block that is detached from the cache while it is
+// still pinned. The last unpin returns the block to the free list.
+#define BCACHE_PIN_RELEASE_PENDING (0x80000000)
+#define BCACHE_PIN_COUNT_MASK (0x7fffffff)
+
+// Segments of the clean block lists in a shard.
+// A new clean block is placed in the window segment first, and then moved to
+// the probation segment. It is placed at the MRU end of the probation segment
+// only if its access frequency is higher than that of the next eviction
+// victim. A block hit in the probation segment is promoted to the protected
+// segment, so that a single scan cannot evict frequently accessed blocks.
+typedef enum {
+    BCACHE_SEG_NONE,
+    BCACHE_SEG_WINDOW,
+    BCACHE_SEG_PROBATION,
+    BCACHE_SEG_PROTECTED
+} bcache_segment_t;
+
 class BlockCacheItem {
 public:
-    BlockCacheItem() : bid(BLK_NOT_FOUND), addr(NULL), flag(0), score(0) {
+    BlockCacheItem() : bid(BLK_NOT_FOUND), addr(NULL), flag(0), score(0),
+                       segment(BCACHE_SEG_NONE), pinState(0) {
         list_elem.prev = list_elem.next = NULL;
     }
 
     BlockCacheItem(bid_t _bid, void *_addr, uint8_t _flag, uint8_t _score) :
-        bid(_bid), addr(_addr), flag(_flag), score(_score) {
+        bid(_bid), addr(_addr), flag(_flag), score(_score),
+        segment(BCACHE_SEG_NONE), pinState(0) {
         list_elem.prev = list_elem.next = NULL;
     }
 
@@ -81,6 +107,10 @@ public:
         return score;
     }
 
+    bcache_segment_t getSegment(void) const {
+        return segment;
+    }
+
     void setBid(bid_t _bid) {
         bid = _bid;
     }
@@ -93,6 +123,18 @@ public:
         score = _score;
     }
 
+    void setSegment(bcache_segment_t _segment) {
+        segment = _segment;
+    }
+
+    /**
+     * Return true if the block is pinned by any reader. The shard lock
+     * should be grabbed, as a new pin is only taken under the shard lock.
+     */
+    bool isPinned(void) const {
+        return pinState.load() & BCACHE_PIN_COUNT_MASK;
+    }
+
     // list elem for {free, clean} lists
     struct list_elem list_elem;
 
@@ -105,15 +147,111 @@ private:
     std::atomic<uint8_t> flag;
     // cache block score
     uint8_t score;
+    // clean block list that this block belongs to
+    bcache_segment_t segment;
+    // Number of readers pinning this block, and BCACHE_PIN_RELEASE_PENDING
+    // if the block was released from the cache while it was pinned.
+    std::atomic<uint32_t> pinState;
+
+    friend class BlockCacheManager;
+};
+
+/**
+ * Count-min sketch that approximates the access frequencies of blocks.
+ * Counters are halved periodically so that the frequencies reflect recent
+ * accesses only. Counter updates are racy by design; a lost increment only
+ * makes the estimation slightly less accurate.
+ */
+class BlockFrequencySketch {
+public:
+    BlockFrequencySketch(uint64_t nblock) : width(64), numSamples(0),
+                                            aging(false) {
+        while (width < nblock * 4) {
+            width <<= 1;
+        }
+        sampleLimit = nblock * BCACHE_FREQ_SAMPLE_FACTOR;
+        if (sampleLimit < width) {
+            sampleLimit = width;
+        }
+        counters = new std::atomic<uint8_t>[width * BCACHE_FREQ_SKETCH_DEPTH];
+        for (uint64_t i = 0; i < width * BCACHE_FREQ_SKETCH_DEPTH; ++i) {
+            counters[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    ~BlockFrequencySketch() {
+        delete[] counters;
+    }
+
+    void increment(uint64_t key) {
+        for (size_t row = 0; row < BCACHE_FREQ_SKETCH_DEPTH; ++row) {
+            std::atomic<uint8_t> &counter = counters[getIndex(key, row)];
+            uint8_t count = counter.load(std::memory_order_relaxed);
+            if (count < maxCount) {
+                counter.store(count + 1, std::memory_order_relaxed);
+            }
+        }
+        if (++numSamples >= sampleLimit) {
+            age();
+        }
+    }
+
+    uint32_t estimate(uint64_t key) const {
+        uint8_t min_count = maxCount;
+        for (size_t row = 0; row < BCACHE_FREQ_SKETCH_DEPTH; ++row) {
+            uint8_t count = counters[getIndex(key, row)].load(
+                                                std::memory_order_relaxed);
+            if (count < min_count) {
+                min_count = count;
+            }
+        }
+        return min_count;
+    }
+
+private:
+    uint64_t getIndex(uint64_t key, size_t row) const {
+        // 64-bit finalizer of splitmix64 with a different seed for each row
+        uint64_t h = key + (row + 1) * 0x9e3779b97f4a7c15ULL;
+        h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+        h ^= h >> 31;
+        return row * width + (h & (width - 1));
+    }
+
+    void age() {
+        bool expected = false;
+        if (!aging.compare_exchange_strong(expected, true)) {
+            // Another thread is already halving the counters.
+            return;
+        }
+        for (uint64_t i = 0; i < width * BCACHE_FREQ_SKETCH_DEPTH; ++i) {
+            counters[i].store(counters[i].load(std::memory_order_relaxed) >> 1,
+                              std::memory_order_relaxed);
+        }
+        numSamples.store(0);
+        aging.store(false);
+    }
+
+    static const uint8_t maxCount = 15;
+
+    // Number of counters in each row (power of 2)
+    uint64_t width;
+    // Number of increments after which all the counters are halved
+    uint64_t sampleLimit;
+    std::atomic<uint64_t> numSamples;
+    std::atomic<bool> aging;
+    std::atomic<uint8_t> *counters;
 };
 
 typedef std::unordered_map<bid_t, BlockCacheItem *> block_map_t;
 
 class BlockCacheShard {
 public:
-    BlockCacheShard() {
+    BlockCacheShard() : numWindow(0), numProbation(0), numProtected(0) {
         spin_init(&lock);
-        list_init(&cleanBlocks);
+        list_init(&windowBlocks);
+        list_init(&probationBlocks);
+        list_init(&protectedBlocks);
     }
 
     ~BlockCacheShard() {
@@ -126,17 +264,142 @@ public:
 
     bool empty() {
         // Caller should grab the shard lock before calling this function.
-        return list_empty(&cleanBlocks) && dirtyDataBlocks.empty() &&
+        return !getNumCleanBlocks() && dirtyDataBlocks.empty() &&
             dirtyIndexBlocks.empty();
     }
 
+    size_t getNumCleanBlocks() const {
+        return numWindow + numProbation + numProtected;
+    }
+
+    // Note that all the functions below should be called while the shard lock
+    // is grabbed.
+
+    /**
+     * Insert a new clean block into the window segment.
+     */
+    void insertCleanBlock(BlockCacheItem *item) {
+        item->setSegment(BCACHE_SEG_WINDOW);
+        list_push_front(&windowBlocks, &item->list_elem);
+        ++numWindow;
+    }
+
+    /**
+     * Move a clean block from the window segment to the probation segment.
+     * An admitted block is placed at the MRU end of the probation segment,
+     * while a rejected one is placed at the LRU end to be evicted first.
+     */
+    void moveToProbation(BlockCacheItem *item, bool admitted) {
+        list_remove(&windowBlocks, &item->list_elem);
+        --numWindow;
+        item->setSegment(BCACHE_SEG_PROBATION);
+        if (admitted) {
+            list_push_front(&probationBlocks, &item->list_elem);
+        } else {
+            list_push_back(&probationBlocks, &item->list_elem);
+        }
+        ++numProbation;
+    }
+
+    /**
+     * Detach a clean block from the segment that it belongs to.
+     */
+    void removeCleanBlock(FileBlockCache *fcache, BlockCacheItem *item) {
+        switch (item->getSegment()) {
+        case BCACHE_SEG_WINDOW:
+            list_remove(&windowBlocks, &item->list_elem);
+            --numWindow;
+            break;
+        case BCACHE_SEG_PROBATION:
+            list_remove(&probationBlocks, &item->list_elem);
+            --numProbation;
+            break;
+        case BCACHE_SEG_PROTECTED:
+            list_remove(&protectedBlocks, &item->list_elem);
+            --numProtected;
+            fcache->numProtected--;
+            break;
+        default:
+            break;
+        }
+        item->setSegment(BCACHE_SEG_NONE);
+    }
+
+    /**
+     * Update the recency of a clean block on a cache hit. A block in the
+     * probation segment is promoted to the protected segment, and the LRU
+     * blocks of the protected segment are demoted to the probation segment
+     * if the protected segment exceeds its share.
+     */
+    void touchCleanBlock(FileBlockCache *fcache, BlockCacheItem *item) {
+        switch (item->getSegment()) {
+        case BCACHE_SEG_WINDOW:
+            list_remove(&windowBlocks, &item->list_elem);
+            list_push_front(&windowBlocks, &item->list_elem);
+            break;
+        case BCACHE_SEG_PROBATION: {
+            list_remove(&probationBlocks, &item->list_elem);
+            --numProbation;
+            item->setSegment(BCACHE_SEG_PROTECTED);
+            list_push_front(&protectedBlocks, &item->list_elem);
+            ++numProtected;
+            fcache->numProtected++;
+
+            size_t limit = (numProbation + numProtected) *
+                           BCACHE_PROTECTED_RATIO;
+            while (numProtected > limit) {
+                BlockCacheItem *demoted = reinterpret_cast<BlockCacheItem *>(
+                    list_pop_back(&protectedBlocks));
+                --numProtected;
+                fcache->numProtected--;
+                demoted->setSegment(BCACHE_SEG_PROBATION);
+                list_push_front(&probationBlocks, &demoted->list_elem);
+                ++numProbation;
+            }
+            break;
+        }
+        case BCACHE_SEG_PROTECTED:
+            list_remove(&protectedBlocks, &item->list_elem);
+            list_push_front(&protectedBlocks, &item->list_elem);
+            break;
+        default:
+            break;
+        }
+    }
+
+    /**
+     * Return the LRU block of the window segment.
+     */
+    BlockCacheItem *getWindowTail() {
+        return reinterpret_cast<BlockCacheItem *>(list_end(&windowBlocks));
+    }
+
+    /**
+     * Return the LRU block of the probation segment.
+     */
+    BlockCacheItem *getProbationTail() {
+        return reinterpret_cast<BlockCacheItem *>(list_end(&probationBlocks));
+    }
+
+    /**
+     * Return the LRU block of the protected segment.
+     */
+    BlockCacheItem *getProtectedTail() {
+        return reinterpret_cast<BlockCacheItem *>(list_end(&protectedBlocks));
+    }
+
 private:
     friend class BlockCacheManager;
     friend class FileBlockCache;
 
     spin_t lock;
-    // LRU List of clean blocks
-    struct list cleanBlocks;
+    // LRU lists of clean blocks for each segment
+    struct list windowBlocks;
+    struct list probationBlocks;
+    struct list protectedBlocks;
+    size_t numWindow;
+    size_t numProbation;
+    size_t numProtected;
     // Tree map of dirty data blocks
     std::map<bid_t, BlockCacheItem *> dirtyDataBlocks;
     // Tree map of dirty index blocks
@@ -145,15 +408,280 @@ private:
     block_map_t allBlocks;
 };
 
+/**
+ * Compressed tier of the block cache that keeps the clean blocks evicted from
+ * the uncompressed tier (see fdb_config.compressed_buffercache_size).
+ *
+ * Entries are spread over partitions by file and block ID, and each partition
+ * has its own lock, LRU list, and share of the memory budget, so that the
+ * entries of all the files age out together. Entries are only inserted while
+ * the shard lock of their block is grabbed (shard lock first, then partition
+ * lock), and a block is never in both tiers of a file at the same time.
+ */
+class CompressedBlockCache {
+public:
+    CompressedBlockCache(uint64_t capacity, uint32_t blocksize)
+        : blockSize(blocksize), numHits(0), numMisses(0), numPromotions(0),
+          numRejects(0), decompressionTime(0)
+    {
+        partitionCapacity = capacity / BCACHE_COMPRESSED_NPARTITIONS;
+        maxCompressedLen = blocksize * BCACHE_COMPRESSED_MAX_RATIO;
+        for (size_t i = 0; i < BCACHE_COMPRESSED_NPARTITIONS; ++i) {
+            Partition &part = partitions[i];
+            spin_init(&part.lock);
+            list_init(&part.lruList);
+            part.usage = 0;
+            part.rawBytes = 0;
+            part.compressedBytes = 0;
+        }
+    }
+
+    ~CompressedBlockCache() {
+        for (size_t i = 0; i < BCACHE_COMPRESSED_NPARTITIONS; ++i) {
+            Partition &part = partitions[i];
+            for (auto &entry : part.entries) {
+                free(entry.second);
+            }
+            spin_destroy(&part.lock);
+        }
+    }
+
+    /**
+     * Return the size of the buffer to be passed to compress().
+     */
+    size_t getMaxCompressedLength() const {
+#ifdef _DOC_COMP
+        return snappy_max_compressed_length(blockSize);
+#else
+        return blockSize;
+#endif
+    }
+
+    /**
+     * Compress a block.
+     *
+     * @return Length of the compressed data, or 0 if the block doesn't
+     *         compress well enough to be kept
+     */
+    size_t compress(const void *buf, void *comp_buf) {
+        size_t len = getMaxCompressedLength();
+#ifdef _DOC_COMP
+        if (snappy_compress(reinterpret_cast<const char *>(buf), blockSize,
+                            reinterpret_cast<char *>(comp_buf),
+                            &len) != SNAPPY_OK) {
+            len = 0;
+        }
+#else
+        (void)buf;
+        (void)comp_buf;
+        len = 0;
+#endif
+        if (len == 0 || len > maxCompressedLen) {
+            numRejects++;
+            return 0;
+        }
+        return len;
+    }
+
+    /**
+     * Insert a compressed block, evicting the LRU entries of the partition
+     * if it is full. Caller should grab the shard lock of the block.
+     */
+    void insert(FileBlockCache *fcache, bid_t bid,
+                const void *comp_buf, size_t len) {
+        size_t entry_size = sizeof(Entry) + len;
+        if (entry_size > partitionCapacity) {
+            return;
+        }
+        Entry *new_entry = reinterpret_cast<Entry *>(malloc(entry_size));
+        new_entry->key = entry_key_t(fcache, bid);
+        new_entry->len = len;
+        memcpy(new_entry->data, comp_buf, len);
+
+        Partition &part = getPartition(fcache, bid);
+        spin_lock(&part.lock);
+        auto existing = part.entries.find(new_entry->key);
+        if (existing != part.entries.end()) {
+            removeEntry(part, existing);
+        }
+        while (part.usage + entry_size > partitionCapacity) {
+            Entry *victim = reinterpret_cast<Entry *>(list_end(&part.lruList));
+            removeEntry(part, part.entries.find(victim->key));
+        }
+        part.entries.insert(std::make_pair(new_entry->key, new_entry));
+        list_push_front(&part.lruList, &new_entry->list_elem);
+        part.usage += entry_size;
+        part.rawBytes += blockSize;
+        part.compressedBytes += len;
+        spin_unlock(&part.lock);
+    }
+
+    /**
+     * Decompress a cached block into a given buffer. Caller should grab the
+     * shard lock of the block.
+     *
+     * @param remove true if the entry is to be dropped (i.e., promoted)
+     * @return true on a hit
+     */
+    bool read(FileBlockCache *fcache, bid_t bid, void *buf, bool remove) {
+        Partition &part = getPartition(fcache, bid);
+        bool hit = false;
+        spin_lock(&part.lock);
+        auto entry = part.entries.find(entry_key_t(fcache, bid));
+        if (entry != part.entries.end()) {
+            ts_nsec start = get_monotonic_ts();
+            hit = decompress(entry->second, buf);
+            decompressionTime += get_monotonic_ts() - start;
+            if (!hit || remove) {
+                removeEntry(part, entry);
+            } else {
+                list_remove(&part.lruList, &entry->second->list_elem);
+                list_push_front(&part.lruList, &entry->second->list_elem);
+            }
+        }
+        spin_unlock(&part.lock);
+
+        if (hit) {
+            numHits++;
+            if (remove) {
+                numPromotions++;
+            }
+        } else {
+            numMisses++;
+        }
+        return hit;
+    }
+
+    /**
+     * Drop the entry of a block, if any. Caller should grab the shard lock
+     * of the block.
+     */
+    void invalidate(FileBlockCache *fcache, bid_t bid) {
+        Partition &part = getPartition(fcache, bid);
+        spin_lock(&part.lock);
+        auto entry = part.entries.find(entry_key_t(fcache, bid));
+        if (entry != part.entries.end()) {
+            removeEntry(part, entry);
+        }
+        spin_unlock(&part.lock);
+    }
+
+    /**
+     * Drop all the entries of a file.
+     */
+    void removeFile(FileBlockCache *fcache) {
+        for (size_t i = 0; i < BCACHE_COMPRESSED_NPARTITIONS; ++i) {
+            Partition &part = partitions[i];
+            spin_lock(&part.lock);
+            auto entry = part.entries.lower_bound(entry_key_t(fcache, 0));
+            while (entry != part.entries.end() &&
+                   entry->first.first == fcache) {
+                entry = removeEntry(part, entry);
+            }
+            spin_unlock(&part.lock);
+        }
+    }
+
+    void getStats(bcache_compressed_stats &stats) {
+        memset(&stats, 0, sizeof(stats));
+        for (size_t i = 0; i < BCACHE_COMPRESSED_NPARTITIONS; ++i) {
+            Partition &part = partitions[i];
+            spin_lock(&part.lock);
+            stats.num_items += part.entries.size();
+            stats.raw_bytes += part.rawBytes;
+            stats.compressed_bytes += part.compressedBytes;
+            spin_unlock(&part.lock);
+        }
+        stats.num_hits = numHits.load(std::memory_order_relaxed);
+        stats.num_misses = numMisses.load(std::memory_order_relaxed);
+        stats.num_promotions = numPromotions.load(std::memory_order_relaxed);
+        stats.num_rejects = numRejects.load(std::memory_order_relaxed);
+        stats.decompression_ns =
+            decompressionTime.load(std::memory_order_relaxed);
+    }
+
+private:
+    typedef std::pair<FileBlockCache *, bid_t> entry_key_t;
+
+    struct Entry {
+        // LRU list elem (should be the first member)
+        struct list_elem list_elem;
+        entry_key_t key;
+        size_t len;
+        uint8_t data[1];
+    };
+
+    typedef std::map<entry_key_t, Entry *> entry_map_t;
+
+    struct Partition {
+        spin_t lock;
+        entry_map_t entries;
+        struct list lruList;
+        // Memory used by the entries including their headers
+        uint64_t usage;
+        uint64_t rawBytes;
+        uint64_t compressedBytes;
+    };
+
+    Partition &getPartition(FileBlockCache *fcache, bid_t bid) {
+        uint64_t h = bid ^ (reinterpret_cast<uintptr_t>(fcache) >> 4);
+        h = (h ^ (h >> 33)) * 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        return partitions[h % BCACHE_COMPRESSED_NPARTITIONS];
+    }
+
+    bool decompress(Entry *entry, void *buf) {
+#ifdef _DOC_COMP
+        size_t len = blockSize;
+        return snappy_uncompress(reinterpret_cast<const char *>(entry->data),
+                                 entry->len, reinterpret_cast<char *>(buf),
+                                 &len) == SNAPPY_OK &&
+               len == blockSize;
+#else
+        (void)entry;
+        (void)buf;
+        return false;
+#endif
+    }
+
+    // Caller should grab the partition lock.
+    entry_map_t::iterator removeEntry(Partition &part,
+                                      entry_map_t::iterator entry) {
+        Entry *item = entry->second;
+        list_remove(&part.lruList, &item->list_elem);
+        part.usage -= sizeof(Entry) + item->len;
+        part.rawBytes -= blockSize;
+        part.compressedBytes -= item->len;
+        free(item);
+        return part.entries.erase(entry);
+    }
+
+    uint32_t blockSize;
+    // Memory budget of each partition
+    uint64_t partitionCapacity;
+    // Blocks compressed to a larger size are not kept
+    size_t maxCompressedLen;
+    Partition partitions[BCACHE_COMPRESSED_NPARTITIONS];
+
+    std::atomic<uint64_t> numHits;
+    std::atomic<uint64_t> numMisses;
+    std::atomic<uint64_t> numPromotions;
+    std::atomic<uint64_t> numRejects;
+    std::atomic<uint64_t> decompressionTime;
+};
+
 FileBlockCache::FileBlockCache()
-    : curFile(NULL), refCount(0), numVictims(0), numItems(0), numImmutables(0),
+    : fileNameHash(0), curFile(NULL), refCount(0), numVictims(0),
+      numEvictions(0), numItems(0), numProtected(0), numImmutables(0),
       accessTimestamp(0), numShards(DEFAULT_NUM_BCACHE_PARTITIONS) { }
 
 FileBlockCache::FileBlockCache(std::string fname, FileMgr *file,
                                size_t num_shards)
-    : fileName(fname), curFile(file), refCount(0), numVictims(0), numItems(0),
-      numImmutables(0), accessTimestamp(0), numShards(num_shards)
+    : fileName(fname), curFile(file), refCount(0), numVictims(0),
+      numEvictions(0), numItems(0), numProtected(0), numImmutables(0),
+      accessTimestamp(0), numShards(num_shards)
 {
+    fileNameHash = hash_djb2((uint8_t *)fileName.c_str(), fileName.size());
     // Create a block cache shard instance.
     for (size_t i = 0; i < numShards; ++i) {
         BlockCacheShard *shard = new BlockCacheShard();
@@ -183,6 +711,10 @@ uint64_t FileBlockCache::getNumVictims(void) const {
     return numVictims;
 }
 
+uint64_t FileBlockCache::getNumEvictions(void) const {
+    return numEvictions;
+}
+
 uint64_t FileBlockCache::getNumItems(void) const {
     return numItems;
 }
@@ -231,7 +763,6 @@ void FileBlockCache::releaseAllShardLocks() {
     }
 }
 
-static const size_t MAX_VICTIM_SELECTIONS = 5;
 static const size_t MIN_TIMESTAMP_GAP = 15000; // 15 seconds
 
 #define BCACHE_DIRTY (0x1)
@@ -240,60 +771,52 @@ static const size_t MIN_TIMESTAMP_GAP = 15000; // 15 seconds
 
 FileBlockCache *BlockCacheManager::chooseEvictionVictim() {
     FileBlockCache *ret = NULL;
-    uint64_t max_items = 0;
+    FileBlockCache *victim_by_time = NULL;
+    FileBlockCache *victim_by_cold_items = NULL;
+    FileBlockCache *victim_by_items = NULL;
+    uint64_t cur_timestamp = gethrtime() / 1000000;
     uint64_t min_timestamp = static_cast<uint64_t>(-1);
-    uint64_t max_timestamp = 0;
-    uint64_t victim_timestamp;
-    uint64_t victim_num_items;
-    int victim_idx, victim_by_time, victim_by_items;
-    size_t num_attempts;
+    uint64_t max_cold_items = 0;
+    uint64_t max_items = 0;
 
     if (reader_lock(&fileListLock) == 0) {
-        // Pick the victim that has the oldest access timestamp
-        // among the files randomly selected, if the gap between
-        // the oldest and newest timestamps is greater than the threshold.
-        // Otherwise, pick the victim that has the largest number of
-        // cached items among the files.
-        num_attempts = fileList.size() / 10 + 1;
-        if (num_attempts > MAX_VICTIM_SELECTIONS) {
-            num_attempts = MAX_VICTIM_SELECTIONS;
-        } else {
-            if(num_attempts == 1 && fileList.size() > 1) {
-                ++num_attempts;
+        // All the files share the global cache budget. Pick the file that
+        // has the oldest access timestamp if it has not been accessed for
+        // longer than the threshold. Otherwise, pick the file that has the
+        // largest number of blocks outside of the protected segment, so that
+        // frequently accessed blocks are not evicted by a scan on another
+        // file. If all the blocks are protected, pick the file that has the
+        // largest number of cached items.
+        for (auto fcache : fileList) {
+            uint64_t num_items = fcache->numItems.load();
+            if (!num_items) {
+                continue;
             }
-        }
-
-        victim_by_time = victim_by_items = -1;
-
-        for (size_t i = 0; i < num_attempts && !fileList.empty(); ++i) {
-            victim_idx = rand() % fileList.size();
-            victim_timestamp = fileList[victim_idx]->getAccessTimestamp();
-            victim_num_items = fileList[victim_idx]->numItems;
-
-            if (victim_num_items) {
-                if (victim_timestamp < min_timestamp) {
-                    min_timestamp = victim_timestamp;
-                    victim_by_time = victim_idx;
-                }
-                if (victim_timestamp > max_timestamp) {
-                    max_timestamp = victim_timestamp;
-                }
-                if (victim_num_items > max_items) {
-                    max_items = victim_num_items;
-                    victim_by_items = victim_idx;
-                }
+            uint64_t timestamp = fcache->getAccessTimestamp();
+            if (timestamp + MIN_TIMESTAMP_GAP < cur_timestamp &&
+                timestamp < min_timestamp) {
+                min_timestamp = timestamp;
+                victim_by_time = fcache;
+            }
+            uint64_t num_protected = fcache->numProtected.load();
+            uint64_t num_cold_items = num_items > num_protected ?
+                                      num_items - num_protected : 0;
+            if (num_cold_items > max_cold_items) {
+                max_cold_items = num_cold_items;
+                victim_by_cold_items = fcache;
+            }
+            if (num_items > max_items) {
+                max_items = num_items;
+                victim_by_items = fcache;
             }
         }
 
-
-        if (max_timestamp - min_timestamp > MIN_TIMESTAMP_GAP) {
-            if (victim_by_time != -1) {
-                ret = fileList[victim_by_time];
-            }
+        if (victim_by_time) {
+            ret = victim_by_time;
+        } else if (victim_by_cold_items) {
+            ret = victim_by_cold_items;
         } else {
-            if (victim_by_items != -1) {
-                ret = fileList[victim_by_items];
-            }
+            ret = victim_by_items;
         }
 
         if (ret) {
@@ -308,6 +831,54 @@ FileBlockCache *BlockCacheManager::chooseEvictionVictim() {
     return ret;
 }
 
+uint32_t BlockCacheManager::estimateFrequency(FileBlockCache *fcache,
+                                              BlockCacheItem *item) {
+    uint64_t key = item->getBid() ^
+                   (static_cast<uint64_t>(fcache->fileNameHash) << 32);
+    uint32_t freq = freqSketch->estimate(key);
+#ifdef __BCACHE_SECOND_CHANCE
+    // b-tree nodes have priority over document blocks
+    freq += item->getScore();
+#endif
+    return freq;
+}
+
+void BlockCacheManager::insertCleanBlock(FileBlockCache *fcache,
+                                         BlockCacheShard *bshard,
+                                         BlockCacheItem *item) {
+    bshard->insertCleanBlock(item);
+
+    size_t window_limit = bshard->getNumCleanBlocks() * BCACHE_WINDOW_RATIO;
+    if (window_limit == 0) {
+        window_limit = 1;
+    }
+    while (bshard->numWindow > window_limit) {
+        // The LRU block of the window segment is admitted into the main
+        // segments only if it is accessed more frequently than the block
+        // that would be evicted next.
+        BlockCacheItem *candidate = bshard->getWindowTail();
+        BlockCacheItem *victim = bshard->getProbationTail();
+        bool admitted = !victim || estimateFrequency(fcache, candidate) >
+                                   estimateFrequency(fcache, victim);
+        bshard->moveToProbation(candidate, admitted);
+    }
+}
+
+BlockCacheItem *BlockCacheManager::evictCleanBlock(FileBlockCache *fcache,
+                                                   BlockCacheShard *bshard) {
+    BlockCacheItem *victim = bshard->getProbationTail();
+    if (!victim) {
+        victim = bshard->getWindowTail();
+    }
+    if (!victim) {
+        victim = bshard->getProtectedTail();
+    }
+    if (victim) {
+        bshard->removeCleanBlock(fcache, victim);
+    }
+    return victim;
+}
+
 BlockCacheItem *BlockCacheManager::getFreeBlock() {
     struct list_elem *elem = NULL;
 
@@ -335,6 +906,24 @@ void BlockCacheManager::addToFreeBlockList(BlockCacheItem *item) {
     spin_unlock(&freeListLock);
 }
 
+void BlockCacheManager::releaseBlock(BlockCacheItem *item) {
+    uint32_t state = item->pinState.fetch_or(BCACHE_PIN_RELEASE_PENDING);
+    if (!(state & BCACHE_PIN_COUNT_MASK)) {
+        item->pinState.store(0);
+        addToFreeBlockList(item);
+    }
+    // Otherwise, the last unpin() returns the block to the free list.
+}
+
+void BlockCacheManager::detachPinnedBlock(FileBlockCache *fcache,
+                                          BlockCacheShard *bshard,
+                                          BlockCacheItem *item) {
+    bshard->removeCleanBlock(fcache, item);
+    bshard->allBlocks.erase(item->getBid());
+    fcache->numItems--;
+    releaseBlock(item);
+}
+
 bool BlockCacheManager::freeFileBlockCache(FileBlockCache *fcache,
                                            bool force)
 {
@@ -353,6 +942,9 @@ bool BlockCacheManager::freeFileBlockCache(FileBlockCache *fcache,
         return false;
     }
 
+    if (compressedCache) {
+        compressedCache->removeFile(fcache);
+    }
     // free a file block cache
     delete fcache;
     return true;
@@ -383,7 +975,8 @@ void BlockCacheManager::cleanUpInvalidFileBlockCaches() {
 fdb_status BlockCacheManager::flushDirtyBlocks(FileBlockCache *fcache,
                                                bool sync,
                                                bool flush_all,
-                                               bool immutables_only) {
+                                               bool immutables_only,
+                                               uint64_t *num_flushed) {
     void *buf = NULL;
     std::map<bid_t, BlockCacheItem *> *shard_dirty_tree;
 
@@ -603,8 +1196,7 @@ fdb_status BlockCacheManager::flushDirtyBlocks(FileBlockCache *fcache,
         dirty_block->setFlag(dirty_block->getFlag() & ~(BCACHE_DIRTY));
         dirty_block->setFlag(dirty_block->getFlag() & ~(BCACHE_IMMUTABLE));
         // move to the shard clean block list.
-        list_push_front(&fcache->shards[shard_num]->cleanBlocks,
-                        &dirty_block->list_elem);
+        insertCleanBlock(fcache, fcache->shards[shard_num], dirty_block);
 
         fdb_assert(!(dirty_block->getFlag() & BCACHE_FREE),
                    dirty_block->getFlag(), BCACHE_FREE);
@@ -614,6 +1206,9 @@ fdb_status BlockCacheManager::flushDirtyBlocks(FileBlockCache *fcache,
         }
 
         count++;
+        if (sync && num_flushed) {
+            (*num_flushed)++;
+        }
         if (count * blockSize >= flushUnit && sync) {
             if (flush_all) {
                 if (o_direct) {
@@ -650,9 +1245,9 @@ fdb_status BlockCacheManager::flushDirtyBlocks(FileBlockCache *fcache,
     return status;
 }
 
-void BlockCacheManager::performEviction() {
+void BlockCacheManager::performEviction(FileBlockCache *fcache,
+                                        size_t shard_num) {
     size_t n_evict;
-    struct list_elem *elem = NULL;
     BlockCacheItem *item = NULL;
     FileBlockCache *victim = NULL;
 
@@ -678,15 +1273,39 @@ void BlockCacheManager::performEviction() {
 
     victim->numVictims++;
 
+    // Committed blocks are kept in the secondary cache once evicted; their
+    // content doesn't change until they are reused.
+    SecondaryCache *scache = SecondaryCache::getInstance();
+    FileMgr *victim_file = victim->getFileManager();
+    uint64_t scache_id = 0;
+    if (scache && victim_file) {
+        scache_id = victim_file->getSecondaryCacheId();
+    }
+    // copy of the evicted block to be written to the lower tiers
+    uint8_t *evicted_buf = NULL;
+    if (scache_id || compressedCache) {
+        evicted_buf = alca(uint8_t, blockSize);
+    }
+
     // select the clean blocks from the victim file
     n_evict = 0;
     while (n_evict < BCACHE_EVICT_UNIT) {
         size_t num_shards = victim->getNumShards();
-        size_t i = random(num_shards);
+        size_t i;
         bool found_victim_shard = false;
+
+        if (victim == fcache) {
+            // Start from the shard where the new block will be inserted, so
+            // that the admission decision made in the shard takes effect.
+            i = (shard_num + num_shards - 1) % num_shards;
+        } else {
+            i = random(num_shards);
+        }
         BlockCacheShard *bshard = NULL;
 
-        for (size_t to_visit = num_shards; to_visit; --to_visit) {
+        // Visit all the shards twice. In the first round, shards that only
+        // have the blocks in the protected segment are skipped.
+        for (size_t to_visit = num_shards * 2; to_visit; --to_visit) {
             i = (i + 1) % num_shards; // Round robin over empty shards..
             bshard = victim->shards[i];
             spin_lock(&bshard->lock);
@@ -695,7 +1314,7 @@ void BlockCacheManager::performEviction() {
                 continue;
             }
 
-            if (list_empty(&bshard->cleanBlocks)) {
+            if (!bshard->getNumCleanBlocks()) {
                 spin_unlock(&bshard->lock);
                 // When the victim shard has no clean block, evict some dirty blocks
                 // from shards.
@@ -707,27 +1326,19 @@ void BlockCacheManager::performEviction() {
                 continue; // Select a victim shard again.
             }
 
-            elem = list_pop_back(&bshard->cleanBlocks);
-            item = reinterpret_cast<BlockCacheItem *>(elem);
-#ifdef __BCACHE_SECOND_CHANCE
-            // repeat until zero-score item is found
-            if (item->getScore() == 0) {
-                found_victim_shard = true;
-                break;
-            } else {
-                // give second chance to the item
-                item->setScore(item->getScore() - 1);
-                list_push_front(&bshard->cleanBlocks, &item->list_elem);
+            if (to_visit > num_shards &&
+                bshard->getNumCleanBlocks() == bshard->numProtected) {
                 spin_unlock(&bshard->lock);
+                continue;
             }
-#else
+
+            item = evictCleanBlock(victim, bshard);
             found_victim_shard = true;
             break;
-#endif
         }
         if (!found_victim_shard) {
-            // We couldn't find any non-empty shards even after 'num_shards'
-            // attempts.
+            // We couldn't find any non-empty shards even after visiting all
+            // the shards.
             // The file is *likely* empty. Note that it is OK to return here
             // even if the file is not empty because the caller will retry again.
             victim->refCount--;
@@ -735,14 +1346,33 @@ void BlockCacheManager::performEviction() {
         }
 
         victim->numItems--;
+        victim->numEvictions++;
+        bid_t evicted_bid = item->getBid();
+        bool to_scache = scache_id && !victim_file->isWritable(evicted_bid);
+        if (evicted_buf) {
+            memcpy(evicted_buf, item->getBlockAddr(), blockSize);
+        }
         // remove from the shard block list
-        bshard->allBlocks.erase(item->getBid());
-        // add to the free block list
-        addToFreeBlockList(item);
+        bshard->allBlocks.erase(evicted_bid);
+        // add to the free block list (deferred until unpinned)
+        releaseBlock(item);
         n_evict++;
 
         spin_unlock(&bshard->lock);
 
+        if (compressedCache) {
+            // compress outside the shard lock
+            insertCompressed(victim, evicted_bid, evicted_buf);
+        }
+        if (to_scache) {
+            // write to the cache device outside the shard lock
+            scache->insert(scache_id, evicted_bid, evicted_buf, blockSize);
+            if (victim_file->isWritable(evicted_bid)) {
+                // reused while being inserted
+                victim_file->invalidateSecondaryCache(evicted_bid);
+            }
+        }
+
         if (victim->numItems.load() == 0) {
             break;
         }
@@ -849,6 +1479,9 @@ int BlockCacheManager::read(FileMgr *file,
     if (fcache) {
         // file exists
         fcache->setAccessTimestamp(gethrtime() / 1000000); // access timestamp in ms
+        // record the access regardless of cache hit or miss
+        freqSketch->increment(bid ^
+                              (static_cast<uint64_t>(fcache->fileNameHash) << 32));
 
         size_t shard_num = bid % fcache->getNumShards();
         spin_lock(&fcache->shards[shard_num]->lock);
@@ -866,13 +1499,10 @@ int BlockCacheManager::read(FileMgr *file,
                 return 0;
             }
 
-            // move the item to the head of list if the block is clean
+            // update the position of the item in the clean block lists
             // (don't care if the block is dirty)
             if (!(item->getFlag() & BCACHE_DIRTY)) {
-                // TODO: Scanning the list would cause some overhead. We need to devise
-                // the better data structure to provide a fast lookup for the clean list.
-                list_remove(&fcache->shards[shard_num]->cleanBlocks, &item->list_elem);
-                list_push_front(&fcache->shards[shard_num]->cleanBlocks, &item->list_elem);
+                fcache->shards[shard_num]->touchCleanBlock(fcache, item);
             }
 
             memcpy(buf, item->getBlockAddr(), blockSize);
@@ -884,6 +1514,9 @@ int BlockCacheManager::read(FileMgr *file,
         } else {
             // cache miss
             spin_unlock(&fcache->shards[shard_num]->lock);
+            if (compressedCache && readCompressed(file, fcache, bid, buf)) {
+                return blockSize;
+            }
         }
     }
 
@@ -891,6 +1524,95 @@ int BlockCacheManager::read(FileMgr *file,
     return 0;
 }
 
+bool BlockCacheManager::readCompressed(FileMgr *file,
+                                       FileBlockCache *fcache,
+                                       bid_t bid,
+                                       void *buf) {
+    // The access was already recorded by the caller.
+    uint64_t key = bid ^ (static_cast<uint64_t>(fcache->fileNameHash) << 32);
+    bool promote = freqSketch->estimate(key) >= BCACHE_COMPRESSED_PROMOTE_FREQ;
+
+    BlockCacheShard *bshard = fcache->shards[bid % fcache->getNumShards()];
+    spin_lock(&bshard->lock);
+    bool hit = compressedCache->read(fcache, bid, buf, promote);
+    spin_unlock(&bshard->lock);
+
+    if (hit && promote) {
+        // Move the block back to the uncompressed tier. Writers of the
+        // block are excluded by the caller as for a read from the disk.
+        write(file, bid, buf, BCACHE_REQ_CLEAN, false);
+    }
+    return hit;
+}
+
+void BlockCacheManager::insertCompressed(FileBlockCache *fcache,
+                                         bid_t bid,
+                                         const void *buf) {
+    uint8_t *comp_buf = alca(uint8_t,
+                             compressedCache->getMaxCompressedLength());
+    size_t len = compressedCache->compress(buf, comp_buf);
+    if (!len) {
+        return;
+    }
+
+    BlockCacheShard *bshard = fcache->shards[bid % fcache->getNumShards()];
+    spin_lock(&bshard->lock);
+    if (bshard->allBlocks.find(bid) == bshard->allBlocks.end()) {
+        compressedCache->insert(fcache, bid, comp_buf, len);
+    } // Otherwise, the block was read or written again while compressed.
+    spin_unlock(&bshard->lock);
+}
+
+bool BlockCacheManager::getCompressedStats(bcache_compressed_stats &stats) {
+    if (!compressedCache) {
+        return false;
+    }
+    compressedCache->getStats(stats);
+    return true;
+}
+
+void *BlockCacheManager::pin(FileMgr *file,
+                            bid_t bid,
+                            void **pin_handle) {
+    FileBlockCache *fcache = file->getBCache();
+    void *addr = NULL;
+
+    if (fcache) {
+        fcache->setAccessTimestamp(gethrtime() / 1000000); // access timestamp in ms
+        freqSketch->increment(bid ^
+                              (static_cast<uint64_t>(fcache->fileNameHash) << 32));
+
+        size_t shard_num = bid % fcache->getNumShards();
+        spin_lock(&fcache->shards[shard_num]->lock);
+
+        auto block_entry = fcache->shards[shard_num]->allBlocks.find(bid);
+        if (block_entry != fcache->shards[shard_num]->allBlocks.end()) {
+            BlockCacheItem *item = block_entry->second;
+            // Only clean blocks can be pinned, as dirty blocks are still
+            // being written.
+            if (!(item->getFlag() & (BCACHE_DIRTY | BCACHE_FREE))) {
+                fcache->shards[shard_num]->touchCleanBlock(fcache, item);
+                setScore(*item);
+                item->pinState++;
+                *pin_handle = item;
+                addr = item->getBlockAddr();
+            }
+        }
+        spin_unlock(&fcache->shards[shard_num]->lock);
+    }
+    return addr;
+}
+
+void BlockCacheManager::unpin(void *pin_handle) {
+    BlockCacheItem *item = reinterpret_cast<BlockCacheItem *>(pin_handle);
+    uint32_t state = item->pinState.fetch_sub(1);
+    if (state == (BCACHE_PIN_RELEASE_PENDING | 1)) {
+        // The block was already released from the cache.
+        item->pinState.store(0);
+        addToFreeBlockList(item);
+    }
+}
+
 bool BlockCacheManager::invalidateBlock(FileMgr *file,
                                         bid_t bid) {
     FileBlockCache *fcache;
@@ -909,6 +1631,10 @@ bool BlockCacheManager::invalidateBlock(FileMgr *file,
         size_t shard_num = bid % fcache->getNumShards();
         spin_lock(&fcache->shards[shard_num]->lock);
 
+        if (compressedCache) {
+            compressedCache->invalidate(fcache, bid);
+        }
+
         // search BHASH
         auto block_entry = fcache->shards[shard_num]->allBlocks.find(bid);
         if (block_entry != fcache->shards[shard_num]->allBlocks.end()) {
@@ -929,11 +1655,11 @@ bool BlockCacheManager::invalidateBlock(FileMgr *file,
                 // remove from the shard block list
                 fcache->shards[shard_num]->allBlocks.erase(bid);
                 // remove from the shard clean list
-                list_remove(&fcache->shards[shard_num]->cleanBlocks, &item->list_elem);
+                fcache->shards[shard_num]->removeCleanBlock(fcache, item);
                 spin_unlock(&fcache->shards[shard_num]->lock);
 
                 // add the block to the global free list
-                addToFreeBlockList(item);
+                releaseBlock(item);
                 ret = true;
             } else {
                 // stale index node block
@@ -976,20 +1702,41 @@ int BlockCacheManager::write(FileMgr *file,
     size_t shard_num = bid % fcache->getNumShards();
     spin_lock(&fcache->shards[shard_num]->lock);
 
+    if (compressedCache) {
+        // the compressed copy, if any, is either stale or promoted
+        compressedCache->invalidate(fcache, bid);
+    }
+
     // search shard hash table
     auto block_entry = fcache->shards[shard_num]->allBlocks.find(bid);
+    if (block_entry != fcache->shards[shard_num]->allBlocks.end() &&
+        block_entry->second->isPinned()) {
+        // The content of a pinned block should not be changed under its
+        // readers. Detach it and write into a new block instead.
+        detachPinnedBlock(fcache, fcache->shards[shard_num],
+                          block_entry->second);
+        block_entry = fcache->shards[shard_num]->allBlocks.end();
+    }
     if (block_entry == fcache->shards[shard_num]->allBlocks.end()) {
         // cache miss
         // get a block from the free list
         while ((item = getFreeBlock()) == NULL) {
             // no free block .. perform eviction
             spin_unlock(&fcache->shards[shard_num]->lock);
-            performEviction();
+            LATENCY_STAT_START();
+            performEviction(fcache, shard_num);
+            LATENCY_STAT_END(file, FDB_LATENCY_BCACHE_EVICT);
             spin_lock(&fcache->shards[shard_num]->lock);
         }
 
         // re-search hash table
         block_entry = fcache->shards[shard_num]->allBlocks.find(bid);
+        if (block_entry != fcache->shards[shard_num]->allBlocks.end() &&
+            block_entry->second->isPinned()) {
+            detachPinnedBlock(fcache, fcache->shards[shard_num],
+                              block_entry->second);
+            block_entry = fcache->shards[shard_num]->allBlocks.end();
+        }
         if (block_entry == fcache->shards[shard_num]->allBlocks.end()) {
             // insert into hash table
             item->setBid(bid);
@@ -1011,9 +1758,11 @@ int BlockCacheManager::write(FileMgr *file,
         fcache->numItems++;
     }
 
-    // remove from the list if the block is in clean list
-    if (!(item->getFlag() & BCACHE_DIRTY) && !(item->getFlag() & BCACHE_FREE)) {
-        list_remove(&fcache->shards[shard_num]->cleanBlocks, &item->list_elem);
+    bool in_clean_list = !(item->getFlag() & BCACHE_DIRTY) &&
+                         !(item->getFlag() & BCACHE_FREE);
+    // remove from the list if the block is in clean list and becomes dirty
+    if (in_clean_list && dirty == BCACHE_REQ_DIRTY) {
+        fcache->shards[shard_num]->removeCleanBlock(fcache, item);
     }
     item->setFlag(item->getFlag() & ~BCACHE_FREE);
 
@@ -1042,9 +1791,10 @@ int BlockCacheManager::write(FileMgr *file,
     } else {
         // CLEAN request
         // insert into clean list only when it was originally clean
-        if (!(item->getFlag() & BCACHE_DIRTY)) {
-            list_push_front(&fcache->shards[shard_num]->cleanBlocks, &item->list_elem);
-            item->setFlag(item->getFlag() & ~(BCACHE_DIRTY));
+        if (in_clean_list) {
+            fcache->shards[shard_num]->touchCleanBlock(fcache, item);
+        } else if (!(item->getFlag() & BCACHE_DIRTY)) {
+            insertCleanBlock(fcache, fcache->shards[shard_num], item);
         }
     }
 
@@ -1094,6 +1844,15 @@ int BlockCacheManager::writePartial(FileMgr *file,
         item = block_entry->second;
     }
 
+    if (item->isPinned()) {
+        // The content of a pinned block should not be changed under its
+        // readers. Detach it and let the caller write a whole block instead,
+        // which is safe as a pinned block is always clean.
+        detachPinnedBlock(fcache, fcache->shards[shard_num], item);
+        spin_unlock(&fcache->shards[shard_num]->lock);
+        return 0;
+    }
+
     if (item->getFlag() & BCACHE_FREE) {
         DBG("Warning: failed to write on the buffer cache entry for a file '%s' "
             "because the entry belongs to the free list!\n",
@@ -1105,7 +1864,7 @@ int BlockCacheManager::writePartial(FileMgr *file,
     // to avoid re-inserting the existing item into the dirty block list
     if (!(item->getFlag() & BCACHE_DIRTY)) {
         // This block was a clean block. Remove it from the clean block list
-        list_remove(&fcache->shards[shard_num]->cleanBlocks, &item->list_elem);
+        fcache->shards[shard_num]->removeCleanBlock(fcache, item);
 
         // Insert into the dirty data or index block tree
         uint8_t marker = *((uint8_t*)item->getBlockAddr() + blockSize - 1);
@@ -1150,7 +1909,9 @@ fdb_status BlockCacheManager::flushImmutable(FileMgr *file) {
     fcache = file->getBCache();
 
     if (fcache) {
-        status = flushDirtyBlocks(fcache, true, true, true);
+        uint64_t num_flushed = 0;
+        status = flushDirtyBlocks(fcache, true, true, true, &num_flushed);
+        IoRateLimiter::request(FDB_IO_BG_WRITE, num_flushed * blockSize);
     }
     return status;
 }
@@ -1173,7 +1934,6 @@ void BlockCacheManager::removeDirtyBlocks(FileMgr *file) {
 
 // remove all clean blocks of the FILE
 void BlockCacheManager::removeCleanBlocks(FileMgr *file) {
-    struct list_elem *elem;
     BlockCacheItem *item;
     FileBlockCache *fcache;
 
@@ -1188,19 +1948,22 @@ void BlockCacheManager::removeCleanBlocks(FileMgr *file) {
         size_t i = 0;
         for (; i < fcache->getNumShards(); ++i) {
             spin_lock(&fcache->shards[i]->lock);
-            elem = list_begin(&fcache->shards[i]->cleanBlocks);
-            while (elem) {
-                item = reinterpret_cast<BlockCacheItem *>(elem);
+            while ((item = fcache->shards[i]->getProbationTail()) ||
+                   (item = fcache->shards[i]->getProtectedTail()) ||
+                   (item = fcache->shards[i]->getWindowTail())) {
                 // remove from clean block list
-                elem = list_remove(&fcache->shards[i]->cleanBlocks, elem);
+                fcache->shards[i]->removeCleanBlock(fcache, item);
                 // remove from the all block list
                 fcache->shards[i]->allBlocks.erase(item->getBid());
                 fcache->numItems--;
                 // insert into the free block list
-                addToFreeBlockList(item);
+                releaseBlock(item);
             }
             spin_unlock(&fcache->shards[i]->lock);
         }
+        if (compressedCache) {
+            compressedCache->removeFile(fcache);
+        }
     }
 }
 
@@ -1254,12 +2017,19 @@ fdb_status BlockCacheManager::flush(FileMgr *file) {
         // Note that this function is invoked as part of a commit operation while
         // the filemgr's lock is already grabbed by a committer.
         // Therefore, we don't need to grab all the shard locks at once.
-        status = flushDirtyBlocks(fcache, true, true, false);
+        uint64_t num_flushed = 0;
+        status = flushDirtyBlocks(fcache, true, true, false, &num_flushed);
+        // Background tasks already charge their writes to the rate limiter
+        // as they append them, so only the foreground commits are paced here.
+        if (!IoRateLimiter::isBackgroundThread()) {
+            IoRateLimiter::request(FDB_IO_FG_COMMIT, num_flushed * blockSize);
+        }
     }
     return status;
 }
 
-BlockCacheManager::BlockCacheManager(uint64_t nblock, uint32_t blocksize) {
+BlockCacheManager::BlockCacheManager(uint64_t nblock, uint32_t blocksize,
+                                     uint64_t compressed_size) {
     BlockCacheItem *item;
     uint8_t *block_ptr;
 
@@ -1290,16 +2060,30 @@ BlockCacheManager::BlockCacheManager(uint64_t nblock, uint32_t blocksize) {
         list_push_front(&freeList, &item->list_elem);
         freeListCount++;
     }
+
+    freqSketch = new BlockFrequencySketch(numBlocks);
+
+    compressedCache = NULL;
+    if (compressed_size) {
+#ifdef _DOC_COMP
+        compressedCache = new CompressedBlockCache(compressed_size, blockSize);
+#else
+        fdb_log(NULL, FDB_RESULT_INVALID_CONFIG,
+                "The compressed tier of the block cache is disabled as "
+                "ForestDB is built without snappy.");
+#endif
+    }
 }
 
-BlockCacheManager* BlockCacheManager::init(uint64_t nblock, uint32_t blocksize) {
+BlockCacheManager* BlockCacheManager::init(uint64_t nblock, uint32_t blocksize,
+                                           uint64_t compressed_size) {
     BlockCacheManager* tmp = instance.load();
     if (tmp == nullptr) {
         // Ensure two threads don't both create an instance.
         LockHolder lock(instanceMutex);
         tmp = instance.load();
         if (tmp == nullptr) {
-            tmp = new BlockCacheManager(nblock, blocksize);
+            tmp = new BlockCacheManager(nblock, blocksize, compressed_size);
             instance.store(tmp);
         }
     }
@@ -1344,6 +2128,7 @@ BlockCacheManager::~BlockCacheManager() {
 
     // Free entire buffer cache memory
     free(bufferCache);
+    delete freqSketch;
 
     spin_lock(&bcacheLock);
     for (auto &file_entry : fileMap) {
@@ -1351,6 +2136,8 @@ BlockCacheManager::~BlockCacheManager() {
     }
     spin_unlock(&bcacheLock);
 
+    delete compressedCache;
+
     spin_destroy(&bcacheLock);
     spin_destroy(&freeListLock);
 
@@ -1379,6 +2166,124 @@ uint64_t BlockCacheManager::getNumBlocks(FileMgr *file) {
     return 0;
 }
 
+struct bcache_hot_block {
+    bid_t bid;
+    // segment rank: protected > probation > window
+    int segment;
+    uint32_t freq;
+    // recency rank within the shard's segment (0: MRU)
+    size_t recency;
+};
+
+static bool _bcache_hot_block_cmp(const bcache_hot_block &a,
+                                  const bcache_hot_block &b) {
+    if (a.segment != b.segment) {
+        return a.segment > b.segment;
+    }
+    if (a.freq != b.freq) {
+        return a.freq > b.freq;
+    }
+    return a.recency < b.recency;
+}
+
+void BlockCacheManager::getHotBlocks(FileMgr *file,
+                                     size_t max_blocks,
+                                     std::vector<bid_t> &bids) {
+    FileBlockCache *fcache = file->getBCache();
+    if (!fcache || !max_blocks) {
+        return;
+    }
+
+    std::vector<bcache_hot_block> blocks;
+    for (size_t i = 0; i < fcache->getNumShards(); ++i) {
+        BlockCacheShard *bshard = fcache->shards[i];
+        struct list *segments[] = {&bshard->windowBlocks,
+                                   &bshard->probationBlocks,
+                                   &bshard->protectedBlocks};
+        spin_lock(&bshard->lock);
+        for (int seg = 0; seg < 3; ++seg) {
+            size_t recency = 0;
+            // each list is ordered from MRU to LRU
+            for (struct list_elem *e = list_begin(segments[seg]); e;
+                 e = list_next(e)) {
+                BlockCacheItem *item = reinterpret_cast<BlockCacheItem *>(e);
+                bcache_hot_block block = {item->getBid(), seg,
+                                          estimateFrequency(fcache, item),
+                                          recency++};
+                blocks.push_back(block);
+            }
+        }
+        spin_unlock(&bshard->lock);
+    }
+
+    if (blocks.size() > max_blocks) {
+        std::partial_sort(blocks.begin(), blocks.begin() + max_blocks,
+                          blocks.end(), _bcache_hot_block_cmp);
+        blocks.resize(max_blocks);
+    } else {
+        std::sort(blocks.begin(), blocks.end(), _bcache_hot_block_cmp);
+    }
+    bids.reserve(bids.size() + blocks.size());
+    for (auto &block : blocks) {
+        bids.push_back(block.bid);
+    }
+}
+
+bool BlockCacheManager::isCached(FileMgr *file, bid_t bid) {
+    FileBlockCache *fcache = file->getBCache();
+    if (!fcache) {
+        return false;
+    }
+
+    size_t shard_num = bid % fcache->getNumShards();
+    spin_lock(&fcache->shards[shard_num]->lock);
+    bool ret = fcache->shards[shard_num]->allBlocks.find(bid) !=
+               fcache->shards[shard_num]->allBlocks.end();
+    spin_unlock(&fcache->shards[shard_num]->lock);
+    return ret;
+}
+
+int BlockCacheManager::warmUp(FileMgr *file,
+                              bid_t bid,
+                              void *buf) {
+    FileBlockCache *fcache = file->getBCache();
+    if (fcache == NULL) {
+        spin_lock(&bcacheLock);
+        fcache = file->getBCache();
+        if (fcache == NULL) {
+            fcache = createFileBlockCache(file);
+        }
+        spin_unlock(&bcacheLock);
+    }
+
+    size_t shard_num = bid % fcache->getNumShards();
+    BlockCacheShard *bshard = fcache->shards[shard_num];
+    spin_lock(&bshard->lock);
+    if (bshard->allBlocks.find(bid) != bshard->allBlocks.end()) {
+        spin_unlock(&bshard->lock);
+        return 0;
+    }
+    BlockCacheItem *item = getFreeBlock();
+    if (!item) {
+        spin_unlock(&bshard->lock);
+        return -1;
+    }
+    if (compressedCache) {
+        compressedCache->invalidate(fcache, bid);
+    }
+
+    item->setBid(bid);
+    item->setFlag(0x0);
+    bshard->allBlocks.insert(std::make_pair(bid, item));
+    fcache->numItems++;
+    memcpy(item->getBlockAddr(), buf, blockSize);
+    setScore(*item);
+    insertCleanBlock(fcache, bshard, item);
+    spin_unlock(&bshard->lock);
+
+    return blockSize;
+}
+
 uint64_t BlockCacheManager::getNumImmutables(FileMgr *file) {
     FileBlockCache *fcache = file->getBCache();
     if (fcache) {
@@ -1423,26 +2328,31 @@ void BlockCacheManager::printItems() {
 
         size_t i = 0;
         for (; i < fcache->getNumShards(); ++i) {
-            elem = list_begin(&fcache->shards[i]->cleanBlocks);
-            while (elem) {
-                item = reinterpret_cast<BlockCacheItem *>(elem);
-                scores[item->getScore()]++;
-                scores_local[item->getScore()]++;
-                nitems++;
-                nfileitems++;
-                nclean++;
+            struct list *clean_lists[] = {&fcache->shards[i]->windowBlocks,
+                                          &fcache->shards[i]->probationBlocks,
+                                          &fcache->shards[i]->protectedBlocks};
+            for (auto clean_list : clean_lists) {
+                elem = list_begin(clean_list);
+                while (elem) {
+                    item = reinterpret_cast<BlockCacheItem *>(elem);
+                    scores[item->getScore()]++;
+                    scores_local[item->getScore()]++;
+                    nitems++;
+                    nfileitems++;
+                    nclean++;
 #ifdef __CRC32
-                ptr = (uint8_t*)item->getBlockAddr() + blockSize - 1;
-                switch (*ptr) {
-                case BLK_MARKER_BNODE:
-                    bnodes_local++;
-                    break;
-                case BLK_MARKER_DOC:
-                    docs_local++;
-                    break;
-                }
+                    ptr = (uint8_t*)item->getBlockAddr() + blockSize - 1;
+                    switch (*ptr) {
+                    case BLK_MARKER_BNODE:
+                        bnodes_local++;
+                        break;
+                    case BLK_MARKER_DOC:
+                        docs_local++;
+                        break;
+                    }
 #endif
-                elem = list_next(elem);
+                    elem = list_next(elem);
+                }
             }
 
             for (auto &data_entry : fcache->shards[i]->dirtyDataBlocks) {
@@ -33,6 +33,28 @@ typedef enum {
 
 class BlockCacheItem;
 class BlockCacheShard;
+class BlockFrequencySketch;
+class CompressedBlockCache;
+
+/**
+ * Stats of the compressed tier of the block cache.
+ */
+struct bcache_compressed_stats {
+    // Number of blocks in the compressed tier
+    uint64_t num_items;
+    // Size of those blocks before and after the compression
+    uint64_t raw_bytes;
+    uint64_t compressed_bytes;
+    // Lookups on a miss in the uncompressed tier
+    uint64_t num_hits;
+    uint64_t num_misses;
+    // Blocks moved back to the uncompressed tier
+    uint64_t num_promotions;
+    // Evicted blocks that were not kept as they don't compress well
+    uint64_t num_rejects;
+    // Total time spent on the decompression of the blocks hit
+    uint64_t decompression_ns;
+};
 
 // Block cache file map with a file name as a key.
 typedef std::unordered_map<std::string, FileBlockCache *> bcache_file_map;
@@ -53,6 +75,8 @@ public:
 
     uint64_t getNumVictims(void) const;
 
+    uint64_t getNumEvictions(void) const;
+
     uint64_t getNumItems(void) const;
 
     uint64_t getNumImmutables(void) const;
@@ -76,8 +100,12 @@ public:
 
 private:
     friend class BlockCacheManager;
+    friend class BlockCacheShard;
 
     std::string fileName;
+    // Hash value of the file name, used to identify blocks across files
+    // in the global access frequency sketch.
+    uint32_t fileNameHash;
     // File manager instance
     // (can be changed on-the-fly when file is closed and re-opened)
     FileMgr *curFile;
@@ -86,7 +114,11 @@ private:
 
     std::atomic<uint32_t> refCount;
     std::atomic<uint64_t> numVictims;
+    // Number of blocks evicted from this file
+    std::atomic<uint64_t> numEvictions;
     std::atomic<uint64_t> numItems;
+    // Number of clean blocks in the protected segments of all shards
+    std::atomic<uint64_t> numProtected;
     std::atomic<uint64_t> numImmutables;
     std::atomic<uint64_t> accessTimestamp;
     size_t numShards;
@@ -105,10 +137,13 @@ public:
      *
      * @param nblock Number of blocks to be allocated in the cache
      * @param blocksize Size of each block in the cache
+     * @param compressed_size Size of the compressed tier in bytes, or 0 if
+     *        the evicted blocks are not kept compressed
      * @return Pointer to the block cache manager
      */
     static BlockCacheManager* init(uint64_t nblock,
-                                   uint32_t blocksize);
+                                   uint32_t blocksize,
+                                   uint64_t compressed_size = 0);
 
     /**
      * Get the singleton instance of the block cache manager.
@@ -142,6 +177,29 @@ public:
              bid_t bid,
              void *buf);
 
+    /**
+     * Pin a given clean block in the block cache, so that its memory is
+     * neither evicted nor overwritten until it is unpinned. A pinned block
+     * can still be evicted or replaced in the cache, but its memory is
+     * returned to the free list only after the last unpin.
+     *
+     * @param file Pointer to the file manager instance
+     * @param bid ID of a block to be pinned
+     * @param pin_handle Pointer to the handle to be passed to unpin()
+     * @return Address of the cached block, or NULL if the block is not cached
+     *         or is dirty.
+     */
+    void *pin(FileMgr *file,
+              bid_t bid,
+              void **pin_handle);
+
+    /**
+     * Unpin a block pinned by pin().
+     *
+     * @param pin_handle Handle returned by pin()
+     */
+    void unpin(void *pin_handle);
+
     /**
      * Invalidate a given cached block and return its memory to the free list
      * to be used for future allocations.
@@ -246,6 +304,45 @@ public:
      */
     uint64_t getNumImmutables(FileMgr *file);
 
+    /**
+     * Return the IDs of the clean blocks of a given file that are cached,
+     * from the most valuable one to keep to the least: the blocks of the
+     * protected segment come first, then those of the probation and window
+     * segments, each ordered by access frequency and then by recency.
+     *
+     * @param file Pointer to the file manager instance
+     * @param max_blocks Maximum number of block IDs to be returned
+     * @param bids Vector where the block IDs are returned
+     */
+    void getHotBlocks(FileMgr *file,
+                      size_t max_blocks,
+                      std::vector<bid_t> &bids);
+
+    /**
+     * Check if a given block is in the block cache.
+     *
+     * @param file Pointer to the file manager instance
+     * @param bid ID of a block to be checked
+     * @return true if the block is cached
+     */
+    bool isCached(FileMgr *file,
+                  bid_t bid);
+
+    /**
+     * Insert a clean block that is read ahead of its use into the block
+     * cache, unless it is already cached. Unlike write(), no cached block is
+     * evicted to make room for it.
+     *
+     * @param file Pointer to the file manager instance
+     * @param bid ID of block to be inserted
+     * @param buf Pointer to the buffer containing the block content
+     * @return Number of bytes written into the cache, 0 if the block is
+     *         already cached, or -1 if the cache has no free block
+     */
+    int warmUp(FileMgr *file,
+               bid_t bid,
+               void *buf);
+
     /**
      * Return the number of blocks in the block cache's free list.
      *
@@ -254,6 +351,14 @@ public:
         return freeListCount;
     }
 
+    /**
+     * Return the stats of the compressed tier.
+     *
+     * @param stats Reference to the stats to be filled
+     * @return false if the compressed tier is disabled
+     */
+    bool getCompressedStats(bcache_compressed_stats &stats);
+
     /**
      * Print the stats summary of the block cache.
      */
@@ -265,8 +370,38 @@ private:
      *
      * @param nblock Number of blocks to be allocated in the cache
      * @param blocksize Size of each block in the cache
+     * @param compressed_size Size of the compressed tier in bytes
+     */
+    BlockCacheManager(uint64_t nblock, uint32_t blocksize,
+                      uint64_t compressed_size);
+
+    /**
+     * Read a block from the compressed tier on a miss in the uncompressed
+     * tier. A block accessed frequently enough is moved back to the
+     * uncompressed tier.
+     *
+     * @param file Pointer to the file manager instance
+     * @param fcache Pointer to the file block cache of the file
+     * @param bid ID of a block to be read
+     * @param buf Pointer to the read buffer
+     * @return true if the block is found in the compressed tier
      */
-    BlockCacheManager(uint64_t nblock, uint32_t blocksize);
+    bool readCompressed(FileMgr *file,
+                        FileBlockCache *fcache,
+                        bid_t bid,
+                        void *buf);
+
+    /**
+     * Keep a compressed copy of a clean block that was just evicted, unless
+     * the block was cached again in the meantime.
+     *
+     * @param fcache Pointer to the file block cache that owned the block
+     * @param bid ID of the evicted block
+     * @param buf Pointer to the content of the evicted block
+     */
+    void insertCompressed(FileBlockCache *fcache,
+                          bid_t bid,
+                          const void *buf);
 
     ~BlockCacheManager();
 
@@ -284,6 +419,27 @@ private:
      */
     void addToFreeBlockList(BlockCacheItem *item);
 
+    /**
+     * Return a cache item detached from its shard to the free block list,
+     * or defer it until the last unpin if the item is pinned.
+     *
+     * @param item Pointer to a cache item to be released
+     */
+    void releaseBlock(BlockCacheItem *item);
+
+    /**
+     * Detach a pinned clean block from a given shard, so that its content
+     * is kept intact while a new block is cached for the same block ID.
+     * Caller should grab the shard lock before calling this function.
+     *
+     * @param fcache Pointer to the file block cache that owns the shard
+     * @param bshard Pointer to the shard where the block belongs to
+     * @param item Pinned clean block to be detached
+     */
+    void detachPinnedBlock(FileBlockCache *fcache,
+                           BlockCacheShard *bshard,
+                           BlockCacheItem *item);
+
     /**
      * Create a file block cache for a given file.
      *
@@ -325,8 +481,13 @@ private:
     /**
      * Perform cache eviction.
      *
+     * @param fcache Pointer to the file block cache where a new block is
+     *        going to be inserted
+     * @param shard_num Index of the shard where a new block is going to be
+     *        inserted. If the given file is chosen as a victim, eviction
+     *        starts from this shard.
      */
-    void performEviction();
+    void performEviction(FileBlockCache *fcache, size_t shard_num);
 
     /**
      * Choose a file block cache that is goint to be a victim for eviction.
@@ -335,6 +496,45 @@ private:
      */
     FileBlockCache *chooseEvictionVictim();
 
+    /**
+     * Insert a new clean block into the window segment of a given shard.
+     * If the window segment overflows, its LRU block is moved to the
+     * probation segment, either to the MRU end if its estimated access
+     * frequency is higher than that of the next eviction victim, or to the
+     * LRU end otherwise. Caller should grab the shard lock before calling
+     * this function.
+     *
+     * @param fcache Pointer to the file block cache that owns the shard
+     * @param bshard Pointer to the shard where the block is inserted
+     * @param item Clean block to be inserted
+     */
+    void insertCleanBlock(FileBlockCache *fcache,
+                          BlockCacheShard *bshard,
+                          BlockCacheItem *item);
+
+    /**
+     * Pick a clean block to be evicted from a given shard and detach it from
+     * the shard's clean block lists. The LRU block of the probation segment
+     * is chosen first, followed by the window and protected segments.
+     * Caller should grab the shard lock before calling this function.
+     *
+     * @param fcache Pointer to the file block cache that owns the shard
+     * @param bshard Pointer to the shard whose clean block is evicted
+     * @return Pointer to the evicted block, or NULL if the shard has no
+     *         clean block
+     */
+    BlockCacheItem *evictCleanBlock(FileBlockCache *fcache,
+                                    BlockCacheShard *bshard);
+
+    /**
+     * Return the estimated access frequency of a given cache item.
+     *
+     * @param fcache Pointer to the file block cache that owns the item
+     * @param item Cache item whose access frequency is estimated
+     * @return Estimated access frequency
+     */
+    uint32_t estimateFrequency(FileBlockCache *fcache, BlockCacheItem *item);
+
     /**
      * Flush some dirty blocks from a given file block cache
      *
@@ -342,12 +542,14 @@ private:
      * @param sync True if dirty blocks should be flushed into disk
      * @param flush_all True if all the dirty blocks should be flushed
      * @param immutable_only True if only immutable dirty blocks should be flushed
+     * @param num_flushed Incremented by the number of blocks written to disk
      * @return FDB_RESULT_SUCCESS if flush is successful
      */
     fdb_status flushDirtyBlocks(FileBlockCache *fcache,
                                 bool sync,
                                 bool flush_all,
-                                bool immutables_only);
+                                bool immutables_only,
+                                uint64_t *num_flushed = NULL);
 
 
     // Singleton block cache manager and mutex guarding it's creation.
@@ -381,6 +583,12 @@ private:
     size_t flushUnit;
     // Pointer to the block cache memory
     void *bufferCache;
+    // Approximate access frequencies of all the blocks (including the blocks
+    // evicted recently) used for the cache admission.
+    BlockFrequencySketch *freqSketch;
+    // Compressed copies of the clean blocks evicted from the cache
+    // (NULL if disabled)
+    CompressedBlockCache *compressedCache;
 
     DISALLOW_COPY_AND_ASSIGN(BlockCacheManager);
 };
@@ -0,0 +1,338 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2016 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "bloom_filter.h"
+#include "forestdb_endian.h"
+
+#define BLOOM_LAYER_HEADER_SIZE (32)
+#define BLOOM_DIR_HEADER_SIZE (8)
+
+static uint32_t _bloom_num_hashes(uint32_t bits_per_key)
+{
+    // k = ln(2) * (bits per key) minimizes the false positive rate
+    uint32_t k = (bits_per_key * 69 + 50) / 100;
+    if (k < 1) {
+        k = 1;
+    } else if (k > 30) {
+        k = 30;
+    }
+    return k;
+}
+
+BloomFilterLayer::BloomFilterLayer(uint64_t _capacity, uint32_t _bits_per_key)
+    : offset(BLK_NOT_FOUND), dirty(true), capacity(_capacity), numKeys(0),
+      bitsPerKey(_bits_per_key)
+{
+    numBits = capacity * bitsPerKey;
+    // round up to a multiple of 64 bits
+    numBits = ((numBits + 63) / 64) * 64;
+    if (numBits == 0) {
+        numBits = 64;
+    }
+    numHashes = _bloom_num_hashes(bitsPerKey);
+    size_t nwords = numBits / 64;
+    words = new std::atomic<uint64_t>[nwords];
+    for (size_t i = 0; i < nwords; ++i) {
+        words[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+BloomFilterLayer::~BloomFilterLayer()
+{
+    delete[] words;
+}
+
+bool BloomFilterLayer::mayContain(uint64_t hash) const
+{
+    // double hashing: probe i is at (h1 + i * h2)
+    uint64_t h1 = hash;
+    uint64_t h2 = ((hash >> 32) | (hash << 32)) | 0x1;
+    for (uint32_t i = 0; i < numHashes; ++i) {
+        uint64_t bit = (h1 + i * h2) % numBits;
+        uint64_t word = words[bit / 64].load(std::memory_order_relaxed);
+        if (!(word & (UINT64_C(1) << (bit % 64)))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void BloomFilterLayer::add(uint64_t hash)
+{
+    uint64_t h1 = hash;
+    uint64_t h2 = ((hash >> 32) | (hash << 32)) | 0x1;
+    for (uint32_t i = 0; i < numHashes; ++i) {
+        uint64_t bit = (h1 + i * h2) % numBits;
+        words[bit / 64].fetch_or(UINT64_C(1) << (bit % 64),
+                                 std::memory_order_relaxed);
+    }
+    ++numKeys;
+    dirty = true;
+}
+
+void BloomFilterLayer::exportLayer(void **buf, size_t *len) const
+{
+    /*
+    <Bloom filter layer>
+    [offset]: (description)
+    [     0]: capacity (# keys): 8 bytes
+    [     8]: # keys: 8 bytes
+    [    16]: # bits: 8 bytes
+    [    24]: # hash functions: 4 bytes
+    [    28]: bits per key: 4 bytes
+    [    32]: bit array: (# bits / 8) bytes
+    */
+    size_t nwords = numBits / 64;
+    size_t offset = 0;
+    uint64_t _edn_safe_64;
+    uint32_t _edn_safe_32;
+    uint8_t *ptr;
+
+    *len = BLOOM_LAYER_HEADER_SIZE + nwords * sizeof(uint64_t);
+    ptr = (uint8_t *)malloc(*len);
+
+    _edn_safe_64 = _endian_encode(capacity);
+    seq_memcpy(ptr + offset, &_edn_safe_64, sizeof(_edn_safe_64), offset);
+    _edn_safe_64 = _endian_encode(numKeys);
+    seq_memcpy(ptr + offset, &_edn_safe_64, sizeof(_edn_safe_64), offset);
+    _edn_safe_64 = _endian_encode(numBits);
+    seq_memcpy(ptr + offset, &_edn_safe_64, sizeof(_edn_safe_64), offset);
+    _edn_safe_32 = _endian_encode(numHashes);
+    seq_memcpy(ptr + offset, &_edn_safe_32, sizeof(_edn_safe_32), offset);
+    _edn_safe_32 = _endian_encode(bitsPerKey);
+    seq_memcpy(ptr + offset, &_edn_safe_32, sizeof(_edn_safe_32), offset);
+
+    for (size_t i = 0; i < nwords; ++i) {
+        _edn_safe_64 = _endian_encode(words[i].load(std::memory_order_relaxed));
+        seq_memcpy(ptr + offset, &_edn_safe_64, sizeof(_edn_safe_64), offset);
+    }
+
+    *buf = ptr;
+}
+
+BloomFilterLayer *BloomFilterLayer::importLayer(void *buf, size_t len)
+{
+    uint8_t *ptr = (uint8_t *)buf;
+    size_t offset = 0;
+    uint64_t _capacity, _num_keys, _num_bits;
+    uint32_t _num_hashes, _bits_per_key;
+
+    if (len < BLOOM_LAYER_HEADER_SIZE) {
+        return NULL;
+    }
+
+    seq_memcpy(&_capacity, ptr + offset, sizeof(_capacity), offset);
+    _capacity = _endian_decode(_capacity);
+    seq_memcpy(&_num_keys, ptr + offset, sizeof(_num_keys), offset);
+    _num_keys = _endian_decode(_num_keys);
+    seq_memcpy(&_num_bits, ptr + offset, sizeof(_num_bits), offset);
+    _num_bits = _endian_decode(_num_bits);
+    seq_memcpy(&_num_hashes, ptr + offset, sizeof(_num_hashes), offset);
+    _num_hashes = _endian_decode(_num_hashes);
+    seq_memcpy(&_bits_per_key, ptr + offset, sizeof(_bits_per_key), offset);
+    _bits_per_key = _endian_decode(_bits_per_key);
+
+    if (_bits_per_key == 0 || _num_bits % 64 ||
+        len != BLOOM_LAYER_HEADER_SIZE + _num_bits / 8) {
+        return NULL;
+    }
+
+    BloomFilterLayer *layer = new BloomFilterLayer(_capacity, _bits_per_key);
+    if (layer->numBits != _num_bits || layer->numHashes != _num_hashes) {
+        delete layer;
+        return NULL;
+    }
+    layer->numKeys = _num_keys;
+    for (size_t i = 0; i < _num_bits / 64; ++i) {
+        uint64_t _edn_safe_64;
+        seq_memcpy(&_edn_safe_64, ptr + offset, sizeof(_edn_safe_64), offset);
+        layer->words[i].store(_endian_decode(_edn_safe_64),
+                              std::memory_order_relaxed);
+    }
+    layer->dirty = false;
+    return layer;
+}
+
+BloomFilter::BloomFilter(uint32_t _bits_per_key)
+    : dirOffset(BLK_NOT_FOUND), bitsPerKey(_bits_per_key), dirty(false),
+      numLayers(0)
+{
+    memset(layers, 0, sizeof(layers));
+}
+
+BloomFilter::~BloomFilter()
+{
+    size_t n = numLayers.load();
+    for (size_t i = 0; i < n; ++i) {
+        delete layers[i];
+    }
+}
+
+uint64_t BloomFilter::hashKey(const void *key, size_t keylen)
+{
+    // MurmurHash64A
+    const uint64_t m = UINT64_C(0xc6a4a7935bd1e995);
+    const int r = 47;
+    const uint8_t *data = (const uint8_t *)key;
+    const uint8_t *end = data + (keylen / 8) * 8;
+    uint64_t h = UINT64_C(0x5bd1e9955bd1e995) ^ (keylen * m);
+
+    for (; data != end; data += 8) {
+        uint64_t k;
+        memcpy(&k, data, sizeof(k));
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+        h ^= k;
+        h *= m;
+    }
+
+    switch (keylen & 7) {
+    case 7: h ^= uint64_t(data[6]) << 48;
+    case 6: h ^= uint64_t(data[5]) << 40;
+    case 5: h ^= uint64_t(data[4]) << 32;
+    case 4: h ^= uint64_t(data[3]) << 24;
+    case 3: h ^= uint64_t(data[2]) << 16;
+    case 2: h ^= uint64_t(data[1]) << 8;
+    case 1: h ^= uint64_t(data[0]);
+            h *= m;
+    };
+
+    h ^= h >> r;
+    h *= m;
+    h ^= h >> r;
+    return h;
+}
+
+void BloomFilter::add(const void *key, size_t keylen)
+{
+    uint64_t hash = hashKey(key, keylen);
+    size_t n = numLayers.load(std::memory_order_relaxed);
+
+    // Updated keys are already in the filter; skipping them keeps
+    // the layers from filling up with duplicates.
+    for (size_t i = 0; i < n; ++i) {
+        if (layers[i]->mayContain(hash)) {
+            return;
+        }
+    }
+
+    if (n == 0 ||
+        (layers[n-1]->isFull() && n < BLOOM_FILTER_MAX_LAYERS)) {
+        uint64_t capacity = BLOOM_FILTER_INIT_LAYER_CAPACITY;
+        if (n > 0) {
+            capacity = layers[n-1]->getCapacity() * 2;
+            if (capacity > BLOOM_FILTER_MAX_LAYER_CAPACITY) {
+                capacity = BLOOM_FILTER_MAX_LAYER_CAPACITY;
+            }
+        }
+        layers[n] = new BloomFilterLayer(capacity,
+                                         bitsPerKey + (n < 4 ? n : 4));
+        ++n;
+        numLayers.store(n, std::memory_order_release);
+    }
+    // once the maximum number of layers is reached,
+    // the last layer keeps absorbing keys.
+    layers[n-1]->add(hash);
+    dirty = true;
+}
+
+bool BloomFilter::mayContain(const void *key, size_t keylen) const
+{
+    uint64_t hash = hashKey(key, keylen);
+    size_t n = numLayers.load(std::memory_order_acquire);
+    for (size_t i = 0; i < n; ++i) {
+        if (layers[i]->mayContain(hash)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void BloomFilter::exportDirectory(void **buf, size_t *len) const
+{
+    /*
+    <Bloom filter layer directory>
+    [offset]: (description)
+    [     0]: bits per key: 4 bytes
+    [     4]: # layers (n): 4 bytes
+    [     8]: offset of the system doc of each layer: 8*n bytes
+    */
+    size_t n = numLayers.load(std::memory_order_relaxed);
+    size_t offset = 0;
+    uint64_t _edn_safe_64;
+    uint32_t _edn_safe_32;
+    uint8_t *ptr;
+
+    *len = BLOOM_DIR_HEADER_SIZE + n * sizeof(uint64_t);
+    ptr = (uint8_t *)malloc(*len);
+
+    _edn_safe_32 = _endian_encode(bitsPerKey);
+    seq_memcpy(ptr + offset, &_edn_safe_32, sizeof(_edn_safe_32), offset);
+    _edn_safe_32 = _endian_encode((uint32_t)n);
+    seq_memcpy(ptr + offset, &_edn_safe_32, sizeof(_edn_safe_32), offset);
+    for (size_t i = 0; i < n; ++i) {
+        _edn_safe_64 = _endian_encode(layers[i]->offset);
+        seq_memcpy(ptr + offset, &_edn_safe_64, sizeof(_edn_safe_64), offset);
+    }
+
+    *buf = ptr;
+}
+
+bool BloomFilter::importDirectory(void *buf, size_t len,
+                                  uint32_t *bits_per_key,
+                                  std::vector<uint64_t> &layer_offsets)
+{
+    uint8_t *ptr = (uint8_t *)buf;
+    size_t offset = 0;
+    uint32_t _bits_per_key, n;
+
+    if (len < BLOOM_DIR_HEADER_SIZE) {
+        return false;
+    }
+    seq_memcpy(&_bits_per_key, ptr + offset, sizeof(_bits_per_key), offset);
+    _bits_per_key = _endian_decode(_bits_per_key);
+    seq_memcpy(&n, ptr + offset, sizeof(n), offset);
+    n = _endian_decode(n);
+    if (_bits_per_key == 0 || n > BLOOM_FILTER_MAX_LAYERS ||
+        len != BLOOM_DIR_HEADER_SIZE + n * sizeof(uint64_t)) {
+        return false;
+    }
+
+    layer_offsets.clear();
+    for (uint32_t i = 0; i < n; ++i) {
+        uint64_t _edn_safe_64;
+        seq_memcpy(&_edn_safe_64, ptr + offset, sizeof(_edn_safe_64), offset);
+        layer_offsets.push_back(_endian_decode(_edn_safe_64));
+    }
+    *bits_per_key = _bits_per_key;
+    return true;
+}
+
+bool BloomFilter::appendLayer(BloomFilterLayer *layer)
+{
+    size_t n = numLayers.load(std::memory_order_relaxed);
+    if (n >= BLOOM_FILTER_MAX_LAYERS) {
+        return false;
+    }
+    layers[n] = layer;
+    numLayers.store(n + 1, std::memory_order_release);
+    return true;
+}
@@ -0,0 +1,165 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2016 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "common.h"
+
+/**
+ * A single Bloom filter layer that can hold a fixed number of keys.
+ * Once a layer is full, it never changes again.
+ */
+class BloomFilterLayer {
+public:
+    BloomFilterLayer(uint64_t _capacity, uint32_t _bits_per_key);
+
+    ~BloomFilterLayer();
+
+    bool mayContain(uint64_t hash) const;
+
+    void add(uint64_t hash);
+
+    bool isFull() const {
+        return numKeys >= capacity;
+    }
+
+    uint64_t getCapacity() const {
+        return capacity;
+    }
+
+    uint64_t getNumKeys() const {
+        return numKeys;
+    }
+
+    uint64_t getNumBits() const {
+        return numBits;
+    }
+
+    /**
+     * Serialize this layer into a newly allocated buffer.
+     * The caller is responsible for freeing the buffer.
+     */
+    void exportLayer(void **buf, size_t *len) const;
+
+    /**
+     * Create a layer from the buffer written by exportLayer().
+     * Return NULL if the buffer is corrupted.
+     */
+    static BloomFilterLayer *importLayer(void *buf, size_t len);
+
+    // Offset of the system doc where this layer is stored
+    uint64_t offset;
+    // True if the layer has been changed since it was last persisted
+    bool dirty;
+
+private:
+    uint64_t capacity;
+    uint64_t numKeys;
+    uint64_t numBits;
+    uint32_t numHashes;
+    uint32_t bitsPerKey;
+    std::atomic<uint64_t> *words;
+};
+
+/**
+ * Scalable Bloom filter over the index keys of a ForestDB file.
+ *
+ * Keys are added when they are flushed from WAL into the main index, so that
+ * a negative answer from mayContain() guarantees that the key does not exist
+ * in the index, and the index lookup can be skipped. Keys are never removed,
+ * as deleted and updated keys only cause false positives.
+ *
+ * The filter grows by appending layers whose capacity doubles from
+ * BLOOM_FILTER_INIT_LAYER_CAPACITY up to BLOOM_FILTER_MAX_LAYER_CAPACITY keys.
+ * Each new layer uses more bits per key (up to 4 more) so that the overall
+ * false positive rate stays bounded as layers accumulate. Only the last layer
+ * is ever modified, so full layers are persisted just once.
+ *
+ * add() should be called while holding the file lock; mayContain() can be
+ * called concurrently without any lock.
+ */
+class BloomFilter {
+public:
+    BloomFilter(uint32_t _bits_per_key);
+
+    ~BloomFilter();
+
+    void add(const void *key, size_t keylen);
+
+    bool mayContain(const void *key, size_t keylen) const;
+
+    size_t getNumLayers() const {
+        return numLayers.load(std::memory_order_acquire);
+    }
+
+    BloomFilterLayer *getLayer(size_t idx) const {
+        return layers[idx];
+    }
+
+    uint32_t getBitsPerKey() const {
+        return bitsPerKey;
+    }
+
+    /**
+     * Return true if any layer or the layer directory has not been persisted
+     * since the last change.
+     */
+    bool isDirty() const {
+        return dirty;
+    }
+
+    void clearDirty() {
+        dirty = false;
+    }
+
+    /**
+     * Serialize the layer directory (the list of layer doc offsets) into a
+     * newly allocated buffer. The caller is responsible for freeing it.
+     */
+    void exportDirectory(void **buf, size_t *len) const;
+
+    /**
+     * Parse the layer directory written by exportDirectory().
+     * Return false if the buffer is corrupted.
+     */
+    static bool importDirectory(void *buf, size_t len,
+                                uint32_t *bits_per_key,
+                                std::vector<uint64_t> &layer_offsets);
+
+    /**
+     * Append a layer loaded from the file. Layers should be appended in the
+     * order given by the layer directory.
+     */
+    bool appendLayer(BloomFilterLayer *layer);
+
+    // Offset of the system doc where the layer directory is stored
+    uint64_t dirOffset;
+
+private:
+    static uint64_t hashKey(const void *key, size_t keylen);
+
+    uint32_t bitsPerKey;
+    bool dirty;
+    std::atomic<size_t> numLayers;
+    BloomFilterLayer *layers[BLOOM_FILTER_MAX_LAYERS];
+};
@@ -26,6 +26,34 @@
 #include "bnode.h"
 #include "hbtrie.h"
 
+/**
+ * Return the length of the common prefix of the given keys, up to 'max_len'.
+ */
+static size_t getCommonPrefixLen(void *key1, void *key2, size_t max_len)
+{
+    uint8_t *k1 = static_cast<uint8_t*>(key1);
+    uint8_t *k2 = static_cast<uint8_t*>(key2);
+    size_t i = 0;
+    while (i < max_len && k1[i] == k2[i]) {
+        ++i;
+    }
+    return i;
+}
+
+/**
+ * Return the disk space saved by storing a common prefix of 'prefix_len'
+ * bytes once for 'num_keys' keys, or 0 if it does not save any space.
+ */
+static size_t getPrefixSavings(size_t num_keys, size_t prefix_len)
+{
+    // the prefix itself and its length
+    size_t overhead = sizeof(uint16_t) + prefix_len;
+    if (num_keys * prefix_len <= overhead) {
+        return 0;
+    }
+    return num_keys * prefix_len - overhead;
+}
+
 
 Bnode::Bnode() :
     nodeSize( Bnode::getDiskSpaceOfEmptyNode() ),
@@ -34,15 +62,51 @@ Bnode::Bnode() :
     nentry(0),
     metaSize(0),
     refCount(0),
+    accessed(false),
     curOffset(BLK_NOT_FOUND),
-    cmpFunc(nullptr)
+    cmpFunc(nullptr),
+    keyPrefixLen(0),
+    keyPrefixLenValid(true),
+    exportBuf(nullptr),
+    inCache(false),
+    swizzledChildren(nullptr),
+    swizzleParent(nullptr),
+    swizzleIdx(0)
 {
     list_elem.prev = list_elem.next = nullptr;
     kvArr.adjustBaseOffset( nodeSize );
 }
 
 Bnode::~Bnode()
-{ }
+{
+    free(exportBuf);
+    delete[] swizzledChildren.load();
+}
+
+size_t Bnode::getNodeSize()
+{
+    return nodeSize - getPrefixSavings(kvArr.getNumElems(), getKeyPrefixLen());
+}
+
+size_t Bnode::getKeyPrefixLen()
+{
+    if (!keyPrefixLenValid) {
+        BsaItem first_kvp = kvArr.first();
+        BsaItem kvp = first_kvp;
+        size_t len = first_kvp.isEmpty() ? 0 : first_kvp.keylen;
+        while (len) {
+            kvp = kvArr.next(kvp);
+            if (kvp.isEmpty()) {
+                break;
+            }
+            len = getCommonPrefixLen(first_kvp.key, kvp.key,
+                                     MIN(len, kvp.keylen));
+        }
+        keyPrefixLen = len;
+        keyPrefixLenValid = true;
+    }
+    return keyPrefixLen;
+}
 
 BnodeResult Bnode::inputSanityCheck( void *key,
                                      size_t keylen,
@@ -126,6 +190,17 @@ BnodeResult Bnode::addKv( void *key,
         return BnodeResult::SUCCESS;
     }
 
+    if (keyPrefixLenValid) {
+        // a new key can only shorten the common prefix
+        BsaItem first_kvp = kvArr.first();
+        if (first_kvp.isEmpty()) {
+            keyPrefixLen = keylen;
+        } else {
+            keyPrefixLen = getCommonPrefixLen(key, first_kvp.key,
+                                              MIN(keyPrefixLen, keylen));
+        }
+    }
+
     if (value) {
         // binary data value
         item = BsaItem(key, keylen, value, valuelen);
@@ -279,6 +354,7 @@ BnodeResult Bnode::removeKv( void *key,
 
     nentry--;
     nodeSize -= item.getSize();
+    keyPrefixLenValid = false;
 
     return BnodeResult::SUCCESS;
 }
@@ -301,7 +377,7 @@ void Bnode::migrateEntries( size_t cur_num_elems,
 
     int64_t new_datasize = static_cast<int64_t>(last_kvp.pos) -
                            first_kvp.pos + last_kvp.getSize();
-    bnode->setNodeSize(bnode->getNodeSize() + new_datasize);
+    bnode->setNodeSize(bnode->nodeSize + new_datasize);
     nodeSize -= new_datasize;
 
 }
@@ -336,8 +412,9 @@ BnodeResult Bnode::splitNode( size_t nodesize_limit,
     bool skip_first_entry_set = false;
     size_t num_nodes = 0;
 
-    size_t est_num_nodes = (nodeSize / nodesize_limit) + 1;
-    size_t est_split_nodesize = nodeSize / est_num_nodes;
+    size_t disk_nodesize = getNodeSize();
+    size_t est_num_nodes = (disk_nodesize / nodesize_limit) + 1;
+    size_t est_split_nodesize = disk_nodesize / est_num_nodes;
 
     if ( est_num_nodes < 2 ||
          nentry < 4 ) {
@@ -355,6 +432,8 @@ BnodeResult Bnode::splitNode( size_t nodesize_limit,
     BsaItem kvp, prev_kvp, first_kvp;
     size_t cur_nodesize = Bnode::getDiskSpaceOfEmptyNode() + metaSize;
     size_t cur_num_elems = 0;
+    // common prefix of the keys in the current split node
+    size_t cur_prefixlen = 0;
 
     uint32_t new_array_size = 0;
     uint32_t new_num_elems = 0;
@@ -363,13 +442,18 @@ BnodeResult Bnode::splitNode( size_t nodesize_limit,
     while ( !kvp.isEmpty() ) {
         if (cur_num_elems == 0) {
             first_kvp = kvp;
+            cur_prefixlen = kvp.keylen;
+        } else {
+            cur_prefixlen = getCommonPrefixLen(first_kvp.key, kvp.key,
+                                               MIN(cur_prefixlen, kvp.keylen));
         }
         cur_num_elems++;
 
         // Note: each split node should contain at least 2 entries,
         // although it exceeds the node size limit.
         cur_nodesize += kvp.getSize();
-        if ( cur_nodesize > est_split_nodesize &&
+        if ( cur_nodesize - getPrefixSavings(cur_num_elems, cur_prefixlen) >
+                 est_split_nodesize &&
              cur_num_elems > 1 ) {
 
             // if the current node is dirty, then
@@ -401,6 +485,7 @@ BnodeResult Bnode::splitNode( size_t nodesize_limit,
         kvArr.setArraySize( new_array_size );
         kvArr.setNumElems( new_num_elems );
     }
+    keyPrefixLenValid = false;
 
     return BnodeResult::SUCCESS;
 }
@@ -434,9 +519,18 @@ void* Bnode::exportRaw()
     uint16_t enc16;
     uint32_t enc32;
     size_t offset = 0;
+    size_t num_elems = kvArr.getNumElems();
+    size_t prefix_len = getKeyPrefixLen();
+    uint32_t raw_flags = flags;
+
+    if (getPrefixSavings(num_elems, prefix_len)) {
+        raw_flags |= BNODE_FLAG_PREFIX_COMPRESSED;
+    } else {
+        prefix_len = 0;
+    }
 
     // node size
-    enc32 = _endian_encode(nodeSize);
+    enc32 = _endian_encode(static_cast<uint32_t>(getNodeSize()));
     memcpy(ptr + offset, &enc32, sizeof(enc32));
     offset += sizeof(enc32);
 
@@ -451,7 +545,7 @@ void* Bnode::exportRaw()
     offset += sizeof(enc16);
 
     // flags
-    enc32 = _endian_encode(flags);
+    enc32 = _endian_encode(raw_flags);
     memcpy(ptr + offset, &enc32, sizeof(enc32));
     offset += sizeof(enc32);
 
@@ -459,7 +553,53 @@ void* Bnode::exportRaw()
     enc16 = _endian_encode(metaSize);
     memcpy(ptr + offset, &enc16, sizeof(enc16));
 
-    return ptr;
+    if (!prefix_len) {
+        return ptr;
+    }
+
+    // Write the common prefix once after the metadata, followed by the
+    // key-value pairs whose keys are stripped of the prefix.
+    exportBuf = realloc(exportBuf, getNodeSize());
+    uint8_t *dst = static_cast<uint8_t*>(exportBuf);
+    uint32_t base = kvArr.getBaseOffset();
+    BsaItem kvp = kvArr.first();
+
+    // header and metadata
+    memcpy(dst, ptr, base);
+    offset = base;
+
+    enc16 = _endian_encode(static_cast<uint16_t>(prefix_len));
+    memcpy(dst + offset, &enc16, sizeof(enc16));
+    offset += sizeof(enc16);
+    memcpy(dst + offset, kvp.key, prefix_len);
+    offset += prefix_len;
+
+    while (!kvp.isEmpty()) {
+        uint8_t *src = ptr + base + kvp.pos;
+        size_t len = kvp.keylen - prefix_len + kvp.valuelen;
+
+        enc16 = _endian_encode(static_cast<uint16_t>(kvp.keylen - prefix_len));
+        memcpy(dst + offset, &enc16, sizeof(enc16));
+        offset += sizeof(enc16);
+
+        // value length
+        memcpy(dst + offset, src + sizeof(uint16_t), sizeof(uint16_t));
+        offset += sizeof(uint16_t);
+
+        // rest of the key, and value
+        memcpy(dst + offset, src + sizeof(uint16_t) * 2 + prefix_len, len);
+        offset += len;
+
+        kvp = kvArr.next(kvp);
+    }
+
+    return exportBuf;
+}
+
+void Bnode::releaseExportBuffer()
+{
+    free(exportBuf);
+    exportBuf = nullptr;
 }
 
 BnodeResult Bnode::importRaw(void *buf,
@@ -479,8 +619,6 @@ BnodeResult Bnode::importRaw(void *buf,
     uint32_t enc32;
     size_t offset = 0;
 
-    kvArr.setDataArrayBuffer(buf, buf_size);
-
     // node size
     enc32 = *( reinterpret_cast<uint32_t*>(ptr + offset) );
     offset += sizeof(enc32);
@@ -509,6 +647,17 @@ BnodeResult Bnode::importRaw(void *buf,
     // metadata
     offset += metaSize;
 
+    // Keep the prefix as stored on disk, so that getNodeSize() returns
+    // the disk space of the node until it is modified.
+    keyPrefixLen = 0;
+    keyPrefixLenValid = true;
+    if (flags & BNODE_FLAG_PREFIX_COMPRESSED) {
+        flags &= ~BNODE_FLAG_PREFIX_COMPRESSED;
+        buf = expandKeyPrefix(buf, buf_size, offset, buf_size);
+    }
+
+    kvArr.setDataArrayBuffer(buf, buf_size);
+
     // adjust base offset
     kvArr.adjustBaseOffset(offset);
 
@@ -518,6 +667,64 @@ BnodeResult Bnode::importRaw(void *buf,
     return BnodeResult::SUCCESS;
 }
 
+void* Bnode::expandKeyPrefix(void *buf,
+                             uint32_t buf_size,
+                             size_t offset,
+                             uint32_t& new_buf_size)
+{
+    uint8_t *src = static_cast<uint8_t*>(buf);
+    uint16_t enc16, keylen_local, valuelen_local;
+    size_t src_offset = offset, dst_offset = offset;
+    size_t len;
+
+    memcpy(&enc16, src + src_offset, sizeof(enc16));
+    keyPrefixLen = _endian_decode(enc16);
+    src_offset += sizeof(enc16);
+    uint8_t *prefix = src + src_offset;
+    src_offset += keyPrefixLen;
+
+    // keep the same headroom as the given buffer
+    uint32_t disk_size = nodeSize;
+    nodeSize = disk_size + getPrefixSavings(nentry, keyPrefixLen);
+    new_buf_size = buf_size - disk_size + nodeSize;
+
+    uint8_t *dst = static_cast<uint8_t*>(malloc(new_buf_size));
+    // header and metadata
+    memcpy(dst, src, offset);
+
+    for (size_t i = 0; i < nentry; ++i) {
+        memcpy(&enc16, src + src_offset, sizeof(enc16));
+        keylen_local = _endian_decode(enc16);
+        src_offset += sizeof(enc16);
+
+        memcpy(&enc16, src + src_offset, sizeof(enc16));
+        valuelen_local = _endian_decode(enc16);
+        src_offset += sizeof(enc16);
+
+        enc16 = _endian_encode(static_cast<uint16_t>(keylen_local +
+                                                     keyPrefixLen));
+        memcpy(dst + dst_offset, &enc16, sizeof(enc16));
+        dst_offset += sizeof(enc16);
+
+        // value length
+        memcpy(dst + dst_offset, src + src_offset - sizeof(uint16_t),
+               sizeof(uint16_t));
+        dst_offset += sizeof(uint16_t);
+
+        memcpy(dst + dst_offset, prefix, keyPrefixLen);
+        dst_offset += keyPrefixLen;
+
+        // rest of the key, and value
+        len = keylen_local + valuelen_local;
+        memcpy(dst + dst_offset, src + src_offset, len);
+        dst_offset += len;
+        src_offset += len;
+    }
+
+    free(buf);
+    return dst;
+}
+
 size_t Bnode::readNodeSize(void *buf)
 {
     // read the first 4 bytes
@@ -527,6 +734,8 @@ size_t Bnode::readNodeSize(void *buf)
 
 void Bnode::fitMemSpaceToNodeSize()
 {
+    // Find the common key prefix before the node is shared with readers.
+    getKeyPrefixLen();
     kvArr.fitArrayAndKvMetaCapacity();
     bidList.shrink_to_fit();
 }
@@ -687,6 +896,22 @@ INLINE int BsaCmp(BsaItem& aa, BsaItem& bb, void *aux)
     }
 }
 
+/**
+ * Return the first 8 bytes of the given key as a big-endian integer,
+ * zero-padded if the key is shorter, so that
+ * getKeyPrefix(a) < getKeyPrefix(b) implies a < b in lexicographical order.
+ */
+INLINE uint64_t getKeyPrefix(const void *key, size_t keylen)
+{
+    const uint8_t *ptr = static_cast<const uint8_t*>(key);
+    size_t len = MIN(keylen, sizeof(uint64_t));
+    uint64_t prefix = 0;
+    for (size_t i = 0; i < len; ++i) {
+        prefix |= static_cast<uint64_t>(ptr[i]) << (56 - 8 * i);
+    }
+    return prefix;
+}
+
 
 BsArray::BsArray() :
     aux(nullptr), kvDataSize(0), arrayBaseOffset(0)
@@ -816,7 +1041,7 @@ BsaItem BsArray::find(BsaItem& key, bool smaller_key)
 {
     int cmp;
     uint32_t start = 0, middle = 0, end= 0;
-    BsaItem cur;
+    uint64_t key_prefix;
     BsaItem not_found;
 
     // empty check
@@ -825,35 +1050,34 @@ BsaItem BsArray::find(BsaItem& key, bool smaller_key)
         return not_found;
     }
 
+    key_prefix = getKeyPrefix(key.key, key.keylen);
+
     // 1) compare with the smallest key
-    cur = fetchItem(0);
-    cmp = BsaCmp(key, cur, aux);
+    cmp = cmpWithItem(key, key_prefix, 0);
     if (cmp < 0) {
         // no smaller key
         return not_found;
     } else if (cmp == 0) {
         // smallest key
-        return cur;
+        return fetchItem(0);
     }
 
     // 2) compare with the greatest key
-    cur = fetchItem(end-1);
-    cmp = BsaCmp(key, cur, aux);
+    cmp = cmpWithItem(key, key_prefix, end-1);
     if (!smaller_key && cmp > 0) {
         // greater than greater key && exact key option
         return not_found;
     } else if (cmp == 0) {
         // return the greatest key
-        return cur;
+        return fetchItem(end-1);
     }
 
     // 3) now do binary search
     while (start+1 < end) {
         middle = (start + end) >> 1;
 
-        // get key at middle
-        cur = fetchItem(middle);
-        cmp = BsaCmp(key, cur, aux);
+        // compare with key at middle
+        cmp = cmpWithItem(key, key_prefix, middle);
         if (cmp < 0) {
             // given key < middle
             end = middle;
@@ -862,15 +1086,14 @@ BsaItem BsArray::find(BsaItem& key, bool smaller_key)
             start = middle;
         } else {
             // exact key found
-            return cur;
+            return fetchItem(middle);
         }
     }
 
     // 4) exact key not found
     //    => return key at 'start' on 'smaller_key' option.
     if (smaller_key) {
-        cur = fetchItem(start);
-        return cur;
+        return fetchItem(start);
     }
     return not_found;
 }
@@ -1027,6 +1250,7 @@ void BsArray::constructKvMetaArray(uint32_t kv_data_size,
         valuelen_local = _endian_decode(valuelen_local);
         offset += sizeof(valuelen_local);
 
+        kvMeta[i].keyPrefix = getKeyPrefix(ptr+offset, keylen_local);
         offset += keylen_local;
 
         if (valuelen_local == HBTrie::getHvSize() &&
@@ -1041,6 +1265,19 @@ void BsArray::constructKvMetaArray(uint32_t kv_data_size,
     }
 }
 
+int BsArray::cmpWithItem(BsaItem& key, uint64_t key_prefix, uint32_t idx)
+{
+    if (!aux) {
+        // prefixes are only meaningful in lexicographical order
+        uint64_t prefix = kvMeta[idx].keyPrefix;
+        if (key_prefix != prefix) {
+            return (key_prefix < prefix) ? -1 : 1;
+        }
+    }
+    BsaItem cur = fetchItem(idx);
+    return BsaCmp(key, cur, aux);
+}
+
 BsaItem BsArray::fetchItem(uint32_t idx) {
     BsaItem ret;
     uint32_t offset = 0;
@@ -1171,11 +1408,13 @@ BsaItem BsArray::addToArray(BsaItem item, uint32_t idx, bool overwrite) {
 
     if (overwrite) {
         // overwrite
+        kvMeta[idx].keyPrefix = getKeyPrefix(item.key, item.keylen);
         kvMeta[idx].kvPos = offset;
         kvMeta[idx].isPtr = item.isValueChildPtr;
     } else {
         // insert at 'idx'
         BsaKvMeta new_meta_entry;
+        new_meta_entry.keyPrefix = getKeyPrefix(item.key, item.keylen);
         new_meta_entry.kvPos = offset;
         new_meta_entry.isPtr = item.isValueChildPtr;
         kvMeta.insert(kvMeta.begin() + idx, new_meta_entry);
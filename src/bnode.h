@@ -94,6 +94,10 @@ struct BsaItem {
  * Meta data structure for key-value pair in BsArray.
  */
 struct BsaKvMeta {
+    // First 8 bytes of the key in big-endian order, zero-padded if the key
+    // is shorter. Comparing two prefixes as integers gives the same result
+    // as comparing the keys lexicographically, unless they are equal.
+    uint64_t keyPrefix;
     // Position of key-value pair.
     uint32_t kvPos;
     // Boolean flag indicates if corresponding key-value pair
@@ -151,6 +155,11 @@ enum class BsaItrType {
  * kvMeta[i].isPtr: boolean flag that indicates if
  *                  KV i contains pointer (true) or binary data (false).
  *
+ * kvMeta[i].keyPrefix: prefix of the key of KV i. Unless a custom
+ *                      comparison function is used, a search compares the
+ *                      prefixes first, and reads the key in 'dataArray'
+ *                      only when the prefixes are equal.
+ *
  */
 class BsArray {
 public:
@@ -357,6 +366,17 @@ private:
      */
     BsaItem fetchItem(uint32_t idx);
 
+    /**
+     * Compare the given key with the key of the given index number.
+     *
+     * @param key Key to compare.
+     * @param key_prefix Prefix of 'key', from getKeyPrefix().
+     * @param idx Index number of the key to compare with.
+     * @return Negative, zero, or positive value if 'key' is smaller than,
+     *         equal to, or greater than the key at 'idx', respectively.
+     */
+    int cmpWithItem(BsaItem& key, uint64_t key_prefix, uint32_t idx);
+
     /**
      * Write given key-value pair into the given position of the array.
      *
@@ -446,8 +466,15 @@ typedef int btree_new_cmp_func(void *key1, size_t keylen1,
  */
 void logBnodeErr(Bnode *bnode, fdb_status error_no, const char *msg);
 
+/**
+ * Flag in the on-disk node header, set if the prefix shared by all keys in
+ * the node is stored once, and each key is stored without it.
+ */
+#define BNODE_FLAG_PREFIX_COMPRESSED (0x1)
+
 class Bnode {
     friend class BnodeIterator;
+    friend class BnodeCacheMgr;
 
 public:
     Bnode();
@@ -471,11 +498,14 @@ public:
                                          Bnode *ptr,
                                          bool value_check = false );
 
-    size_t getNodeSize() const {
-        return nodeSize;
-    }
+    /**
+     * Return the disk space of the node, which is smaller than its size in
+     * memory if the keys share a prefix (see exportRaw()).
+     */
+    size_t getNodeSize();
     void setNodeSize(uint32_t _node_size) {
         nodeSize = _node_size;
+        keyPrefixLenValid = false;
     }
 
     size_t getMemConsumption() {
@@ -540,6 +570,47 @@ public:
         return --refCount;
     }
 
+    /**
+     * Mark the node as accessed since the last eviction pass. The flag is
+     * only written if it is clear, so that the readers of a hot node don't
+     * keep writing to it.
+     */
+    void markAccessed() {
+        if (!accessed.load(std::memory_order_relaxed)) {
+            accessed.store(true, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * Clear the accessed flag.
+     *
+     * @return True if the node was accessed since the flag was last cleared.
+     */
+    bool clearAccessed() {
+        if (!accessed.load(std::memory_order_relaxed)) {
+            return false;
+        }
+        accessed.store(false, std::memory_order_relaxed);
+        return true;
+    }
+
+    /**
+     * Return the in-memory pointer to the child node that the idx-th entry
+     * points to, if it has been swizzled while both nodes are in the bnode
+     * cache (see BnodeCacheMgr::swizzleChild()).
+     *
+     * @param idx Index number of the entry.
+     * @return Pointer to the child node, or NULL if it is not swizzled.
+     */
+    Bnode* getSwizzledChild(uint32_t idx) const {
+        std::atomic<Bnode*> *children =
+            swizzledChildren.load(std::memory_order_acquire);
+        if (!children) {
+            return nullptr;
+        }
+        return children[idx].load(std::memory_order_acquire);
+    }
+
     uint64_t getCurOffset() const {
         return curOffset;
     }
@@ -551,6 +622,10 @@ public:
         return cmpFunc;
     }
     void setCmpFunc(btree_new_cmp_func *_func) {
+        if (_func == cmpFunc) {
+            // Don't write to a cached node shared by concurrent readers.
+            return;
+        }
         cmpFunc = _func;
         if (cmpFunc) {
             kvArr.setAux(this);
@@ -716,12 +791,23 @@ public:
      * To avoid unnecessary memcpy() overhead, it directly returns
      * the buffer address kept in the node. So caller function should not
      * destroy the memory region after use. It will be freed when the
-     * node is destroyed.
+     * node is destroyed, or by releaseExportBuffer().
+     *
+     * If storing the prefix shared by all keys only once saves space, the
+     * keys are written without it into a separate buffer, and
+     * BNODE_FLAG_PREFIX_COMPRESSED is set in the header. The size of the
+     * raw data is always getNodeSize().
      *
      * @return Pointer to the memory address of raw binary data.
      */
     void* exportRaw();
 
+    /**
+     * Free the separate buffer allocated by exportRaw(), if any. The
+     * pointer returned by exportRaw() should not be used after this call.
+     */
+    void releaseExportBuffer();
+
     /**
      * Construct logical B+tree node structure from raw binary data.
      * To avoid unnecessary memcpy() overhead, given memory region is
@@ -788,6 +874,28 @@ private:
                          BsaItem first_kvp,
                          BsaItem last_kvp );
 
+    /**
+     * Return the length of a prefix shared by all keys in the node,
+     * computing it if it is not known.
+     */
+    size_t getKeyPrefixLen();
+
+    /**
+     * Rebuild the in-memory node image from raw data whose keys are stored
+     * without their common prefix.
+     *
+     * @param buf Memory area containing raw data. It is freed by this
+     *        function.
+     * @param buf_size Size of 'buf'.
+     * @param offset Offset of the common prefix in 'buf'.
+     * @param new_buf_size Size of the returned buffer, to be returned.
+     * @return Buffer containing the node image with full keys.
+     */
+    void* expandKeyPrefix( void *buf,
+                           uint32_t buf_size,
+                           size_t offset,
+                           uint32_t& new_buf_size );
+
     // Disk space of B+tree node.
     uint32_t nodeSize;
     // Flags
@@ -804,6 +912,9 @@ private:
     // Reference counter for the given node. If this value is not zero, the node
     // must not be ejected from the cache.
     std::atomic<uint64_t> refCount;
+    // Flag that indicates if the node has been read through the bnode cache
+    // since the last eviction pass over it.
+    std::atomic<bool> accessed;
     // File offset where this node is written. If this node is dirty so that
     // has not been flushed yet, the value is BLK_NOT_FOUND.
     std::atomic<uint64_t> curOffset;
@@ -812,6 +923,24 @@ private:
     std::vector<bid_t> bidList;
     // Key comparison function. Lexicographical order by default.
     btree_new_cmp_func *cmpFunc;
+    // Length of a prefix shared by all keys. It is the longest such prefix
+    // when computed from the keys, but it may be shorter for a node read
+    // from the file, in which case it is the prefix stored on disk.
+    uint16_t keyPrefixLen;
+    // Flag that indicates if 'keyPrefixLen' is up to date.
+    bool keyPrefixLenValid;
+    // Buffer for the raw data with prefix-compressed keys (see exportRaw()).
+    void *exportBuf;
+    // Flag that indicates if the node is in the bnode cache.
+    std::atomic<bool> inCache;
+    // Array of the swizzled pointers to the child nodes, indexed by entry.
+    // Allocated on the first swizzle.
+    std::atomic<std::atomic<Bnode*>*> swizzledChildren;
+    // Parent node that holds a swizzled pointer to this node, and the index
+    // of the entry, so that the pointer can be cleared when this node leaves
+    // the cache.
+    Bnode *swizzleParent;
+    uint32_t swizzleIdx;
 };
 
 
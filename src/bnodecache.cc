@@ -18,17 +18,117 @@
 #include "bnodecache.h"
 #include "fdb_internal.h"
 #include "filemgr.h"
+#include "secondary_cache.h"
 
 std::atomic<BnodeCacheMgr*> BnodeCacheMgr::instance(nullptr);
 std::mutex BnodeCacheMgr::instanceMutex;
 static uint64_t defaultCacheSize = 134217728;   // 128MB
 static uint64_t defaultFlushLimit = 1048576;    // 1MB
 
-/**
- * Hash function to determine the shard within a file
- * using the offset.
- */
-static std::hash<std::string> str_hash;
+Bnode* const BnodeIndex::tombstone = reinterpret_cast<Bnode*>(1);
+static const size_t BNODE_INDEX_MIN_CAPACITY = 16;
+
+BnodeIndex::BnodeIndex()
+    : table(new Table(BNODE_INDEX_MIN_CAPACITY)), numUsed(0), numLive(0)
+{ }
+
+BnodeIndex::~BnodeIndex() {
+    delete table.load();
+}
+
+Bnode* BnodeIndex::find(cs_off_t offset) const {
+    Table* t = table.load(std::memory_order_acquire);
+    size_t idx = getHash(offset) & t->mask;
+    for (size_t i = 0; i <= t->mask; ++i, idx = (idx + 1) & t->mask) {
+        Slot& slot = t->slots[idx];
+        Bnode* node = slot.node.load(std::memory_order_acquire);
+        if (node == nullptr) {
+            return nullptr;
+        }
+        if (node != tombstone &&
+            slot.offset.load(std::memory_order_acquire) ==
+                static_cast<uint64_t>(offset)) {
+            // Make sure that the offset read is that of 'node', not that of
+            // an entry that replaced it in the meantime. Since 'node' cannot
+            // be freed (and reused) while the caller is pinned, it is enough
+            // to check that the slot still points to it.
+            if (slot.node.load(std::memory_order_relaxed) == node) {
+                return node;
+            }
+        }
+    }
+    return nullptr;
+}
+
+void BnodeIndex::insert(cs_off_t offset, Bnode* node) {
+    if ((numUsed + 1) * 2 > table.load()->mask + 1) {
+        grow();
+    }
+
+    Table* t = table.load(std::memory_order_relaxed);
+    size_t idx = getHash(offset) & t->mask;
+    while (true) {
+        Slot& slot = t->slots[idx];
+        Bnode* cur = slot.node.load(std::memory_order_relaxed);
+        if (cur == nullptr || cur == tombstone) {
+            if (cur == nullptr) {
+                numUsed++;
+            }
+            slot.offset.store(offset, std::memory_order_release);
+            slot.node.store(node, std::memory_order_release);
+            numLive++;
+            return;
+        }
+        idx = (idx + 1) & t->mask;
+    }
+}
+
+void BnodeIndex::remove(cs_off_t offset) {
+    Table* t = table.load(std::memory_order_relaxed);
+    size_t idx = getHash(offset) & t->mask;
+    for (size_t i = 0; i <= t->mask; ++i, idx = (idx + 1) & t->mask) {
+        Slot& slot = t->slots[idx];
+        Bnode* cur = slot.node.load(std::memory_order_relaxed);
+        if (cur == nullptr) {
+            return;
+        }
+        if (cur != tombstone &&
+            slot.offset.load(std::memory_order_relaxed) ==
+                static_cast<uint64_t>(offset)) {
+            slot.node.store(tombstone, std::memory_order_release);
+            numLive--;
+            return;
+        }
+    }
+}
+
+void BnodeIndex::grow() {
+    Table* old_table = table.load(std::memory_order_relaxed);
+    size_t capacity = BNODE_INDEX_MIN_CAPACITY;
+    while (capacity < (numLive + 1) * 4) {
+        capacity <<= 1;
+    }
+
+    Table* new_table = new Table(capacity);
+    for (size_t i = 0; i <= old_table->mask; ++i) {
+        Bnode* node = old_table->slots[i].node.load(std::memory_order_relaxed);
+        if (node == nullptr || node == tombstone) {
+            continue;
+        }
+        uint64_t offset = old_table->slots[i].offset.load(
+                                                std::memory_order_relaxed);
+        size_t idx = getHash(offset) & new_table->mask;
+        while (new_table->slots[idx].node.load(std::memory_order_relaxed)) {
+            idx = (idx + 1) & new_table->mask;
+        }
+        new_table->slots[idx].offset.store(offset, std::memory_order_relaxed);
+        new_table->slots[idx].node.store(node, std::memory_order_relaxed);
+    }
+    numUsed = numLive;
+
+    table.store(new_table, std::memory_order_release);
+    BnodeCacheMgr::getEpochManager().retire(old_table);
+}
 
 FileBnodeCache::FileBnodeCache(std::string fname,
                                FileMgr* file,
@@ -42,6 +142,7 @@ FileBnodeCache::FileBnodeCache(std::string fname,
       accessTimestamp(0),
       evictionInProgress(false)
 {
+    spin_init(&swizzleLock);
 
     for (size_t i = 0; i < num_shards; ++i) {
         shards.emplace_back(new BnodeCacheShard(i));
@@ -149,6 +250,7 @@ void BnodeCacheMgr::destroyInstance() {
         delete tmp;
         instance = nullptr;
     }
+    getEpochManager().reclaim();
 }
 
 void BnodeCacheMgr::eraseFileHistory(FileMgr* file) {
@@ -203,14 +305,20 @@ void BnodeCacheMgr::updateParams(uint64_t cache_size, uint64_t flush_limit) {
     flushLimit.store(flush_limit);
 }
 
-int BnodeCacheMgr::read(FileMgr* file,
-                        Bnode** node,
-                        cs_off_t offset) {
+EpochManager& BnodeCacheMgr::getEpochManager() {
+    static EpochManager epochManager;
+    return epochManager;
+}
 
-    if (!file) {
-        return FDB_RESULT_INVALID_ARGS;
-    }
+size_t BnodeCacheMgr::getShardNum(FileBnodeCache* fcache, cs_off_t offset) {
+    uint64_t hash = static_cast<uint64_t>(offset);
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    return hash % fcache->getNumShards();
+}
 
+FileBnodeCache* BnodeCacheMgr::getFileBnodeCache(FileMgr* file) {
     // Note that we don't need to grab the bnodeCacheLock here as the bnode
     // cache is already created and binded when the file is created or opened
     // for the first time.
@@ -226,12 +334,57 @@ int BnodeCacheMgr::read(FileMgr* file,
         }
         spin_unlock(&bnodeCacheLock);
     }
+    return fcache;
+}
+
+int BnodeCacheMgr::read(FileMgr* file,
+                        Bnode** node,
+                        cs_off_t offset) {
+    return readLocked(file, node, offset, true);
+}
+
+int BnodeCacheMgr::readOptimistic(FileMgr* file,
+                                  Bnode** node,
+                                  cs_off_t offset) {
+    if (!file) {
+        return FDB_RESULT_INVALID_ARGS;
+    }
+
+    FileBnodeCache* fcache = file->getBnodeCache();
+    if (fcache) {
+        Bnode* cached = fcache->shards[getShardNum(fcache, offset)]->
+                            index.find(offset);
+        if (cached) {
+            // cache hit: instead of moving the node in the LRU list, let the
+            // eviction give it a second chance.
+            cached->markAccessed();
+            uint64_t timestamp = gethrtime() / 1000000;
+            if (fcache->getAccessTimestamp() != timestamp) {
+                fcache->setAccessTimestamp(timestamp);
+            }
+            *node = cached;
+            return cached->getNodeSize();
+        }
+    }
+
+    return readLocked(file, node, offset, false);
+}
+
+int BnodeCacheMgr::readLocked(FileMgr* file,
+                              Bnode** node,
+                              cs_off_t offset,
+                              bool take_ref) {
+
+    if (!file) {
+        return FDB_RESULT_INVALID_ARGS;
+    }
+
+    FileBnodeCache* fcache = getFileBnodeCache(file);
 
     if (fcache) {
         // file exists, update the access timestamp (in ms)
         fcache->setAccessTimestamp(gethrtime() / 1000000);
-        size_t shard_num = str_hash(std::to_string(offset)) %
-                           fcache->getNumShards();
+        size_t shard_num = getShardNum(fcache, offset);
 
         spin_lock(&fcache->shards[shard_num]->lock);
 
@@ -239,7 +392,9 @@ int BnodeCacheMgr::read(FileMgr* file,
         if (entry != fcache->shards[shard_num]->allNodes.end()) {
             // cache hit
             *node = entry->second;
-            entry->second->incRefCount();
+            if (take_ref) {
+                entry->second->incRefCount();
+            }
 
             // Move the item to the back of the clean node list if the item is
             // not dirty (to ensure that it is the last entry in this file's
@@ -265,14 +420,19 @@ int BnodeCacheMgr::read(FileMgr* file,
                 return status;
             } else {
                 // Add back to allBNodes hash table
+                (*node)->inCache.store(true);
                 fcache->shards[shard_num]->allNodes.insert(
                                 std::make_pair((*node)->getCurOffset(), *node));
+                fcache->shards[shard_num]->index.insert(
+                                (*node)->getCurOffset(), *node);
                 // Add to back of clean node list
                 list_push_back(&fcache->shards[shard_num]->cleanNodes,
                                &((*node)->list_elem));
                 bnodeCacheCurrentUsage.fetch_add((*node)->getMemConsumption());
                 fcache->numItems++;
-                (*node)->incRefCount();
+                if (take_ref) {
+                    (*node)->incRefCount();
+                }
                 spin_unlock(&fcache->shards[shard_num]->lock);
 
                 // Do Eviction if necessary
@@ -289,6 +449,65 @@ int BnodeCacheMgr::read(FileMgr* file,
     return 0;
 }
 
+void BnodeCacheMgr::swizzleChild(FileMgr* file,
+                                 Bnode* parent,
+                                 uint32_t idx,
+                                 Bnode* child) {
+    FileBnodeCache* fcache = file ? file->getBnodeCache() : nullptr;
+    if (!fcache || !parent || !child || idx >= parent->getNentry() ||
+        !parent->inCache.load(std::memory_order_relaxed)) {
+        // e.g., a dirty parent node
+        return;
+    }
+
+    spin_lock(&fcache->swizzleLock);
+    // A node that leaves the cache clears its swizzled pointers under this
+    // lock after its 'inCache' flag is cleared, so checking the flags here
+    // ensures that no pointer to a retired node is left behind.
+    if (parent->inCache.load() && child->inCache.load() &&
+        child->swizzleParent == nullptr) {
+        std::atomic<Bnode*>* children =
+            parent->swizzledChildren.load(std::memory_order_relaxed);
+        if (!children) {
+            children = new std::atomic<Bnode*>[parent->getNentry()];
+            for (size_t i = 0; i < parent->getNentry(); ++i) {
+                children[i].store(nullptr, std::memory_order_relaxed);
+            }
+            parent->swizzledChildren.store(children,
+                                           std::memory_order_release);
+        }
+        if (children[idx].load(std::memory_order_relaxed) == nullptr) {
+            child->swizzleParent = parent;
+            child->swizzleIdx = idx;
+            children[idx].store(child, std::memory_order_release);
+        }
+    }
+    spin_unlock(&fcache->swizzleLock);
+}
+
+void BnodeCacheMgr::unswizzle(FileBnodeCache* fcache, Bnode* node) {
+    node->inCache.store(false);
+
+    spin_lock(&fcache->swizzleLock);
+    if (node->swizzleParent) {
+        node->swizzleParent->swizzledChildren.load()[node->swizzleIdx].store(
+                                                nullptr,
+                                                std::memory_order_release);
+        node->swizzleParent = nullptr;
+    }
+    std::atomic<Bnode*>* children = node->swizzledChildren.load();
+    if (children) {
+        for (size_t i = 0; i < node->getNentry(); ++i) {
+            Bnode* child = children[i].load(std::memory_order_relaxed);
+            if (child) {
+                child->swizzleParent = nullptr;
+                children[i].store(nullptr, std::memory_order_release);
+            }
+        }
+    }
+    spin_unlock(&fcache->swizzleLock);
+}
+
 int BnodeCacheMgr::write(FileMgr* file,
                          Bnode* node,
                          cs_off_t offset) {
@@ -297,23 +516,12 @@ int BnodeCacheMgr::write(FileMgr* file,
         return FDB_RESULT_INVALID_ARGS;
     }
 
-    FileBnodeCache* fcache = file->getBnodeCache();
-    if (fcache == nullptr) {
-        spin_lock(&bnodeCacheLock);
-        // Check again within bnodeCacheLock
-        fcache = file->getBnodeCache();
-        if (fcache == nullptr) {
-            // A file bnode cache doesn not exist, creating it
-            fcache = createFileBnodeCache_UNLOCKED(file);
-        }
-        spin_unlock(&bnodeCacheLock);
-    }
+    FileBnodeCache* fcache = getFileBnodeCache(file);
 
     // Update the access timestamp (in ms)
     fcache->setAccessTimestamp(gethrtime() / 1000000);
 
-    size_t shard_num = str_hash(std::to_string(offset)) %
-                       fcache->getNumShards();
+    size_t shard_num = getShardNum(fcache, offset);
     spin_lock(&fcache->shards[shard_num]->lock);
 
     // search shard hash table
@@ -329,6 +537,8 @@ int BnodeCacheMgr::write(FileMgr* file,
             spin_unlock(&fcache->shards[shard_num]->lock);
             return FDB_RESULT_EEXIST;
         }
+        fcache->shards[shard_num]->index.insert(node->getCurOffset(), node);
+        node->inCache.store(true);
         bnodeCacheCurrentUsage.fetch_add(node->getMemConsumption());
         fcache->numItems++;
         fcache->numItemsWritten++;
@@ -381,7 +591,10 @@ fdb_status BnodeCacheMgr::flush(FileMgr* file) {
         // Note that this function is invoked as part of a commit operation
         // while the filemgr's lock is already grabbed by a committer.
         // Therefore, we don't need to grab all the shard locks at once.
-        return flushDirtyIndexNodes(fcache, true, true);
+        LATENCY_STAT_START();
+        fdb_status fs = flushDirtyIndexNodes(fcache, true, true);
+        LATENCY_STAT_END(file, FDB_LATENCY_BNODE_FLUSH);
+        return fs;
     }
     return FDB_RESULT_FILE_NOT_OPEN;
 }
@@ -425,42 +638,46 @@ fdb_status BnodeCacheMgr::invalidateBnode(FileMgr* file, Bnode* node) {
         return FDB_RESULT_FILE_NOT_OPEN;
     }
 
-    size_t shard_num = str_hash(std::to_string(node->getCurOffset())) %
-                                fcache->getNumShards();
+    cs_off_t offset = node->getCurOffset();
+    size_t shard_num = getShardNum(fcache, offset);
+    BnodeCacheShard* shard = fcache->shards[shard_num].get();
+
+    spin_lock(&shard->lock);
+    // Search shard hash table
+    auto entry = shard->allNodes.find(offset);
+    if (entry == shard->allNodes.end()) {
+        // Readers don't hold the nodes that they use in the cache, so the
+        // node may have been evicted in the meantime.
+        spin_unlock(&shard->lock);
+        return FDB_RESULT_KEY_NOT_FOUND;
+    }
 
-    if (node->getRefCount() <= 1) {
-        spin_lock(&fcache->shards[shard_num]->lock);
-        // Search shard hash table
-        auto entry = fcache->shards[shard_num]->allNodes.find(node->getCurOffset());
-        if (entry != fcache->shards[shard_num]->allNodes.end()) {
-            // Remove from all nodes list
-            fcache->shards[shard_num]->allNodes.erase(node->getCurOffset());
-            // Remove from dirty index nodes (if present)
-            fcache->shards[shard_num]->dirtyIndexNodes.erase(node->getCurOffset());
-            // Remove from clean nodes (if present)
-            list_remove(&fcache->shards[shard_num]->cleanNodes,
-                        &node->list_elem);
-            fcache->numItems--;
-            fcache->numItemsWritten--;
-            // Decrement memory usage
-            bnodeCacheCurrentUsage.fetch_sub(node->getMemConsumption());
-            spin_unlock(&fcache->shards[shard_num]->lock);
-        } else {
-            spin_unlock(&fcache->shards[shard_num]->lock);
-            fdb_log(nullptr, FDB_RESULT_KEY_NOT_FOUND,
-                    "Warning: Failed to remove bnode (at offset: %s) "
-                    "in file '%s', because it wasn't found in the cache!",
-                    std::to_string(node->getCurOffset()).c_str(),
-                    fcache->getFileName().c_str());
-            return FDB_RESULT_KEY_NOT_FOUND;
-        }
-    } else {
+    Bnode* cached = entry->second;
+    if (cached->getRefCount()) {
         // failure of invalidation is used as one of conditions
         // in BnodeMgr layer during node cloning, so we don't
         // need to report warning here.
+        spin_unlock(&shard->lock);
         return FDB_RESULT_FILE_IS_BUSY;
     }
 
+    // Remove from all nodes list
+    shard->allNodes.erase(entry);
+    shard->index.remove(offset);
+    unswizzle(fcache, cached);
+    // Remove from dirty index nodes (if present)
+    shard->dirtyIndexNodes.erase(offset);
+    // Remove from clean nodes (if present)
+    list_remove(&shard->cleanNodes, &cached->list_elem);
+    fcache->numItems--;
+    fcache->numItemsWritten--;
+    // Decrement memory usage
+    bnodeCacheCurrentUsage.fetch_sub(cached->getMemConsumption());
+    spin_unlock(&shard->lock);
+
+    // Free the node once the readers that may have found it are done
+    getEpochManager().retire(cached);
+
     return FDB_RESULT_SUCCESS;
 }
 
@@ -509,6 +726,8 @@ void BnodeCacheMgr::removeCleanBnodes(FileMgr* file) {
                 elem = list_remove(&fcache->shards[i]->cleanNodes, elem);
                 // Remove from the all node list
                 fcache->shards[i]->allNodes.erase(item->getCurOffset());
+                fcache->shards[i]->index.remove(item->getCurOffset());
+                unswizzle(fcache, item);
                 fcache->numItems--;
                 // Decrement memory usage
                 bnodeCacheCurrentUsage.fetch_sub(item->getMemConsumption());
@@ -520,6 +739,47 @@ void BnodeCacheMgr::removeCleanBnodes(FileMgr* file) {
     }
 }
 
+void BnodeCacheMgr::getHotBnodes(FileMgr* file,
+                                 uint64_t max_bytes,
+                                 std::vector<cs_off_t> &offsets) {
+    FileBnodeCache* fcache = file ? file->getBnodeCache() : nullptr;
+    if (!fcache || !max_bytes) {
+        return;
+    }
+
+    // MRU-first (offset, memory consumption) pairs of each shard
+    std::vector<std::vector<std::pair<cs_off_t, size_t> > > shard_nodes(
+                                                    fcache->getNumShards());
+    size_t max_nodes = 0;
+    for (size_t i = 0; i < fcache->getNumShards(); ++i) {
+        spin_lock(&fcache->shards[i]->lock);
+        // The back of the clean node list is the most recently used
+        struct list_elem *elem = list_end(&fcache->shards[i]->cleanNodes);
+        while (elem) {
+            Bnode* item = reinterpret_cast<Bnode*>(elem);
+            shard_nodes[i].push_back(std::make_pair(item->getCurOffset(),
+                                                    item->getMemConsumption()));
+            elem = list_prev(elem);
+        }
+        spin_unlock(&fcache->shards[i]->lock);
+        max_nodes = std::max(max_nodes, shard_nodes[i].size());
+    }
+
+    uint64_t total = 0;
+    for (size_t rank = 0; rank < max_nodes; ++rank) {
+        for (auto &nodes : shard_nodes) {
+            if (rank >= nodes.size()) {
+                continue;
+            }
+            total += nodes[rank].second;
+            if (total > max_bytes) {
+                return;
+            }
+            offsets.push_back(nodes[rank].first);
+        }
+    }
+}
+
 // Remove a file bnode cache from the file bnode cache list.
 // MUST ensure that there is no dirty index node that belongs to this File
 // (or memory leak occurs).
@@ -636,6 +896,42 @@ bool BnodeCacheMgr::freeFileBnodeCache(FileBnodeCache* fcache, bool force) {
 
 static const size_t BNODE_BUFFER_HEADROOM = 256;
 
+// Only committed nodes stored in a single block are kept in the secondary
+// cache, so that a node's entry is invalidated along with its block.
+static bool isSecondaryCacheable(FileMgr* file, cs_off_t offset,
+                                 size_t length) {
+    size_t blocksize = file->getBlockSize();
+    if (offset % blocksize + length > blocksize - sizeof(IndexBlkMeta)) {
+        return false;
+    }
+    return !file->isWritable(offset / blocksize);
+}
+
+// Read a node evicted into the secondary cache, if any.
+static Bnode* fetchFromSecondaryCache(FileMgr* file, cs_off_t offset) {
+    SecondaryCache* scache = SecondaryCache::getInstance();
+    uint64_t scache_id = file->getSecondaryCacheId();
+    if (!scache || !scache_id) {
+        return nullptr;
+    }
+
+    size_t buf_size = scache->getSlotSize();
+    void* buf = malloc(buf_size + BNODE_BUFFER_HEADROOM);
+    size_t length = scache->read(scache_id, offset, buf, buf_size);
+    if (length == 0 || Bnode::readNodeSize(buf) != length ||
+        !isSecondaryCacheable(file, offset, length)) {
+        free(buf);
+        return nullptr;
+    }
+    buf = realloc(buf, length + BNODE_BUFFER_HEADROOM);
+
+    Bnode* bnode_out = new Bnode();
+    bnode_out->addBidList(offset / file->getBlockSize());
+    bnode_out->importRaw(buf, length + BNODE_BUFFER_HEADROOM);
+    bnode_out->setCurOffset(offset);
+    return bnode_out;
+}
+
 fdb_status BnodeCacheMgr::fetchFromFile(FileMgr* file,
                                         Bnode** node,
                                         cs_off_t offset) {
@@ -647,6 +943,12 @@ fdb_status BnodeCacheMgr::fetchFromFile(FileMgr* file,
     fdb_status status = FDB_RESULT_SUCCESS;
     ssize_t ret = 0;
 
+    Bnode* cached = fetchFromSecondaryCache(file, offset);
+    if (cached) {
+        *node = cached;
+        return status;
+    }
+
     // 1> Read the first 4 bytes
     uint32_t length;
     ret = file->readBuf(&length, sizeof(length), offset);
@@ -971,6 +1273,8 @@ fdb_status BnodeCacheMgr::flushDirtyIndexNodes(FileBnodeCache* fcache,
                 }
             }
 
+            dirty_bnode->releaseExportBuffer();
+
             // Move to the shard clean node list
             list_push_back(&fcache->shards[shard_num]->cleanNodes,
                            &dirty_bnode->list_elem);
@@ -981,6 +1285,8 @@ fdb_status BnodeCacheMgr::flushDirtyIndexNodes(FileBnodeCache* fcache,
             fcache->numItemsWritten--;
             // Remove from the all node list
             fcache->shards[shard_num]->allNodes.erase(dirty_bnode->getCurOffset());
+            fcache->shards[shard_num]->index.remove(dirty_bnode->getCurOffset());
+            unswizzle(fcache, dirty_bnode);
             // Decrement memory usage
             bnodeCacheCurrentUsage.fetch_sub(dirty_bnode->getMemConsumption());
             flushed += dirty_bnode->getNodeSize();
@@ -1079,6 +1385,13 @@ void BnodeCacheMgr::performEviction(Bnode *node_to_protect) {
     Bnode* item = nullptr;
     FileBnodeCache* victim = nullptr;
 
+    // Committed nodes are kept in the secondary cache once evicted.
+    SecondaryCache* scache = SecondaryCache::getInstance();
+    uint8_t* scache_buf = nullptr;
+    if (scache) {
+        scache_buf = alca(uint8_t, scache->getSlotSize());
+    }
+
     // Select the victim and then the clean blocks from the victim file, eject
     // items until memory usage falls 4K (max btree node size) less than
     // the allowed bnodeCacheLimit.
@@ -1109,6 +1422,12 @@ void BnodeCacheMgr::performEviction(Bnode *node_to_protect) {
         BnodeCacheShard* bshard = nullptr;
         size_t toVisit = num_shards;
 
+        FileMgr* victim_file = victim->getFileManager();
+        uint64_t scache_id = 0;
+        if (scache && victim_file) {
+            scache_id = victim_file->getSecondaryCacheId();
+        }
+
         while (bnodeCacheCurrentUsage.load() > (bnodeCacheLimit - 4096) &&
                toVisit-- != 0) {
             i = (i + 1) % num_shards;   // Round-robin over empty shards
@@ -1135,32 +1454,64 @@ void BnodeCacheMgr::performEviction(Bnode *node_to_protect) {
                 spin_lock(&bshard->lock);
             }
 
+            cs_off_t scache_offset = BLK_NOT_FOUND;
+            size_t scache_len = 0;
             elem = list_pop_front(&bshard->cleanNodes);
             if (elem) {
                 item = reinterpret_cast<Bnode*>(elem);
-                if (item != node_to_protect && item->getRefCount() == 0) {
+                if (item->clearAccessed()) {
+                    // Read since the last pass: give it a second chance
+                    list_push_back(&bshard->cleanNodes,
+                                   &item->list_elem);
+                } else if (item != node_to_protect &&
+                           item->getRefCount() == 0) {
                     victim->numVictims++;
 
                     victim->numItems--;
+                    cs_off_t offset = item->getCurOffset();
+                    if (scache_id &&
+                        isSecondaryCacheable(victim_file, offset,
+                                             item->getNodeSize())) {
+                        scache_offset = offset;
+                        scache_len = item->getNodeSize();
+                        memcpy(scache_buf, item->exportRaw(), scache_len);
+                    }
                     // Remove from the shard nodes list
-                    bshard->allNodes.erase(item->getCurOffset());
+                    bshard->allNodes.erase(offset);
+                    bshard->index.remove(offset);
+                    unswizzle(victim, item);
                     // Decrement mem usage stat
                     bnodeCacheCurrentUsage.fetch_sub(item->getMemConsumption());
 
-                    // Free bnode instance
-                    delete item;
+                    // Free bnode instance once the readers that may have
+                    // found it are done
+                    getEpochManager().retire(item);
                 } else {
                     list_push_back(&bshard->cleanNodes,
                                    &item->list_elem);
                 }
             }
             spin_unlock(&bshard->lock);
+
+            if (scache_len) {
+                // write to the cache device outside the shard lock
+                scache->insert(scache_id, scache_offset, scache_buf,
+                               scache_len);
+                bid_t bid = scache_offset / victim_file->getBlockSize();
+                if (victim_file->isWritable(bid)) {
+                    // reused while being inserted
+                    victim_file->invalidateSecondaryCache(bid);
+                }
+            }
         }
 
         victim->refCount--;
         victim->setEvictionInProgress(false);
         victim = nullptr;
     }
+
+    // Free the nodes evicted or invalidated so far that are no longer read
+    getEpochManager().maybeReclaim();
 }
 
 static const size_t MAX_VICTIM_SELECTIONS = 5;
@@ -1247,8 +1598,7 @@ void BnodeCacheMgr::removeSelectBnodes(FileMgr* file,
     }
 
     for (auto node : nodes) {
-        size_t shard_num = str_hash(std::to_string(node->getCurOffset())) %
-                           fcache->getNumShards();
+        size_t shard_num = getShardNum(fcache, node->getCurOffset());
         spin_lock(&fcache->shards[shard_num]->lock);
 
         // Search shard hash table
@@ -1256,6 +1606,8 @@ void BnodeCacheMgr::removeSelectBnodes(FileMgr* file,
         if (entry != fcache->shards[shard_num]->allNodes.end()) {
             // Remove from all nodes list
             fcache->shards[shard_num]->allNodes.erase(node->getCurOffset());
+            fcache->shards[shard_num]->index.remove(node->getCurOffset());
+            unswizzle(fcache, node);
             // Remove from dirty index nodes (if present)
             fcache->shards[shard_num]->dirtyIndexNodes.erase(node->getCurOffset());
             // Remove from clean nodes (if present)
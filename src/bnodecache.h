@@ -34,6 +34,7 @@
 #include "atomic.h"
 #include "bnode.h"
 #include "common.h"
+#include "epoch_manager.h"
 #include "list.h"
 
 // Forward declaration
@@ -69,6 +70,81 @@ struct IndexBlkMeta {
     uint8_t marker;
 };
 
+/**
+ * Open-addressing hash table from offsets to the bnodes of a shard, which
+ * readers probe without the shard lock.
+ *
+ * The table is only modified under the shard lock. A removed entry leaves a
+ * tombstone, and a table that fills up is replaced by a larger one, which
+ * retires the old table so that readers still probing it are not affected.
+ * Readers should pin the bnode cache epoch (see
+ * BnodeCacheMgr::getEpochManager()) while they use the table and the bnodes
+ * found in it.
+ */
+class BnodeIndex {
+public:
+    BnodeIndex();
+
+    ~BnodeIndex();
+
+    /**
+     * Find the bnode at a given offset, without any lock.
+     *
+     * @param offset Offset of the bnode
+     * @return Pointer to the bnode, or NULL if it is not found
+     */
+    Bnode* find(cs_off_t offset) const;
+
+    /**
+     * Add a bnode that is not in the table yet.
+     * Caller should hold the shard lock.
+     */
+    void insert(cs_off_t offset, Bnode* node);
+
+    /**
+     * Remove the bnode at a given offset, if any.
+     * Caller should hold the shard lock.
+     */
+    void remove(cs_off_t offset);
+
+private:
+    struct Slot {
+        Slot() : offset(0), node(nullptr) { }
+
+        std::atomic<uint64_t> offset;
+        // NULL if the slot has never been used, 'tombstone' if its entry
+        // has been removed
+        std::atomic<Bnode*> node;
+    };
+
+    struct Table {
+        Table(size_t capacity)
+            : mask(capacity - 1), slots(new Slot[capacity]) { }
+
+        size_t mask;
+        std::unique_ptr<Slot[]> slots;
+    };
+
+    static size_t getHash(cs_off_t offset) {
+        // Fibonacci hashing, whose upper bits are used below
+        return static_cast<size_t>(
+                    (static_cast<uint64_t>(offset) * 0x9e3779b97f4a7c15ULL) >> 32);
+    }
+
+    /**
+     * Replace the table with one that has room for twice the live entries.
+     */
+    void grow();
+
+    static Bnode* const tombstone;
+
+    std::atomic<Table*> table;
+    // Number of slots that are not NULL (including tombstones)
+    size_t numUsed;
+    // Number of live entries
+    size_t numLive;
+};
+
 /**
  * Shard Bnodecache instance
  */
@@ -103,7 +179,8 @@ private:
 
     // Shard id
     size_t id;
-    // Lock to synchronize access to cleanNodes, dirtyIndexNodes, allNodes
+    // Lock to synchronize access to cleanNodes, dirtyIndexNodes, allNodes,
+    // and the updates of 'index'
     spin_t lock;
     // LRU list of clean index nodes
     struct list cleanNodes;
@@ -111,6 +188,9 @@ private:
     std::map<cs_off_t, Bnode*> dirtyIndexNodes;
     // Hashtable of all the btree nodes belonging to this shard
     std::unordered_map<cs_off_t, Bnode*> allNodes;
+    // Lock-free copy of 'allNodes' for the readers (see
+    // BnodeCacheMgr::readOptimistic())
+    BnodeIndex index;
 };
 
 /**
@@ -120,7 +200,9 @@ class FileBnodeCache {
 public:
     FileBnodeCache(std::string fname, FileMgr* file, size_t num_shards);
 
-    ~FileBnodeCache() { }
+    ~FileBnodeCache() {
+        spin_destroy(&swizzleLock);
+    }
 
     /* Fetch filename that the bnode cache instance is associated with */
     const std::string& getFileName(void) const;
@@ -181,6 +263,10 @@ private:
 
     // Flag if eviction is running on this victim
     std::atomic<bool> evictionInProgress;
+
+    // Lock to synchronize the swizzled pointers between the bnodes of the
+    // file (see BnodeCacheMgr::swizzleChild())
+    spin_t swizzleLock;
 };
 
 typedef std::pair<Bnode*, cs_off_t> bnode_offset_t;
@@ -232,6 +318,41 @@ public:
      */
     int read(FileMgr* file, Bnode** node, cs_off_t offset);
 
+    /**
+     * Fetches bnode at the specified offset, on behalf of a reader that has
+     * pinned the epoch of the bnode cache (see getEpochManager()).
+     *
+     * Unlike read(), the node is not referenced: it may be evicted while it
+     * is used, but it is not freed until the reader unpins the epoch. A
+     * cache hit takes no lock and doesn't write to any shared memory
+     * except for the first access to the node since its last eviction pass.
+     *
+     * @param file Pointer to the FileMgr instance
+     * @param node Pointer reference to the retrieved bnode
+     * @param offset Offset at which the bnode is read
+     *
+     * @returns the number of bytes that read from the cache
+     */
+    int readOptimistic(FileMgr* file, Bnode** node, cs_off_t offset);
+
+    /**
+     * Swizzle the pointer from an entry of a cached parent bnode to the
+     * cached child bnode that it points to, so that the readers pinned as in
+     * readOptimistic() can traverse it without looking up the cache. The
+     * pointer is cleared when either bnode leaves the cache.
+     *
+     * Nothing is done if either bnode is no longer in the cache, or if the
+     * child is already swizzled from another parent (e.g., an older version
+     * of the parent that points to the same child).
+     *
+     * @param file Pointer to the FileMgr instance
+     * @param parent Pointer to the parent bnode
+     * @param idx Index number of the entry of the parent
+     * @param child Pointer to the child bnode
+     */
+    void swizzleChild(FileMgr* file, Bnode* parent, uint32_t idx,
+                      Bnode* child);
+
     /**
      * Writes/overwrites a btree node at the specified offset.
      *
@@ -274,8 +395,9 @@ public:
     fdb_status addLastBlockMeta(FileMgr* file, bid_t bid);
 
     /**
-     * Removes the bnode from the cache iff the ref count is less
-     * than or equal to one.
+     * Removes the bnode at the offset of a given bnode from the cache iff it
+     * is not referenced (see read()). The cached bnode is retired, so that
+     * the readers still using it are not affected.
      *
      * @param file Pointer to the FileMgr instance
      * @param node Pointer to the Bnode
@@ -321,6 +443,13 @@ public:
         flushLimit.store(to);
     }
 
+    /**
+     * Return the epoch manager that protects the bnodes evicted from the
+     * cache of every file, and the internal tables of the cache, from being
+     * freed while they are read.
+     */
+    static EpochManager& getEpochManager();
+
     /**
      * Fetch the current memory usage by the bnodeCache.
      */
@@ -328,6 +457,26 @@ public:
         return bnodeCacheCurrentUsage.load();
     }
 
+    /**
+     * Fetch the memory limit of the bnodeCache.
+     */
+    uint64_t getMemoryLimit() {
+        return bnodeCacheLimit.load();
+    }
+
+    /**
+     * Return the offsets of the clean bnodes of a given file that are cached,
+     * from the most recently used one to the least, taking the shards in
+     * turns.
+     *
+     * @param file Pointer to the file manager instance
+     * @param max_bytes Maximum memory consumption of the returned bnodes
+     * @param offsets Vector where the bnode offsets are returned
+     */
+    void getHotBnodes(FileMgr* file,
+                      uint64_t max_bytes,
+                      std::vector<cs_off_t> &offsets);
+
 private:
     /**
      * Constructor
@@ -378,6 +527,33 @@ private:
       */
     FileBnodeCache* createFileBnodeCache_UNLOCKED(FileMgr* file);
 
+    /**
+     * Return the file bnode cache of a given file, creating it if necessary.
+     */
+    FileBnodeCache* getFileBnodeCache(FileMgr* file);
+
+    /**
+     * Return the shard of a given file bnode cache that a given offset
+     * belongs to.
+     */
+    static size_t getShardNum(FileBnodeCache* fcache, cs_off_t offset);
+
+    /**
+     * Read a bnode through the shard lock, fetching it from the file on a
+     * cache miss.
+     *
+     * @param take_ref True if the reference count of the bnode should be
+     *                 increased
+     */
+    int readLocked(FileMgr* file, Bnode** node, cs_off_t offset,
+                   bool take_ref);
+
+    /**
+     * Clear the swizzled pointers from and to a bnode that leaves the cache.
+     * Caller should hold the lock of the bnode's shard.
+     */
+    void unswizzle(FileBnodeCache* fcache, Bnode* node);
+
     /**
      * Fetch bnode from file
      *
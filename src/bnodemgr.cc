@@ -32,6 +32,7 @@ static const size_t block_meta_size = sizeof(IndexBlkMeta);
 
 BnodeMgr::BnodeMgr() :
     file(nullptr),
+    epochPin(BnodeCacheMgr::getEpochManager()),
     curBid(BLK_NOT_FOUND),
     curOffset(0),
     logCallback(nullptr),
@@ -65,24 +66,15 @@ void BnodeMgr::removeDirtyNode(Bnode* bnode)
 
 Bnode* BnodeMgr::getMutableNodeFromClean(Bnode* clean_bnode)
 {
-    Bnode* bnode_out;
-    fdb_status ret = BnodeCacheMgr::get()->invalidateBnode(file, clean_bnode);
+    // Eject the clean node from cache (if it is not being held by a
+    // reference), as it is about to become stale. Even then, it cannot be
+    // modified in place since other readers may still be using it.
+    BnodeCacheMgr::get()->invalidateBnode(file, clean_bnode);
 
     // make the region of previous clean node as stale.
     markBnodeStale(clean_bnode);
 
-    if (ret == FDB_RESULT_SUCCESS) {
-        // clean node is ejected from cache.
-        // now we can modify it as a dirty node without cloning.
-        releaseCleanNode(clean_bnode);
-        clean_bnode->setCurOffset(BLK_NOT_FOUND);
-        clean_bnode->clearBidList();
-        bnode_out = clean_bnode;
-    } else {
-        // clean node cannot be ejected.
-        // make a dirty clone of the node.
-        bnode_out = clean_bnode->cloneNode();
-    }
+    Bnode* bnode_out = clean_bnode->cloneNode();
     addDirtyNode(bnode_out);
 
     return bnode_out;
@@ -161,7 +153,10 @@ Bnode* BnodeMgr::readNode(uint64_t offset)
 {
     Bnode* bnode_out;
 
-    int ret = BnodeCacheMgr::get()->read(file, &bnode_out, offset);
+    // Pin the epoch before the lookup, so that the node is not freed until
+    // releaseCleanNodes() even if it is evicted.
+    epochPin.pin();
+    int ret = BnodeCacheMgr::get()->readOptimistic(file, &bnode_out, offset);
     if (ret <= 0) {
         fdb_log(logCallback, static_cast<fdb_status>(ret),
                 "Failed to read the B+tree index node at "
@@ -169,17 +164,23 @@ Bnode* BnodeMgr::readNode(uint64_t offset)
                 offset, file->getFileName());
         return nullptr;
     }
-    bnode_out->setCurOffset(offset);
 
-    if (cleanNodes.find(bnode_out) != cleanNodes.end()) {
-        // Same clean node already exists in the current BnodeMgr,
-        // so we should not increase its ref count once again.
-        // => decrease the ref count that was increased by BnodeCache.
-        bnode_out->decRefCount();
-    } else {
-        cleanNodes.insert( bnode_out );
+    return bnode_out;
+}
+
+Bnode* BnodeMgr::readChildNode(Bnode* parent, uint32_t idx, uint64_t offset)
+{
+    epochPin.pin();
+    Bnode* bnode_out = parent->getSwizzledChild(idx);
+    if (bnode_out) {
+        bnode_out->markAccessed();
+        return bnode_out;
     }
 
+    bnode_out = readNode(offset);
+    if (bnode_out) {
+        BnodeCacheMgr::get()->swizzleChild(file, parent, idx, bnode_out);
+    }
     return bnode_out;
 }
 
@@ -276,18 +277,9 @@ void BnodeMgr::moveDirtyNodesToBcache()
     // it will be done in ForestDB-level functions.
 }
 
-void BnodeMgr::releaseCleanNode( Bnode *bnode )
-{
-    bnode->decRefCount();
-    cleanNodes.erase( bnode );
-}
-
 void BnodeMgr::releaseCleanNodes()
 {
-    for (auto &entry: cleanNodes) {
-        entry->decRefCount();
-    }
-    cleanNodes.clear();
+    epochPin.unpin();
 }
 
 
@@ -81,11 +81,9 @@ public:
     void removeDirtyNode(Bnode* bnode);
 
     /**
-     * Make given clean node writable.
-     * If other thread is currently accessing the same clean node,
-     * create a dirty clone of the node. If the clean node is being
-     * accessed by the caller thread only, then directly switch the
-     * clean node as dirty.
+     * Make given clean node writable, by creating a dirty clone of the node.
+     * The clean node is removed from the cache, but it is not modified as
+     * other threads may be reading it.
      *
      * @param clean_bnode Pointer to clean node.
      * @return Writable dirty node.
@@ -95,13 +93,26 @@ public:
     /**
      * Read a B+tree node corresponding to the given offset.
      * This API first searches the in-memory cache, and then read the DB
-     * file on cache miss.
+     * file on cache miss. The node stays valid until releaseCleanNodes() is
+     * called, even if it is evicted from the cache in the meantime.
      *
      * @param offset File offset of the index node to read.
      * @return Bnode class instance.
      */
     Bnode* readNode(uint64_t offset);
 
+    /**
+     * Read the child node that an entry of a given clean node points to.
+     * Once both nodes are in the cache, the pointer to the child is
+     * swizzled, so that it is followed directly on the next reads.
+     *
+     * @param parent Pointer to the parent node.
+     * @param idx Index number of the entry of the parent node.
+     * @param offset File offset of the child node.
+     * @return Bnode class instance.
+     */
+    Bnode* readChildNode(Bnode* parent, uint32_t idx, uint64_t offset);
+
     /**
      * Calculate and assign a DB file offset, where the given dirty node
      * will be written back. Note that 16-byte meta data is added for
@@ -124,15 +135,8 @@ public:
     void moveDirtyNodesToBcache();
 
     /**
-     * Decrease the reference counter of the given clean node, to make it
-     * ejectable from the cache.
-     *
-     * @param bnode Pointer to
-     */
-    void releaseCleanNode( Bnode *bnode );
-
-    /**
-     * Decrease reference counters of all present clean nodes.
+     * Release all the clean nodes read so far, which must not be used
+     * anymore.
      */
     void releaseCleanNodes();
 
@@ -149,8 +153,9 @@ private:
 
     // FileMgr instance.
     FileMgr *file;
-    // Set of clean nodes that are currently accessed by the B+tree.
-    std::unordered_set<Bnode*> cleanNodes;
+    // Epoch pin that protects the clean nodes currently accessed by the
+    // B+tree from being freed.
+    EpochManager::Participant epochPin;
     // Set of dirty nodes that are created in the current batch.
     std::unordered_set<Bnode*> dirtyNodes;
     // Latest block ID for dirty node allocation.
@@ -194,7 +194,6 @@ BtreeV2Result BtreeV2::initFromAddr(BtreeNodeAddr root_addr)
         Bnode *root = bMgr->readNode(rootAddr.offset);
         height = root->getLevel();
         // TODO: reading / storing 'nentry' from / to the root node .
-        bMgr->releaseCleanNode(root);
         return BtreeV2Result::SUCCESS;
     } else {
         // dirty root node
@@ -273,9 +272,6 @@ uint32_t BtreeV2::getMetaSize()
 
     node = getRootNode();
     ret = node->getMetaSize();
-    if ( !rootAddr.isDirty ) {
-        bMgr->releaseCleanNode(node);
-    }
 
     return ret;
 }
@@ -292,9 +288,6 @@ BtreeV2Result BtreeV2::readMeta( BtreeV2Meta& meta )
     node = getRootNode();
     meta.size = node->getMetaSize();
     memcpy(meta.ctx, node->getMeta(), meta.size);
-    if ( !rootAddr.isDirty ) {
-        bMgr->releaseCleanNode(node);
-    }
 
     return BtreeV2Result::SUCCESS;
 }
@@ -324,6 +317,132 @@ BtreeV2Result BtreeV2::insert( BtreeKvPair kv )
     return insertMulti( kv_list );
 }
 
+BtreeV2Result BtreeV2::bulkLoad( std::vector<BtreeKvPair>& kv_list,
+                                 double fill_factor )
+{
+    if ( kv_list.empty() ) {
+        return BtreeV2Result::SUCCESS;
+    }
+
+    if ( !rootAddr.isEmpty &&
+         ( !rootAddr.isDirty || rootAddr.ptr->getNentry() ) ) {
+        // The tree is already populated.
+        return insertMulti( kv_list );
+    }
+
+    if ( fill_factor <= 0 || fill_factor > 1 ) {
+        fill_factor = BTREEV2_BULK_LOAD_FILL_FACTOR;
+    }
+
+    // 1) Keep the meta data of the existing (empty) root node,
+    //    and discard the node.
+    std::vector<uint8_t> meta;
+    if ( rootAddr.isDirty ) {
+        Bnode *old_root = rootAddr.ptr;
+        uint8_t *meta_ptr = static_cast<uint8_t*>(old_root->getMeta());
+        meta.assign(meta_ptr, meta_ptr + old_root->getMetaSize());
+        bMgr->removeDirtyNode(old_root);
+        delete old_root;
+    }
+
+    // 2) Fill leaf nodes in a key order.
+    std::vector<Bnode*> cur_level;
+    std::vector<Bnode*> upper_level;
+    Bnode *node = nullptr;
+    size_t level = 1;
+    size_t nodesize_target = getNodeSizeLimit(level) * fill_factor;
+
+    nentry = 0;
+    for (auto &kv: kv_list) {
+        if ( !node ) {
+            node = new Bnode();
+            node->setCmpFunc(cmpFunc);
+        }
+        node->addKv( kv.key, kv.keylen, kv.value, kv.valuelen,
+                     nullptr, true );
+        nentry++;
+        if ( node->getNodeSize() >= nodesize_target ) {
+            cur_level.push_back(node);
+            node = nullptr;
+        }
+    }
+    if ( node ) {
+        cur_level.push_back(node);
+    }
+
+    // 3) Write each level, and build its parent level from the smallest
+    //    key and offset of each node, until only the root node remains.
+    while ( true ) {
+        if ( cur_level.size() == 1 && meta.size() ) {
+            // root node .. restore the meta data before its offset is fixed.
+            cur_level[0]->setMeta(meta.data(), meta.size());
+        }
+        writeBulkLoadedNodes(cur_level);
+        if ( cur_level.size() == 1 ) {
+            break;
+        }
+
+        level++;
+        nodesize_target = getNodeSizeLimit(level) * fill_factor;
+        node = nullptr;
+        upper_level.clear();
+        for (auto &entry: cur_level) {
+            void *min_key;
+            size_t min_keylen;
+            uint64_t child_offset = _endian_encode( entry->getCurOffset() );
+
+            if ( !node ) {
+                node = new Bnode();
+                node->setLevel(level);
+                node->setCmpFunc(cmpFunc);
+            }
+            entry->findMinKey(min_key, min_keylen);
+            node->addKv( min_key, min_keylen,
+                         &child_offset, sizeof(child_offset),
+                         nullptr, true );
+            // Each intermediate node should have at least two children.
+            if ( node->getNodeSize() >= nodesize_target &&
+                 node->getNentry() > 1 ) {
+                upper_level.push_back(node);
+                node = nullptr;
+            }
+        }
+        if ( node ) {
+            upper_level.push_back(node);
+        }
+        cur_level.swap(upper_level);
+    }
+
+    height = level;
+    rootAddr = BtreeNodeAddr(cur_level[0]->getCurOffset(), nullptr);
+
+    return BtreeV2Result::SUCCESS;
+}
+
+void BtreeV2::writeBulkLoadedNodes( std::vector<Bnode*>& nodes )
+{
+    std::vector<bnode_offset_t> nodes_to_write;
+    uint64_t offset;
+
+    nodes_to_write.reserve(nodes.size());
+    for (auto &entry: nodes) {
+        offset = bMgr->assignDirtyNodeOffset(entry);
+        entry->setCurOffset(offset);
+        entry->fitMemSpaceToNodeSize();
+        nodes_to_write.push_back(std::make_pair(entry, offset));
+    }
+
+    int ret = BnodeCacheMgr::get()->writeMulti(bMgr->getFile(),
+                                               nodes_to_write);
+    if (ret <= 0) {
+        fdb_log(bMgr->getLogCallback(), static_cast<fdb_status>(ret),
+                "Failed to write %" _F64 " bulk-loaded B+tree index nodes "
+                "in a file %s",
+                static_cast<uint64_t>(nodes.size()),
+                bMgr->getFile()->getFileName());
+    }
+}
+
 BtreeV2Result BtreeV2::_insert( std::vector<BtreeKvPair>& kv_list,
                                 Bnode *parent_node,
                                 BtreeKey ref_key,
@@ -661,7 +780,7 @@ BtreeV2Result BtreeV2::find( BtreeKvPair& kv,
     BtreeV2Result br = BtreeV2Result::SUCCESS;
     BtreeNodeAddr node_addr = rootAddr;
 
-    br = _find(kv, node_addr, allocate_memory, FindOption::EQUAL);
+    br = _find(kv, nullptr, 0, node_addr, allocate_memory, FindOption::EQUAL);
 
     return br;
 }
@@ -669,16 +788,20 @@ BtreeV2Result BtreeV2::find( BtreeKvPair& kv,
 BtreeV2Result BtreeV2::findSmallerOrEqual(BtreeKvPair& kv,
                                           bool allocate_memory)
 {
-    return _find(kv, rootAddr, allocate_memory, FindOption::SMALLER_OR_EQUAL);
+    return _find(kv, nullptr, 0, rootAddr, allocate_memory,
+                 FindOption::SMALLER_OR_EQUAL);
 }
 
 BtreeV2Result BtreeV2::findGreaterOrEqual(BtreeKvPair& kv,
                                           bool allocate_memory)
 {
-    return _find(kv, rootAddr, allocate_memory, FindOption::GREATER_OR_EQUAL);
+    return _find(kv, nullptr, 0, rootAddr, allocate_memory,
+                 FindOption::GREATER_OR_EQUAL);
 }
 
 BtreeV2Result BtreeV2::_find( BtreeKvPair& kv,
+                              Bnode *parent_node,
+                              uint32_t parent_idx,
                               BtreeNodeAddr node_addr,
                               bool allocate_memory,
                               FindOption opt )
@@ -692,6 +815,11 @@ BtreeV2Result BtreeV2::_find( BtreeKvPair& kv,
         if ( node_addr.isDirty ) {
             // dirty node .. use the pointer.
             node = node_addr.ptr;
+        } else if ( parent_node ) {
+            // clean child node .. follow the swizzled pointer if any,
+            // otherwise read from file.
+            node = bMgr->readChildNode( parent_node, parent_idx,
+                                        node_addr.offset );
         } else {
             // clean node .. read from file.
             node = bMgr->readNode( node_addr.offset );
@@ -716,7 +844,8 @@ BtreeV2Result BtreeV2::_find( BtreeKvPair& kv,
         }
         // recursive call
         BtreeNodeAddr next_addr( kvp );
-        BtreeV2Result br = _find( kv, next_addr, allocate_memory, opt );
+        BtreeV2Result br = _find( kv, node, kvp.idx, next_addr,
+                                  allocate_memory, opt );
 
         // Same as the cases described in seekGreaterOrEqualRecursiveBT()
         // below, we need to explore prev/next child node too if given opt is
@@ -725,12 +854,16 @@ BtreeV2Result BtreeV2::_find( BtreeKvPair& kv,
             opt != FindOption::EQUAL) {
             if (opt == FindOption::SMALLER_OR_EQUAL) {
                 // smaller option: visit smaller child node once again.
-                BtreeNodeAddr smaller_node(node->getKvArr().prev(kvp));
-                return _find(kv, smaller_node, allocate_memory, opt);
+                BsaItem smaller_kvp = node->getKvArr().prev(kvp);
+                BtreeNodeAddr smaller_node(smaller_kvp);
+                return _find(kv, node, smaller_kvp.idx, smaller_node,
+                             allocate_memory, opt);
             } else if (opt == FindOption::GREATER_OR_EQUAL) {
                 // greater option: visit greater child node once again.
-                BtreeNodeAddr greater_node(node->getKvArr().next(kvp));
-                return _find(kv, greater_node, allocate_memory, opt);
+                BsaItem greater_kvp = node->getKvArr().next(kvp);
+                BtreeNodeAddr greater_node(greater_kvp);
+                return _find(kv, node, greater_kvp.idx, greater_node,
+                             allocate_memory, opt);
             }
         }
         return br;
@@ -1004,12 +1137,8 @@ BtreeIteratorV2::BtreeIteratorV2(BtreeV2 *_btree,
 }
 
 BtreeIteratorV2::~BtreeIteratorV2() {
-    for (int cursor = btree->getHeight() - 1; cursor >= 0; --cursor) {
-        Bnode *oldBnode = bnodeItrs[cursor].getIteratorBnode();
-        if (oldBnode) { // Release reference to bnode from the cursor
-            btree->bMgr->releaseCleanNode(oldBnode);
-        }
-    }
+    // The nodes read are released along with the other clean nodes of the
+    // B+tree node manager (see BnodeMgr::releaseCleanNodes()).
     uint8_t *bnodeArrayBuf = reinterpret_cast<uint8_t *>(bnodeItrs);
     // Release memory for all the Bnode Iterators in one single deallocation
     delete [] bnodeArrayBuf;
@@ -1052,12 +1181,7 @@ BnodeIteratorResult BtreeIteratorV2::fetchBnode(Bnode * & node,
     if (!node) { // Error reading or btree not yet populated
         return BnodeIteratorResult::INVALID_NODE;
     }
-    // Release reference on old B+Tree node if there is a cached node there..
     int level = node->getLevel() - 1; // (leaf node starts at level 1)
-    cachedBnode = bnodeItrs[level].getIteratorBnode();
-    if (cachedBnode) {
-        btree->bMgr->releaseCleanNode(cachedBnode);
-    }
     new (&bnodeItrs[level]) BnodeIterator(node);
     return BnodeIteratorResult::SUCCESS;
 }
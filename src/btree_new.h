@@ -26,6 +26,10 @@
 #include "bnodemgr.h"
 #include "bnode.h"
 
+// Default ratio of the node size limit that each node is filled up to,
+// when a B+tree is built by BtreeV2::bulkLoad().
+#define BTREEV2_BULK_LOAD_FILL_FACTOR (0.9)
+
 enum class BtreeV2Result {
     // Succeeded.
     SUCCESS,
@@ -242,6 +246,23 @@ public:
      */
     BtreeV2Result insert( BtreeKvPair kv );
 
+    /**
+     * Build the tree bottom-up from a set of key-value pairs, instead of
+     * inserting them one by one. Each node is filled up to the given ratio of
+     * its size limit, and all nodes in the same level are written into the
+     * node cache sequentially before their parent level is built. As a
+     * result, the tree becomes clean once this function returns.
+     * Note that all pairs MUST be sorted in a key order without duplicates.
+     * If the tree already has any entry, this function falls back to
+     * insertMulti().
+     *
+     * @param kv_list List of key-value pairs to load.
+     * @param fill_factor Ratio of the node size limit to fill each node.
+     * @return SUCCESS on success.
+     */
+    BtreeV2Result bulkLoad( std::vector<BtreeKvPair>& kv_list,
+                            double fill_factor = BTREEV2_BULK_LOAD_FILL_FACTOR );
+
     /**
      * Remove a set of key-value pairs from the tree.
      * Note that all pairs MUST be sorted in a key order.
@@ -395,16 +416,29 @@ private:
      */
     void shrinkHeight();
 
+    /**
+     * Assign consecutive offsets to the given nodes built by bulkLoad(), and
+     * write them into the node cache at once.
+     *
+     * @param nodes List of nodes in the same level.
+     */
+    void writeBulkLoadedNodes( std::vector<Bnode*>& nodes );
+
     /**
      * Internal recursive function for find operation.
      *
      * @param kv Key-value pair to find. Value field will be assigned as a result
      *        of this API call.
+     * @param parent_node Pointer to parent node, or NULL for the root node.
+     * @param parent_idx Index number of the entry of the parent node that
+     *        points to the current node.
      * @param node_addr File offset (clean) or pointer (dirty) to the current node.
      * @param allocate_memory Flag for memory allocation.
      * @return SUCCESS on success.
      */
     BtreeV2Result _find( BtreeKvPair& kv,
+                         Bnode *parent_node,
+                         uint32_t parent_idx,
                          BtreeNodeAddr node_addr,
                          bool allocate_memory,
                          FindOption opt );
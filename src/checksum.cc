@@ -18,7 +18,7 @@
 /*
  * Checksum abstraction functions.
  *
- * ForestDB evolved to support a software CRC and platform's CRC32-C.
+ * ForestDB evolved to support a software CRC, CRC32-C and XXH3.
  * This module provides an API for checking and creating checksums
  * utilising the correct method based upon the callers crc_mode.
  */
@@ -31,17 +31,17 @@
 # include <platform/crc32c.h>
 #else
 #include <stdint.h>
-// Define a crc32c which does nothing but assert.
-static uint32_t crc32c(const uint8_t* buf,
-                size_t buf_len,
-                uint32_t pre) {
-    // Non couchbase builds are configured to never turn on crc32c.
-    assert(false);
-    return 0;
+#include "crc32c.h"
+// Bundled crc32c with runtime CPU dispatch.
+static inline uint32_t crc32c(const uint8_t* buf,
+                              size_t buf_len,
+                              uint32_t pre) {
+    return crc32c_8(buf, buf_len, pre);
 }
 #endif
 # include "checksum.h"
 #include "crc32.h"
+#include "xxhash3.h"
 
 /*
  * Get a checksum of buf for buf_len bytes.
@@ -54,6 +54,8 @@ uint32_t get_checksum(const uint8_t* buf,
                       crc_mode_e mode) {
     if (mode == CRC32C) {
         return crc32c(buf, buf_len, pre);
+    } else if (mode == XXH3) {
+        return static_cast<uint32_t>(xxh3_64_with_seed(buf, buf_len, pre));
     } else {
         assert(mode == CRC32);
         return crc32_8((void *)buf, buf_len, pre);
@@ -87,19 +89,12 @@ bool perform_integrity_check(const uint8_t* buf,
                             size_t buf_len,
                             uint32_t checksum,
                             crc_mode_e mode) {
-    bool success = false;
-#ifdef _CRC32C
-    if (mode == CRC_UNKNOWN || mode == CRC32C) {
-        success = checksum == crc32c(buf, buf_len, 0);
-        if (!success && mode == CRC_UNKNOWN) {
-            success = checksum == crc32_8((void *)buf, buf_len, 0);
-        }
-    } else
-#endif
-    {
-        success = checksum == crc32_8((void *)buf, buf_len, 0);
+    if (mode == CRC_UNKNOWN) {
+        return checksum == crc32c(buf, buf_len, 0) ||
+               checksum == crc32_8((void *)buf, buf_len, 0) ||
+               checksum == get_checksum(buf, buf_len, 0, XXH3);
     }
-    return success;
+    return checksum == get_checksum(buf, buf_len, 0, mode);
 }
 
 /*
@@ -113,17 +108,13 @@ bool detect_and_check_crc(const uint8_t* buf,
                           size_t buf_len,
                           uint32_t checksum,
                           crc_mode_e* mode) {
-    *mode = CRC_UNKNOWN;
-#ifdef _CRC32C
-    if (perform_integrity_check(buf, buf_len, checksum, CRC32C)) {
-        *mode = CRC32C;
-        return true;
-    } else
-#endif
-    if (perform_integrity_check(buf, buf_len, checksum, CRC32)) {
-        *mode = CRC32;
-        return true;
+    static const crc_mode_e modes[] = {CRC32C, CRC32, XXH3};
+    for (crc_mode_e candidate : modes) {
+        if (perform_integrity_check(buf, buf_len, checksum, candidate)) {
+            *mode = candidate;
+            return true;
+        }
     }
-
+    *mode = CRC_UNKNOWN;
     return false;
 }
@@ -18,7 +18,7 @@
 /*
  * Checksum abstraction functions.
  *
- * ForestDB evolved to support a software CRC and platform's CRC32-C.
+ * ForestDB evolved to support a software CRC, CRC32-C and XXH3.
  * This module provides an API for checking and creating checksums
  * utilising the correct method based upon the callers crc_mode.
  */
@@ -32,11 +32,14 @@ enum crc_mode_e {
     CRC_UNKNOWN,
     CRC32,
     CRC32C,
-#ifdef _CRC32C
-    CRC_DEFAULT = CRC32C // Couchbase builds pickup crc32c from plaform
-#else
-    CRC_DEFAULT = CRC32 // Non-couchbase falls back to bundled utils/crc32.cc
-#endif
+    // Lower 32 bits of XXH3-64, where the pre value is used as the seed.
+    // Unlike CRCs, checksums of split buffers cannot be chained into the
+    // checksum of the whole buffer, so readers must chain the same pieces
+    // as the writer did.
+    XXH3,
+    // Couchbase builds pickup crc32c from platform, others use the bundled
+    // utils/crc32c.cc; both use the hardware CRC32-C instructions if present.
+    CRC_DEFAULT = CRC32C
 };
 
 /*
@@ -88,7 +91,7 @@ bool perform_integrity_check(const uint8_t* buf,
 
 /*
  * Detect the CRC mode by performing an integrity check against the
- * two CRC functions ForestDB files could be written with.
+ * checksum functions ForestDB files could be written with.
  *
  * Returns true if a match is found and sets mode to the correct mode.
  * Returns false if no match and sets mode to CRC_UNKNOWN.
@@ -783,7 +783,10 @@ fdb_status CommitLog::_appendLogEntry(CommitLogEntry *entry,
     }
 
     if ( !target_file ) {
-        createNewLogFile();
+        fs = createNewLogFile();
+        if (fs != FDB_RESULT_SUCCESS) {
+            return fs;
+        }
         target_file = curFile;
     }
 
@@ -987,15 +990,17 @@ void CommitLog::scanLogFiles(std::map<uint64_t, std::string>& file_map,
         dir_name = "./";
     }
 
+    // directory entries do not contain the path, so match
+    // the base name of the DB instance only.
+    query = dbName.substr(pos == std::string::npos ? 0 : pos + 1) + ".log";
+
     dir_info = opendir(dir_name.c_str());
     if (dir_info != NULL) {
         while ((dir_entry = readdir(dir_info))) {
 
-            // log file should include sub-string ".log"
+            // log file name should start with '[dbname].log'
             name_str = std::string(dir_entry->d_name);
-            query = dbName + ".log";
-            pos = name_str.find(query);
-            if (pos != std::string::npos) {
+            if (name_str.compare(0, query.size(), query) == 0) {
                 parseFileName(name_str, file_map);
             }
         }
@@ -1157,3 +1162,48 @@ fdb_status CommitLog::destroyLogUpto(uint64_t log_id_upto)
     return FDB_RESULT_SUCCESS;
 }
 
+fdb_status CommitLog::destroyAllLogs()
+{
+    uint64_t min_id, max_id;
+    std::map<uint64_t, std::string> file_map;
+
+    bool has_files = false;
+    uint64_t last_id = 0;
+    {
+        std::lock_guard<std::mutex> lock(logManagementLock);
+        if (!files.empty()) {
+            has_files = true;
+            last_id = files.back()->getLogId();
+        }
+    }
+
+    // close and remove all log files opened by this instance first.
+    if (has_files) {
+        fdb_status fs = destroyLogUpto(last_id);
+        if (fs != FDB_RESULT_SUCCESS) {
+            return fs;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(logManagementLock);
+    curFile = nullptr;
+
+    // remove remaining log files that have not been opened yet.
+    scanLogFiles(file_map, min_id, max_id);
+    for (auto &entry : file_map) {
+        char id_cstr[64];
+        sprintf(id_cstr, ".log%08" _F64, entry.first);
+        std::string log_filename = dbName + std::string(id_cstr);
+        if (remove(log_filename.c_str()) != 0) {
+            char errno_msg[512];
+            config->fileOps->get_errno_str(
+                static_cast<fdb_fileops_handle>(NULL), errno_msg, 512);
+            fdb_log(NULL, FDB_RESULT_FILE_REMOVE_FAIL,
+                    "Error in REMOVE on a log file '%s', %s",
+                    log_filename.c_str(), errno_msg);
+            return FDB_RESULT_FILE_REMOVE_FAIL;
+        }
+    }
+
+    return FDB_RESULT_SUCCESS;
+}
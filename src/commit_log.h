@@ -609,6 +609,15 @@ public:
      */
     fdb_status destroyLogUpto(uint64_t log_id_upto);
 
+    /**
+     * Destroy all log files of the DB instance, including the ones that
+     * have not been opened by this instance. The next log entry will be
+     * appended into a newly created log file.
+     *
+     * @return FDB_RESULT_SUCCESS on success.
+     */
+    fdb_status destroyAllLogs();
+
 private:
     // Commit log configuration.
     CommitLogConfig *config;
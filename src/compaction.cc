@@ -27,6 +27,7 @@
 #include "libforestdb/forestdb.h"
 
 #include "bgflusher.h"
+#include "bloom_filter.h"
 #include "btree.h"
 #include "btree_new.h"
 #include "bnodemgr.h"
@@ -39,6 +40,7 @@
 #include "fdb_internal.h"
 #include "filemgr.h"
 #include "hbtrie.h"
+#include "rate_limiter.h"
 #include "version.h"
 #include "wal.h"
 
@@ -75,7 +77,13 @@ char *_fdb_redirect_header(FileMgr *old_file, uint8_t *buf,
     size_t new_fnamelen_off = ver_get_new_filename_off(old_file->getVersion());
     size_t new_fname_off = new_fnamelen_off + 4;
     size_t offset = new_fnamelen_off;
+    size_t trailing_len; // old_filename and optional Bloom filter offset
+    uint64_t header_flags;
     char *old_filename;
+    // Read existing DB header's flags (located right before the filenames)
+    memcpy(&header_flags, buf + new_fnamelen_off - sizeof(header_flags),
+           sizeof(header_flags));
+    header_flags = _endian_decode(header_flags);
     // Read existing DB header's size of newly compacted filename
     seq_memcpy(&new_compact_filename_len, buf + offset, sizeof(uint16_t),
                offset);
@@ -85,6 +93,10 @@ char *_fdb_redirect_header(FileMgr *old_file, uint8_t *buf,
     seq_memcpy(&old_compact_filename_len, buf + offset, sizeof(uint16_t),
                offset);
     old_compact_filename_len = _endian_decode(old_compact_filename_len);
+    trailing_len = old_compact_filename_len;
+    if (header_flags & FDB_FLAG_BLOOM_FILTER) {
+        trailing_len += sizeof(uint64_t);
+    }
 
     // Update DB header's size of newly compacted filename to redirected one
     memcpy(buf + new_fnamelen_off, &new_filename_len_enc, sizeof(uint16_t));
@@ -93,12 +105,12 @@ char *_fdb_redirect_header(FileMgr *old_file, uint8_t *buf,
     old_filename = (char*)buf + offset + new_filename_len;
     if (new_compact_filename_len != new_filename_len) {
         memmove(old_filename, buf + offset + new_compact_filename_len,
-                old_compact_filename_len);
+                trailing_len);
     }
     // Update the DB header's new_filename to the redirected one
     memcpy(buf + new_fname_off, new_file->getFileName(), new_filename_len);
     // Compute the DB header's new crc32 value
-    crc_offset = new_fname_off + new_filename_len + old_compact_filename_len;
+    crc_offset = new_fname_off + new_filename_len + trailing_len;
     crc = get_checksum(buf, crc_offset, new_file->getCrcMode());
     crc = _endian_encode(crc);
     // Update the DB header's new crc32 value
@@ -156,6 +168,8 @@ fdb_status Compaction::compactFile(FdbFileHandle *fhandle,
     FileMgrConfig fconfig;
     FdbKvsHandle *handle = fhandle->getRootHandle();
     fdb_status status;
+    // The I/O issued by the compaction is paced as background work
+    IoRateLimiter::BackgroundScope background_io;
     LATENCY_STAT_START();
 
     // Prevent updates to the current file
@@ -241,6 +255,7 @@ fdb_status Compaction::compactFile(FdbFileHandle *fhandle,
         // multi KV instance mode .. append up-to-date KV header
         handle->kv_info_offset = fdb_kvs_header_append(handle);
     }
+    fdb_bloom_filter_append(handle);
 
     if (sb) {
         sb->returnReusableBlocks(handle);
@@ -623,6 +638,27 @@ fdb_status Compaction::createFile(const std::string file_name,
 
     fileMgr->fhandleAdd(handle->fhandle);
     fileMgr->setInPlaceCompaction(in_place_compaction);
+    ioChargedPos = fileMgr->getPos();
+
+    if (fileMgr->claimBloomFilterInit()) {
+        // Keys are moved into the new file's index through WAL flushing,
+        // so the Bloom filter of the new file is rebuilt from scratch.
+        BloomFilter *old_filter = handle->file->getBloomFilter();
+        uint32_t bits_per_key = handle->config.bloom_filter_bits_per_key;
+        if (!bits_per_key && old_filter) {
+            bits_per_key = old_filter->getBitsPerKey();
+        }
+        if (bits_per_key) {
+            fileMgr->setBloomFilter(new BloomFilter(bits_per_key));
+        }
+    }
+
+    if (handle->file->getCommitLog() && !in_place_compaction) {
+        // Keep using the commit log on the new file. As in-place compaction
+        // renames the new file afterwards, commits on such a file fall back
+        // to DB header commits until the file is reopened.
+        fileMgr->initCommitLog(handle->config.commit_log_size);
+    }
 
     docHandle = new DocioHandle(fileMgr,
                                 handle->config.compress_document_body,
@@ -936,6 +972,7 @@ fdb_status Compaction::copyDocsUptoMarker(FdbKvsHandle *rhandle,
         }
 
     }
+    fdb_bloom_filter_append(&new_handle);
     if (ver_btreev2_format(fileMgr->getVersion())) {
         new_handle.staletreeV2 = staleTreeV2;
     } else {
@@ -1225,6 +1262,255 @@ fdb_status Compaction::copyWalDocs(FdbKvsHandle *handle,
     return fs;
 }
 
+// Return true if a document read from the current file should be moved into
+// the new file, i.e., it is not deleted, or it is logically deleted but its
+// timestamp isn't overdue for purging yet.
+static bool _compaction_keep_doc(FdbKvsHandle *handle,
+                                 struct docio_object *doc,
+                                 timestamp_t cur_timestamp)
+{
+    if (!(doc->length.flag & DOCIO_DELETED)) {
+        return true;
+    }
+    return cur_timestamp < doc->timestamp + handle->config.purging_interval;
+}
+
+/**
+ * Context of a thread that moves a contiguous range of (sorted) document
+ * offsets from the current file to the new file during compaction.
+ */
+struct compaction_copier {
+    FdbKvsHandle *handle; // KV store handle of the current file
+    FileMgr *new_file;
+    DocioHandle *rhandle; // read cursor on the current file
+    DocioHandle *whandle; // write cursor on the new file
+    struct async_io_handle aio_handle;
+    struct async_io_handle *aio_handle_ptr;
+    struct docio_object *doc;
+    uint64_t *new_offset_array;
+    struct _fdb_key_cmp_info *cmp_info;
+    mutex_t *wal_lock;
+    // input of each round
+    uint64_t *offset_array;
+    size_t num_offsets;
+    timestamp_t cur_timestamp;
+    // output of each round
+    uint64_t n_moved_docs;
+    uint64_t old_offset;
+    uint64_t new_offset;
+    fdb_status status;
+    thread_t tid;
+};
+
+static void *_compaction_copier_thread(void *voidargs)
+{
+    struct compaction_copier *copier = (struct compaction_copier *)voidargs;
+    FdbKvsHandle *handle = copier->handle;
+    struct docio_object *doc = copier->doc;
+    Wal *wal = copier->new_file->getWal();
+    size_t i, j, num_batch_reads;
+    uint8_t deleted;
+    fdb_doc wal_doc;
+    IoRateLimiter::BackgroundScope background_io;
+
+    memset(&wal_doc, 0, sizeof(wal_doc));
+    i = 0;
+    while (i < copier->num_offsets) {
+        num_batch_reads =
+            copier->rhandle->batchReadDocs_Docio(&copier->offset_array[i],
+                                          doc, copier->num_offsets - i,
+                                          FDB_COMP_MOVE_UNIT, FDB_COMP_BATCHSIZE,
+                                          copier->aio_handle_ptr, false);
+        if (num_batch_reads == (size_t) -1) {
+            copier->status = FDB_RESULT_COMPACTION_FAIL;
+            break;
+        }
+
+        // append the documents to be kept through this copier's own cursor
+        for (j = 0; j < num_batch_reads; ++j) {
+            copier->new_offset_array[j] = BLK_NOT_FOUND;
+            if (!doc[j].key ||
+                !_compaction_keep_doc(handle, &doc[j], copier->cur_timestamp)) {
+                continue;
+            }
+            deleted = doc[j].length.flag & DOCIO_DELETED;
+            copier->new_offset_array[j] =
+                copier->whandle->appendDoc_Docio(&doc[j], deleted, 0);
+        }
+
+        // the new file's WAL is shared by all copiers
+        mutex_lock(copier->wal_lock);
+        for (j = 0; j < num_batch_reads; ++j) {
+            if (copier->new_offset_array[j] == BLK_NOT_FOUND) {
+                continue;
+            }
+            wal_doc.keylen = doc[j].length.keylen;
+            wal_doc.metalen = doc[j].length.metalen;
+            wal_doc.bodylen = doc[j].length.bodylen;
+            wal_doc.key = doc[j].key;
+            wal_doc.seqnum = doc[j].seqnum;
+            wal_doc.deleted = doc[j].length.flag & DOCIO_DELETED;
+            wal_doc.meta = doc[j].meta;
+            wal_doc.body = doc[j].body;
+            wal_doc.size_ondisk = _fdb_get_docsize(doc[j].length);
+            wal_doc.offset = copier->new_offset_array[j];
+
+            wal->insert_Wal(copier->new_file->getGlobalTxn(),
+                            copier->cmp_info, &wal_doc,
+                            copier->new_offset_array[j],
+                            WAL_INS_COMPACT_PHASE1);
+            copier->n_moved_docs++;
+            copier->old_offset = copier->offset_array[i + j];
+            copier->new_offset = copier->new_offset_array[j];
+        }
+        mutex_unlock(copier->wal_lock);
+
+        for (j = 0; j < num_batch_reads; ++j) {
+            free(doc[j].key);
+            free(doc[j].meta);
+            free(doc[j].body);
+            doc[j].key = doc[j].meta = doc[j].body = NULL;
+        }
+        i += num_batch_reads;
+
+        // stop early; the caller reports the rollback or the cancellation
+        if (handle->file->isRollbackOn() ||
+            handle->file->isCompactionCancellationRequested()) {
+            break;
+        }
+    }
+
+    thread_exit(0);
+    return NULL;
+}
+
+struct compaction_copier *Compaction::createCopiers(
+                                      FdbKvsHandle *handle,
+                                      size_t num_copiers,
+                                      struct _fdb_key_cmp_info *cmp_info,
+                                      mutex_t *wal_lock)
+{
+    struct compaction_copier *copiers = (struct compaction_copier *)
+        calloc(num_copiers, sizeof(struct compaction_copier));
+
+    for (size_t k = 0; k < num_copiers; ++k) {
+        struct compaction_copier *copier = &copiers[k];
+        copier->handle = handle;
+        copier->new_file = fileMgr;
+        copier->rhandle = new DocioHandle(handle->file,
+                                          handle->config.compress_document_body,
+                                          &handle->log_callback);
+        copier->whandle = new DocioHandle(fileMgr,
+                                          handle->config.compress_document_body,
+                                          &handle->log_callback);
+        copier->aio_handle.queue_depth = ASYNC_IO_QUEUE_DEPTH;
+        copier->aio_handle.block_size =
+            handle->file->getConfig()->getBlockSize();
+        copier->aio_handle.fops_handle = handle->file->getFopsHandle();
+        if (handle->file->getOps()->aio_init(handle->file->getFopsHandle(),
+                                             &copier->aio_handle)
+            == FDB_RESULT_SUCCESS) {
+            copier->aio_handle_ptr = &copier->aio_handle;
+        }
+        copier->doc = (struct docio_object *)
+            calloc(FDB_COMP_BATCHSIZE, sizeof(struct docio_object));
+        copier->new_offset_array = (uint64_t *)
+            malloc(sizeof(uint64_t) * FDB_COMP_BATCHSIZE);
+        copier->cmp_info = cmp_info;
+        copier->wal_lock = wal_lock;
+    }
+    return copiers;
+}
+
+void Compaction::destroyCopiers(FdbKvsHandle *handle,
+                                struct compaction_copier *copiers,
+                                size_t num_copiers)
+{
+    for (size_t k = 0; k < num_copiers; ++k) {
+        struct compaction_copier *copier = &copiers[k];
+        if (copier->aio_handle_ptr) {
+            handle->file->getOps()->aio_destroy(handle->file->getFopsHandle(),
+                                                copier->aio_handle_ptr);
+        }
+        delete copier->rhandle;
+        delete copier->whandle;
+        free(copier->doc);
+        free(copier->new_offset_array);
+    }
+    free(copiers);
+}
+
+fdb_status Compaction::moveDocsParallel(struct compaction_copier *copiers,
+                                        size_t num_copiers,
+                                        uint64_t *offset_array,
+                                        size_t num_offsets,
+                                        timestamp_t cur_timestamp,
+                                        uint64_t *n_moved_docs,
+                                        uint64_t *old_offset,
+                                        uint64_t *new_offset)
+{
+    size_t k, begin, end;
+    void *ret;
+    fdb_status fs = FDB_RESULT_SUCCESS;
+
+    // As offsets are sorted, each copier reads a contiguous region of the
+    // current file and appends it to its own blocks of the new file.
+    begin = 0;
+    for (k = 0; k < num_copiers; ++k) {
+        end = num_offsets * (k + 1) / num_copiers;
+        copiers[k].offset_array = offset_array + begin;
+        copiers[k].num_offsets = end - begin;
+        copiers[k].cur_timestamp = cur_timestamp;
+        copiers[k].n_moved_docs = 0;
+        copiers[k].status = FDB_RESULT_SUCCESS;
+        thread_create(&copiers[k].tid, _compaction_copier_thread,
+                      (void *)&copiers[k]);
+        begin = end;
+    }
+
+    for (k = 0; k < num_copiers; ++k) {
+        thread_join(copiers[k].tid, &ret);
+        if (copiers[k].status != FDB_RESULT_SUCCESS) {
+            fs = copiers[k].status;
+        }
+        if (copiers[k].n_moved_docs) {
+            *n_moved_docs += copiers[k].n_moved_docs;
+            *old_offset = copiers[k].old_offset;
+            *new_offset = copiers[k].new_offset;
+        }
+    }
+    return fs;
+}
+
+void Compaction::beginIndexBulkLoad(FdbKvsHandle *handle, size_t mem_limit)
+{
+    if (!ver_btreev2_format(fileMgr->getVersion())) {
+        return;
+    }
+    keyTrie->beginBulkLoad(mem_limit);
+    if (handle->kvs) {
+        seqTrie->beginBulkLoad(mem_limit);
+    }
+}
+
+void Compaction::endIndexBulkLoad(FdbKvsHandle *handle, fdb_status fs)
+{
+    if (!ver_btreev2_format(fileMgr->getVersion())) {
+        return;
+    }
+    if (fs == FDB_RESULT_SUCCESS) {
+        keyTrie->endBulkLoad();
+        if (handle->kvs) {
+            seqTrie->endBulkLoad();
+        }
+    } else {
+        keyTrie->abortBulkLoad();
+        if (handle->kvs) {
+            seqTrie->abortBulkLoad();
+        }
+    }
+}
+
 fdb_status Compaction::copyDocs(FdbKvsHandle *handle,
                                 size_t *prob,
                                 bool clone_docs)
@@ -1251,6 +1537,10 @@ fdb_status Compaction::copyDocs(FdbKvsHandle *handle,
     bid_t compactor_prev_bid, writer_prev_bid;
     bool locked = false;
 
+    size_t num_copiers;
+    struct compaction_copier *copiers = NULL;
+    mutex_t wal_lock;
+
 #ifdef _COW_COMPACTION
     if (clone_docs) {
         if (!FileMgr::isCowSupported(handle->file, fileMgr)) {
@@ -1329,6 +1619,22 @@ fdb_status Compaction::copyDocs(FdbKvsHandle *handle,
         calloc(FDB_COMP_BATCHSIZE, sizeof(struct docio_object));
     c = count = n_moved_docs = old_offset = new_offset = 0;
 
+    // Documents are moved by multiple copier threads unless the user decides
+    // on each of them through the callback, which is called in key order.
+    num_copiers = handle->config.num_compaction_copy_threads;
+    if (handle->config.compaction_cb &&
+        handle->config.compaction_cb_mask & FDB_CS_MOVE_DOC) {
+        num_copiers = 1;
+    }
+    if (num_copiers > 1) {
+        mutex_init(&wal_lock);
+        copiers = createCopiers(handle, num_copiers, &cmp_info, &wal_lock);
+    }
+
+    // The new file's index is empty, so that the moved documents can be
+    // bulk-loaded into it in a key order.
+    beginIndexBulkLoad(handle, window_size);
+
     it = new HBTrieIterator();
     hr = it->init(handle->trie, NULL, 0);
 
@@ -1364,18 +1670,36 @@ fdb_status Compaction::copyDocs(FdbKvsHandle *handle,
             // 3) flush WAL periodically
             i = 0;
             do {
-                // === read docs from the old file ===
                 size_t start_idx = i;
-                size_t num_batch_reads =
-                    handle->dhandle->batchReadDocs_Docio(&offset_array[start_idx],
+                size_t num_batch_reads = 0;
+                if (copiers) {
+                    // === move one batch per copier in parallel ===
+                    size_t n = c - start_idx;
+                    if (n > num_copiers * FDB_COMP_BATCHSIZE) {
+                        n = num_copiers * FDB_COMP_BATCHSIZE;
+                    }
+                    fs = moveDocsParallel(copiers, num_copiers,
+                                          &offset_array[start_idx], n,
+                                          cur_timestamp, &n_moved_docs,
+                                          &old_offset, &new_offset);
+                    if (fs != FDB_RESULT_SUCCESS) {
+                        break;
+                    }
+                    i += n;
+                } else {
+                    // === read docs from the old file ===
+                    num_batch_reads =
+                        handle->dhandle->batchReadDocs_Docio(
+                                          &offset_array[start_idx],
                                           doc, c - start_idx,
                                           FDB_COMP_MOVE_UNIT, FDB_COMP_BATCHSIZE,
                                           aio_handle_ptr, false);
-                if (num_batch_reads == (size_t) -1) {
-                    fs = FDB_RESULT_COMPACTION_FAIL;
-                    break;
+                    if (num_batch_reads == (size_t) -1) {
+                        fs = FDB_RESULT_COMPACTION_FAIL;
+                        break;
+                    }
+                    i += num_batch_reads;
                 }
-                i += num_batch_reads;
 
                 // === write docs into the new file ===
                 for (j=0; j<num_batch_reads; ++j) {
@@ -1416,20 +1740,11 @@ fdb_status Compaction::copyDocs(FdbKvsHandle *handle,
                         wal_doc.key = (void *)((uint8_t*)wal_doc.key
                                     - key_offset);
                         wal_doc.keylen += key_offset;
+                    } else if (_compaction_keep_doc(handle, &doc[j],
+                                                    cur_timestamp)) {
+                        decision = FDB_CS_KEEP_DOC;
                     } else {
-                        // compare timestamp
-                        if (!deleted ||
-                            (cur_timestamp < doc[j].timestamp +
-                             handle->config.purging_interval &&
-                             deleted)) {
-                            // re-write the document to new file when
-                            // 1. the document is not deleted
-                            // 2. the document is logically deleted but
-                            //    its timestamp isn't overdue
-                            decision = FDB_CS_KEEP_DOC;
-                        } else {
-                            decision = FDB_CS_DROP_DOC;
-                        }
+                        decision = FDB_CS_DROP_DOC;
                     }
                     if (decision == FDB_CS_KEEP_DOC) {
                         new_offset = docHandle->appendDoc_Docio(&doc[j],
@@ -1518,6 +1833,7 @@ fdb_status Compaction::copyDocs(FdbKvsHandle *handle,
                                           &compactor_prev_bid,
                                           prob,
                                           handle->config.max_writer_lock_prob);
+                chargeBackgroundWrites();
 
                 // If the rollback operation is issued, abort the compaction task.
                 if (handle->file->isRollbackOn()) {
@@ -1543,6 +1859,13 @@ fdb_status Compaction::copyDocs(FdbKvsHandle *handle,
     free(offset_array);
     free(doc);
 
+    endIndexBulkLoad(handle, fs);
+
+    if (copiers) {
+        destroyCopiers(handle, copiers, num_copiers);
+        mutex_destroy(&wal_lock);
+    }
+
     if (aio_handle_ptr) {
         handle->file->getOps()->aio_destroy(handle->file->getFopsHandle(),
                                             aio_handle_ptr);
@@ -1648,6 +1971,8 @@ fdb_status Compaction::cloneDocs(FdbKvsHandle *handle, size_t *prob)
 
     c = old_offset = new_offset = 0;
 
+    beginIndexBulkLoad(handle, FDB_COMP_BUF_MINSIZE);
+
     it = new HBTrieIterator();
     hr = it->init(handle->trie, NULL, 0);
 
@@ -1662,6 +1987,7 @@ fdb_status Compaction::cloneDocs(FdbKvsHandle *handle, size_t *prob)
                 free(_doc);
                 delete it;
                 free(offset_array);
+                endIndexBulkLoad(handle, fs);
                 return fs;
             }
         }
@@ -1862,6 +2188,7 @@ fdb_status Compaction::cloneDocs(FdbKvsHandle *handle, size_t *prob)
             updateWriteThrottlingProb(writer_curr_bid, compactor_curr_bid,
                                       &writer_prev_bid, &compactor_prev_bid,
                                       prob, handle->config.max_writer_lock_prob);
+            chargeBackgroundWrites();
 
             // If the rollback operation is issued, abort the compaction task.
             if (handle->file->isRollbackOn()) {
@@ -1885,6 +2212,8 @@ fdb_status Compaction::cloneDocs(FdbKvsHandle *handle, size_t *prob)
     delete it;
     free(offset_array);
 
+    endIndexBulkLoad(handle, fs);
+
     if (handle->config.compaction_cb &&
         handle->config.compaction_cb_mask & FDB_CS_END) {
         auto curApi = handle->suspendBusy();
@@ -2075,6 +2404,7 @@ fdb_status Compaction::copyDelta(FdbKvsHandle *handle,
                     // multi KV instance mode .. append up-to-date KV header
                     new_handle.kv_info_offset = fdb_kvs_header_append(&new_handle);
                 }
+                fdb_bloom_filter_append(&new_handle);
 
                 // Note: calling fdb_gather_stale_blocks() MUST be called BEFORE
                 // calling FileMgr::getNextAllocBlock(), because the system doc for
@@ -2241,6 +2571,9 @@ fdb_status Compaction::copyDelta(FdbKvsHandle *handle,
                                 &writer_bid_prev, &compactor_bid_prev,
                                 prob, handle->config.max_writer_lock_prob);
                             distance_updated = true;
+                            if (!got_lock) {
+                                chargeBackgroundWrites();
+                            }
                         }
 
                     } else {
@@ -2689,6 +3022,7 @@ fdb_status Compaction::commitAndRemovePending(FdbKvsHandle *handle,
         // multi KV instance mode .. append up-to-date KV header
         handle->kv_info_offset = fdb_kvs_header_append(handle);
     }
+    fdb_bloom_filter_append(handle);
 
     new_file->getStaleData()->gatherRegions(handle,
                                             new_file->getHeaderRevnum() + 1,
@@ -2856,6 +3190,15 @@ void Compaction::adjustWriteThrottlingProb(size_t cur_ratio, size_t *prob,
     }
 }
 
+void Compaction::chargeBackgroundWrites()
+{
+    uint64_t cur_pos = fileMgr->getPos();
+    if (cur_pos > ioChargedPos) {
+        IoRateLimiter::request(FDB_IO_BG_WRITE, cur_pos - ioChargedPos);
+    }
+    ioChargedPos = cur_pos;
+}
+
 void Compaction::updateWriteThrottlingProb(bid_t writer_curr_bid,
                                            bid_t compactor_curr_bid,
                                            bid_t *writer_prev_bid,
@@ -33,6 +33,7 @@ class DocioHandle;
 class HBTrie;
 class BTree;
 class BtreeV2;
+struct compaction_copier;
 
 /**
  * Abstraction that defines all operations related to compaction
@@ -41,7 +42,8 @@ class Compaction {
 public:
     Compaction() : fileMgr(nullptr), btreeHandle(nullptr), docHandle(nullptr),
                    keyTrie(nullptr), seqTree(nullptr), seqTrie(nullptr),
-                   staleTree(nullptr), oldFileStaleOps(nullptr) { }
+                   staleTree(nullptr), oldFileStaleOps(nullptr),
+                   ioChargedPos(0) { }
 
     /**
      * Compact a given file by copying its active blocks to the new file.
@@ -131,6 +133,78 @@ private:
                         size_t *prob,
                         bool clone_docs);
 
+    /**
+     * Create the copier threads' contexts used by copyDocs to move documents
+     * from the current file to the new file in parallel. Each copier has its
+     * own read cursor on the current file and its own write cursor on the
+     * new file.
+     *
+     * @param handle Pointer to the KV store handle of the current file
+     * @param num_copiers Number of copiers to be created
+     * @param cmp_info Key comparison info used for WAL insertions
+     * @param wal_lock Lock serializing the copiers' WAL insertions
+     * @return Array of copier contexts
+     */
+    struct compaction_copier *createCopiers(FdbKvsHandle *handle,
+                                            size_t num_copiers,
+                                            struct _fdb_key_cmp_info *cmp_info,
+                                            mutex_t *wal_lock);
+
+    /**
+     * Free the copier contexts created by createCopiers.
+     *
+     * @param handle Pointer to the KV store handle of the current file
+     * @param copiers Array of copier contexts
+     * @param num_copiers Number of copiers in the array
+     */
+    void destroyCopiers(FdbKvsHandle *handle,
+                        struct compaction_copier *copiers,
+                        size_t num_copiers);
+
+    /**
+     * Move the documents at the given (sorted) offsets of the current file
+     * into the new file and its WAL, by splitting the offsets into
+     * contiguous ranges that are moved by the copier threads in parallel.
+     *
+     * @param copiers Array of copier contexts
+     * @param num_copiers Number of copiers in the array
+     * @param offset_array Offsets of the documents in the current file
+     * @param num_offsets Number of offsets in the array
+     * @param cur_timestamp Current time used to purge deleted documents
+     * @param n_moved_docs Incremented by the number of documents moved
+     * @param old_offset Set to the offset of the last document moved
+     * @param new_offset Set to the new offset of the last document moved
+     * @return FDB_RESULT_SUCCESS on a successful copy operation
+     */
+    fdb_status moveDocsParallel(struct compaction_copier *copiers,
+                                size_t num_copiers,
+                                uint64_t *offset_array,
+                                size_t num_offsets,
+                                timestamp_t cur_timestamp,
+                                uint64_t *n_moved_docs,
+                                uint64_t *old_offset,
+                                uint64_t *new_offset);
+
+    /**
+     * Let the new file's by-key and by-seq HB+tries buffer the index entries
+     * of the documents moved by the compactor, so that the tries are built
+     * bottom-up at once by endIndexBulkLoad() instead of being updated one
+     * by one at every WAL flush. Only the new B+tree (V2) format is affected.
+     *
+     * @param handle Pointer to the KV store handle of the current file
+     * @param mem_limit Memory limit of the buffered entries for each trie
+     */
+    void beginIndexBulkLoad(FdbKvsHandle *handle, size_t mem_limit);
+
+    /**
+     * Build the new file's tries from the index entries buffered since
+     * beginIndexBulkLoad(), or discard them if the copy failed.
+     *
+     * @param handle Pointer to the KV store handle of the current file
+     * @param fs Result of the copy operation
+     */
+    void endIndexBulkLoad(FdbKvsHandle *handle, fdb_status fs);
+
     /**
      * Copy all the active blocks from a given beginning block to ending block in
      * the current file to the new file
@@ -285,6 +359,14 @@ private:
                                    size_t *prob,
                                    size_t max_prob);
 
+    /**
+     * Charge the bytes appended to the new file since the last call to the
+     * background write budget of the I/O rate limiter, and wait as long as
+     * the budget requires. Must not be called while holding the lock of the
+     * current file.
+     */
+    void chargeBackgroundWrites();
+
 
     FileMgr *fileMgr; // file manager instance for a new file
     union {
@@ -303,4 +385,5 @@ private:
         BtreeV2 *staleTreeV2; // stale block tree for a new file
     };
     BTreeKVOps *oldFileStaleOps; // stale ops of old file, freed on success!
+    uint64_t ioChargedPos; // new file's offset charged to the I/O rate limiter
 };
@@ -116,6 +116,33 @@ fdb_config get_default_config(void) {
     // Flush limit in bytes for non-block aligned buffer cache
     fconfig.bcache_flush_limit = 1048576;
 
+    // Each synchronous commit issues its own fsync by default
+    fconfig.group_commit = false;
+
+    // Size of each commit log file (used by FDB_DRB_COMMIT_LOG only)
+    fconfig.commit_log_size = FDB_DEFAULT_COMMIT_LOG_SIZE;
+
+    // Bloom filter for negative lookups is disabled by default
+    fconfig.bloom_filter_bits_per_key = 0;
+
+    fconfig.io_backend = FDB_IO_BACKEND_DEFAULT;
+
+    fconfig.num_compaction_copy_threads = DEFAULT_NUM_COMPACTION_COPY_THREADS;
+
+    // I/O rate limits are disabled by default
+    fconfig.fg_read_rate_limit = 0;
+    fconfig.fg_commit_rate_limit = 0;
+    fconfig.bg_write_rate_limit = 0;
+
+    // The WAL is flushed by the writer that hits the threshold by default
+    fconfig.background_wal_flush = false;
+
+    fconfig.num_wal_flush_threads = DEFAULT_NUM_WAL_FLUSH_THREADS;
+    fconfig.cache_warmup_budget = 0;
+    fconfig.secondary_cache_path = NULL;
+    fconfig.secondary_cache_size = 0;
+    fconfig.compressed_buffercache_size = 0;
+
     return fconfig;
 }
 
@@ -169,18 +196,69 @@ bool validate_fdb_config(fdb_config *fconfig) {
     if (fconfig->durability_opt != FDB_DRB_NONE &&
         fconfig->durability_opt != FDB_DRB_ODIRECT &&
         fconfig->durability_opt != FDB_DRB_ASYNC &&
-        fconfig->durability_opt != FDB_DRB_ODIRECT_ASYNC) {
+        fconfig->durability_opt != FDB_DRB_ODIRECT_ASYNC &&
+        fconfig->durability_opt != FDB_DRB_COMMIT_LOG) {
         fdb_log(NULL, FDB_RESULT_INVALID_ARGS,
                 "Config Error: Durability option (%x) : Not recognized! "
                 "[Allowed options: FDB_DRB_NONE (%x), FDB_DRB_ODIRECT (%x),"
-                " FDB_DRB_ASYNC (%x), FDB_DRB_ODIRECT_ASYNC (%x)]\n",
+                " FDB_DRB_ASYNC (%x), FDB_DRB_ODIRECT_ASYNC (%x),"
+                " FDB_DRB_COMMIT_LOG (%x)]\n",
                 fconfig->durability_opt, FDB_DRB_NONE, FDB_DRB_ODIRECT,
-                FDB_DRB_ASYNC, FDB_DRB_ODIRECT_ASYNC);
+                FDB_DRB_ASYNC, FDB_DRB_ODIRECT_ASYNC, FDB_DRB_COMMIT_LOG);
+        return false;
+    }
+
+    if (fconfig->durability_opt == FDB_DRB_COMMIT_LOG &&
+        fconfig->commit_log_size < FDB_BLOCKSIZE) {
+        fdb_log(NULL, FDB_RESULT_INVALID_ARGS,
+                "Config Error: Commit log size (%" _F64 ") : Should be at least "
+                "%d bytes when FDB_DRB_COMMIT_LOG is used\n",
+                fconfig->commit_log_size, FDB_BLOCKSIZE);
+        return false;
+    }
+
+    if (fconfig->bloom_filter_bits_per_key > 64) {
+        fdb_log(NULL, FDB_RESULT_INVALID_ARGS,
+                "Config Error: Bloom filter bits per key (%u) : Should be "
+                "between 0 and 64\n", fconfig->bloom_filter_bits_per_key);
+        return false;
+    }
+
+    if (fconfig->io_backend != FDB_IO_BACKEND_DEFAULT &&
+        fconfig->io_backend != FDB_IO_BACKEND_IO_URING) {
+        fdb_log(NULL, FDB_RESULT_INVALID_ARGS,
+                "Config Error: I/O backend (%d) : Not recognized! "
+                "[Allowed options: FDB_IO_BACKEND_DEFAULT (%x),"
+                " FDB_IO_BACKEND_IO_URING (%x)]\n",
+                fconfig->io_backend, FDB_IO_BACKEND_DEFAULT,
+                FDB_IO_BACKEND_IO_URING);
+        return false;
+    }
+
+    if (fconfig->num_compaction_copy_threads < 1 ||
+        fconfig->num_compaction_copy_threads > MAX_NUM_COMPACTION_COPY_THREADS) {
+        fdb_log(NULL, FDB_RESULT_INVALID_ARGS,
+                "Config Error: Compaction copy threads (%" _F64 ") : Should be "
+                "between 1 and %d\n",
+                (uint64_t)fconfig->num_compaction_copy_threads,
+                MAX_NUM_COMPACTION_COPY_THREADS);
+        return false;
+    }
+
+    if (fconfig->num_wal_flush_threads < 1 ||
+        fconfig->num_wal_flush_threads > MAX_NUM_WAL_FLUSH_THREADS) {
+        fdb_log(NULL, FDB_RESULT_INVALID_ARGS,
+                "Config Error: WAL flush threads (%" _F64 ") : Should be "
+                "between 1 and %d\n",
+                (uint64_t)fconfig->num_wal_flush_threads,
+                MAX_NUM_WAL_FLUSH_THREADS);
         return false;
     }
 
-    if ((fconfig->flags & FDB_OPEN_FLAG_CREATE) &&
-        (fconfig->flags & FDB_OPEN_FLAG_RDONLY)) {
+    if (((fconfig->flags & FDB_OPEN_FLAG_CREATE) &&
+         (fconfig->flags & FDB_OPEN_FLAG_RDONLY)) ||
+        ((fconfig->flags & FDB_OPEN_WITH_LEGACY_CRC) &&
+         (fconfig->flags & FDB_OPEN_WITH_XXH3_CHECKSUM))) {
         fdb_log(NULL, FDB_RESULT_INVALID_ARGS,
                 "Config Error: Open flags (%x) : Not recognized! "
                 "[Allowed options: FDB_OPEN_FLAG_CREATE (%x),"
@@ -532,6 +532,24 @@ DocioHandle::_docio_length_checksum(struct docio_length length)
                                 file_Docio->getCrcMode()) & 0xff);
 }
 
+uint32_t DocioHandle::_docio_doc_checksum(const uint8_t *buf, size_t len,
+                                          size_t keylen, size_t metalen)
+{
+    crc_mode_e crc_mode = file_Docio->getCrcMode();
+    size_t offset = sizeof(struct docio_length);
+    uint32_t crc = get_checksum(buf, offset, crc_mode);
+    crc = get_checksum(buf + offset, keylen, crc, crc_mode);
+    offset += keylen;
+    crc = get_checksum(buf + offset, sizeof(timestamp_t), crc, crc_mode);
+    offset += sizeof(timestamp_t);
+    crc = get_checksum(buf + offset, sizeof(fdb_seqnum_t), crc, crc_mode);
+    offset += sizeof(fdb_seqnum_t);
+    crc = get_checksum(buf + offset, metalen, crc, crc_mode);
+    offset += metalen;
+    // body (compressed, if so)
+    return get_checksum(buf + offset, len - offset, crc, crc_mode);
+}
+
 inline bid_t DocioHandle::_appendDoc_Docio(struct docio_object *doc)
 {
     size_t _len;
@@ -640,9 +658,9 @@ inline bid_t DocioHandle::_appendDoc_Docio(struct docio_object *doc)
     }
 
 #ifdef __CRC32
-    crc = get_checksum(reinterpret_cast<const uint8_t*>(buf),
-                       docsize - sizeof(crc),
-                       file_Docio->getCrcMode());
+    crc = _docio_doc_checksum(reinterpret_cast<const uint8_t*>(buf),
+                              docsize - sizeof(crc),
+                              length.keylen, length.metalen);
     memcpy((uint8_t *)buf + offset, &crc, sizeof(crc));
 #endif
 
@@ -1378,6 +1396,15 @@ int64_t DocioHandle::readDoc_Docio(uint64_t offset,
         }
     }
 #else
+    if (doc->length.flag & DOCIO_COMPRESSED) {
+        // compressed docs can't be read without the compression support
+        fdb_log(log_callback, FDB_RESULT_FILE_CORRUPTION,
+                "Error in reading a compressed doc with offset %" _F64
+                " from a database file '%s' that is not supported by "
+                "this build", offset, file_Docio->getFileName());
+        free_docio_object(doc, key_alloc, meta_alloc, body_alloc);
+        return (int64_t) FDB_RESULT_FILE_CORRUPTION;
+    }
     _offset = _readDocComponent_Docio(_offset, doc->length.bodylen,
                                         doc->body);
     if (_offset < 0) {
@@ -1461,6 +1488,115 @@ int64_t DocioHandle::readDoc_Docio(uint64_t offset,
     return _offset;
 }
 
+int64_t DocioHandle::readDocPinned_Docio(uint64_t offset,
+                                         struct docio_object *doc,
+                                         void **pin_handle)
+{
+    size_t real_blocksize = file_Docio->getBlockSize();
+    size_t blocksize = real_blocksize;
+    bool non_consecutive = ver_non_consecutive_doc(file_Docio->getVersion());
+    struct docblk_meta blk_meta;
+#ifdef __CRC32
+    if (non_consecutive) {
+        // new version: support non-consecutive document block
+        blocksize -= DOCBLK_META_SIZE;
+    } else {
+        // old version: block marker only
+        blocksize -= BLK_MARKER_SIZE;
+    }
+#endif
+
+    bid_t bid = offset / real_blocksize;
+    size_t pos = offset % real_blocksize;
+    if (pos + sizeof(struct docio_length) > blocksize) {
+        return 0;
+    }
+
+    uint8_t *addr = static_cast<uint8_t *>(file_Docio->pinBlock(bid,
+                                                                pin_handle));
+    if (!addr) {
+        // Bring the block into the block cache and try again.
+        // Note that 'readbuffer' is overwritten so that 'lastbid' is reset.
+        lastbid = BLK_NOT_FOUND;
+        if (file_Docio->read_FileMgr(bid, readbuffer, log_callback, true)
+            != FDB_RESULT_SUCCESS) {
+            return 0;
+        }
+        addr = static_cast<uint8_t *>(file_Docio->pinBlock(bid, pin_handle));
+        if (!addr) {
+            // block cache is disabled or the block is dirty
+            return 0;
+        }
+    }
+
+    if (non_consecutive) {
+        memcpy(&blk_meta, addr + real_blocksize - DOCBLK_META_SIZE,
+               sizeof(blk_meta));
+    } else {
+        memcpy(&blk_meta.marker, addr + real_blocksize - BLK_MARKER_SIZE,
+               sizeof(blk_meta.marker));
+    }
+    if (blk_meta.marker != BLK_MARKER_DOC) {
+        file_Docio->unpinBlock(*pin_handle);
+        return 0;
+    }
+
+    struct docio_length _length;
+    memcpy(&_length, addr + pos, sizeof(_length));
+    if (_docio_length_checksum(_length) != _length.checksum) {
+        file_Docio->unpinBlock(*pin_handle);
+        return 0;
+    }
+
+    doc->length = _decodeLength_Docio(_length);
+    size_t doc_size = sizeof(struct docio_length) + doc->length.keylen +
+                      sizeof(timestamp_t) + sizeof(fdb_seqnum_t) +
+                      doc->length.metalen + doc->length.bodylen;
+#ifdef __CRC32
+    doc_size += sizeof(uint32_t);
+#endif
+    if ((doc->length.flag & (DOCIO_TXN_COMMITTED | DOCIO_COMPRESSED)) ||
+        doc->length.keylen == 0 ||
+        doc->length.keylen > FDB_MAX_KEYLEN_INTERNAL ||
+        pos + doc_size > blocksize) {
+        // commit marker, compressed body, or the doc spanning multiple blocks
+        file_Docio->unpinBlock(*pin_handle);
+        return 0;
+    }
+
+    uint8_t *ptr = addr + pos + sizeof(struct docio_length);
+    timestamp_t _timestamp;
+    fdb_seqnum_t _seqnum;
+
+    doc->key = ptr;
+    ptr += doc->length.keylen;
+    memcpy(&_timestamp, ptr, sizeof(_timestamp));
+    doc->timestamp = _endian_decode(_timestamp);
+    ptr += sizeof(_timestamp);
+    memcpy(&_seqnum, ptr, sizeof(_seqnum));
+    doc->seqnum = _endian_decode(_seqnum);
+    ptr += sizeof(_seqnum);
+    doc->meta = doc->length.metalen ? ptr : NULL;
+    ptr += doc->length.metalen;
+    doc->body = doc->length.bodylen ? ptr : NULL;
+    ptr += doc->length.bodylen;
+
+#ifdef __CRC32
+    uint32_t crc_file, crc;
+    memcpy(&crc_file, ptr, sizeof(crc_file));
+    crc = _docio_doc_checksum(addr + pos, ptr - (addr + pos),
+                              doc->length.keylen, doc->length.metalen);
+    if (crc != crc_file) {
+        // let readDoc_Docio() report the checksum error
+        file_Docio->unpinBlock(*pin_handle);
+        doc->key = doc->meta = doc->body = NULL;
+        return 0;
+    }
+#endif
+
+    return offset + doc_size;
+}
+
 int DocioHandle::_submitAsyncIORequests_Docio(struct docio_object *doc_array,
                                      size_t doc_idx,
                                      struct async_io_handle *aio_handle,
@@ -1468,9 +1604,7 @@ int DocioHandle::_submitAsyncIORequests_Docio(struct docio_object *doc_array,
                                      size_t *sum_doc_size,
                                      bool keymeta_only)
 {
-#ifdef _ASYNC_IO
 #if !defined(WIN32) && !defined(_WIN32)
-    struct io_event* io_evt = NULL;
     uint8_t *buf = NULL;
     uint64_t offset = 0, _offset = 0;
     int num_events = 0;
@@ -1513,9 +1647,10 @@ int DocioHandle::_submitAsyncIORequests_Docio(struct docio_object *doc_array,
             return num_events;
         }
         num_sub -= num_events;
-        for (io_evt = aio_handle->events; num_events > 0; --num_events, ++io_evt) {
-            buf = (uint8_t *) io_evt->obj->u.c.buf;
-            offset = *((uint64_t *) io_evt->data); // Original offset.
+        for (int i = 0; i < num_events; ++i) {
+            size_t aio_idx = aio_handle->completed[i];
+            buf = aio_handle->aio_buf + aio_idx * aio_handle->block_size;
+            offset = aio_handle->offset_array[aio_idx]; // Original offset.
 
             // Set the docio handle's buffer to the AIO buffer to read
             // a doc from the AIO buffer. If adddtional blocks need to be
@@ -1551,10 +1686,7 @@ int DocioHandle::_submitAsyncIORequests_Docio(struct docio_object *doc_array,
         }
     }
     return size;
-#else // Plan to implement async I/O in other OSs (e.g., Windows, OSx)
-    return 0;
-#endif
-#else // Async I/O is not supported in the current OS.
+#else // Plan to implement async I/O in other OSs (e.g., Windows)
     return 0;
 #endif
 }
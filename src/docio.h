@@ -113,6 +113,24 @@ public:
                           struct docio_object *doc,
                           bool read_on_cache_miss);
 
+    /**
+     * Read a KV item at a given file offset without copying it, by pinning
+     * the block cache entry that contains the item. The key, metadata, and
+     * body of the docio_object point into the pinned block, which should be
+     * unpinned through FileMgr::unpinBlock() once they are no longer used.
+     *
+     * @param offset File offset to a KV item
+     * @param doc Pointer to docio_object instance
+     * @param pin_handle Pointer to the handle of the pinned block
+     * @return next offset right after a key and its value on successful read,
+     *         otherwise, 0 if the item cannot be read in place (e.g., it spans
+     *         multiple blocks, its body is compressed, or its block is not
+     *         cached) and should be read by readDoc_Docio() instead.
+     */
+    int64_t readDocPinned_Docio(uint64_t offset,
+                                struct docio_object *doc,
+                                void **pin_handle);
+
     /**
      * Read a batch of docs using async reads if possible
      *
@@ -208,6 +226,15 @@ private:
 
     struct docio_length _decodeLength_Docio(struct docio_length length);
     uint8_t _docio_length_checksum(struct docio_length length);
+
+    /**
+     * Checksum of a doc stored contiguously in the given buffer, excluding
+     * the trailing checksum itself. The components are chained in the same
+     * order as readDoc_Docio() does, so that the result also matches for
+     * checksum modes that cannot be computed over concatenated pieces.
+     */
+    uint32_t _docio_doc_checksum(const uint8_t *buf, size_t len,
+                                 size_t keylen, size_t metalen);
     bid_t _appendDoc_Docio(struct docio_object *doc);
 
     fdb_status _readThroughBuffer_Docio(bid_t bid, bool read_on_cache_miss);
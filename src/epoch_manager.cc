@@ -0,0 +1,115 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2016 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "epoch_manager.h"
+
+#include "memleak.h"
+
+EpochManager::Participant::Participant(EpochManager &_mgr)
+    : mgr(_mgr), epoch(0), pinned(false)
+{
+    std::lock_guard<std::mutex> lh(mgr.lock);
+    mgr.participants.insert(this);
+}
+
+EpochManager::Participant::~Participant()
+{
+    unpin();
+    std::lock_guard<std::mutex> lh(mgr.lock);
+    mgr.participants.erase(this);
+}
+
+void EpochManager::Participant::pin()
+{
+    if (pinned) {
+        return;
+    }
+    epoch.store(mgr.globalEpoch.load());
+    // The pinned epoch should be visible to reclaim() before any shared
+    // object is looked up.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    pinned = true;
+}
+
+void EpochManager::Participant::unpin()
+{
+    if (!pinned) {
+        return;
+    }
+    // Release, so that all reads of the objects looked up while pinned
+    // happen before they are freed.
+    epoch.store(0, std::memory_order_release);
+    pinned = false;
+}
+
+EpochManager::EpochManager()
+    : globalEpoch(1), numRetired(0), numKept(0)
+{ }
+
+EpochManager::~EpochManager()
+{
+    for (auto &item : retired) {
+        item.deleter(item.ptr);
+    }
+}
+
+void EpochManager::retire(void *ptr, deleter_t deleter)
+{
+    // A participant that pinned an epoch greater than this one pinned it
+    // after the object was unlinked, so it cannot have found the object.
+    uint64_t epoch = globalEpoch.fetch_add(1);
+    std::lock_guard<std::mutex> lh(lock);
+    retired.push_back(RetiredItem{epoch, ptr, deleter});
+    numRetired.store(retired.size(), std::memory_order_relaxed);
+}
+
+size_t EpochManager::reclaim()
+{
+    if (!getNumRetired()) {
+        return 0;
+    }
+
+    std::vector<RetiredItem> to_free;
+    {
+        std::lock_guard<std::mutex> lh(lock);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        uint64_t min_epoch = static_cast<uint64_t>(-1);
+        for (auto participant : participants) {
+            uint64_t epoch = participant->epoch.load(std::memory_order_acquire);
+            if (epoch && epoch < min_epoch) {
+                min_epoch = epoch;
+            }
+        }
+
+        size_t num_kept = 0;
+        for (auto &item : retired) {
+            if (item.epoch < min_epoch) {
+                to_free.push_back(item);
+            } else {
+                retired[num_kept++] = item;
+            }
+        }
+        retired.resize(num_kept);
+        numRetired.store(num_kept, std::memory_order_relaxed);
+        numKept.store(num_kept, std::memory_order_relaxed);
+    }
+
+    for (auto &item : to_free) {
+        item.deleter(item.ptr);
+    }
+    return to_free.size();
+}
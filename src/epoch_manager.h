@@ -0,0 +1,144 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2016 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Number of objects retired since the last reclamation, after which
+// maybeReclaim() tries to free them.
+#define EPOCH_RECLAIM_BATCH (64)
+
+/**
+ * Epoch-based reclamation of objects that may still be read by threads that
+ * don't hold any lock or reference on them.
+ *
+ * A reader pins the current epoch before it looks up shared objects, and
+ * unpins it once it no longer uses any of them. An object unlinked from
+ * every shared structure is retired instead of freed; it is freed by
+ * reclaim() once every participant that might have found it before it was
+ * unlinked has unpinned. Pinning and unpinning only store to the
+ * participant's own epoch, so readers don't write to any shared cache line.
+ */
+class EpochManager {
+public:
+    typedef void (*deleter_t)(void *ptr);
+
+    /**
+     * A reader of the objects protected by an epoch manager. A participant
+     * is not thread-safe; it should be used by one thread at a time.
+     */
+    class Participant {
+    public:
+        Participant(EpochManager &_mgr);
+
+        ~Participant();
+
+        /**
+         * Pin the current epoch. Does nothing if it is already pinned.
+         */
+        void pin();
+
+        /**
+         * Unpin the epoch pinned by the participant, after which none of the
+         * objects looked up while pinned may be used.
+         */
+        void unpin();
+
+        bool isPinned() const {
+            return pinned;
+        }
+
+    private:
+        friend class EpochManager;
+
+        EpochManager &mgr;
+        // Epoch pinned by the participant, or 0 if unpinned
+        std::atomic<uint64_t> epoch;
+        bool pinned;
+    };
+
+    EpochManager();
+
+    /**
+     * Free all the retired objects. There should be no pinned participant.
+     */
+    ~EpochManager();
+
+    /**
+     * Retire an object that has been unlinked from every shared structure.
+     *
+     * @param ptr Pointer to the object
+     * @param deleter Function that frees the object
+     */
+    void retire(void *ptr, deleter_t deleter);
+
+    /**
+     * Retire an object that should be freed with 'delete'.
+     */
+    template <typename T>
+    void retire(T *ptr) {
+        retire(ptr, [](void *p) { delete static_cast<T *>(p); });
+    }
+
+    /**
+     * Free the retired objects that no pinned participant can be using.
+     *
+     * @return Number of objects freed
+     */
+    size_t reclaim();
+
+    /**
+     * Call reclaim() if EPOCH_RECLAIM_BATCH objects have been retired since
+     * the last call, so that frequent callers don't keep scanning objects
+     * held by a long-pinned participant.
+     */
+    void maybeReclaim() {
+        if (getNumRetired() >=
+            numKept.load(std::memory_order_relaxed) + EPOCH_RECLAIM_BATCH) {
+            reclaim();
+        }
+    }
+
+    size_t getNumRetired() const {
+        return numRetired.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct RetiredItem {
+        // Global epoch at the time the object was retired
+        uint64_t epoch;
+        void *ptr;
+        deleter_t deleter;
+    };
+
+    std::atomic<uint64_t> globalEpoch;
+    std::atomic<size_t> numRetired;
+    // Number of objects that the last reclaim() could not free
+    std::atomic<size_t> numKept;
+
+    // guards 'participants' and 'retired'
+    std::mutex lock;
+    std::unordered_set<Participant *> participants;
+    std::vector<RetiredItem> retired;
+};
@@ -26,6 +26,8 @@
 #include "kvs_handle.h"
 #include "bnode.h"
 
+class FdbWriteBatch;
+
 /**
  * Class that defines the list of callback functions invoked for each WAL item
  * during the WAL flush
@@ -220,6 +222,49 @@ public:
                    fdb_doc *doc,
                    bool metaOnly);
 
+    /**
+     * Retrieve the metadata and doc body for a given key as a view into the
+     * pinned block cache entry, or into private copies if the doc cannot be
+     * read in place.
+     *
+     * @param handle Pointer to ForestDB KV store handle.
+     * @param key Pointer to the key to be retrieved.
+     * @param keylen Length of the key.
+     * @param pinned_doc Pointer to the view to be populated.
+     * @return FDB_RESULT_SUCCESS on success.
+     */
+    fdb_status getPinned(FdbKvsHandle *handle,
+                         const void *key,
+                         size_t keylen,
+                         fdb_pinned_doc *pinned_doc);
+
+    /**
+     * Release a view returned by getPinned().
+     *
+     * @param pinned_doc Pointer to the view to be released.
+     * @return FDB_RESULT_SUCCESS on success.
+     */
+    fdb_status releasePinned(fdb_pinned_doc *pinned_doc);
+
+    /**
+     * Retrieve the metadata and doc bodies for a batch of keys.
+     * Keys are sorted and their offsets are resolved through the WAL and the
+     * HB+trie in a single pass, and then all the docs are read in file offset
+     * order, using async I/O for the blocks not cached if it is supported.
+     *
+     * @param handle Pointer to ForestDB KV store handle.
+     * @param docs Array of ForestDB doc instances whose metadata and doc
+     *        bodies are populated as a result of this API call.
+     * @param num_docs Number of doc instances in the array.
+     * @param results Array of num_docs status codes, each of which is set to
+     *        the result of the lookup for the corresponding doc.
+     * @return FDB_RESULT_SUCCESS if the batch was processed.
+     */
+    fdb_status getMulti(FdbKvsHandle *handle,
+                        fdb_doc **docs,
+                        size_t num_docs,
+                        fdb_status *results);
+
     /**
      * Retrieve the metadata and doc body for a given sequence number.
      * Note that FDB_DOC instance should be created by calling
@@ -281,6 +326,19 @@ public:
     fdb_status del(FdbKvsHandle *handle,
                    fdb_doc *doc);
 
+    /**
+     * Apply all the set and delete operations in a write batch to a KV store.
+     * All docs are appended in a single run under the file mutex, their
+     * sequence numbers are assigned together, and they are indexed in WAL
+     * with each WAL shard lock grabbed only once.
+     *
+     * @param handle Pointer to ForestDB KV store handle.
+     * @param batch Pointer to the write batch to be applied.
+     * @return FDB_RESULT_SUCCESS on success.
+     */
+    fdb_status applyWriteBatch(FdbKvsHandle *handle,
+                               FdbWriteBatch *batch);
+
     /**
      * Simplified get API without key's metadata:
      * Retrieve the value (doc body in fdb_get) for a given key.
@@ -463,6 +521,24 @@ public:
      */
     size_t getBufferCacheUsed();
 
+    /**
+     * Change the I/O rate limit of a given class of requests.
+     *
+     * @param io_class Class of I/O requests
+     * @param bytes_per_sec New limit in bytes per second, 0 for unlimited
+     * @return FDB_RESULT_SUCCESS on success.
+     */
+    fdb_status setIoRateLimit(fdb_io_class io_class, uint64_t bytes_per_sec);
+
+    /**
+     * Return the I/O rate limit and throttling stats of a given class.
+     *
+     * @param io_class Class of I/O requests
+     * @param stats Pointer to the stats to be populated
+     * @return FDB_RESULT_SUCCESS on success.
+     */
+    fdb_status getIoRateStats(fdb_io_class io_class, fdb_io_rate_stats *stats);
+
     /**
      * Return the overall disk space actively used by a ForestDB file.
      * Note that this doesn't include the disk space used by stale btree nodes
@@ -533,9 +609,34 @@ public:
                                fdb_latency_stat *stats,
                                fdb_latency_stat_type type);
 
+    /**
+     * Return the latency percentiles of various forestdb api calls and
+     * internal operations on a ForestDB file
+     *
+     * @param fhandle Pointer to ForestDB file handle
+     * @param stats Pointer to a latency percentiles instance
+     * @param type Type of latency stat to be retrieved
+     * @return FDB_RESULT_SUCCESS on success.
+     */
+    fdb_status getLatencyPercentiles(FdbFileHandle *fhandle,
+                                     fdb_latency_percentiles *stats,
+                                     fdb_latency_stat_type type);
+
+    /**
+     * Return the latency percentiles of the forestdb api calls made on
+     * a given KV store
+     *
+     * @param handle Pointer to ForestDB KV store handle
+     * @param stats Pointer to a latency percentiles instance
+     * @param type Type of latency stat to be retrieved
+     * @return FDB_RESULT_SUCCESS on success.
+     */
+    fdb_status getKvsLatencyPercentiles(FdbKvsHandle *handle,
+                                        fdb_latency_percentiles *stats,
+                                        fdb_latency_stat_type type);
+
     /**
      * Returns a histogram of latencies for various forestdb api calls
-     * (Works with Couchbase Server Build only)
      *
      * @param fhandle Pointer to ForestDB file handle
      * @param stats Char pointer to stats (need to be freed from heap
@@ -868,6 +969,16 @@ private:
      */
     fdb_status closeRootHandle(FdbKvsHandle *handle);
 
+    /**
+     * Open the commit log of the file (FDB_DRB_COMMIT_LOG mode) and replay
+     * all the committed log entries that are not reflected in the DB file yet.
+     * This is done only on the first open of the file.
+     *
+     * @param handle Pointer to the root KV store handle
+     * @return FDB_RESULT_SUCCESS on success.
+     */
+    fdb_status replayCommitLog(FdbKvsHandle *handle);
+
     /**
      * Open the KV store with a given file and KV store name.
      *
@@ -97,7 +97,10 @@ void fdb_fetch_header(uint64_t version,
                       uint64_t *header_flags,
                       char **new_filename,
                       char **old_filename);
+uint64_t fdb_fetch_header_bloom_filter_offset(uint64_t version,
+                                             void *header_buf);
 uint64_t fdb_set_file_header(FdbKvsHandle *handle);
+void fdb_bloom_filter_append(FdbKvsHandle *handle);
 
 fdb_status fdb_open_for_compactor(fdb_file_handle **ptr_fhandle,
                                   const char *filename,
@@ -35,9 +35,13 @@
 #include "wal.h"
 #include "list.h"
 #include "fdb_internal.h"
+#include "rate_limiter.h"
+#include "secondary_cache.h"
 #include "time_utils.h"
 #include "executorpool.h"
 #include "version.h"
+#include "commit_log.h"
+#include "bloom_filter.h"
 
 #include "memleak.h"
 
@@ -71,8 +75,6 @@ superblock_init_cb FileMgr::sbInitializer(nullptr);
 std::mutex FileMgrMap::initGuard;
 std::atomic<FileMgrMap *> FileMgrMap::instance(nullptr);
 
-static const int MAX_STAT_UPDATE_RETRIES = 5;
-
 struct temp_buf_item {
     void *addr;
     struct list_elem le;
@@ -280,13 +282,16 @@ void FileMgrMap::freeEntries(filemgr_factory_free_cb free_callback) {
 FileMgr::FileMgr()
     : refCount(1), fMgrFlags(0x00), blockSize(global_config.getBlockSize()),
       fopsHandle(nullptr), lastPos(0), lastCommit(0), lastWritableBmpRevnum(0),
-      ioInprog(0), fMgrWal(nullptr), exPoolCtx(this), fMgrOps(nullptr),
+      ioInprog(0), fMgrWal(nullptr), exPoolCtx(this), taskableRegistered(false),
+      pendingWalFlush(nullptr), fMgrOps(nullptr),
       fMgrStatus(FILE_NORMAL), fileConfig(nullptr), bCache(nullptr),
       bnodeCache(nullptr), inPlaceCompaction(false),
       fsType(0), kvHeader(nullptr), throttlingDelay(0), fMgrVersion(0),
-      fMgrSb(nullptr), kvsStatOps(this), crcMode(CRC_DEFAULT),
-      staleData(nullptr), latestDirtyUpdate(nullptr),
-      bcacheHits(0), bcacheMisses(0)
+      fMgrSb(nullptr), kvsStatOps(this), groupSyncInProgress(false),
+      groupSyncedRevnum(0), crcMode(CRC_DEFAULT), staleData(nullptr),
+      latestDirtyUpdate(nullptr), bcacheHits(0), bcacheMisses(0),
+      commitLog(nullptr), commitLogConfig(nullptr), commitLogBytes(0),
+      bloomFilter(nullptr), bloomFilterInit(false)
 {
 
     fMgrHeader.bid = 0;
@@ -296,12 +301,10 @@ FileMgr::FileMgr()
 
     prefetchStatus = FILEMGR_PREFETCH_IDLE;
     prefetchTid = 0;
+    warmupStatus = FILEMGR_PREFETCH_IDLE;
+    warmupTid = 0;
 
-#ifdef _LATENCY_STATS
-    for (int i = 0; i < FDB_LATENCY_NUM_STATS; ++i) {
-        LatencyStats::init(&latStats[i]);
-    }
-#endif // _LATENCY_STATS
+    secondaryCacheId = SecondaryCache::newFileId();
 
     spin_init(&fMgrLock);
 
@@ -352,12 +355,6 @@ FileMgr::FileMgr()
 
 FileMgr::~FileMgr()
 {
-#ifdef _LATENCY_STATS
-    for (int x = 0; x < FDB_LATENCY_NUM_STATS; ++x) {
-        LatencyStats::destroy(&latStats[x]);
-    }
-#endif // _LATENCY_STATS
-
     spin_destroy(&fMgrLock);
 
 #ifdef __FILEMGR_DATA_PARTIAL_LOCK
@@ -401,8 +398,10 @@ void FileMgr::init(FileMgrConfig *config)
                                         global_config.getBlockSize(),
                                         global_config.getFlushLimit());
                 } else {
-                    BlockCacheManager::init(global_config.getNcacheBlock(),
-                                            global_config.getBlockSize());
+                    BlockCacheManager::init(
+                                    global_config.getNcacheBlock(),
+                                    global_config.getBlockSize(),
+                                    global_config.getCompressedCacheSize());
                 }
             }
 
@@ -829,11 +828,9 @@ fdb_status FileMgr::readHeader(ErrLogCallback *log_callback)
                         crc32 = get_checksum(reinterpret_cast<const uint8_t*>(buf),
                                              len - sizeof(crc),
                                              CRC32);
-#ifdef _CRC32C
                         crc32c = get_checksum(reinterpret_cast<const uint8_t*>(buf),
                                               len - sizeof(crc),
                                               CRC32C);
-#endif
                         const char *msg = "Crash Detected: CRC on disk %u != (%u | %u) "
                             "in a database file '%s'\n";
                         DBG(msg, crc_file, crc32, crc32c, getFileName());
@@ -1023,6 +1020,334 @@ void FileMgr::prefetch(ErrLogCallback *log_callback)
     releaseSpinLock();
 }
 
+// Suffix of the file where the warm-up list of a DB file is saved
+#define FILEMGR_WARMUP_SUFFIX ".warm"
+#define FILEMGR_WARMUP_MAGIC (0x5741524d4c495354ULL)
+// Types of the entries in a warm-up list
+#define FILEMGR_WARMUP_BLOCKS (0x0)
+#define FILEMGR_WARMUP_BNODES (0x1)
+// magic, type, block size, header BID, header revnum, and number of entries
+#define FILEMGR_WARMUP_HDR_FIELDS (6)
+
+struct filemgr_warmup_args {
+    FileMgr *file;
+    ErrLogCallback *log_callback;
+};
+
+void FileMgr::saveWarmupList(ErrLogCallback *log_callback)
+{
+    uint64_t budget = fileConfig->getWarmupBudget();
+    bid_t hdr_bid = getHeaderBid();
+    if (!budget || global_config.getNcacheBlock() == 0 ||
+        hdr_bid == BLK_NOT_FOUND) {
+        return;
+    }
+
+    std::vector<uint64_t> entries;
+    uint64_t type;
+    if (ver_btreev2_format(getVersion())) {
+        std::vector<cs_off_t> offsets;
+        BnodeCacheMgr::get()->getHotBnodes(this, budget, offsets);
+        entries.assign(offsets.begin(), offsets.end());
+        type = FILEMGR_WARMUP_BNODES;
+    } else {
+        std::vector<bid_t> bids;
+        BlockCacheManager::getInstance()->getHotBlocks(this,
+                                                       budget / blockSize,
+                                                       bids);
+        entries.assign(bids.begin(), bids.end());
+        type = FILEMGR_WARMUP_BLOCKS;
+    }
+
+    std::string path = std::string(fileName) + FILEMGR_WARMUP_SUFFIX;
+    if (entries.empty()) {
+        // don't leave the list of a previous state of the file behind
+        remove(path.c_str());
+        return;
+    }
+
+    // The list is only valid for the commit header that it is saved with.
+    std::vector<uint64_t> buf;
+    buf.reserve(FILEMGR_WARMUP_HDR_FIELDS + entries.size());
+    buf.push_back(FILEMGR_WARMUP_MAGIC);
+    buf.push_back(type);
+    buf.push_back(blockSize);
+    buf.push_back(hdr_bid);
+    buf.push_back(getHeaderRevnum());
+    buf.push_back(entries.size());
+    buf.insert(buf.end(), entries.begin(), entries.end());
+    for (auto &field : buf) {
+        field = _endian_encode(field);
+    }
+    size_t len = buf.size() * sizeof(uint64_t);
+    uint32_t crc = _endian_encode(get_checksum(
+                            reinterpret_cast<uint8_t *>(buf.data()), len));
+
+    // Write a temporary file first, so that a crash never leaves a torn list
+    std::string tmp_path = path + ".tmp";
+    FILE *fp = fopen(tmp_path.c_str(), "wb");
+    if (!fp) {
+        const char *msg = "Warning: Unable to open cache warm-up list file "
+                          "'%s'\n";
+        fdb_log(log_callback, FDB_RESULT_OPEN_FAIL, msg, tmp_path.c_str());
+        return;
+    }
+    bool written = fwrite(buf.data(), 1, len, fp) == len &&
+                   fwrite(&crc, 1, sizeof(crc), fp) == sizeof(crc);
+    written = (fclose(fp) == 0) && written;
+    if (!written || rename(tmp_path.c_str(), path.c_str()) < 0) {
+        remove(tmp_path.c_str());
+        const char *msg = "Warning: Unable to write cache warm-up list file "
+                          "'%s'\n";
+        fdb_log(log_callback, FDB_RESULT_WRITE_FAIL, msg, path.c_str());
+    }
+}
+
+bool FileMgr::loadWarmupList(std::vector<uint64_t> &entries,
+                             ErrLogCallback *log_callback)
+{
+    std::string path = std::string(fileName) + FILEMGR_WARMUP_SUFFIX;
+    FILE *fp = fopen(path.c_str(), "rb");
+    if (!fp) {
+        return false;
+    }
+
+    std::vector<uint64_t> buf;
+    bool valid = false;
+    long file_size = -1;
+    if (fseek(fp, 0, SEEK_END) == 0) {
+        file_size = ftell(fp);
+    }
+    size_t hdr_len = FILEMGR_WARMUP_HDR_FIELDS * sizeof(uint64_t);
+    if (file_size >= (long)(hdr_len + sizeof(uint32_t)) &&
+        (file_size - hdr_len - sizeof(uint32_t)) % sizeof(uint64_t) == 0 &&
+        fseek(fp, 0, SEEK_SET) == 0) {
+        size_t len = file_size - sizeof(uint32_t);
+        uint32_t crc;
+        buf.resize(len / sizeof(uint64_t));
+        if (fread(buf.data(), 1, len, fp) == len &&
+            fread(&crc, 1, sizeof(crc), fp) == sizeof(crc) &&
+            _endian_decode(crc) == get_checksum(
+                            reinterpret_cast<uint8_t *>(buf.data()), len)) {
+            for (auto &field : buf) {
+                field = _endian_decode(field);
+            }
+            uint64_t type = ver_btreev2_format(getVersion())
+                            ? FILEMGR_WARMUP_BNODES : FILEMGR_WARMUP_BLOCKS;
+            // The file should not have been committed since the list was
+            // saved; otherwise the listed blocks may be stale or reused.
+            valid = buf[0] == FILEMGR_WARMUP_MAGIC &&
+                    buf[1] == type &&
+                    buf[2] == blockSize &&
+                    buf[3] == getHeaderBid() &&
+                    buf[4] == getHeaderRevnum() &&
+                    buf[5] == buf.size() - FILEMGR_WARMUP_HDR_FIELDS;
+        }
+    }
+    fclose(fp);
+
+    if (!valid) {
+        const char *msg = "Warning: Ignored cache warm-up list file '%s' "
+                          "that is corrupted or outdated\n";
+        fdb_log(log_callback, FDB_RESULT_FILE_CORRUPTION, msg, path.c_str());
+        return false;
+    }
+    entries.assign(buf.begin() + FILEMGR_WARMUP_HDR_FIELDS, buf.end());
+    return true;
+}
+
+void FileMgr::removeWarmupList(const std::string &filename)
+{
+    std::string path = filename + FILEMGR_WARMUP_SUFFIX;
+    remove(path.c_str());
+}
+
+void FileMgr::warmUpBlocks(std::vector<uint64_t> &entries,
+                           ErrLogCallback *log_callback)
+{
+    BlockCacheManager *bcache = BlockCacheManager::getInstance();
+    uint64_t max_blocks = fileConfig->getWarmupBudget() / blockSize;
+    uint64_t num_blocks = 0;
+
+    // Read the blocks in batches through async I/O, unless they need to be
+    // decrypted.
+    struct async_io_handle aio_handle;
+    bool use_aio = false;
+    if (fMgrEncryption.ops == nullptr) {
+        aio_handle.queue_depth = ASYNC_IO_QUEUE_DEPTH;
+        aio_handle.block_size = blockSize;
+        aio_handle.fops_handle = fopsHandle;
+        use_aio = fMgrOps->aio_init(fopsHandle, &aio_handle) ==
+                  FDB_RESULT_SUCCESS;
+    }
+    size_t batch_size = use_aio ? aio_handle.queue_depth : 1;
+    uint8_t *buf = alca(uint8_t, blockSize);
+    std::vector<bid_t> batch;
+    bool terminate = false;
+    size_t i = 0;
+
+    while (!terminate && i < entries.size()) {
+        batch.clear();
+        for (; i < entries.size() && batch.size() < batch_size; ++i) {
+            if (num_blocks + batch.size() >= max_blocks ||
+                bcache->getNumFreeBlocks() <= batch.size()) {
+                // the budget or the free space of the cache is used up
+                terminate = true;
+                break;
+            }
+            bid_t bid = entries[i];
+            if (bid * blockSize >= getPos() || isWritable(bid) ||
+                bcache->isCached(this, bid)) {
+                continue;
+            }
+            batch.push_back(bid);
+        }
+        if (batch.empty() ||
+            warmupStatus.load() == FILEMGR_PREFETCH_ABORT) {
+            break;
+        }
+
+        if (!use_aio) {
+            bid_t bid = batch[0];
+            ssize_t r = readBlock(buf, bid);
+            if (r != (ssize_t)blockSize) {
+                fdb_log(log_callback, FDB_RESULT_READ_FAIL,
+                        "Cache warm-up thread failed to read a block with "
+                        "block id %" _F64 " from a database file '%s'",
+                        bid, fileName);
+                break;
+            }
+            if (checkCRC32(buf) == FDB_RESULT_SUCCESS && !isWritable(bid)) {
+                int ret = bcache->warmUp(this, bid, buf);
+                if (ret < 0) {
+                    break;
+                }
+                num_blocks += ret > 0 ? 1 : 0;
+            }
+            continue;
+        }
+
+        for (size_t j = 0; j < batch.size(); ++j) {
+            fMgrOps->aio_prep_read(fopsHandle, &aio_handle, j, blockSize,
+                                   batch[j] * blockSize);
+        }
+        int num_sub = fMgrOps->aio_submit(fopsHandle, &aio_handle,
+                                          batch.size());
+        if (num_sub != (int)batch.size()) {
+            fdb_log(log_callback, FDB_RESULT_READ_FAIL,
+                    "Cache warm-up thread failed to submit async I/O "
+                    "requests to a database file '%s'", fileName);
+            terminate = true;
+        }
+        while (num_sub > 0) {
+            int num_events = fMgrOps->aio_getevents(fopsHandle, &aio_handle,
+                                                    1, num_sub,
+                                                    (unsigned int) -1);
+            if (num_events < 0) {
+                fdb_log(log_callback, (fdb_status) num_events,
+                        "Cache warm-up thread failed to get async I/O "
+                        "events for a database file '%s'", fileName);
+                terminate = true;
+                break;
+            }
+            num_sub -= num_events;
+            for (int k = 0; k < num_events; ++k) {
+                size_t aio_idx = aio_handle.completed[k];
+                uint8_t *aio_buf = aio_handle.aio_buf +
+                                   aio_idx * aio_handle.block_size;
+                bid_t bid = aio_handle.offset_array[aio_idx] / blockSize;
+                // The block may have become writable (i.e., reused)
+                // while being read.
+                if (terminate || checkCRC32(aio_buf) != FDB_RESULT_SUCCESS ||
+                    isWritable(bid)) {
+                    continue;
+                }
+                int ret = bcache->warmUp(this, bid, aio_buf);
+                if (ret < 0) {
+                    terminate = true;
+                }
+                num_blocks += ret > 0 ? 1 : 0;
+            }
+        }
+    }
+
+    if (use_aio) {
+        fMgrOps->aio_destroy(fopsHandle, &aio_handle);
+    }
+}
+
+void FileMgr::warmUpBnodes(std::vector<uint64_t> &entries)
+{
+    BnodeCacheMgr *bcache = BnodeCacheMgr::get();
+    uint64_t budget = fileConfig->getWarmupBudget();
+    uint64_t loaded = 0;
+
+    for (auto &offset : entries) {
+        if (warmupStatus.load() == FILEMGR_PREFETCH_ABORT ||
+            loaded >= budget ||
+            bcache->getMemoryUsage() >= bcache->getMemoryLimit()) {
+            break;
+        }
+        if (offset >= getPos() || isWritable(offset / blockSize)) {
+            continue;
+        }
+        Bnode *node = nullptr;
+        if (bcache->read(this, &node, offset) <= 0 || !node) {
+            continue;
+        }
+        loaded += node->getMemConsumption();
+        node->decRefCount();
+    }
+}
+
+void *FileMgr::warmUpThread(void *voidargs)
+{
+    struct filemgr_warmup_args *args = (struct filemgr_warmup_args*)voidargs;
+    FileMgr *file = args->file;
+    std::vector<uint64_t> entries;
+
+    if (file->loadWarmupList(entries, args->log_callback)) {
+        if (ver_btreev2_format(file->getVersion())) {
+            file->warmUpBnodes(entries);
+        } else {
+            file->warmUpBlocks(entries, args->log_callback);
+        }
+    }
+
+    file->warmupStatus.store(FILEMGR_PREFETCH_TERMINATED);
+    free(args);
+    return NULL;
+}
+
+// warm up the cache with the list saved at the last close of the DB file
+void FileMgr::warmUp(ErrLogCallback *log_callback)
+{
+    acquireSpinLock();
+    filemgr_prefetch_status_t cond = FILEMGR_PREFETCH_IDLE;
+    if (getHeaderBid() != BLK_NOT_FOUND &&
+        warmupStatus.compare_exchange_strong(cond, FILEMGR_PREFETCH_RUNNING)) {
+        struct filemgr_warmup_args *args;
+        args = (struct filemgr_warmup_args *)
+                            calloc(1, sizeof(struct filemgr_warmup_args));
+        args->file = this;
+        args->log_callback = log_callback;
+        thread_create(&warmupTid, FileMgr::warmUpThread, args);
+    }
+    releaseSpinLock();
+}
+
+void FileMgr::stopWarmUp()
+{
+    filemgr_prefetch_status_t cond = FILEMGR_PREFETCH_RUNNING;
+    if (warmupStatus.compare_exchange_strong(cond, FILEMGR_PREFETCH_ABORT) ||
+        cond == FILEMGR_PREFETCH_TERMINATED) {
+        // the thread has been created; wait for it to be done
+        void *ret;
+        thread_join(warmupTid, &ret);
+        warmupStatus.store(FILEMGR_PREFETCH_IDLE);
+    }
+}
+
 fdb_status FileMgr::doesFileExist(const char *filename) {
     struct filemgr_ops *ops = get_filemgr_ops();
     fdb_fileops_handle fops_handle;
@@ -1245,6 +1570,8 @@ filemgr_open_result FileMgr::open(std::string filename,
     // initialize CRC mode
     if (file->fileConfig && file->fileConfig->getOptions() & FILEMGR_CREATE_CRC32) {
         file->crcMode = CRC32;
+    } else if (file->fileConfig) {
+        file->crcMode = file->fileConfig->getCreateCrcMode();
     } else {
         file->crcMode = CRC_DEFAULT;
     }
@@ -1327,6 +1654,9 @@ filemgr_open_result FileMgr::open(std::string filename,
     if (config->getPrefetchDuration() > 0) {
         file->prefetch(log_callback);
     }
+    if (config->getWarmupBudget() > 0 && global_config.getNcacheBlock() > 0) {
+        file->warmUp(log_callback);
+    }
 
     spin_unlock(&fileMgrOpenlock);
 
@@ -1730,6 +2060,15 @@ fdb_status FileMgr::close(FileMgr *file,
         return FDB_RESULT_SUCCESS;
     }
 
+    if (file->taskableRegistered) {
+        // Grabbing the file mutex applies the pending WAL flush, if any;
+        // then wait for the tasks of this file to be done.
+        file->mutexLock();
+        file->taskableRegistered = false;
+        file->mutexUnlock();
+        ExecutorPool::get()->unregisterTaskable(file->exPoolCtx, false);
+    }
+
     spin_lock(&fileMgrOpenlock);  // Grab the fileMgrOpenlock to avoid the race with
                                   // Filemgr::open() because file->fMgrLock won't
                                   // prevent the race condition.
@@ -1756,6 +2095,10 @@ fdb_status FileMgr::close(FileMgr *file,
         if (file->fMgrWal) {
             file->fMgrWal->close_Wal(log_callback);
         }
+        file->stopWarmUp();
+        if (file->getFileStatus() != FILE_REMOVED_PENDING) {
+            file->saveWarmupList(log_callback);
+        }
 #ifdef _LATENCY_STATS_DUMP_TO_FILE
         LatencyStats::dump(file, log_callback);
 #endif // _LATENCY_STATS_DUMP_TO_FILE
@@ -1835,6 +2178,14 @@ fdb_status FileMgr::close(FileMgr *file,
                                            log_callback,
                                            FDB_RESULT_FILE_RENAME_FAIL,
                                            "CLOSE", file->fileName);
+                        } else {
+                            // the warm-up list follows the file
+                            std::string warm_path = std::string(file->fileName)
+                                                    + FILEMGR_WARMUP_SUFFIX;
+                            std::string orig_warm_path =
+                                std::string(orig_file_name) +
+                                FILEMGR_WARMUP_SUFFIX;
+                            rename(warm_path.c_str(), orig_warm_path.c_str());
                         }
                     }
                 }
@@ -1891,6 +2242,7 @@ void FileMgr::freeFunc(FileMgr *file)
         // wait (the thread must have been created..)
         thread_join(file->prefetchTid, &ret);
     }
+    file->stopWarmUp();
 
     // remove all cached blocks
     file->removeAllBufferBlocks();
@@ -1921,6 +2273,23 @@ void FileMgr::freeFunc(FileMgr *file)
     // free superblock
     delete file->getSb();
 
+    // close commit log; its log files are not needed any more
+    // once the file has been replaced by compaction.
+    if (file->commitLog) {
+        if (file->fMgrStatus.load() == FILE_REMOVED_PENDING) {
+            file->commitLog->destroyAllLogs();
+        }
+        delete file->commitLog;
+        delete file->commitLogConfig;
+    }
+
+    // the warm-up list of a file replaced by compaction is useless
+    if (file->fMgrStatus.load() == FILE_REMOVED_PENDING) {
+        removeWarmupList(file->fileName);
+    }
+
+    delete file->bloomFilter.load();
+
     // free file structure
     delete file->staleData;
     delete file->fileConfig;
@@ -2002,11 +2371,13 @@ fdb_status FileMgr::shutdown()
 bid_t FileMgr::alloc_FileMgr(ErrLogCallback *log_callback) {
     acquireSpinLock();
     bid_t bid = BLK_NOT_FOUND;
+    bool reused = false;
 
     // block reusing is not allowed for being compacted file
     // for easy implementation.
     if (getFileStatus() == FILE_NORMAL && fMgrSb) {
         bid = fMgrSb->allocBlock();
+        reused = (bid != BLK_NOT_FOUND);
     }
     if (bid == BLK_NOT_FOUND) {
         bid = lastPos.load() / blockSize;
@@ -2023,6 +2394,11 @@ bid_t FileMgr::alloc_FileMgr(ErrLogCallback *log_callback) {
     }
     releaseSpinLock();
 
+    if (reused) {
+        // the old content of the block is about to be overwritten
+        invalidateSecondaryCache(bid);
+    }
+
     return bid;
 }
 
@@ -2103,9 +2479,24 @@ bool FileMgr::invalidateBlock(bid_t bid) {
         !ver_btreev2_format(getVersion())) {
         BlockCacheManager::getInstance()->invalidateBlock(this, bid);
     }
+    invalidateSecondaryCache(bid);
     return ret;
 }
 
+void FileMgr::invalidateSecondaryCache(bid_t bid) {
+    SecondaryCache *scache = SecondaryCache::getInstance();
+    uint64_t id = getSecondaryCacheId();
+    if (!scache || !id) {
+        return;
+    }
+    if (ver_btreev2_format(getVersion())) {
+        // B+tree nodes are cached by their offsets
+        scache->invalidate(id, bid * blockSize, (bid + 1) * blockSize);
+    } else {
+        scache->invalidate(id, bid, bid + 1);
+    }
+}
+
 bool FileMgr::isFullyResident() {
     bool ret = false;
     if (global_config.getNcacheBlock() > 0) {
@@ -2188,6 +2579,7 @@ fdb_status FileMgr::read_FileMgr(bid_t bid, void *buf,
         bid_t is_writer = 0;
 #endif
         bool locked = false;
+        bool disk_read = false;
         // Note: we don't need to grab lock for committed blocks
         // because they are immutable so that no writer will interfere and
         // overwrite dirty data
@@ -2225,52 +2617,65 @@ fdb_status FileMgr::read_FileMgr(bid_t bid, void *buf,
                 return FDB_RESULT_READ_FAIL;
             }
 
-            // if normal file, just read a block
-            r = readBlock(buf, bid);
-            if (r != (ssize_t)blockSize) {
-                _log_errno_str(fopsHandle, fMgrOps, log_callback,
-                               (fdb_status) r, "READ", fileName);
-                if (locked) {
+            // Committed blocks evicted from the cache may still be in the
+            // secondary cache, in which case their CRC is already checked.
+            SecondaryCache *scache = SecondaryCache::getInstance();
+            uint64_t scache_id = getSecondaryCacheId();
+            bool scache_hit = false;
+            if (scache && scache_id && !locked) {
+                scache_hit = scache->read(scache_id, bid, buf,
+                                          blockSize) == blockSize;
+            }
+
+            if (!scache_hit) {
+                // if normal file, just read a block
+                r = readBlock(buf, bid);
+                disk_read = true;
+                if (r != (ssize_t)blockSize) {
+                    _log_errno_str(fopsHandle, fMgrOps, log_callback,
+                                   (fdb_status) r, "READ", fileName);
+                    if (locked) {
 #ifdef __FILEMGR_DATA_PARTIAL_LOCK
-                    plock_unlock(&fMgrPlock, plock_entry);
+                        plock_unlock(&fMgrPlock, plock_entry);
 #elif defined(__FILEMGR_DATA_MUTEX_LOCK)
-                    mutex_unlock(&dataMutex[lock_no]);
+                        mutex_unlock(&dataMutex[lock_no]);
 #else
-                    spin_unlock(&dataSpinlock[lock_no]);
+                        spin_unlock(&dataSpinlock[lock_no]);
 #endif //__FILEMGR_DATA_PARTIAL_LOCK
+                    }
+                    const char *msg = "Read error: BID %" _F64 " in a "
+                                      "database file '%s' is not read "
+                                      "correctly: only %d bytes read";
+                    status = r < 0 ? (fdb_status)r : FDB_RESULT_READ_FAIL;
+                    fdb_log(log_callback, status, msg, bid, fileName, r);
+                    if (!log_callback || !log_callback->getCallback()) {
+                        dbg_print_buf(buf, blockSize, true, 16);
+                    }
+                    return status;
                 }
-                const char *msg = "Read error: BID %" _F64 " in a database file"
-                                  " '%s' " "is not read correctly: only %d "
-                                  "bytes read";
-                status = r < 0 ? (fdb_status)r : FDB_RESULT_READ_FAIL;
-                fdb_log(log_callback, status, msg, bid, fileName, r);
-                if (!log_callback || !log_callback->getCallback()) {
-                    dbg_print_buf(buf, blockSize, true, 16);
-                }
-                return status;
-            }
 
-            status = checkCRC32(buf);
-            if (status != FDB_RESULT_SUCCESS) {
-                _log_errno_str(fopsHandle, fMgrOps, log_callback, status, "READ",
-                               fileName);
-                if (locked) {
+                status = checkCRC32(buf);
+                if (status != FDB_RESULT_SUCCESS) {
+                    _log_errno_str(fopsHandle, fMgrOps, log_callback, status,
+                                   "READ", fileName);
+                    if (locked) {
 #ifdef __FILEMGR_DATA_PARTIAL_LOCK
-                    plock_unlock(&fMgrPlock, plock_entry);
+                        plock_unlock(&fMgrPlock, plock_entry);
 #elif defined(__FILEMGR_DATA_MUTEX_LOCK)
-                    mutex_unlock(&dataMutex[lock_no]);
+                        mutex_unlock(&dataMutex[lock_no]);
 #else
-                    spin_unlock(&dataSpinlock[lock_no]);
+                        spin_unlock(&dataSpinlock[lock_no]);
 #endif //__FILEMGR_DATA_PARTIAL_LOCK
+                    }
+                    const char *msg = "Read error: checksum error on BID %" _F64
+                                      " in a database file '%s' : marker %x";
+                    fdb_log(log_callback, status, msg, bid,
+                            fileName, *((uint8_t*)buf + blockSize - 1));
+                    if (!log_callback || !log_callback->getCallback()) {
+                        dbg_print_buf(buf, blockSize, true, 16);
+                    }
+                    return status;
                 }
-                const char *msg = "Read error: checksum error on BID %" _F64
-                                  " in a database file '%s' : marker %x";
-                fdb_log(log_callback, status, msg, bid,
-                        fileName, *((uint8_t*)buf + blockSize - 1));
-                if (!log_callback || !log_callback->getCallback()) {
-                    dbg_print_buf(buf, blockSize, true, 16);
-                }
-                return status;
             }
 
             r = BlockCacheManager::getInstance()->write(this, bid, buf,
@@ -2311,6 +2716,10 @@ fdb_status FileMgr::read_FileMgr(bid_t bid, void *buf,
             spin_unlock(&dataSpinlock[lock_no]);
 #endif //__FILEMGR_DATA_PARTIAL_LOCK
         }
+        // Pace the foreground reads after the data lock is released.
+        if (disk_read && !IoRateLimiter::isBackgroundThread()) {
+            IoRateLimiter::request(FDB_IO_FG_READ, blockSize);
+        }
     } else {
         if (!read_on_cache_miss) {
             const char *msg = "Read error: BID %" _F64 " in a database file "
@@ -2320,6 +2729,9 @@ fdb_status FileMgr::read_FileMgr(bid_t bid, void *buf,
             return FDB_RESULT_READ_FAIL;
         }
 
+        if (!IoRateLimiter::isBackgroundThread()) {
+            IoRateLimiter::request(FDB_IO_FG_READ, blockSize);
+        }
         r = readBlock(buf, bid);
         if (r != (ssize_t)blockSize) {
             _log_errno_str(fopsHandle, fMgrOps, log_callback, (fdb_status) r,
@@ -2353,6 +2765,23 @@ fdb_status FileMgr::read_FileMgr(bid_t bid, void *buf,
     return status;
 }
 
+void *FileMgr::pinBlock(bid_t bid, void **pin_handle) {
+    if (global_config.getNcacheBlock() == 0 ||
+        ver_btreev2_format(getVersion())) {
+        return NULL;
+    }
+
+    void *addr = BlockCacheManager::getInstance()->pin(this, bid, pin_handle);
+    if (addr) {
+        incrBlockCacheHits();
+    }
+    return addr;
+}
+
+void FileMgr::unpinBlock(void *pin_handle) {
+    BlockCacheManager::getInstance()->unpin(pin_handle);
+}
+
 fdb_status FileMgr::writeOffset(bid_t bid, uint64_t offset, uint64_t len,
                                 void *buf, bool final_write,
                                 ErrLogCallback *log_callback) {
@@ -2558,6 +2987,7 @@ fdb_status FileMgr::commitBid(bid_t bid, uint64_t bmp_revnum, bool sync,
     filemgr_header_revnum_t _revnum;
     int result = FDB_RESULT_SUCCESS;
     bool block_reusing = false;
+    LATENCY_STAT_START();
 
     setIoInprog();
     if (global_config.getNcacheBlock() > 0) {
@@ -2727,14 +3157,60 @@ fdb_status FileMgr::commitBid(bid_t bid, uint64_t bmp_revnum, bool sync,
     releaseSpinLock();
 
     if (sync) {
-        result = fMgrOps->fsync(fopsHandle);
+        result = fsyncFile();
         _log_errno_str(fopsHandle, fMgrOps, log_callback, (fdb_status)result,
                        "FSYNC", fileName);
     }
     clearIoInprog();
+    LATENCY_STAT_END(this, FDB_LATENCY_HEADER_COMMIT);
     return (fdb_status) result;
 }
 
+int FileMgr::fsyncFile() {
+    LATENCY_STAT_START();
+    int result = fMgrOps->fsync(fopsHandle);
+    LATENCY_STAT_END(this, FDB_LATENCY_FSYNC);
+    return result;
+}
+
+fdb_status FileMgr::syncGroupCommit(filemgr_header_revnum_t revnum,
+                                    ErrLogCallback *log_callback) {
+    std::unique_lock<std::mutex> lh(groupCommitLock);
+    while (groupSyncedRevnum < revnum) {
+        if (groupSyncInProgress) {
+            // another committer is the leader of the current group;
+            // wait for its fsync and check again whether it covered us.
+            groupCommitCond.wait(lh);
+            continue;
+        }
+
+        // become the leader of a new group. Every header whose revnum is
+        // visible here has already been written by commitBid(), so a single
+        // fsync makes all of them durable.
+        groupSyncInProgress = true;
+        filemgr_header_revnum_t target = getHeaderRevnum();
+        lh.unlock();
+
+        setIoInprog();
+        int result = fsyncFile();
+        _log_errno_str(fopsHandle, fMgrOps, log_callback, (fdb_status)result,
+                       "FSYNC", fileName);
+        clearIoInprog();
+
+        lh.lock();
+        groupSyncInProgress = false;
+        if (result == FDB_RESULT_SUCCESS && target > groupSyncedRevnum) {
+            groupSyncedRevnum = target;
+        }
+        // on failure, waiters retry the fsync on their own
+        groupCommitCond.notify_all();
+        if (result != FDB_RESULT_SUCCESS) {
+            return (fdb_status) result;
+        }
+    }
+    return FDB_RESULT_SUCCESS;
+}
+
 fdb_status FileMgr::sync_FileMgr(bool sync_option,
                                  ErrLogCallback *log_callback) {
     fdb_status result = FDB_RESULT_SUCCESS;
@@ -2753,7 +3229,7 @@ fdb_status FileMgr::sync_FileMgr(bool sync_option,
     }
 
     if (sync_option && (fMgrFlags & FILEMGR_SYNC)) {
-        int rv = fMgrOps->fsync(fopsHandle);
+        int rv = fsyncFile();
         _log_errno_str(fopsHandle, fMgrOps, log_callback, (fdb_status)rv, "FSYNC",
                        fileName);
         return (fdb_status) rv;
@@ -3048,6 +3524,8 @@ fdb_status FileMgr::destroyFile(std::string filename,
                 if (disk_file.fileConfig &&
                     disk_file.fileConfig->getOptions() & FILEMGR_CREATE_CRC32) {
                     disk_file.crcMode = CRC32;
+                } else if (disk_file.fileConfig) {
+                    disk_file.crcMode = disk_file.fileConfig->getCreateCrcMode();
                 } else {
                     disk_file.crcMode = CRC_DEFAULT;
                 }
@@ -3110,6 +3588,14 @@ fdb_status FileMgr::destroyFile(std::string filename,
         }
     }
 
+    if (status == FDB_RESULT_SUCCESS) {
+        // remove commit log files of the destroyed file, if any
+        CommitLogConfig log_config(get_filemgr_ops());
+        CommitLog commit_log(filename, &log_config);
+        status = commit_log.destroyAllLogs();
+        removeWarmupList(filename);
+    }
+
     if (!destroy_file_set) { // top level or non-recursive call
         destroy_set->clear();
     }
@@ -3117,6 +3603,16 @@ fdb_status FileMgr::destroyFile(std::string filename,
     return status;
 }
 
+bool FileMgr::initCommitLog(uint64_t file_size_limit) {
+    if (commitLog) {
+        return false;
+    }
+    commitLogConfig = new CommitLogConfig(fMgrOps, file_size_limit);
+    commitLog = new CommitLog(std::string(fileName), commitLogConfig);
+    commitLogBytes.store(0);
+    return true;
+}
+
 uint64_t FileMgr::getBCacheItems() {
     // If bnodeCache is available fetch stats from it,
     // or else if blockCache is available fetch stats from it.
@@ -3144,6 +3640,19 @@ uint64_t FileMgr::getBCacheVictims() {
     }
 }
 
+uint64_t FileMgr::getBCacheEvictions() {
+    // If bnodeCache is available fetch stats from it,
+    // or else if blockCache is available fetch stats from it.
+    // Note that bnodeCache counts a victim for each evicted node.
+    if (bnodeCache.load()) {
+        return bnodeCache.load()->getNumVictims();
+    } else if (bCache.load()) {
+        return bCache.load()->getNumEvictions();
+    } else {
+        return 0;
+    }
+}
+
 uint64_t FileMgr::getBCacheImmutables() {
     // If bnodeCache is available fetch stats from it,
     // or else if blockCache is available fetch stats from it.
@@ -3220,16 +3729,50 @@ void FileMgr::mutexOpenunlock(void) {
 void FileMgr::mutexLock() {
     mutex_lock(&writerLock.mutex);
     writerLock.locked = true;
+    completePendingWalFlush();
 }
 
 bool FileMgr::mutexTrylock() {
     if (mutex_trylock(&writerLock.mutex)) {
         writerLock.locked = true;
+        completePendingWalFlush();
+        return true;
+    }
+    return false;
+}
+
+void FileMgr::mutexLockForAppend() {
+    mutex_lock(&writerLock.mutex);
+    writerLock.locked = true;
+}
+
+bool FileMgr::stepPendingWalFlush() {
+    if (!pendingWalFlush) {
+        return false;
+    }
+    if (!pendingWalFlush->step()) {
         return true;
     }
+    delete pendingWalFlush;
+    pendingWalFlush = nullptr;
     return false;
 }
 
+void FileMgr::completePendingWalFlush() {
+    while (stepPendingWalFlush()) { }
+}
+
+void FileMgr::scheduleTask(ExTask &task) {
+    if (!taskableRegistered) {
+        LockHolder lh(taskableLock);
+        if (!taskableRegistered) {
+            ExecutorPool::get()->registerTaskable(exPoolCtx);
+            taskableRegistered = true;
+        }
+    }
+    ExecutorPool::get()->schedule(task, WRITER_TASK_IDX);
+}
+
 void FileMgr::mutexUnlock() {
     if (writerLock.locked) {
         writerLock.locked = false;
@@ -3746,6 +4289,11 @@ const char* FileMgr::getLatencyStatName(fdb_latency_stat_type stat) {
         case FDB_LATENCY_WAL_COMMIT:    return "wal_commit      ";
         case FDB_LATENCY_WAL_FLUSH:     return "wal_flush       ";
         case FDB_LATENCY_WAL_RELEASE:   return "wal_releas_items";
+        case FDB_LATENCY_WAL_FLUSH_COMPACT: return "wal_flush_compct";
+        case FDB_LATENCY_BCACHE_EVICT:  return "bcache_evict    ";
+        case FDB_LATENCY_BNODE_FLUSH:   return "bnode_flush     ";
+        case FDB_LATENCY_FSYNC:         return "fsync           ";
+        case FDB_LATENCY_HEADER_COMMIT: return "header_commit   ";
     }
     return NULL;
 }
@@ -3982,105 +4530,111 @@ KvsOpsStat* KvsStatOperations::migrateOpStats(FileMgr *old_file,
 }
 
 #ifdef _LATENCY_STATS
-void LatencyStats::init(struct latency_stat *val) {
-    val->lat_max = 0;
-    val->lat_min = static_cast<uint64_t>(-1);
-    val->lat_sum = 0;
-    val->lat_num = 0;
-}
-
-void LatencyStats::destroy(struct latency_stat *val) {
-    (void) val;
-}
-
 void LatencyStats::migrate(FileMgr *src, FileMgr *dst) {
     for (int type = 0; type < FDB_LATENCY_NUM_STATS; ++type) {
-        dst->latStats[type].lat_min.store(src->latStats[type].lat_min.load(),
-                                          std::memory_order_relaxed);
-        dst->latStats[type].lat_max.store(src->latStats[type].lat_max.load(),
-                                          std::memory_order_relaxed);
-        dst->latStats[type].lat_sum.store(src->latStats[type].lat_sum.load(),
-                                          std::memory_order_relaxed);
-        dst->latStats[type].lat_num.store(src->latStats[type].lat_num.load(),
-                                          std::memory_order_relaxed);
+        dst->latStats[type].merge(src->latStats[type]);
+    }
+    // KV store histograms are shared so that the handles that have not
+    // switched to the new file yet keep updating the same instances.
+    std::lock_guard<std::mutex> src_lock(src->kvsLatStatsLock);
+    std::lock_guard<std::mutex> dst_lock(dst->kvsLatStatsLock);
+    for (auto &entry : src->kvsLatStats) {
+        dst->kvsLatStats.insert(entry);
     }
 }
 
 void LatencyStats::update(FileMgr *file, fdb_latency_stat_type type,
                           uint64_t val) {
-    int retry = MAX_STAT_UPDATE_RETRIES;
-    do {
-        uint64_t lat_max = file->latStats[type].lat_max.load(
-                                                    std::memory_order_relaxed);
-        if (lat_max < val) {
-            if (!file->latStats[type].lat_max.compare_exchange_strong(lat_max,
-                                                                      val)) {
-                continue;
-            }
-        }
-        break;
-    } while (--retry);
-    retry = MAX_STAT_UPDATE_RETRIES;
-    do {
-        uint64_t lat_min = file->latStats[type].lat_min.load(
-                                                    std::memory_order_relaxed);
-        if (val < lat_min) {
-            if (!file->latStats[type].lat_min.compare_exchange_strong(lat_min,
-                                                                      val)) {
-                continue;
+    file->latStats[type].add(val);
+}
+
+static kvs_latency_stats *_get_kvs_latency_stats(FdbKvsHandle *handle) {
+    FileMgr *file = handle->file;
+    if (!handle->lat_stats || handle->lat_stats_file != file) {
+        fdb_kvs_id_t kv_id = handle->kvs ? handle->kvs->getKvsId() : 0;
+        std::lock_guard<std::mutex> lock(file->kvsLatStatsLock);
+        auto entry = file->kvsLatStats.find(kv_id);
+        if (entry == file->kvsLatStats.end()) {
+            // The handle may have moved to a file that the stats were not
+            // migrated to (e.g., rollback); carry over its own stats.
+            std::shared_ptr<kvs_latency_stats> stats = handle->lat_stats;
+            if (!stats) {
+                stats = std::make_shared<kvs_latency_stats>();
             }
+            entry = file->kvsLatStats.insert(std::make_pair(kv_id, stats)).first;
         }
-        break;
-    } while (--retry);
-    file->latStats[type].lat_sum.fetch_add(val, std::memory_order_relaxed);
-    file->latStats[type].lat_num++;
-#ifdef _PLATFORM_LIB_AVAILABLE
-    file->histStats[type].add(val / 1000);
-#endif
+        handle->lat_stats = entry->second;
+        handle->lat_stats_file = file;
+    }
+    return handle->lat_stats.get();
+}
+
+void LatencyStats::update(FdbKvsHandle *handle, fdb_latency_stat_type type,
+                          uint64_t val) {
+    handle->file->latStats[type].add(val);
+    _get_kvs_latency_stats(handle)->lat[type].add(val);
+}
+
+static uint32_t _lat_to_u32(uint64_t val) {
+    return val > UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>(val);
 }
 
 void LatencyStats::get(FileMgr *file, fdb_latency_stat_type type,
                        fdb_latency_stat *stat) {
-    uint64_t num = file->latStats[type].lat_num.load(std::memory_order_relaxed);
-    if (!num) {
+    LatencySnapshot snap;
+    file->latStats[type].getSnapshot(snap);
+    if (!snap.count) {
         memset(stat, 0, sizeof(fdb_latency_stat));
         return;
     }
-    stat->lat_max = file->latStats[type].lat_max.load(std::memory_order_relaxed);
-    stat->lat_min = file->latStats[type].lat_min.load(std::memory_order_relaxed);
-    stat->lat_count = num;
-    stat->lat_avg = file->latStats[type].lat_sum.load(std::memory_order_relaxed) / num;
+    stat->lat_max = _lat_to_u32(snap.max);
+    stat->lat_min = _lat_to_u32(snap.min);
+    stat->lat_count = snap.count;
+    stat->lat_avg = _lat_to_u32(snap.sum / snap.count);
+}
+
+static void _fill_latency_percentiles(const LatencySnapshot &snap,
+                                      fdb_latency_percentiles *stat) {
+    stat->lat_count = snap.count;
+    stat->lat_p50 = _lat_to_u32(snap.getPercentile(50.0));
+    stat->lat_p90 = _lat_to_u32(snap.getPercentile(90.0));
+    stat->lat_p99 = _lat_to_u32(snap.getPercentile(99.0));
+    stat->lat_p999 = _lat_to_u32(snap.getPercentile(99.9));
+    stat->lat_max = _lat_to_u32(snap.max);
+}
+
+void LatencyStats::getPercentiles(FileMgr *file, fdb_latency_stat_type type,
+                                  fdb_latency_percentiles *stat) {
+    LatencySnapshot snap;
+    file->latStats[type].getSnapshot(snap);
+    _fill_latency_percentiles(snap, stat);
+}
+
+void LatencyStats::getPercentiles(FdbKvsHandle *handle,
+                                  fdb_latency_stat_type type,
+                                  fdb_latency_percentiles *stat) {
+    LatencySnapshot snap;
+    _get_kvs_latency_stats(handle)->lat[type].getSnapshot(snap);
+    _fill_latency_percentiles(snap, stat);
 }
 
-#ifdef _PLATFORM_LIB_AVAILABLE
 void LatencyStats::getHistogram(FileMgr *file,
                                 fdb_latency_stat_type type,
                                 char **stat,
                                 size_t *stat_length) {
-
-    uint64_t num = file->latStats[type].lat_num.load(std::memory_order_relaxed);
-    if (!num) {
+    LatencySnapshot snap;
+    file->latStats[type].getSnapshot(snap);
+    if (!snap.count) {
         *stat = nullptr;
         *stat_length = 0;
         return;
     }
-    std::stringstream ss;
-    ss << "{";
-    for (auto it : file->histStats[type]) {
-        if (it->count()) {
-            ss << "(" << it->start() << "µs - " << it->end() << "µs) : ";
-            ss << it->count() << "; ";
-        } else {
-            break;
-        }
-    }
-    ss << "}";
-    char *buffer = (char*) malloc(ss.str().length());
-    memcpy(buffer, ss.str().c_str(), ss.str().length());
+    std::string str = snap.toString();
+    char *buffer = (char*) malloc(str.length() + 1);
+    memcpy(buffer, str.c_str(), str.length() + 1);
     *stat = buffer;
-    *stat_length = ss.str().length();
+    *stat_length = str.length();
 }
-#endif
 
 #ifdef _LATENCY_STATS_DUMP_TO_FILE
 static const int _MAX_STATSFILE_LEN = FDB_MAX_FILENAME_LEN + 4;
@@ -4097,47 +4651,46 @@ void LatencyStats::dump(FileMgr *file, ErrLogCallback *log_callback) {
         fdb_log(log_callback, status, msg, latency_file_path);
         return;
     }
-    fprintf(lat_file, "%15.15s  %15.4s %15.3s %15.3s %15.11s\n",
-            "latency(µs)    ", "tmin", "avg", "max", "num_samples");
+    fprintf(lat_file, "%15.15s  %10.4s %10.3s %10.3s %10.3s %10.3s %10.5s "
+            "%10.3s %12.11s\n", "latency(µs)    ", "tmin", "avg", "p50", "p90",
+            "p99", "p99.9", "max", "num_samples");
     for (int i = 0; i < FDB_LATENCY_NUM_STATS; ++i) {
-        uint64_t num = file->latStats[i].lat_num.load(std::memory_order_relaxed);
-        if (!num) {
+        LatencySnapshot snap;
+        file->latStats[i].getSnapshot(snap);
+        if (!snap.count) {
             continue;
         }
-        uint64_t avg = file->latStats[i].lat_sum.load(std::memory_order_relaxed) / num;
-        uint64_t min = file->latStats[i].lat_min.load(std::memory_order_relaxed);
-        uint64_t max = file->latStats[i].lat_max.load(std::memory_order_relaxed);
-        fprintf(lat_file, "%15.15s:%15.10s %15.10s %15.10s %15.10s\n",
-                FileMgr::getLatencyStatName(i),
-                std::to_string(min).c_str(),
-                std::to_string(avg).c_str(),
-                std::to_string(max).c_str(),
-                std::to_string(num).c_str());
-
+        fprintf(lat_file, "%15.15s:%10" _F64 " %10" _F64 " %10" _F64
+                " %10" _F64 " %10" _F64 " %10" _F64 " %10" _F64 " %12" _F64
+                "\n",
+                FileMgr::getLatencyStatName(i), snap.min,
+                snap.sum / snap.count, snap.getPercentile(50.0),
+                snap.getPercentile(90.0), snap.getPercentile(99.0),
+                snap.getPercentile(99.9), snap.max, snap.count);
     }
 
-#ifdef _PLATFORM_LIB_AVAILABLE
     fprintf(lat_file, "\n\nHistograms:\n\n");
     for (int i = 0; i < FDB_LATENCY_NUM_STATS; ++i) {
-        uint64_t count = file->latStats[i].lat_num.load(std::memory_order_relaxed);
-        if (count) {
-            fprintf(lat_file, "%s (Total: %" _F64 ")\n"
-                              "----------------------------------------\n",
-                    FileMgr::getLatencyStatName(i), count);
-            for (auto it : file->histStats[i]) {
-                if (it->count()) {
-                    std::stringstream ss;
-                    ss << it->start() << "µs - " << it->end() << "µs";
-                    fprintf(lat_file, "%20.20s:%" _F64 " (%.2f%%)\n",
-                            ss.str().c_str(),
-                            static_cast<uint64_t>(it->count()),
-                            (100.0 * it->count() / count));
-                }
+        LatencySnapshot snap;
+        file->latStats[i].getSnapshot(snap);
+        if (!snap.count) {
+            continue;
+        }
+        fprintf(lat_file, "%s (Total: %" _F64 ")\n"
+                          "----------------------------------------\n",
+                FileMgr::getLatencyStatName(i), snap.count);
+        for (size_t b = 0; b < LatencyHistogram::LAT_HIST_NUM_BUCKETS; ++b) {
+            if (snap.buckets[b]) {
+                std::stringstream ss;
+                ss << LatencyHistogram::getBucketStart(b) << "µs - "
+                   << LatencyHistogram::getBucketEnd(b) << "µs";
+                fprintf(lat_file, "%20.20s:%" _F64 " (%.2f%%)\n",
+                        ss.str().c_str(), snap.buckets[b],
+                        (100.0 * snap.buckets[b] / snap.count));
             }
-            fprintf(lat_file, "\n");
         }
+        fprintf(lat_file, "\n");
     }
-#endif
 
     fflush(lat_file);
     fclose(lat_file);
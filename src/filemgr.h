@@ -42,16 +42,19 @@
 #include "superblock.h"
 #include "staleblock.h"
 #include "taskable.h"
+#include "globaltask.h"
+#include "latency_histogram.h"
 
 #include <atomic>
+#include <condition_variable>
+#include <map>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
-#ifdef _PLATFORM_LIB_AVAILABLE
-#include <platform/histogram.h>
-#endif
 
 #define FILEMGR_SYNC 0x01
 #define FILEMGR_READONLY 0x02
@@ -70,10 +73,13 @@ public:
         : blocksize(FDB_BLOCKSIZE), ncacheblock(0),
           flushlimit(1048576), flag(0), chunksize(sizeof(uint64_t)),
           options(0x00), seqtree_opt(FDB_SEQTREE_NOT_USE), prefetch_duration(0),
+          warmup_budget(0),
+          compressed_cache_size(0),
           num_wal_shards(DEFAULT_NUM_WAL_PARTITIONS),
           num_bcache_shards(DEFAULT_NUM_BCACHE_PARTITIONS),
           block_reusing_threshold(65/*default*/),
-          num_keeping_headers(5/*default*/)
+          num_keeping_headers(5/*default*/),
+          create_crc_mode(CRC_DEFAULT)
     {
         encryption_key.algorithm = FDB_ENCRYPTION_NONE;
         memset(encryption_key.bytes, 0, sizeof(encryption_key.bytes));
@@ -95,10 +101,13 @@ public:
           options(_options),
           seqtree_opt(_seqtree_opt),
           prefetch_duration(_prefetch_duration),
+          warmup_budget(0),
+          compressed_cache_size(0),
           num_wal_shards(_num_wal_shards),
           num_bcache_shards(_num_bcache_shards),
           block_reusing_threshold(_block_reusing_threshold),
-          num_keeping_headers(_num_keeping_headers)
+          num_keeping_headers(_num_keeping_headers),
+          create_crc_mode(CRC_DEFAULT)
     {
         encryption_key.algorithm = _algorithm;
         memset(encryption_key.bytes,
@@ -115,6 +124,8 @@ public:
         chunksize = config.chunksize;
         options = config.options;
         prefetch_duration = config.prefetch_duration;
+        warmup_budget = config.warmup_budget;
+        compressed_cache_size = config.compressed_cache_size;
         num_wal_shards = config.num_wal_shards;
         num_bcache_shards = config.num_bcache_shards;
         encryption_key = config.encryption_key;
@@ -122,6 +133,7 @@ public:
                                       std::memory_order_relaxed);
         num_keeping_headers.store(config.num_keeping_headers.load(),
                                   std::memory_order_relaxed);
+        create_crc_mode = config.create_crc_mode;
     }
 
     void setBlockSize(int to) {
@@ -164,6 +176,14 @@ public:
         prefetch_duration = to;
     }
 
+    void setWarmupBudget(uint64_t to) {
+        warmup_budget = to;
+    }
+
+    void setCompressedCacheSize(uint64_t to) {
+        compressed_cache_size = to;
+    }
+
     void setNumWalShards(uint16_t to) {
         num_wal_shards = to;
     }
@@ -222,6 +242,14 @@ public:
         return prefetch_duration;
     }
 
+    uint64_t getWarmupBudget() const {
+        return warmup_budget;
+    }
+
+    uint64_t getCompressedCacheSize() const {
+        return compressed_cache_size;
+    }
+
     uint16_t getNumWalShards() const {
         return num_wal_shards;
     }
@@ -242,6 +270,14 @@ public:
         return num_keeping_headers.load(std::memory_order_relaxed);
     }
 
+    void setCreateCrcMode(crc_mode_e to) {
+        create_crc_mode = to;
+    }
+
+    crc_mode_e getCreateCrcMode() const {
+        return create_crc_mode;
+    }
+
 private:
     int blocksize;
     int ncacheblock;
@@ -251,6 +287,10 @@ private:
     uint8_t options;
     uint8_t seqtree_opt;
     uint64_t prefetch_duration;
+    // Cache memory in bytes warmed up from the saved list at open
+    uint64_t warmup_budget;
+    // Size of the compressed tier of the block cache in bytes
+    uint64_t compressed_cache_size;
     uint16_t num_wal_shards;
     uint16_t num_bcache_shards;
     fdb_encryption_key encryption_key;
@@ -259,11 +299,15 @@ private:
     // Number of the last commit headders whose stale blocks should
     // be kept for snapshot readers.
     std::atomic<uint64_t> num_keeping_headers;
+    // Checksum mode of newly created files. Existing files keep the mode
+    // they were written with (detected on open).
+    crc_mode_e create_crc_mode;
 };
 
 #ifndef _LATENCY_STATS
 #define LATENCY_STAT_START()
 #define LATENCY_STAT_END(file, type)
+#define LATENCY_STAT_END_KVS(handle, type)
 #else
 class LatencyStats;
 #define LATENCY_STAT_START() \
@@ -271,16 +315,22 @@ class LatencyStats;
 #define LATENCY_STAT_END(file, type) \
     uint64_t end = get_monotonic_ts();\
     LatencyStats::update(file, type, ts_diff(begin, end));
-
-struct latency_stat {
-    std::atomic<uint64_t> lat_min;
-    std::atomic<uint64_t> lat_max;
-    std::atomic<uint64_t> lat_sum;
-    std::atomic<uint64_t> lat_num;
-};
+// Same as LATENCY_STAT_END, but also accounts the latency to the KV store
+// of the given handle.
+#define LATENCY_STAT_END_KVS(handle, type) \
+    uint64_t end = get_monotonic_ts();\
+    LatencyStats::update(handle, type, ts_diff(begin, end));
 
 #endif // _LATENCY_STATS
 
+/**
+ * Latency histograms of a single KV store, shared by all of its handles
+ * and carried over to the new file on compaction.
+ */
+struct kvs_latency_stats {
+    LatencyHistogram lat[FDB_LATENCY_NUM_STATS];
+};
+
 struct async_io_handle {
 #ifdef _ASYNC_IO
 #if !defined(WIN32) && !defined(_WIN32)
@@ -291,9 +341,13 @@ struct async_io_handle {
 #endif
     uint8_t *aio_buf;
     uint64_t *offset_array;
+    // Indexes of the requests completed by the last aio_getevents() call
+    size_t *completed;
     size_t queue_depth;
     size_t block_size;
     fdb_fileops_handle fops_handle;
+    // Context of the async I/O backend other than libaio (e.g., io_uring)
+    void *aio_ctx;
 };
 
 typedef int filemgr_fs_type_t;
@@ -418,6 +472,9 @@ class Wal;
 class KvsHeader;
 class FileBlockCache;
 class FileBnodeCache;
+class CommitLog;
+class CommitLogConfig;
+class BloomFilter;
 
 typedef struct {
     mutex_t mutex;
@@ -507,6 +564,28 @@ private:
     FileMgr *file;
 };
 
+/**
+ * A WAL flush handed over to a background task. The flush is applied in
+ * batches, so that the writers appending into the WAL can grab the file
+ * mutex in between.
+ */
+class PendingWalFlush {
+public:
+    virtual ~PendingWalFlush() { }
+
+    /**
+     * Apply the next batch of the flush. Called with the file mutex held.
+     *
+     * @return True if the whole flush has been applied
+     */
+    virtual bool step() = 0;
+
+    /**
+     * Return the number of WAL items frozen into the flush.
+     */
+    virtual size_t getNumItems() = 0;
+};
+
 /**
  * A Context for managing I/O Tasks queued into the global shared thread pool
  */
@@ -753,6 +832,8 @@ public:
 
     uint64_t getBCacheVictims();
 
+    uint64_t getBCacheEvictions();
+
     uint64_t getBCacheImmutables();
 
     fdb_txn* getGlobalTxn() {
@@ -812,12 +893,56 @@ public:
         spin_unlock(&fMgrLock);
     }
 
+    /**
+     * Grab the file mutex. A pending background WAL flush is completed
+     * before returning, so that the caller sees the main index and the WAL
+     * in a consistent state.
+     */
     void mutexLock();
 
     bool mutexTrylock();
 
+    /**
+     * Grab the file mutex on behalf of a writer appending into the WAL.
+     * Unlike mutexLock(), a pending background WAL flush is left as it is.
+     */
+    void mutexLockForAppend();
+
     void mutexUnlock();
 
+    /**
+     * Hand over a WAL flush to the background. Should be called with the
+     * file mutex held and no flush pending.
+     */
+    void setPendingWalFlush(PendingWalFlush *flush) {
+        pendingWalFlush = flush;
+    }
+
+    PendingWalFlush* getPendingWalFlush() {
+        return pendingWalFlush;
+    }
+
+    /**
+     * Apply the next batch of the pending WAL flush, if any. Should be called
+     * with the file mutex held.
+     *
+     * @return True if a part of the flush remains to be applied
+     */
+    bool stepPendingWalFlush();
+
+    /**
+     * Apply the rest of the pending WAL flush, if any. Should be called with
+     * the file mutex held.
+     */
+    void completePendingWalFlush();
+
+    /**
+     * Schedule a task of this file on the global executor pool. The file is
+     * registered with the pool on its first task, and unregistered when its
+     * last reference is closed.
+     */
+    void scheduleTask(ExTask &task);
+
     void setCrcMode(crc_mode_e to) {
         crcMode = to;
     }
@@ -830,6 +955,14 @@ public:
         return &fMgrEncryption;
     }
 
+    /**
+     * Return the ID of this file in the secondary cache, or 0 if its blocks
+     * should not be cached there, i.e., if the file is encrypted.
+     */
+    uint64_t getSecondaryCacheId() {
+        return fMgrEncryption.ops ? 0 : secondaryCacheId;
+    }
+
     void setStaleData(StaleDataManagerBase *to) {
         staleData = to;
     }
@@ -852,6 +985,9 @@ public:
     /* Returns true if the block invalidated is from recent uncommited blocks */
     bool invalidateBlock(bid_t bid);
 
+    /* Drops the copies of a block kept in the secondary cache */
+    void invalidateSecondaryCache(bid_t bid);
+
     bool isFullyResident();
 
     /* Returns number of immutable blocks that remain in file */
@@ -861,6 +997,13 @@ public:
                             ErrLogCallback *log_callback,
                             bool read_on_cache_miss);
 
+    /* Pins a clean block in the block cache and returns its address, or NULL
+       if the block is not cached. The block should be unpinned by
+       unpinBlock() before the file is closed. */
+    void *pinBlock(bid_t bid, void **pin_handle);
+
+    static void unpinBlock(void *pin_handle);
+
     fdb_status writeOffset(bid_t bid, uint64_t offset,
                            uint64_t len, void *buf, bool final_write,
                            ErrLogCallback *log_callback);
@@ -905,6 +1048,21 @@ public:
 
     fdb_status sync_FileMgr(bool sync_option, ErrLogCallback *log_callback);
 
+    /**
+     * Make the DB header with a given revision number durable, sharing a
+     * single fsync() among all the committers of this file (group commit).
+     * Only one fsync() is in flight at a time; commits whose headers are
+     * written while it is in progress are covered together by the next one.
+     * This function should be called without holding the file mutex, after
+     * the header has been written by commitBid() with 'sync' disabled.
+     *
+     * @param revnum Revision number of the DB header to be made durable.
+     * @param log_callback Pointer to log callback function.
+     * @return FDB_RESULT_SUCCESS once the header is durable.
+     */
+    fdb_status syncGroupCommit(filemgr_header_revnum_t revnum,
+                               ErrLogCallback *log_callback);
+
     /**
      * Updates the file status and oldFileName of the FileMgr instance,
      * with the arguments provided.
@@ -1273,19 +1431,76 @@ public:
         return bcacheMisses.load();
     }
 
+    /**
+     * Create the commit log of this file if it does not exist yet.
+     * Should be called while holding the file mutex.
+     *
+     * @param file_size_limit Size of each commit log file.
+     * @return True if the commit log was newly created by this call.
+     */
+    bool initCommitLog(uint64_t file_size_limit);
+
+    CommitLog* getCommitLog() {
+        return commitLog;
+    }
+
+    void addCommitLogBytes(uint64_t bytes) {
+        commitLogBytes.fetch_add(bytes);
+    }
+
+    uint64_t getCommitLogBytes() {
+        return commitLogBytes.load();
+    }
+
+    void resetCommitLogBytes() {
+        commitLogBytes.store(0);
+    }
+
+    /**
+     * Decide whether this caller initializes the Bloom filter of this file.
+     * Only the first caller gets true, so that the filter is loaded (or
+     * created) at most once during the lifetime of this instance.
+     */
+    bool claimBloomFilterInit() {
+        bool expected = false;
+        return bloomFilterInit.compare_exchange_strong(expected, true);
+    }
+
+    void setBloomFilter(BloomFilter *filter) {
+        bloomFilter.store(filter);
+    }
+
+    BloomFilter* getBloomFilter() {
+        return bloomFilter.load(std::memory_order_relaxed);
+    }
+
     // variables related to prefetching
     std::atomic<uint8_t> prefetchStatus;
     thread_t prefetchTid;
 
+    // variables related to the cache warm-up
+    std::atomic<uint8_t> warmupStatus;
+    thread_t warmupTid;
+
+    // ID of this file in the secondary cache
+    uint64_t secondaryCacheId;
+
 #ifdef _LATENCY_STATS
-    struct latency_stat latStats[FDB_LATENCY_NUM_STATS];
-#ifdef _PLATFORM_LIB_AVAILABLE
-    Histogram<hrtime_t> histStats[FDB_LATENCY_NUM_STATS];
-#endif // _PLATFORM_LIB_AVAILABLE
+    LatencyHistogram latStats[FDB_LATENCY_NUM_STATS];
+    // Per KV store latency histograms, indexed by KV store ID
+    std::map<fdb_kvs_id_t, std::shared_ptr<kvs_latency_stats> > kvsLatStats;
+    std::mutex kvsLatStatsLock;
 #endif //_LATENCY_STATS
 
 private:
 
+    /**
+     * fsync() the file, recording its latency
+     *
+     * @return FDB_RESULT_SUCCESS on success, or a negative error code
+     */
+    int fsyncFile();
+
     /**
      * Remove a given dirty node from the dirty block tree
      */
@@ -1327,6 +1542,53 @@ private:
      */
     void prefetch(ErrLogCallback *log_callback);
 
+    /**
+     * Spawn a thread to read the blocks (or bnodes) in the warm-up list saved
+     * at the last close back into the cache
+     */
+    void warmUp(ErrLogCallback *log_callback);
+
+    /**
+     * Body of the warm-up thread
+     */
+    static void *warmUpThread(void *voidargs);
+
+    /**
+     * Read the blocks with the given IDs into the block cache
+     */
+    void warmUpBlocks(std::vector<uint64_t> &entries,
+                      ErrLogCallback *log_callback);
+
+    /**
+     * Read the bnodes at the given offsets into the bnode cache
+     */
+    void warmUpBnodes(std::vector<uint64_t> &entries);
+
+    /**
+     * Abort the warm-up thread if running, and wait for it to be done
+     */
+    void stopWarmUp();
+
+    /**
+     * Save the list of the hottest cached blocks (or bnodes) of the file,
+     * to be warmed up when the file is opened again
+     */
+    void saveWarmupList(ErrLogCallback *log_callback);
+
+    /**
+     * Load the warm-up list saved for the current state of the file
+     *
+     * @param entries Vector where the block IDs (or bnode offsets) are loaded
+     * @return true if a valid list is loaded
+     */
+    bool loadWarmupList(std::vector<uint64_t> &entries,
+                        ErrLogCallback *log_callback);
+
+    /**
+     * Remove the warm-up list saved for a given file, if any
+     */
+    static void removeWarmupList(const std::string &filename);
+
     /**
      * CRC32 check for a given buffer
      *
@@ -1372,6 +1634,9 @@ private:
     std::atomic<uint8_t> ioInprog;
     Wal *fMgrWal;
     FdbTaskable exPoolCtx; // executor pool context
+    std::atomic<bool> taskableRegistered; // exPoolCtx registered with the pool
+    std::mutex taskableLock; // serializes the registration of exPoolCtx
+    PendingWalFlush *pendingWalFlush; // WAL flush applied in the background
     FileMgrHeader fMgrHeader;
     struct filemgr_ops *fMgrOps;
     std::atomic<uint8_t> fMgrStatus;
@@ -1410,6 +1675,13 @@ private:
     // mutex for synchronization among multiple writers
     mutex_lock_t writerLock;
 
+    // Group commit: lock and condition variable for committers waiting
+    // for an in-flight fsync, and the latest header revnum made durable
+    std::mutex groupCommitLock;
+    std::condition_variable groupCommitCond;
+    bool groupSyncInProgress;
+    filemgr_header_revnum_t groupSyncedRevnum;
+
     // CRC the file is using
     crc_mode_e crcMode;
 
@@ -1460,6 +1732,16 @@ private:
     std::atomic<size_t> bcacheHits;
     // Block cache miss count for read ops
     std::atomic<size_t> bcacheMisses;
+
+    // Commit log used by FDB_DRB_COMMIT_LOG durability mode
+    CommitLog *commitLog;
+    CommitLogConfig *commitLogConfig;
+    // Bytes appended to the commit log since the last DB header commit
+    std::atomic<uint64_t> commitLogBytes;
+
+    // Bloom filter over the keys in the main index, NULL if not maintained
+    std::atomic<BloomFilter *> bloomFilter;
+    std::atomic<bool> bloomFilterInit;
 };
 
 /**
@@ -1490,20 +1772,6 @@ fdb_status convert_errno_to_fdb_status(int errno_value,
 #ifdef _LATENCY_STATS
 class LatencyStats {
 public:
-    /**
-     * Initialize a latency stats instance
-     *
-     * @param val Pointer to a latency stats instance to be initialized
-     */
-    static void init(struct latency_stat *val);
-
-    /**
-     * Destroy a latency stats instance
-     *
-     * @param val Pointer to a latency stats instance to be destroyed
-     */
-    static void destroy(struct latency_stat *val);
-
     /**
      * Migrate the latency stats from the source file to the destination file
      *
@@ -1523,6 +1791,17 @@ public:
     static void update(FileMgr *file, fdb_latency_stat_type type,
                        uint64_t val);
 
+    /**
+     * Update the latency stats for the file and the KV store of a given
+     * handle
+     *
+     * @param handle Pointer to the KV store handle
+     * @param type Type of a latency stat to be updated
+     * @param val New value of a latency stat
+     */
+    static void update(FdbKvsHandle *handle, fdb_latency_stat_type type,
+                       uint64_t val);
+
     /**
      * Get the latency stats from a given file manager
      *
@@ -1533,7 +1812,27 @@ public:
     static void get(FileMgr *file, fdb_latency_stat_type type,
                     fdb_latency_stat *stat);
 
-#ifdef _PLATFORM_LIB_AVAILABLE
+    /**
+     * Get the latency percentiles from a given file manager
+     *
+     * @param file Pointer to the file manager
+     * @param type Type of a latency stat to be retrieved
+     * @param stat Pointer to the percentiles instance to be populated
+     */
+    static void getPercentiles(FileMgr *file, fdb_latency_stat_type type,
+                               fdb_latency_percentiles *stat);
+
+    /**
+     * Get the latency percentiles of the KV store of a given handle
+     *
+     * @param handle Pointer to the KV store handle
+     * @param type Type of a latency stat to be retrieved
+     * @param stat Pointer to the percentiles instance to be populated
+     */
+    static void getPercentiles(FdbKvsHandle *handle,
+                               fdb_latency_stat_type type,
+                               fdb_latency_percentiles *stat);
+
     /**
      * Get the histogram of latencies from a given file manager
      *
@@ -1545,7 +1844,6 @@ public:
      */
     static void getHistogram(FileMgr *file, fdb_latency_stat_type type,
                              char **stat, size_t *stat_length);
-#endif // _PLATFORM_LIB_AVAILABLE
 
 #ifdef _LATENCY_STATS_DUMP_TO_FILE
     /**
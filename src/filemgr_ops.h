@@ -26,6 +26,13 @@ extern "C" {
 
 struct filemgr_ops * get_filemgr_ops();
 
+/**
+ * Select the I/O backend of the file operations returned by get_filemgr_ops().
+ * The default backend is used instead if the given one is not supported by
+ * the host OS, in which case FDB_RESULT_INVALID_CONFIG is returned.
+ */
+fdb_status select_filemgr_io_backend(fdb_io_backend_t backend);
+
 static inline int handle_to_fd(fdb_fileops_handle handle) {
     return (int)(intptr_t)handle;
 }
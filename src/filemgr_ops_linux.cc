@@ -23,6 +23,11 @@
 #include <errno.h>
 #include <string.h>
 #include <sys/mman.h>
+#ifdef _IO_URING
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+#endif
 
 #include "filemgr.h"
 #include "filemgr_ops.h"
@@ -215,6 +220,9 @@ int _filemgr_aio_init(fdb_fileops_handle fileops_handle,
     aio_handle->aio_buf = (uint8_t *) buf;
     aio_handle->offset_array = (uint64_t*)
         malloc(sizeof(uint64_t) * aio_handle->queue_depth);
+    aio_handle->completed = (size_t*)
+        malloc(sizeof(size_t) * aio_handle->queue_depth);
+    aio_handle->aio_ctx = NULL;
 
     aio_handle->ioq = (struct iocb**)
         malloc(sizeof(struct iocb*) * aio_handle->queue_depth);
@@ -299,6 +307,10 @@ int _filemgr_aio_getevents(fdb_fileops_handle fops_handle,
     if (num_events < 0) {
         return FDB_RESULT_AIO_GETEVENTS_FAIL;
     }
+    for (int i = 0; i < num_events; ++i) {
+        aio_handle->completed[i] = (uint64_t *) aio_handle->events[i].data -
+                                   aio_handle->offset_array;
+    }
     return num_events;
 #else
     return FDB_RESULT_AIO_NOT_SUPPORTED;
@@ -322,12 +334,332 @@ int _filemgr_aio_destroy(fdb_fileops_handle fops_handle,
     free(aio_handle->events);
     free_align(aio_handle->aio_buf);
     free(aio_handle->offset_array);
+    free(aio_handle->completed);
     return FDB_RESULT_SUCCESS;
 #else
     return FDB_RESULT_AIO_NOT_SUPPORTED;
 #endif
 }
 
+#ifdef _IO_URING
+/**
+ * Async I/O through io_uring, using raw system calls.
+ *
+ * Each async I/O handle owns a ring whose submission queue entries map
+ * one-to-one to the slots of the handle's read buffer. The file descriptor
+ * and the read buffer are registered to the ring, so that the kernel does
+ * not need to look up the file and map the buffer pages for every read.
+ * All the reads prepared by aio_prep_read() are submitted by a single
+ * io_uring_enter() call.
+ */
+struct io_uring_aio_ctx {
+    int ring_fd;
+    bool fixed_file;
+    bool fixed_buf;
+    // submission queue
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    struct io_uring_sqe *sqes;
+    // completion queue
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+    // mapped ring memory
+    void *sq_ptr;
+    size_t sq_len;
+    void *cq_ptr;
+    size_t cq_len;
+    size_t sqes_len;
+    // used if the read buffer cannot be registered
+    struct iovec *iovecs;
+};
+
+static int _io_uring_setup(unsigned entries, struct io_uring_params *p)
+{
+    return (int) syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int _io_uring_enter(int ring_fd, unsigned to_submit,
+                           unsigned min_complete, unsigned flags)
+{
+    int rv;
+    do {
+        rv = (int) syscall(__NR_io_uring_enter, ring_fd, to_submit,
+                           min_complete, flags, NULL, 0);
+    } while (rv == -1 && errno == EINTR);
+    return rv;
+}
+
+static int _io_uring_register(int ring_fd, unsigned opcode, void *arg,
+                              unsigned nr_args)
+{
+    return (int) syscall(__NR_io_uring_register, ring_fd, opcode, arg,
+                         nr_args);
+}
+
+static void _io_uring_ctx_free(struct io_uring_aio_ctx *ctx)
+{
+    if (ctx->sqes) {
+        munmap(ctx->sqes, ctx->sqes_len);
+    }
+    if (ctx->cq_ptr && ctx->cq_ptr != ctx->sq_ptr) {
+        munmap(ctx->cq_ptr, ctx->cq_len);
+    }
+    if (ctx->sq_ptr) {
+        munmap(ctx->sq_ptr, ctx->sq_len);
+    }
+    if (ctx->ring_fd >= 0) {
+        close(ctx->ring_fd);
+    }
+    free(ctx->iovecs);
+    free(ctx);
+}
+
+static struct io_uring_aio_ctx *_io_uring_ctx_create(unsigned entries)
+{
+    struct io_uring_params p;
+    struct io_uring_aio_ctx *ctx = (struct io_uring_aio_ctx *)
+        calloc(1, sizeof(struct io_uring_aio_ctx));
+
+    memset(&p, 0, sizeof(p));
+    ctx->ring_fd = _io_uring_setup(entries, &p);
+    if (ctx->ring_fd < 0) {
+        free(ctx);
+        return NULL;
+    }
+
+    ctx->sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    ctx->cq_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ctx->cq_len > ctx->sq_len) {
+            ctx->sq_len = ctx->cq_len;
+        }
+        ctx->cq_len = ctx->sq_len;
+    }
+
+    ctx->sq_ptr = mmap(0, ctx->sq_len, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, ctx->ring_fd,
+                       IORING_OFF_SQ_RING);
+    if (ctx->sq_ptr == MAP_FAILED) {
+        ctx->sq_ptr = NULL;
+        _io_uring_ctx_free(ctx);
+        return NULL;
+    }
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        ctx->cq_ptr = ctx->sq_ptr;
+    } else {
+        ctx->cq_ptr = mmap(0, ctx->cq_len, PROT_READ | PROT_WRITE,
+                           MAP_SHARED | MAP_POPULATE, ctx->ring_fd,
+                           IORING_OFF_CQ_RING);
+        if (ctx->cq_ptr == MAP_FAILED) {
+            ctx->cq_ptr = NULL;
+            _io_uring_ctx_free(ctx);
+            return NULL;
+        }
+    }
+    ctx->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+    ctx->sqes = (struct io_uring_sqe *)
+        mmap(0, ctx->sqes_len, PROT_READ | PROT_WRITE,
+             MAP_SHARED | MAP_POPULATE, ctx->ring_fd, IORING_OFF_SQES);
+    if (ctx->sqes == MAP_FAILED) {
+        ctx->sqes = NULL;
+        _io_uring_ctx_free(ctx);
+        return NULL;
+    }
+
+    uint8_t *sq = (uint8_t *) ctx->sq_ptr;
+    uint8_t *cq = (uint8_t *) ctx->cq_ptr;
+    ctx->sq_head = (unsigned *) (sq + p.sq_off.head);
+    ctx->sq_tail = (unsigned *) (sq + p.sq_off.tail);
+    ctx->sq_mask = (unsigned *) (sq + p.sq_off.ring_mask);
+    ctx->sq_array = (unsigned *) (sq + p.sq_off.array);
+    ctx->cq_head = (unsigned *) (cq + p.cq_off.head);
+    ctx->cq_tail = (unsigned *) (cq + p.cq_off.tail);
+    ctx->cq_mask = (unsigned *) (cq + p.cq_off.ring_mask);
+    ctx->cqes = (struct io_uring_cqe *) (cq + p.cq_off.cqes);
+    return ctx;
+}
+
+int _filemgr_io_uring_init(fdb_fileops_handle fileops_handle,
+                           struct async_io_handle *aio_handle)
+{
+    if (!aio_handle) {
+        return FDB_RESULT_INVALID_ARGS;
+    }
+    if (!aio_handle->queue_depth || aio_handle->queue_depth > 512) {
+        aio_handle->queue_depth =  ASYNC_IO_QUEUE_DEPTH;
+    }
+    if (!aio_handle->block_size) {
+        aio_handle->block_size = FDB_BLOCKSIZE;
+    }
+
+    struct io_uring_aio_ctx *ctx = _io_uring_ctx_create(
+                                        aio_handle->queue_depth);
+    if (!ctx) {
+        return FDB_RESULT_AIO_INIT_FAIL;
+    }
+
+    void *buf;
+    size_t buf_size = aio_handle->block_size * aio_handle->queue_depth;
+    malloc_align(buf, FDB_SECTOR_SIZE, buf_size);
+    aio_handle->aio_buf = (uint8_t *) buf;
+    aio_handle->offset_array = (uint64_t*)
+        malloc(sizeof(uint64_t) * aio_handle->queue_depth);
+    aio_handle->completed = (size_t*)
+        malloc(sizeof(size_t) * aio_handle->queue_depth);
+
+    // Registration can fail (e.g., due to RLIMIT_MEMLOCK), in which case
+    // the file descriptor and the buffer are passed with each request.
+    int fd = handle_to_fd(aio_handle->fops_handle);
+    ctx->fixed_file = _io_uring_register(ctx->ring_fd, IORING_REGISTER_FILES,
+                                         &fd, 1) == 0;
+    struct iovec iov;
+    iov.iov_base = buf;
+    iov.iov_len = buf_size;
+    ctx->fixed_buf = _io_uring_register(ctx->ring_fd, IORING_REGISTER_BUFFERS,
+                                        &iov, 1) == 0;
+    if (!ctx->fixed_buf) {
+        ctx->iovecs = (struct iovec *)
+            calloc(aio_handle->queue_depth, sizeof(struct iovec));
+    }
+    aio_handle->aio_ctx = ctx;
+    return FDB_RESULT_SUCCESS;
+}
+
+int _filemgr_io_uring_prep_read(fdb_fileops_handle fops_handle,
+                                struct async_io_handle *aio_handle,
+                                size_t aio_idx, size_t read_size,
+                                uint64_t offset)
+{
+    if (!aio_handle || !aio_handle->aio_ctx) {
+        return FDB_RESULT_INVALID_ARGS;
+    }
+    struct io_uring_aio_ctx *ctx = (struct io_uring_aio_ctx *)
+                                   aio_handle->aio_ctx;
+    struct io_uring_sqe *sqe = &ctx->sqes[aio_idx];
+    uint8_t *buf = aio_handle->aio_buf + (aio_idx * aio_handle->block_size);
+
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    if (ctx->fixed_file) {
+        sqe->fd = 0;
+        sqe->flags = IOSQE_FIXED_FILE;
+    } else {
+        sqe->fd = handle_to_fd(aio_handle->fops_handle);
+    }
+    if (ctx->fixed_buf) {
+        sqe->opcode = IORING_OP_READ_FIXED;
+        sqe->addr = (uint64_t) (uintptr_t) buf;
+        sqe->len = aio_handle->block_size;
+        sqe->buf_index = 0;
+    } else {
+        ctx->iovecs[aio_idx].iov_base = buf;
+        ctx->iovecs[aio_idx].iov_len = aio_handle->block_size;
+        sqe->opcode = IORING_OP_READV;
+        sqe->addr = (uint64_t) (uintptr_t) &ctx->iovecs[aio_idx];
+        sqe->len = 1;
+    }
+    sqe->off = (offset / aio_handle->block_size) * aio_handle->block_size;
+    sqe->user_data = aio_idx;
+    // Record the original offset.
+    aio_handle->offset_array[aio_idx] = offset;
+    return FDB_RESULT_SUCCESS;
+}
+
+int _filemgr_io_uring_submit(fdb_fileops_handle fops_handle,
+                             struct async_io_handle *aio_handle, int num_subs)
+{
+    if (!aio_handle || !aio_handle->aio_ctx) {
+        return FDB_RESULT_INVALID_ARGS;
+    }
+    struct io_uring_aio_ctx *ctx = (struct io_uring_aio_ctx *)
+                                   aio_handle->aio_ctx;
+    unsigned tail = *ctx->sq_tail;
+    unsigned mask = *ctx->sq_mask;
+    for (int i = 0; i < num_subs; ++i) {
+        ctx->sq_array[(tail + i) & mask] = i;
+    }
+    __atomic_store_n(ctx->sq_tail, tail + num_subs, __ATOMIC_RELEASE);
+
+    int rc = _io_uring_enter(ctx->ring_fd, num_subs, 0, 0);
+    if (rc < 0) {
+        return FDB_RESULT_AIO_SUBMIT_FAIL;
+    }
+    return rc; // 'rc' should be equal to 'num_subs' upon succcess.
+}
+
+int _filemgr_io_uring_getevents(fdb_fileops_handle fops_handle,
+                                struct async_io_handle *aio_handle, int min,
+                                int max, unsigned int timeout)
+{
+    if (!aio_handle || !aio_handle->aio_ctx) {
+        return FDB_RESULT_INVALID_ARGS;
+    }
+    struct io_uring_aio_ctx *ctx = (struct io_uring_aio_ctx *)
+                                   aio_handle->aio_ctx;
+    unsigned mask = *ctx->cq_mask;
+    int num_events = 0;
+    int err = 0;
+
+    while (true) {
+        unsigned head = *ctx->cq_head;
+        unsigned tail = __atomic_load_n(ctx->cq_tail, __ATOMIC_ACQUIRE);
+        while (head != tail && num_events < max) {
+            struct io_uring_cqe *cqe = &ctx->cqes[head & mask];
+            if (cqe->res < 0) {
+                err = -cqe->res;
+            } else {
+                aio_handle->completed[num_events++] = cqe->user_data;
+            }
+            ++head;
+        }
+        __atomic_store_n(ctx->cq_head, head, __ATOMIC_RELEASE);
+
+        if (err) {
+            errno = err;
+            return FDB_RESULT_AIO_GETEVENTS_FAIL;
+        }
+        // Unlike libaio, a finite timeout only polls the completion queue
+        // without waiting.
+        if (num_events >= min || timeout != (unsigned int) -1) {
+            break;
+        }
+        if (_io_uring_enter(ctx->ring_fd, 0, min - num_events,
+                            IORING_ENTER_GETEVENTS) < 0) {
+            return FDB_RESULT_AIO_GETEVENTS_FAIL;
+        }
+    }
+    return num_events;
+}
+
+int _filemgr_io_uring_destroy(fdb_fileops_handle fops_handle,
+                              struct async_io_handle *aio_handle)
+{
+    if (!aio_handle || !aio_handle->aio_ctx) {
+        return FDB_RESULT_INVALID_ARGS;
+    }
+    _io_uring_ctx_free((struct io_uring_aio_ctx *) aio_handle->aio_ctx);
+    aio_handle->aio_ctx = NULL;
+    free_align(aio_handle->aio_buf);
+    free(aio_handle->offset_array);
+    free(aio_handle->completed);
+    return FDB_RESULT_SUCCESS;
+}
+
+// Check if io_uring is supported by the running kernel.
+static bool _io_uring_supported()
+{
+    struct io_uring_aio_ctx *ctx = _io_uring_ctx_create(1);
+    if (!ctx) {
+        return false;
+    }
+    _io_uring_ctx_free(ctx);
+    return true;
+}
+#endif // _IO_URING
+
 #if defined(__APPLE__) || defined(__FreeBSD__)
 #include <sys/mount.h>
 #elif !defined(__sun)
@@ -517,9 +849,54 @@ struct filemgr_ops linux_ops = {
     NULL
 };
 
+#ifdef _IO_URING
+struct filemgr_ops linux_io_uring_ops = {
+    _filemgr_linux_constructor,
+    _filemgr_linux_open,
+    _filemgr_linux_pwrite,
+    _filemgr_linux_pread,
+    _filemgr_linux_close,
+    _filemgr_linux_goto_eof,
+    _filemgr_linux_file_size,
+    _filemgr_linux_fdatasync,
+    _filemgr_linux_fsync,
+    _filemgr_linux_get_errno_str,
+    _filemgr_linux_mmap,
+    _filemgr_linux_munmap,
+    // Async I/O operations
+    _filemgr_io_uring_init,
+    _filemgr_io_uring_prep_read,
+    _filemgr_io_uring_submit,
+    _filemgr_io_uring_getevents,
+    _filemgr_io_uring_destroy,
+    _filemgr_linux_get_fs_type,
+    _filemgr_linux_copy_file_range,
+    _filemgr_linux_destructor,
+    NULL
+};
+#endif
+
+static struct filemgr_ops *linux_selected_ops = &linux_ops;
+
+fdb_status select_filemgr_io_backend(fdb_io_backend_t backend)
+{
+    if (backend == FDB_IO_BACKEND_IO_URING) {
+#ifdef _IO_URING
+        if (_io_uring_supported()) {
+            linux_selected_ops = &linux_io_uring_ops;
+            return FDB_RESULT_SUCCESS;
+        }
+#endif
+        linux_selected_ops = &linux_ops;
+        return FDB_RESULT_INVALID_CONFIG;
+    }
+    linux_selected_ops = &linux_ops;
+    return FDB_RESULT_SUCCESS;
+}
+
 struct filemgr_ops * get_linux_filemgr_ops()
 {
-    return &linux_ops;
+    return linux_selected_ops;
 }
 
 #endif
@@ -332,6 +332,12 @@ struct filemgr_ops win_ops = {
     NULL
 };
 
+fdb_status select_filemgr_io_backend(fdb_io_backend_t backend)
+{
+    return backend == FDB_IO_BACKEND_DEFAULT ? FDB_RESULT_SUCCESS
+                                             : FDB_RESULT_INVALID_CONFIG;
+}
+
 struct filemgr_ops * get_win_filemgr_ops()
 {
     return &win_ops;
@@ -20,6 +20,9 @@
 #include <string.h>
 #include <fcntl.h>
 #include <time.h>
+#include <algorithm>
+#include <string>
+#include <vector>
 #if !defined(WIN32) && !defined(_WIN32)
 #include <sys/time.h>
 #endif
@@ -39,6 +42,7 @@
 #include "docio.h"
 #include "executorpool.h"
 #include "btreeblock.h"
+#include "blockcache.h"
 #include "bnodemgr.h"
 #include "common.h"
 #include "wal.h"
@@ -48,12 +52,18 @@
 #include "bgflusher.h"
 #include "compaction.h"
 #include "compactor.h"
+#include "rate_limiter.h"
+#include "secondary_cache.h"
 #include "memleak.h"
 #include "time_utils.h"
 #include "timing.h"
 #include "system_resource_stats.h"
 #include "version.h"
 #include "staleblock.h"
+#include "write_batch.h"
+#include "commit_log.h"
+#include "bloom_filter.h"
+#include "wal_flusher.h"
 
 #ifdef __DEBUG
 #ifndef __DEBUG_FDB
@@ -284,6 +294,27 @@ void fdb_fetch_header(uint64_t version,
     }
 }
 
+uint64_t fdb_fetch_header_bloom_filter_offset(uint64_t version,
+                                             void *header_buf)
+{
+    size_t offset = ver_get_new_filename_off(version);
+    uint16_t new_filename_len;
+    uint16_t old_filename_len;
+    uint64_t bloom_filter_offset;
+
+    seq_memcpy(&new_filename_len, (uint8_t *)header_buf + offset,
+               sizeof(new_filename_len), offset);
+    new_filename_len = _endian_decode(new_filename_len);
+    seq_memcpy(&old_filename_len, (uint8_t *)header_buf + offset,
+               sizeof(old_filename_len), offset);
+    old_filename_len = _endian_decode(old_filename_len);
+    offset += new_filename_len + old_filename_len;
+
+    memcpy(&bloom_filter_offset, (uint8_t *)header_buf + offset,
+           sizeof(bloom_filter_offset));
+    return _endian_decode(bloom_filter_offset);
+}
+
 void fdb_dummy_log_callback(int err_code, const char *err_msg, void *ctx_data)
 {
     (void)err_code;
@@ -1393,6 +1424,40 @@ fdb_status fdb_get_metaonly(FdbKvsHandle *handle, fdb_doc *doc)
     return FDB_RESULT_ENGINE_NOT_INSTANTIATED;
 }
 
+// search document using key without copying it
+LIBFDB_API
+fdb_status fdb_get_pinned(FdbKvsHandle *handle, const void *key,
+                          size_t keylen, fdb_pinned_doc *pinned_doc)
+{
+    FdbEngine *fdb_engine = FdbEngine::getInstance();
+    if (fdb_engine) {
+        return fdb_engine->getPinned(handle, key, keylen, pinned_doc);
+    }
+    return FDB_RESULT_ENGINE_NOT_INSTANTIATED;
+}
+
+LIBFDB_API
+fdb_status fdb_pinned_release(fdb_pinned_doc *pinned_doc)
+{
+    FdbEngine *fdb_engine = FdbEngine::getInstance();
+    if (fdb_engine) {
+        return fdb_engine->releasePinned(pinned_doc);
+    }
+    return FDB_RESULT_ENGINE_NOT_INSTANTIATED;
+}
+
+// search multiple documents using their keys
+LIBFDB_API
+fdb_status fdb_get_multi(FdbKvsHandle *handle, fdb_doc **docs,
+                         size_t num_docs, fdb_status *results)
+{
+    FdbEngine *fdb_engine = FdbEngine::getInstance();
+    if (fdb_engine) {
+        return fdb_engine->getMulti(handle, docs, num_docs, results);
+    }
+    return FDB_RESULT_ENGINE_NOT_INSTANTIATED;
+}
+
 // search document using sequence number
 LIBFDB_API
 fdb_status fdb_get_byseq(FdbKvsHandle *handle, fdb_doc *doc)
@@ -1457,6 +1522,54 @@ fdb_status fdb_get_byoffset(FdbKvsHandle *handle, fdb_doc *doc)
     return FDB_RESULT_ENGINE_NOT_INSTANTIATED;
 }
 
+LIBFDB_API
+fdb_status fdb_write_batch_create(fdb_write_batch **ptr_batch)
+{
+    if (!ptr_batch) {
+        return FDB_RESULT_INVALID_ARGS;
+    }
+    *ptr_batch = new FdbWriteBatch();
+    return FDB_RESULT_SUCCESS;
+}
+
+LIBFDB_API
+fdb_status fdb_write_batch_set(fdb_write_batch *batch, fdb_doc *doc)
+{
+    if (!batch) {
+        return FDB_RESULT_INVALID_ARGS;
+    }
+    return batch->addSet(doc);
+}
+
+LIBFDB_API
+fdb_status fdb_write_batch_del(fdb_write_batch *batch, fdb_doc *doc)
+{
+    if (!batch) {
+        return FDB_RESULT_INVALID_ARGS;
+    }
+    return batch->addDel(doc);
+}
+
+LIBFDB_API
+fdb_status fdb_write_batch_apply(FdbKvsHandle *handle, fdb_write_batch *batch)
+{
+    FdbEngine *fdb_engine = FdbEngine::getInstance();
+    if (fdb_engine) {
+        return fdb_engine->applyWriteBatch(handle, batch);
+    }
+    return FDB_RESULT_ENGINE_NOT_INSTANTIATED;
+}
+
+LIBFDB_API
+fdb_status fdb_write_batch_free(fdb_write_batch *batch)
+{
+    if (!batch) {
+        return FDB_RESULT_INVALID_ARGS;
+    }
+    delete batch;
+    return FDB_RESULT_SUCCESS;
+}
+
 INLINE uint64_t _fdb_get_wal_threshold(FdbKvsHandle *handle)
 {
     return handle->config.wal_threshold;
@@ -1497,6 +1610,11 @@ static uint64_t _fdb_export_header_flags(FdbKvsHandle *handle)
         // the default KVS is based on custom key order
         rv |= FDB_FLAG_ROOT_CUSTOM_CMP;
     }
+    BloomFilter *bloom_filter = handle->file->getBloomFilter();
+    if (bloom_filter && !bloom_filter->isDirty()) {
+        // the Bloom filter persisted in the file covers all indexed keys
+        rv |= FDB_FLAG_BLOOM_FILTER;
+    }
     return rv;
 }
 
@@ -1519,8 +1637,10 @@ uint64_t fdb_set_file_header(FdbKvsHandle *handle)
     [    82]: Size of old file name before compaction :  2 bytes
     [    84]: File name of newly compacted file : x bytes
     [  84+x]: File name of old file before compcation : y bytes
-    [84+x+y]: CRC32: 4 bytes
-    total size (header's length): 88+x+y bytes
+    [84+x+y]: Offset of the Bloom filter directory doc: 8 bytes
+              (only if FDB_FLAG_BLOOM_FILTER is set in header flags)
+    [84+x+y(+8)]: CRC32: 4 bytes
+    total size (header's length): 88+x+y(+8) bytes
 
     Note: the list of functions that need to be modified
           if the header structure is changed:
@@ -1651,6 +1771,14 @@ uint64_t fdb_set_file_header(FdbKvsHandle *handle)
                    old_filename_len, offset);
     }
 
+    // Bloom filter directory offset
+    // (should be consistent with FDB_FLAG_BLOOM_FILTER in header flags)
+    BloomFilter *bloom_filter = cur_file->getBloomFilter();
+    if (bloom_filter && !bloom_filter->isDirty()) {
+        _edn_safe_64 = _endian_encode(bloom_filter->dirOffset);
+        seq_memcpy(buf + offset, &_edn_safe_64, sizeof(_edn_safe_64), offset);
+    }
+
     // crc32
     crc = get_checksum(buf, offset, handle->file->getCrcMode());
     crc = _endian_encode(crc);
@@ -1659,6 +1787,168 @@ uint64_t fdb_set_file_header(FdbKvsHandle *handle)
     return handle->file->updateHeader(buf, offset);
 }
 
+static uint64_t _fdb_append_bloom_filter_doc(FdbKvsHandle *handle,
+                                            const char *doc_key,
+                                            void *data, size_t len,
+                                            uint64_t prev_offset)
+{
+    uint64_t doc_offset;
+    struct docio_object doc;
+    struct docio_length doc_len;
+
+    memset(&doc, 0, sizeof(struct docio_object));
+    doc.key = (void *)doc_key;
+    doc.meta = NULL;
+    doc.body = data;
+    doc.length.keylen = strlen(doc_key) + 1;
+    doc.length.metalen = 0;
+    doc.length.bodylen = len;
+    doc.seqnum = 0;
+    doc_offset = handle->dhandle->appendSystemDoc_Docio(&doc);
+    if (doc_offset == BLK_NOT_FOUND) {
+        return doc_offset;
+    }
+
+    if (prev_offset != BLK_NOT_FOUND) {
+        if (handle->dhandle->readDocLength_Docio(&doc_len, prev_offset)
+            == FDB_RESULT_SUCCESS) {
+            // mark stale
+            handle->file->markDocStale(prev_offset,
+                                       _fdb_get_docsize(doc_len));
+        }
+    }
+    return doc_offset;
+}
+
+void fdb_bloom_filter_append(FdbKvsHandle *handle)
+{
+    BloomFilter *filter = handle->file->getBloomFilter();
+    uint64_t doc_offset;
+    void *data;
+    size_t len;
+
+    if (!filter || !filter->isDirty()) {
+        return;
+    }
+
+    // Full layers never change, so only the last layer is usually written.
+    for (size_t i = 0; i < filter->getNumLayers(); ++i) {
+        BloomFilterLayer *layer = filter->getLayer(i);
+        if (!layer->dirty) {
+            continue;
+        }
+        layer->exportLayer(&data, &len);
+        doc_offset = _fdb_append_bloom_filter_doc(handle, "Bloom_filter_layer",
+                                                  data, len, layer->offset);
+        free(data);
+        if (doc_offset == BLK_NOT_FOUND) {
+            // The filter remains dirty, so the next DB header will not
+            // refer to it.
+            return;
+        }
+        layer->offset = doc_offset;
+        layer->dirty = false;
+    }
+
+    filter->exportDirectory(&data, &len);
+    doc_offset = _fdb_append_bloom_filter_doc(handle, "Bloom_filter",
+                                              data, len, filter->dirOffset);
+    free(data);
+    if (doc_offset == BLK_NOT_FOUND) {
+        return;
+    }
+    filter->dirOffset = doc_offset;
+    filter->clearDirty();
+}
+
+static BloomFilter *_fdb_bloom_filter_read(FdbKvsHandle *handle,
+                                           uint64_t dir_offset,
+                                           uint32_t bits_per_key)
+{
+    int64_t offset;
+    struct docio_object doc;
+    std::vector<uint64_t> layer_offsets;
+    BloomFilter *filter;
+
+    if (dir_offset == BLK_NOT_FOUND) {
+        // No key has been indexed yet
+        return new BloomFilter(bits_per_key);
+    }
+
+    memset(&doc, 0, sizeof(struct docio_object));
+    offset = handle->dhandle->readDoc_Docio(dir_offset, &doc, true);
+    if (offset <= 0) {
+        return NULL;
+    }
+    if (!BloomFilter::importDirectory(doc.body, doc.length.bodylen,
+                                      &bits_per_key, layer_offsets)) {
+        free_docio_object(&doc, true, true, true);
+        return NULL;
+    }
+    free_docio_object(&doc, true, true, true);
+
+    filter = new BloomFilter(bits_per_key);
+    filter->dirOffset = dir_offset;
+    for (auto &entry : layer_offsets) {
+        BloomFilterLayer *layer;
+        memset(&doc, 0, sizeof(struct docio_object));
+        offset = handle->dhandle->readDoc_Docio(entry, &doc, true);
+        if (offset <= 0) {
+            delete filter;
+            return NULL;
+        }
+        layer = BloomFilterLayer::importLayer(doc.body, doc.length.bodylen);
+        free_docio_object(&doc, true, true, true);
+        if (!layer) {
+            delete filter;
+            return NULL;
+        }
+        layer->offset = entry;
+        filter->appendLayer(layer);
+    }
+    return filter;
+}
+
+// Load the Bloom filter of a file that is being opened for the first time,
+// using its latest DB header. The filter is discarded (and the index is always
+// looked up) if the file has keys that the filter does not cover.
+static void _fdb_bloom_filter_init(FdbKvsHandle *handle,
+                                   const fdb_config *config,
+                                   void *header_buf,
+                                   size_t header_len,
+                                   uint64_t header_flags,
+                                   uint64_t version)
+{
+    BloomFilter *filter = NULL;
+
+    if (!config->bloom_filter_bits_per_key) {
+        return;
+    }
+
+    if (!header_len) {
+        // New file: every key will be added through WAL flushing
+        filter = new BloomFilter(config->bloom_filter_bits_per_key);
+    } else if (header_flags & FDB_FLAG_BLOOM_FILTER) {
+        uint64_t dir_offset = fdb_fetch_header_bloom_filter_offset(version,
+                                                                   header_buf);
+        filter = _fdb_bloom_filter_read(handle, dir_offset,
+                                        config->bloom_filter_bits_per_key);
+        if (!filter) {
+            fdb_log(&handle->log_callback, FDB_RESULT_READ_FAIL,
+                    "Failed to read the Bloom filter with the offset %" _F64
+                    " from a database file '%s'. Index lookups will not be "
+                    "filtered until the file is compacted.",
+                    dir_offset, handle->file->getFileName());
+        }
+    }
+    // Otherwise, the file was written without the filter;
+    // it will be built when the file is compacted.
+
+    if (filter) {
+        handle->file->setBloomFilter(filter);
+    }
+}
+
 static fdb_status _fdb_append_commit_mark(void *voidhandle, uint64_t offset)
 {
     uint64_t marker_offset;
@@ -1967,6 +2257,30 @@ fdb_status fdb_get_latency_stats(fdb_file_handle *fhandle,
     return FDB_RESULT_ENGINE_NOT_INSTANTIATED;
 }
 
+LIBFDB_API
+fdb_status fdb_get_latency_percentiles(fdb_file_handle *fhandle,
+                                       fdb_latency_percentiles *stats,
+                                       fdb_latency_stat_type type)
+{
+    FdbEngine *fdb_engine = FdbEngine::getInstance();
+    if (fdb_engine) {
+        return fdb_engine->getLatencyPercentiles(fhandle, stats, type);
+    }
+    return FDB_RESULT_ENGINE_NOT_INSTANTIATED;
+}
+
+LIBFDB_API
+fdb_status fdb_get_kvs_latency_percentiles(fdb_kvs_handle *handle,
+                                           fdb_latency_percentiles *stats,
+                                           fdb_latency_stat_type type)
+{
+    FdbEngine *fdb_engine = FdbEngine::getInstance();
+    if (fdb_engine) {
+        return fdb_engine->getKvsLatencyPercentiles(handle, stats, type);
+    }
+    return FDB_RESULT_ENGINE_NOT_INSTANTIATED;
+}
+
 LIBFDB_API
 fdb_status fdb_get_latency_histogram(fdb_file_handle *fhandle,
                                      char **stats,
@@ -2048,6 +2362,28 @@ size_t fdb_get_buffer_cache_used() {
     return 0;
 }
 
+LIBFDB_API
+fdb_status fdb_set_io_rate_limit(fdb_io_class io_class,
+                                 uint64_t bytes_per_sec)
+{
+    FdbEngine *fdb_engine = FdbEngine::getInstance();
+    if (fdb_engine) {
+        return fdb_engine->setIoRateLimit(io_class, bytes_per_sec);
+    }
+    return FDB_RESULT_ENGINE_NOT_INSTANTIATED;
+}
+
+LIBFDB_API
+fdb_status fdb_get_io_rate_stats(fdb_io_class io_class,
+                                 fdb_io_rate_stats *stats)
+{
+    FdbEngine *fdb_engine = FdbEngine::getInstance();
+    if (fdb_engine) {
+        return fdb_engine->getIoRateStats(io_class, stats);
+    }
+    return FDB_RESULT_ENGINE_NOT_INSTANTIATED;
+}
+
 LIBFDB_API
 fdb_status fdb_cancel_compaction(fdb_file_handle *fhandle)
 {
@@ -2123,7 +2459,9 @@ fdb_status FdbEngine::init(fdb_config *config) {
             // We temporarily disable validity checking of block cache size
             // on Android platform at this time.
             double ram_size = (double) get_memory_size();
-            if (ram_size * BCACHE_MEMORY_THRESHOLD < (double) _config.buffercache_size) {
+            if (ram_size * BCACHE_MEMORY_THRESHOLD <
+                (double) (_config.buffercache_size +
+                          _config.compressed_buffercache_size)) {
                 return FDB_RESULT_TOO_BIG_BUFFER_CACHE;
             }
 #endif
@@ -2136,6 +2474,8 @@ fdb_status FdbEngine::init(fdb_config *config) {
             // Initialize file manager configs and global block cache
             f_config.setBlockSize(_config.blocksize);
             f_config.setNcacheBlock(_config.buffercache_size / _config.blocksize);
+            f_config.setCompressedCacheSize(
+                                    _config.compressed_buffercache_size);
             f_config.setSeqtreeOpt(_config.seqtree_opt);
             FileMgr::init(&f_config);
             FileMgr::setLazyFileDeletion(true,
@@ -2145,6 +2485,20 @@ fdb_status FdbEngine::init(fdb_config *config) {
                 FileMgr::setSbInitializer(standard_sb_init);
                 Superblock::initBmpMask();
             }
+            // Select the async I/O backend; fall back to the default one
+            // if the requested backend is not supported.
+            if (select_filemgr_io_backend(_config.io_backend) !=
+                FDB_RESULT_SUCCESS) {
+                fdb_log(NULL, FDB_RESULT_INVALID_CONFIG,
+                        "I/O backend %d is not supported on this platform; "
+                        "falling back to the default backend.",
+                        (int) _config.io_backend);
+            }
+
+            // Initialize the I/O rate limiter shared by all the files
+            IoRateLimiter::init(_config);
+            // Initialize the secondary cache shared by all the files
+            SecondaryCache::init(_config);
 
             // Initialize compaction daemon manager
             c_config.sleep_duration = _config.compactor_sleep_duration;
@@ -2195,6 +2549,8 @@ fdb_status FdbEngine::destroyInstance() {
             }
             // Shutdown HBtrie's memory pool
             HBTrie::shutdownMemoryPool();
+            IoRateLimiter::destroyInstance();
+            SecondaryCache::destroyInstance();
             delete tmp;
             instance = nullptr;
         } else {
@@ -2230,11 +2586,15 @@ void FdbEngine::initFileConfig(const fdb_config *config,
     }
 
     fconfig->setPrefetchDuration(config->prefetch_duration);
+    fconfig->setWarmupBudget(config->cache_warmup_budget);
     fconfig->setNumWalShards(config->num_wal_partitions);
     fconfig->setNumBcacheShards(config->num_bcache_partitions);
     fconfig->setEncryptionKey(config->encryption_key);
     fconfig->setBlockReusingThreshold(config->block_reusing_threshold);
     fconfig->setNumKeepingHeaders(config->num_keeping_headers);
+    if (config->flags & FDB_OPEN_WITH_XXH3_CHECKSUM) {
+        fconfig->setCreateCrcMode(XXH3);
+    }
 }
 
 fdb_status FdbEngine::openFile(FdbFileHandle **ptr_fhandle,
@@ -2442,7 +2802,8 @@ fdb_status FdbEngine::openFdb(FdbKvsHandle *handle,
     // If cloning from a snapshot handle, fdb_snapshot_open would have already
     // set handle->last_hdr_bid to the block id of required header, so rewind..
     last_hdr_bid = handle->last_hdr_bid.load(std::memory_order_relaxed);
-    if (handle->shandle && last_hdr_bid) {
+    bool latest_hdr = !(handle->shandle && last_hdr_bid);
+    if (!latest_hdr) {
         status = handle->file->fetchHeader(last_hdr_bid,
                                            header_buf, &header_len, &seqnum,
                                            &latest_header_revnum, &deltasize,
@@ -2558,6 +2919,11 @@ fdb_status FdbEngine::openFdb(FdbKvsHandle *handle,
         break;
     } while (true);
 
+    if (latest_hdr && handle->file->claimBloomFilterInit()) {
+        _fdb_bloom_filter_init(handle, config, header_buf, header_len,
+                               header_flags, version);
+    }
+
     handle->config = *config;
     handle->config.seqtree_opt = seqtree_opt;
     handle->config.multi_kv_instances = multi_kv_instances;
@@ -3069,6 +3435,16 @@ fdb_status FdbEngine::openFdb(FdbKvsHandle *handle,
         free(prev_filename);
     }
 
+    if (filename_mode == FDB_VFILENAME && !handle->shandle &&
+        !(config->flags & FDB_OPEN_FLAG_RDONLY) &&
+        config->durability_opt == FDB_DRB_COMMIT_LOG) {
+        status = replayCommitLog(handle);
+        if (status != FDB_RESULT_SUCCESS) {
+            _fdb_cleanup_open_err(handle);
+            return status;
+        }
+    }
+
     // do not register read-only handles
     if (!(config->flags & FDB_OPEN_FLAG_RDONLY)) {
         if (config->compaction_mode == FDB_COMPACTION_AUTO) {
@@ -3092,6 +3468,155 @@ fdb_status FdbEngine::openFdb(FdbKvsHandle *handle,
     return status;
 }
 
+// A committed update read from the commit log during replay
+struct _fdb_log_replay_item {
+    std::string key;
+    std::string meta;
+    std::string body;
+    fdb_seqnum_t seqnum;
+    timestamp_t timestamp;
+    bool deleted;
+};
+
+struct _fdb_log_replay_ctx {
+    // updates that are not followed by a commit marker yet
+    std::vector<_fdb_log_replay_item> pending;
+    // updates followed by a commit marker
+    std::vector<_fdb_log_replay_item> committed;
+    // true if any log entry exists
+    bool log_found;
+};
+
+static CommitLogScanDecision _fdb_log_replay_cb(CommitLogEntry *entry,
+                                                bool is_system_doc,
+                                                void *ptr_value,
+                                                void *ptr_entry,
+                                                uint64_t log_id,
+                                                void *ctx)
+{
+    (void)ptr_value;
+    (void)ptr_entry;
+    (void)log_id;
+    struct _fdb_log_replay_ctx *replay = (struct _fdb_log_replay_ctx *)ctx;
+
+    replay->log_found = true;
+    if (is_system_doc) {
+        uint64_t revnum, txn_id;
+        if (entry->getCommitMarker(revnum, txn_id)) {
+            // all the updates logged before the marker are committed
+            replay->committed.insert(replay->committed.end(),
+                std::make_move_iterator(replay->pending.begin()),
+                std::make_move_iterator(replay->pending.end()));
+            replay->pending.clear();
+        }
+        return CommitLogScanDecision::COMMIT_LOG_SCAN_CONTINUE;
+    }
+
+    _fdb_log_replay_item item;
+    item.key.assign((char *)entry->getKey(), entry->getKeyLen());
+    if (entry->getMetaLen()) {
+        item.meta.assign((char *)entry->getMeta(), entry->getMetaLen());
+    }
+    if (entry->getBodyLen()) {
+        item.body.assign((char *)entry->getBody(), entry->getBodyLen());
+    }
+    item.seqnum = entry->getSeqnum();
+    item.timestamp = entry->getTimestamp();
+    item.deleted = entry->checkFlag(DOCIO_DELETED);
+    replay->pending.push_back(std::move(item));
+
+    return CommitLogScanDecision::COMMIT_LOG_SCAN_CONTINUE;
+}
+
+fdb_status FdbEngine::replayCommitLog(FdbKvsHandle *handle)
+{
+    FileMgr *file = handle->file;
+    struct _fdb_log_replay_ctx ctx;
+    struct _fdb_key_cmp_info cmp_info;
+    fdb_status fs;
+
+    file->mutexLock();
+    if (!file->initCommitLog(handle->config.commit_log_size)) {
+        // the commit log has been already opened and replayed
+        file->mutexUnlock();
+        return FDB_RESULT_SUCCESS;
+    }
+
+    ctx.log_found = false;
+    fs = file->getCommitLog()->reconstructLog(_fdb_log_replay_cb, &ctx);
+    if (fs != FDB_RESULT_SUCCESS || !ctx.log_found) {
+        file->mutexUnlock();
+        return fs;
+    }
+
+    cmp_info.kvs_config = handle->kvs_config;
+    cmp_info.kvs = handle->kvs;
+
+    for (auto &item : ctx.committed) {
+        fdb_kvs_id_t kv_id = 0;
+        if (handle->kvs) {
+            size_t key_offset;
+            if (!_fdb_kvs_extract_name_off(handle, &item.key[0], &key_offset)) {
+                // the KV store has been removed since then
+                continue;
+            }
+            buf2kvid(handle->config.chunksize, &item.key[0], &kv_id);
+        }
+        if (item.seqnum <= fdb_kvs_get_seqnum(file, kv_id)) {
+            // already reflected in the DB file
+            continue;
+        }
+
+        struct docio_object _doc;
+        memset(&_doc, 0, sizeof(_doc));
+        _doc.length.keylen = item.key.size();
+        _doc.length.metalen = item.meta.size();
+        _doc.length.bodylen = item.body.size();
+        _doc.key = &item.key[0];
+        _doc.meta = item.meta.empty() ? NULL : &item.meta[0];
+        _doc.body = item.body.empty() ? NULL : &item.body[0];
+        _doc.seqnum = item.seqnum;
+        _doc.timestamp = item.timestamp;
+
+        uint64_t offset = handle->dhandle->appendDoc_Docio(&_doc, item.deleted,
+                                                           false);
+        if (offset == BLK_NOT_FOUND) {
+            file->mutexUnlock();
+            return FDB_RESULT_WRITE_FAIL;
+        }
+
+        fdb_doc wal_doc;
+        memset(&wal_doc, 0, sizeof(wal_doc));
+        wal_doc.key = _doc.key;
+        wal_doc.keylen = _doc.length.keylen;
+        wal_doc.meta = _doc.meta;
+        wal_doc.metalen = _doc.length.metalen;
+        wal_doc.seqnum = _doc.seqnum;
+        wal_doc.deleted = item.deleted;
+        wal_doc.size_ondisk = _fdb_get_docsize(_doc.length);
+        wal_doc.offset = offset;
+        if (item.deleted && !handle->config.purging_interval) {
+            file->getWal()->immediateRemove_Wal(file->getGlobalTxn(), &cmp_info,
+                                                &wal_doc, offset,
+                                                WAL_INS_WRITER);
+        } else {
+            file->getWal()->insert_Wal(file->getGlobalTxn(), &cmp_info,
+                                       &wal_doc, offset, WAL_INS_WRITER);
+        }
+        fdb_kvs_set_seqnum(file, kv_id, item.seqnum);
+    }
+    if (file->getWal()->getDirtyStatus_Wal() == FDB_WAL_CLEAN) {
+        file->getWal()->setDirtyStatus_Wal(FDB_WAL_DIRTY);
+    }
+    handle->seqnum = file->getSeqnum();
+    file->mutexUnlock();
+
+    // Write the replayed updates into the DB file with a durable header.
+    // This also discards all the replayed log files, so that stale log
+    // entries that were never committed cannot be picked up later.
+    return commitWithKVHandle(handle, FDB_COMMIT_MANUAL_WAL_FLUSH, true);
+}
+
 fdb_status FdbEngine::setLogCallback(FdbKvsHandle *handle,
                                      fdb_log_callback log_callback,
                                      void *ctx_data) {
@@ -3179,6 +3704,14 @@ fdb_status FdbEngine::get(FdbKvsHandle *handle, fdb_doc *doc,
     handle->op_stats->num_gets++;
 
     if (wr == FDB_RESULT_KEY_NOT_FOUND) {
+        BloomFilter *bloom_filter = handle->file->getBloomFilter();
+        if (bloom_filter && !handle->kvs_config.custom_cmp &&
+            !bloom_filter->mayContain(doc_kv.key, doc_kv.keylen)) {
+            // the key has never been flushed into the main index
+            END_HANDLE_BUSY(handle);
+            return FDB_RESULT_KEY_NOT_FOUND;
+        }
+
         _fdb_sync_dirty_root(handle);
 
         // as 'offset' is located at the beginning of doc_meta,
@@ -3254,7 +3787,7 @@ fdb_status FdbEngine::get(FdbKvsHandle *handle, fdb_doc *doc,
         doc->size_ondisk = _fdb_get_docsize(_doc.length);
         doc->offset = offset;
 
-        LATENCY_STAT_END(handle->file, FDB_LATENCY_GETS);
+        LATENCY_STAT_END_KVS(handle, FDB_LATENCY_GETS);
         END_HANDLE_BUSY(handle);
         return FDB_RESULT_SUCCESS;
     }
@@ -3263,38 +3796,48 @@ fdb_status FdbEngine::get(FdbKvsHandle *handle, fdb_doc *doc,
     return FDB_RESULT_KEY_NOT_FOUND;
 }
 
-fdb_status FdbEngine::getBySeq(FdbKvsHandle *handle,
-                               fdb_doc *doc,
-                               bool metaOnly)
+fdb_status FdbEngine::getPinned(FdbKvsHandle *handle, const void *key,
+                                size_t keylen, fdb_pinned_doc *pinned_doc)
 {
     uint64_t offset;
     struct docio_object _doc;
-    DocioHandle *dhandle;
     FileMgr *wal_file = NULL;
+    struct _fdb_key_cmp_info cmp_info;
     fdb_status wr;
-    btree_result br = BTREE_RESULT_FAIL;
-    fdb_seqnum_t _seqnum;
+    hbtrie_result hr = HBTRIE_RESULT_FAIL;
     fdb_txn *txn;
-    struct _fdb_key_cmp_info cmp_info;
+    fdb_doc doc_kv;
+    size_t prefix_len = 0;
     LATENCY_STAT_START();
 
     if (!handle) {
         return FDB_RESULT_INVALID_HANDLE;
     }
 
-    if (!doc || doc->seqnum == SEQNUM_NOT_USED) {
+    if (!pinned_doc || !key ||
+        keylen == 0 || keylen > FDB_MAX_KEYLEN ||
+        (handle->kvs_config.custom_cmp &&
+            keylen > handle->config.blocksize - HBTRIE_HEADROOM)) {
         return FDB_RESULT_INVALID_ARGS;
     }
 
-    // Sequence trees are a must for byseq operations
-    if (handle->config.seqtree_opt != FDB_SEQTREE_USE) {
-        return FDB_RESULT_INVALID_CONFIG;
-    }
-
     if (!BEGIN_HANDLE_BUSY(handle)) {
         return FDB_RESULT_HANDLE_BUSY;
     }
 
+    memset(&doc_kv, 0x0, sizeof(doc_kv));
+    if (handle->kvs) {
+        // multi KV instance mode
+        prefix_len = handle->config.chunksize;
+        doc_kv.keylen = keylen + prefix_len;
+        doc_kv.key = alca(uint8_t, doc_kv.keylen);
+        kvid2buf(prefix_len, handle->kvs->getKvsId(), doc_kv.key);
+        memcpy((uint8_t*)doc_kv.key + prefix_len, key, keylen);
+    } else {
+        doc_kv.keylen = keylen;
+        doc_kv.key = const_cast<void *>(key);
+    }
+
     if (!handle->shandle) {
         wr = fdb_check_file_reopen(handle, NULL);
         if (wr != FDB_RESULT_SUCCESS) {
@@ -3313,20 +3856,10 @@ fdb_status FdbEngine::getBySeq(FdbKvsHandle *handle,
     cmp_info.kvs_config = handle->kvs_config;
     cmp_info.kvs = handle->kvs;
     wal_file = handle->file;
-    dhandle = handle->dhandle;
 
-    // prevent searching by key in WAL if 'doc' is not empty
-    size_t key_len = doc->keylen;
-    doc->keylen = 0;
-    if (handle->kvs) {
-        wr = wal_file->getWal()->findWithKvid_Wal(txn, handle->kvs->getKvsId(),
-                                             &cmp_info,
-                                             handle->shandle, doc, &offset);
-    } else {
-        wr = wal_file->getWal()->find_Wal(txn, &cmp_info, handle->shandle, doc, &offset);
-    }
+    wr = wal_file->getWal()->find_Wal(txn, &cmp_info, handle->shandle, &doc_kv,
+                                      &offset);
 
-    doc->keylen = key_len;
     if (!handle->shandle) {
         fdb_sync_db_header(handle);
     }
@@ -3334,27 +3867,507 @@ fdb_status FdbEngine::getBySeq(FdbKvsHandle *handle,
     handle->op_stats->num_gets++;
 
     if (wr == FDB_RESULT_KEY_NOT_FOUND) {
+        BloomFilter *bloom_filter = handle->file->getBloomFilter();
+        if (bloom_filter && !handle->kvs_config.custom_cmp &&
+            !bloom_filter->mayContain(doc_kv.key, doc_kv.keylen)) {
+            // the key has never been flushed into the main index
+            END_HANDLE_BUSY(handle);
+            return FDB_RESULT_KEY_NOT_FOUND;
+        }
+
         _fdb_sync_dirty_root(handle);
 
-        _seqnum = _endian_encode(doc->seqnum);
-        if (handle->kvs) {
-            int size_id, size_seq;
-            uint8_t *kv_seqnum;
-            hbtrie_result hr;
-            fdb_kvs_id_t _kv_id;
+        DocMetaForIndex doc_meta;
+        hr = handle->trie->find(doc_kv.key, doc_kv.keylen, &doc_meta);
 
-            _kv_id = _endian_encode(handle->kvs->getKvsId());
-            size_id = sizeof(fdb_kvs_id_t);
-            size_seq = sizeof(fdb_seqnum_t);
-            kv_seqnum = alca(uint8_t, size_id + size_seq);
-            memcpy(kv_seqnum, &_kv_id, size_id);
-            memcpy(kv_seqnum + size_id, &_seqnum, size_seq);
-            hr = handle->seqtrie->find((void *)kv_seqnum, size_id + size_seq,
-                                       (void *)&offset);
-            br = (hr == HBTRIE_RESULT_SUCCESS)?(BTREE_RESULT_SUCCESS):(br);
-        } else {
-            br = handle->seqtree->find((void *)&_seqnum, (void *)&offset);
-        }
+        if (ver_btreev2_format(handle->file->getVersion())) {
+            handle->bnodeMgr->releaseCleanNodes();
+        } else {
+            handle->bhandle->flushBuffer();
+        }
+        doc_meta.decode();
+        offset = doc_meta.offset;
+
+        _fdb_release_dirty_root(handle);
+    }
+
+    if (!((wr == FDB_RESULT_SUCCESS && offset != BLK_NOT_FOUND) ||
+          hr == HBTRIE_RESULT_SUCCESS) ||
+        (wr == FDB_RESULT_SUCCESS && doc_kv.deleted)) {
+        END_HANDLE_BUSY(handle);
+        return FDB_RESULT_KEY_NOT_FOUND;
+    }
+
+    void *pin_handle = NULL;
+    memset(&_doc, 0x0, sizeof(_doc));
+    int64_t _offset = handle->dhandle->readDocPinned_Docio(offset, &_doc,
+                                                           &pin_handle);
+    if (_offset == 0) {
+        // The doc cannot be read in place. Read a copy of it instead.
+        pin_handle = NULL;
+        memset(&_doc, 0x0, sizeof(_doc));
+        _offset = handle->dhandle->readDoc_Docio(offset, &_doc, true);
+        if (_offset <= 0) {
+            END_HANDLE_BUSY(handle);
+            return _offset < 0 ? (fdb_status)_offset : FDB_RESULT_KEY_NOT_FOUND;
+        }
+    }
+
+    if ((_doc.length.keylen != doc_kv.keylen) ||
+        (_doc.length.flag & DOCIO_DELETED)) {
+        if (pin_handle) {
+            FileMgr::unpinBlock(pin_handle);
+        } else {
+            free_docio_object(&_doc, true, true, true);
+        }
+        END_HANDLE_BUSY(handle);
+        return FDB_RESULT_KEY_NOT_FOUND;
+    }
+
+    pinned_doc->keylen = keylen;
+    pinned_doc->metalen = _doc.length.metalen;
+    pinned_doc->bodylen = _doc.length.bodylen;
+    pinned_doc->seqnum = _doc.seqnum;
+    pinned_doc->offset = offset;
+    pinned_doc->key = (uint8_t*)_doc.key + prefix_len;
+    pinned_doc->meta = _doc.meta;
+    pinned_doc->body = _doc.body;
+    pinned_doc->zero_copy = pin_handle != NULL;
+    pinned_doc->pin_handle = pin_handle;
+    pinned_doc->key_buf = pin_handle ? NULL : _doc.key;
+
+    LATENCY_STAT_END_KVS(handle, FDB_LATENCY_GETS);
+    END_HANDLE_BUSY(handle);
+    return FDB_RESULT_SUCCESS;
+}
+
+fdb_status FdbEngine::releasePinned(fdb_pinned_doc *pinned_doc)
+{
+    if (!pinned_doc) {
+        return FDB_RESULT_INVALID_ARGS;
+    }
+
+    if (pinned_doc->pin_handle) {
+        FileMgr::unpinBlock(pinned_doc->pin_handle);
+    } else {
+        free(pinned_doc->key_buf);
+        free(const_cast<void *>(pinned_doc->meta));
+        free(const_cast<void *>(pinned_doc->body));
+    }
+    memset(pinned_doc, 0x0, sizeof(fdb_pinned_doc));
+    return FDB_RESULT_SUCCESS;
+}
+
+/**
+ * Per-key state for a batched lookup issued by FdbEngine::getMulti.
+ */
+struct _fdb_multi_get_item {
+    fdb_doc *doc;
+    // Key used for WAL / HB+trie lookups (prefixed by KV ID in multi KVS mode)
+    void *key;
+    size_t keylen;
+    uint64_t offset;
+    fdb_status status;
+};
+
+static bool _fdb_multi_get_key_less(const struct _fdb_multi_get_item *a,
+                                    const struct _fdb_multi_get_item *b)
+{
+    size_t len = MIN(a->keylen, b->keylen);
+    int cmp = memcmp(a->key, b->key, len);
+    if (cmp == 0) {
+        return a->keylen < b->keylen;
+    }
+    return cmp < 0;
+}
+
+static bool _fdb_multi_get_offset_less(const struct _fdb_multi_get_item *a,
+                                       const struct _fdb_multi_get_item *b)
+{
+    return a->offset < b->offset;
+}
+
+// Find the first unresolved item in 'sorted' (ordered by key) whose key
+// matches the key of the document read from disk.
+static struct _fdb_multi_get_item *_fdb_multi_get_match(
+                        std::vector<struct _fdb_multi_get_item *> &sorted,
+                        struct docio_object *_doc)
+{
+    struct _fdb_multi_get_item probe;
+    probe.key = _doc->key;
+    probe.keylen = _doc->length.keylen;
+
+    auto it = std::lower_bound(sorted.begin(), sorted.end(), &probe,
+                               _fdb_multi_get_key_less);
+    for (; it != sorted.end(); ++it) {
+        if ((*it)->keylen != probe.keylen ||
+            memcmp((*it)->key, probe.key, probe.keylen)) {
+            break;
+        }
+        if ((*it)->status == FDB_RESULT_KEY_NOT_FOUND &&
+            (*it)->offset != BLK_NOT_FOUND) {
+            return *it;
+        }
+    }
+    return NULL;
+}
+
+fdb_status FdbEngine::getMulti(FdbKvsHandle *handle,
+                               fdb_doc **docs,
+                               size_t num_docs,
+                               fdb_status *results)
+{
+    DocioHandle *dhandle;
+    FileMgr *wal_file = NULL;
+    struct _fdb_key_cmp_info cmp_info;
+    fdb_status wr;
+    fdb_txn *txn;
+    size_t i, j;
+    LATENCY_STAT_START();
+
+    if (!handle) {
+        return FDB_RESULT_INVALID_HANDLE;
+    }
+
+    if (!docs || !results || num_docs == 0) {
+        return FDB_RESULT_INVALID_ARGS;
+    }
+
+    if (!BEGIN_HANDLE_BUSY(handle)) {
+        return FDB_RESULT_HANDLE_BUSY;
+    }
+
+    std::vector<struct _fdb_multi_get_item> items(num_docs);
+    std::vector<struct _fdb_multi_get_item *> sorted;
+    sorted.reserve(num_docs);
+
+    int size_chunk = handle->config.chunksize;
+    for (i = 0; i < num_docs; ++i) {
+        fdb_doc *doc = docs[i];
+        items[i].doc = doc;
+        items[i].key = NULL;
+        items[i].keylen = 0;
+        items[i].offset = BLK_NOT_FOUND;
+        results[i] = items[i].status = FDB_RESULT_KEY_NOT_FOUND;
+
+        if (!doc || !doc->key ||
+            doc->keylen == 0 || doc->keylen > FDB_MAX_KEYLEN ||
+            (handle->kvs_config.custom_cmp &&
+                doc->keylen > handle->config.blocksize - HBTRIE_HEADROOM)) {
+            results[i] = items[i].status = FDB_RESULT_INVALID_ARGS;
+            continue;
+        }
+
+        if (handle->kvs) {
+            // multi KV instance mode
+            items[i].keylen = doc->keylen + size_chunk;
+            items[i].key = malloc(items[i].keylen);
+            kvid2buf(size_chunk, handle->kvs->getKvsId(), items[i].key);
+            memcpy((uint8_t*)items[i].key + size_chunk, doc->key, doc->keylen);
+        } else {
+            items[i].keylen = doc->keylen;
+            items[i].key = doc->key;
+        }
+        sorted.push_back(&items[i]);
+    }
+
+    // Sort the keys so that both WAL and HB+trie lookups walk the index
+    // in key order, which maximizes the reuse of cached index nodes.
+    std::sort(sorted.begin(), sorted.end(), _fdb_multi_get_key_less);
+
+    if (!handle->shandle) {
+        wr = fdb_check_file_reopen(handle, NULL);
+        if (wr != FDB_RESULT_SUCCESS) {
+            if (handle->kvs) {
+                for (i = 0; i < sorted.size(); ++i) {
+                    free(sorted[i]->key);
+                }
+            }
+            END_HANDLE_BUSY(handle);
+            return wr;
+        }
+
+        txn = handle->fhandle->getRootHandle()->txn;
+        if (!txn) {
+            txn = handle->file->getGlobalTxn();
+        }
+    } else {
+        txn = handle->shandle->snap_txn;
+    }
+
+    cmp_info.kvs_config = handle->kvs_config;
+    cmp_info.kvs = handle->kvs;
+    wal_file = handle->file;
+    dhandle = handle->dhandle;
+
+    // 1. Resolve offsets from WAL first. This should be done for all keys
+    //    before syncing the DB header, so that items flushed from WAL in the
+    //    meantime are still visible through the (newer) index root.
+    std::vector<struct _fdb_multi_get_item *> trie_lookups;
+    for (i = 0; i < sorted.size(); ++i) {
+        struct _fdb_multi_get_item *item = sorted[i];
+        fdb_doc doc_kv = *item->doc;
+        doc_kv.key = item->key;
+        doc_kv.keylen = item->keylen;
+        doc_kv.deleted = false;
+
+        uint64_t offset;
+        wr = wal_file->getWal()->find_Wal(txn, &cmp_info, handle->shandle,
+                                          &doc_kv, &offset);
+        if (wr == FDB_RESULT_SUCCESS) {
+            if (doc_kv.deleted || offset == BLK_NOT_FOUND) {
+                // logically deleted in WAL
+                continue;
+            }
+            item->offset = offset;
+        } else {
+            trie_lookups.push_back(item);
+        }
+    }
+
+    if (!handle->shandle) {
+        fdb_sync_db_header(handle);
+    }
+
+    handle->op_stats->num_gets += sorted.size();
+
+    // 2. Resolve the remaining offsets from the HB+trie in one pass.
+    if (!trie_lookups.empty()) {
+        BloomFilter *bloom_filter = handle->file->getBloomFilter();
+        if (handle->kvs_config.custom_cmp) {
+            bloom_filter = NULL;
+        }
+        _fdb_sync_dirty_root(handle);
+
+        for (i = 0; i < trie_lookups.size(); ++i) {
+            struct _fdb_multi_get_item *item = trie_lookups[i];
+            if (bloom_filter &&
+                !bloom_filter->mayContain(item->key, item->keylen)) {
+                continue;
+            }
+            DocMetaForIndex doc_meta;
+            hbtrie_result hr = handle->trie->find(item->key, item->keylen,
+                                                  &doc_meta);
+            if (!ver_btreev2_format(handle->file->getVersion())) {
+                handle->bhandle->flushBuffer();
+            }
+            if (hr == HBTRIE_RESULT_SUCCESS) {
+                doc_meta.decode();
+                item->offset = doc_meta.offset;
+            }
+        }
+        if (ver_btreev2_format(handle->file->getVersion())) {
+            handle->bnodeMgr->releaseCleanNodes();
+        }
+
+        _fdb_release_dirty_root(handle);
+    }
+
+    // 3. Read all the document bodies in file offset order, using async I/O
+    //    for the blocks not resident in the buffer cache if it is supported.
+    std::vector<uint64_t> offset_array;
+    offset_array.reserve(sorted.size());
+    std::vector<struct _fdb_multi_get_item *> by_offset;
+    for (i = 0; i < sorted.size(); ++i) {
+        if (sorted[i]->offset != BLK_NOT_FOUND) {
+            by_offset.push_back(sorted[i]);
+        }
+    }
+    std::sort(by_offset.begin(), by_offset.end(), _fdb_multi_get_offset_less);
+    for (i = 0; i < by_offset.size(); ++i) {
+        offset_array.push_back(by_offset[i]->offset);
+    }
+
+    if (!offset_array.empty()) {
+        struct async_io_handle *aio_handle_ptr = NULL;
+        struct async_io_handle aio_handle;
+        if (offset_array.size() > 1) {
+            aio_handle.queue_depth = ASYNC_IO_QUEUE_DEPTH;
+            aio_handle.block_size = handle->file->getConfig()->getBlockSize();
+            aio_handle.fops_handle = handle->file->getFopsHandle();
+            if (handle->file->getOps()->aio_init(handle->file->getFopsHandle(),
+                                                 &aio_handle) ==
+                FDB_RESULT_SUCCESS) {
+                aio_handle_ptr = &aio_handle;
+            }
+        }
+
+        size_t batch_size = MIN(offset_array.size(),
+                                (size_t)FDB_MULTI_GET_BATCHSIZE);
+        struct docio_object *doc_array = (struct docio_object *)
+            calloc(batch_size, sizeof(struct docio_object));
+
+        i = 0;
+        while (i < offset_array.size()) {
+            size_t num_reads =
+                dhandle->batchReadDocs_Docio(&offset_array[i], doc_array,
+                                             offset_array.size() - i,
+                                             FDB_MULTI_GET_MOVE_UNIT,
+                                             batch_size,
+                                             aio_handle_ptr, false);
+            if (num_reads == (size_t) -1 || num_reads == 0) {
+                for (j = i; j < by_offset.size(); ++j) {
+                    by_offset[j]->status = FDB_RESULT_READ_FAIL;
+                }
+                break;
+            }
+            i += num_reads;
+
+            // Docs read asynchronously are not necessarily returned in the
+            // order of offsets, so match them back to the requested keys.
+            for (j = 0; j < num_reads; ++j) {
+                struct docio_object *_doc = &doc_array[j];
+                if (!_doc->key) {
+                    continue;
+                }
+
+                struct _fdb_multi_get_item *item =
+                    _fdb_multi_get_match(sorted, _doc);
+                if (!item || (_doc->length.flag & DOCIO_DELETED)) {
+                    free_docio_object(_doc, true, true, true);
+                    if (item) {
+                        item->offset = BLK_NOT_FOUND;
+                    }
+                    continue;
+                }
+
+                fdb_doc *doc = item->doc;
+                if (doc->meta) {
+                    // caller-provided buffer, as in fdb_get()
+                    memcpy(doc->meta, _doc->meta, _doc->length.metalen);
+                    free(_doc->meta);
+                } else {
+                    doc->meta = _doc->meta;
+                }
+                if (doc->body) {
+                    memcpy(doc->body, _doc->body, _doc->length.bodylen);
+                    free(_doc->body);
+                } else {
+                    doc->body = _doc->body;
+                }
+                free(_doc->key);
+
+                doc->seqnum = _doc->seqnum;
+                doc->metalen = _doc->length.metalen;
+                doc->bodylen = _doc->length.bodylen;
+                doc->deleted = false;
+                doc->size_ondisk = _fdb_get_docsize(_doc->length);
+                doc->offset = item->offset;
+                item->status = FDB_RESULT_SUCCESS;
+            }
+        }
+
+        free(doc_array);
+        if (aio_handle_ptr) {
+            handle->file->getOps()->aio_destroy(handle->file->getFopsHandle(),
+                                                aio_handle_ptr);
+        }
+    }
+
+    for (i = 0; i < num_docs; ++i) {
+        results[i] = items[i].status;
+        if (handle->kvs && items[i].key) {
+            free(items[i].key);
+        }
+    }
+
+    LATENCY_STAT_END_KVS(handle, FDB_LATENCY_GETS);
+    END_HANDLE_BUSY(handle);
+    return FDB_RESULT_SUCCESS;
+}
+
+fdb_status FdbEngine::getBySeq(FdbKvsHandle *handle,
+                               fdb_doc *doc,
+                               bool metaOnly)
+{
+    uint64_t offset;
+    struct docio_object _doc;
+    DocioHandle *dhandle;
+    FileMgr *wal_file = NULL;
+    fdb_status wr;
+    btree_result br = BTREE_RESULT_FAIL;
+    fdb_seqnum_t _seqnum;
+    fdb_txn *txn;
+    struct _fdb_key_cmp_info cmp_info;
+    LATENCY_STAT_START();
+
+    if (!handle) {
+        return FDB_RESULT_INVALID_HANDLE;
+    }
+
+    if (!doc || doc->seqnum == SEQNUM_NOT_USED) {
+        return FDB_RESULT_INVALID_ARGS;
+    }
+
+    // Sequence trees are a must for byseq operations
+    if (handle->config.seqtree_opt != FDB_SEQTREE_USE) {
+        return FDB_RESULT_INVALID_CONFIG;
+    }
+
+    if (!BEGIN_HANDLE_BUSY(handle)) {
+        return FDB_RESULT_HANDLE_BUSY;
+    }
+
+    if (!handle->shandle) {
+        wr = fdb_check_file_reopen(handle, NULL);
+        if (wr != FDB_RESULT_SUCCESS) {
+            END_HANDLE_BUSY(handle);
+            return wr;
+        }
+
+        txn = handle->fhandle->getRootHandle()->txn;
+        if (!txn) {
+            txn = handle->file->getGlobalTxn();
+        }
+    } else {
+        txn = handle->shandle->snap_txn;
+    }
+
+    cmp_info.kvs_config = handle->kvs_config;
+    cmp_info.kvs = handle->kvs;
+    wal_file = handle->file;
+    dhandle = handle->dhandle;
+
+    // prevent searching by key in WAL if 'doc' is not empty
+    size_t key_len = doc->keylen;
+    doc->keylen = 0;
+    if (handle->kvs) {
+        wr = wal_file->getWal()->findWithKvid_Wal(txn, handle->kvs->getKvsId(),
+                                             &cmp_info,
+                                             handle->shandle, doc, &offset);
+    } else {
+        wr = wal_file->getWal()->find_Wal(txn, &cmp_info, handle->shandle, doc, &offset);
+    }
+
+    doc->keylen = key_len;
+    if (!handle->shandle) {
+        fdb_sync_db_header(handle);
+    }
+
+    handle->op_stats->num_gets++;
+
+    if (wr == FDB_RESULT_KEY_NOT_FOUND) {
+        _fdb_sync_dirty_root(handle);
+
+        _seqnum = _endian_encode(doc->seqnum);
+        if (handle->kvs) {
+            int size_id, size_seq;
+            uint8_t *kv_seqnum;
+            hbtrie_result hr;
+            fdb_kvs_id_t _kv_id;
+
+            _kv_id = _endian_encode(handle->kvs->getKvsId());
+            size_id = sizeof(fdb_kvs_id_t);
+            size_seq = sizeof(fdb_seqnum_t);
+            kv_seqnum = alca(uint8_t, size_id + size_seq);
+            memcpy(kv_seqnum, &_kv_id, size_id);
+            memcpy(kv_seqnum + size_id, &_seqnum, size_seq);
+            hr = handle->seqtrie->find((void *)kv_seqnum, size_id + size_seq,
+                                       (void *)&offset);
+            br = (hr == HBTRIE_RESULT_SUCCESS)?(BTREE_RESULT_SUCCESS):(br);
+        } else {
+            br = handle->seqtree->find((void *)&_seqnum, (void *)&offset);
+        }
         if (ver_btreev2_format(handle->file->getVersion())) {
             handle->bnodeMgr->releaseCleanNodes();
         } else {
@@ -3431,7 +4444,7 @@ fdb_status FdbEngine::getBySeq(FdbKvsHandle *handle,
         doc->offset = offset;
 
         END_HANDLE_BUSY(handle);
-        LATENCY_STAT_END(handle->file, FDB_LATENCY_GETS);
+        LATENCY_STAT_END_KVS(handle, FDB_LATENCY_GETS);
         return FDB_RESULT_SUCCESS;
     }
 
@@ -3524,6 +4537,136 @@ fdb_status FdbEngine::getByOffset(FdbKvsHandle *handle, fdb_doc *doc)
     return FDB_RESULT_SUCCESS;
 }
 
+// Append a non-transactional update into the commit log of the file, if the
+// file is in FDB_DRB_COMMIT_LOG mode. Should be called under the file mutex
+// so that the order of log entries matches the order of sequence numbers.
+static fdb_status _fdb_append_commit_log(FileMgr *file,
+                                         struct docio_object *doc,
+                                         bool deleted)
+{
+    CommitLog *commit_log = file->getCommitLog();
+    if (!commit_log) {
+        return FDB_RESULT_SUCCESS;
+    }
+
+    CommitLogEntry entry;
+    void *ptr_value = nullptr;
+    entry.setKey(doc->key, doc->length.keylen);
+    entry.setMeta(doc->meta, doc->length.metalen);
+    entry.setBody(doc->body, doc->length.bodylen);
+    entry.setSeqnum(doc->seqnum);
+    entry.setTimestamp(doc->timestamp);
+    if (deleted) {
+        entry.setFlag(DOCIO_DELETED);
+    }
+
+    fdb_status fs = commit_log->appendLogEntry(&entry, ptr_value);
+    if (fs == FDB_RESULT_SUCCESS) {
+        file->addCommitLogBytes(entry.getRawSize());
+    }
+    return fs;
+}
+
+// Mark WAL as dirty after new items are inserted, and flush it into the main
+// index if the number of flushable items exceeds the threshold and the
+// flushing before commit is enabled. Should be called under the file mutex.
+static fdb_status _fdb_wal_flush_on_threshold(FdbKvsHandle *handle,
+                                              bool txn_enabled,
+                                              bool *wal_flushed)
+{
+    FileMgr *file = handle->file;
+    fdb_status wr = FDB_RESULT_SUCCESS;
+
+    if (file->getWal()->getDirtyStatus_Wal() == FDB_WAL_CLEAN) {
+        file->getWal()->setDirtyStatus_Wal(FDB_WAL_DIRTY);
+    }
+
+    if (handle->config.auto_commit &&
+        file->getWal()->getNumFlushable_Wal() > _fdb_get_wal_threshold(handle)) {
+        // we don't need dirty WAL flushing in auto commit mode
+        // (commitWithKVHandle is internally called by the caller)
+        *wal_flushed = true;
+
+    } else if (handle->config.wal_flush_before_commit) {
+
+        bid_t dirty_idtree_root = BLK_NOT_FOUND;
+        bid_t dirty_seqtree_root = BLK_NOT_FOUND;
+
+        if (!txn_enabled) {
+            handle->dirty_updates = 1;
+        }
+
+        if (handle->config.background_wal_flush) {
+            // Only the items inserted after the pending flush was handed over
+            // count towards the threshold.
+            size_t num_frozen = 0;
+            PendingWalFlush *pending = file->getPendingWalFlush();
+            if (pending) {
+                num_frozen = pending->getNumItems();
+            }
+            if (file->getWal()->getNumFlushable_Wal() >
+                num_frozen + _fdb_get_wal_threshold(handle)) {
+                // Backpressure: wait for the previous generation to be
+                // flushed before freezing another one.
+                file->completePendingWalFlush();
+                wr = BgWalFlush::start(handle);
+            }
+            return wr;
+        }
+
+        if (file->getWal()->getNumFlushable_Wal() > _fdb_get_wal_threshold(handle)) {
+            union wal_flush_items flush_items;
+
+            // in case another handle on this file left a background flush
+            file->completePendingWalFlush();
+
+            // commit only for non-transactional WAL entries
+            wr = file->getWal()->commit_Wal(file->getGlobalTxn(), NULL,
+                                            &handle->log_callback);
+            if (wr != FDB_RESULT_SUCCESS) {
+                return wr;
+            }
+
+            struct filemgr_dirty_update_node *prev_node = NULL, *new_node = NULL;
+
+            _fdb_dirty_update_ready(handle, &prev_node, &new_node,
+                                    &dirty_idtree_root, &dirty_seqtree_root, true);
+
+            wr = file->getWal()->flush_Wal((void *)handle,
+                                           WalFlushCallbacks::flushItem,
+                                           WalFlushCallbacks::getOldOffset,
+                                           WalFlushCallbacks::purgeSeqTreeEntry,
+                                           WalFlushCallbacks::updateKvsDeltaStats,
+                                           &flush_items);
+
+            bool is_btree_v2 = ver_btreev2_format(handle->file->getVersion());
+            if (wr != FDB_RESULT_SUCCESS) {
+                if (!is_btree_v2) {
+                    handle->bhandle->clearDirtyUpdate();
+                    FileMgr::dirtyUpdateCloseNode(prev_node);
+                    handle->file->dirtyUpdateRemoveNode(new_node);
+                }
+                return wr;
+            }
+
+            _fdb_dirty_update_finalize(handle, prev_node, new_node,
+                                       &dirty_idtree_root, &dirty_seqtree_root, false);
+
+            file->getWal()->setDirtyStatus_Wal(FDB_WAL_PENDING);
+            // it is ok to release flushed items becuase
+            // these items are not actually committed yet.
+            // they become visible after fdb_commit is invoked.
+            file->getWal()->releaseFlushedItems_Wal(&flush_items);
+
+            *wal_flushed = true;
+            if (!is_btree_v2) {
+                handle->bhandle->resetSubblockInfo();
+            }
+        }
+    }
+    return wr;
+}
+
 fdb_status FdbEngine::set(FdbKvsHandle *handle, fdb_doc *doc)
 {
     if (!handle) {
@@ -3604,7 +4747,7 @@ fdb_set_start:
     cmp_info.kvs_config = handle->kvs_config;
     cmp_info.kvs = handle->kvs;
 
-    handle->file->mutexLock();
+    handle->file->mutexLockForAppend();
     fdb_sync_db_header(handle);
 
     if (handle->file->isRollbackOn()) {
@@ -3667,122 +4810,67 @@ fdb_set_start:
         _doc.timestamp = 0;
     }
 
-    if (txn) {
-        txn_enabled = true;
-    }
-
-    offset = dhandle->appendDoc_Docio(&_doc, doc->deleted, txn_enabled);
-    if (offset == BLK_NOT_FOUND) {
-        file->mutexUnlock();
-        END_HANDLE_BUSY(handle);
-        return FDB_RESULT_WRITE_FAIL;
-    }
-
-    if (doc->deleted && !handle->config.purging_interval) {
-        // immediately remove from hbtrie upon WAL flush
-        immediate_remove = true;
-    }
-
-    doc->size_ondisk = _fdb_get_docsize(_doc.length);
-    doc->offset = offset;
-    if (!txn) {
-        txn = file->getGlobalTxn();
-    }
-    if (handle->kvs) {
-        // multi KV instance mode
-        fdb_doc kv_ins_doc = *doc;
-        kv_ins_doc.key = _doc.key;
-        kv_ins_doc.keylen = _doc.length.keylen;
-        if (!immediate_remove) {
-            file->getWal()->insert_Wal(txn, &cmp_info, &kv_ins_doc, offset,
-                       WAL_INS_WRITER);
-        } else {
-            file->getWal()->immediateRemove_Wal(txn, &cmp_info, &kv_ins_doc, offset,
-                                 WAL_INS_WRITER);
-        }
-    } else {
-        if (!immediate_remove) {
-            file->getWal()->insert_Wal(txn, &cmp_info, doc, offset, WAL_INS_WRITER);
-        } else {
-            file->getWal()->immediateRemove_Wal(txn, &cmp_info, doc, offset,
-                                           WAL_INS_WRITER);
-        }
-    }
-
-    if (file->getWal()->getDirtyStatus_Wal() == FDB_WAL_CLEAN) {
-        file->getWal()->setDirtyStatus_Wal(FDB_WAL_DIRTY);
-    }
-
-    if (handle->config.auto_commit &&
-        file->getWal()->getNumFlushable_Wal() > _fdb_get_wal_threshold(handle)) {
-        // we don't need dirty WAL flushing in auto commit mode
-        // (commitWithKVHandle is internally called at the end of this function)
-        wal_flushed = true;
-
-    } else if (handle->config.wal_flush_before_commit) {
-
-        bid_t dirty_idtree_root = BLK_NOT_FOUND;
-        bid_t dirty_seqtree_root = BLK_NOT_FOUND;
-
-        if (!txn_enabled) {
-            handle->dirty_updates = 1;
-        }
-
-        if (file->getWal()->getNumFlushable_Wal() > _fdb_get_wal_threshold(handle)) {
-            union wal_flush_items flush_items;
-
-            // commit only for non-transactional WAL entries
-            wr = file->getWal()->commit_Wal(file->getGlobalTxn(), NULL,
-                                            &handle->log_callback);
-            if (wr != FDB_RESULT_SUCCESS) {
-                file->mutexUnlock();
-                END_HANDLE_BUSY(handle);
-                return wr;
-            }
-
-            struct filemgr_dirty_update_node *prev_node = NULL, *new_node = NULL;
-
-            _fdb_dirty_update_ready(handle, &prev_node, &new_node,
-                                    &dirty_idtree_root, &dirty_seqtree_root, true);
-
-            wr = file->getWal()->flush_Wal((void *)handle,
-                                           WalFlushCallbacks::flushItem,
-                                           WalFlushCallbacks::getOldOffset,
-                                           WalFlushCallbacks::purgeSeqTreeEntry,
-                                           WalFlushCallbacks::updateKvsDeltaStats,
-                                           &flush_items);
-
-            bool is_btree_v2 = ver_btreev2_format(handle->file->getVersion());
-            if (wr != FDB_RESULT_SUCCESS) {
-                if (!is_btree_v2) {
-                    handle->bhandle->clearDirtyUpdate();
-                    FileMgr::dirtyUpdateCloseNode(prev_node);
-                    handle->file->dirtyUpdateRemoveNode(new_node);
-                }
-                file->mutexUnlock();
-                END_HANDLE_BUSY(handle);
-                return wr;
-            }
-
-            _fdb_dirty_update_finalize(handle, prev_node, new_node,
-                                       &dirty_idtree_root, &dirty_seqtree_root, false);
+    if (txn) {
+        txn_enabled = true;
+    }
 
-            file->getWal()->setDirtyStatus_Wal(FDB_WAL_PENDING);
-            // it is ok to release flushed items becuase
-            // these items are not actually committed yet.
-            // they become visible after fdb_commit is invoked.
-            file->getWal()->releaseFlushedItems_Wal(&flush_items);
+    offset = dhandle->appendDoc_Docio(&_doc, doc->deleted, txn_enabled);
+    if (offset == BLK_NOT_FOUND) {
+        file->mutexUnlock();
+        END_HANDLE_BUSY(handle);
+        return FDB_RESULT_WRITE_FAIL;
+    }
 
-            wal_flushed = true;
-            if (!is_btree_v2) {
-                handle->bhandle->resetSubblockInfo();
-            }
+    if (!txn_enabled) {
+        wr = _fdb_append_commit_log(file, &_doc, doc->deleted);
+        if (wr != FDB_RESULT_SUCCESS) {
+            file->mutexUnlock();
+            END_HANDLE_BUSY(handle);
+            return wr;
+        }
+    }
+
+    if (doc->deleted && !handle->config.purging_interval) {
+        // immediately remove from hbtrie upon WAL flush
+        immediate_remove = true;
+    }
+
+    doc->size_ondisk = _fdb_get_docsize(_doc.length);
+    doc->offset = offset;
+    if (!txn) {
+        txn = file->getGlobalTxn();
+    }
+    if (handle->kvs) {
+        // multi KV instance mode
+        fdb_doc kv_ins_doc = *doc;
+        kv_ins_doc.key = _doc.key;
+        kv_ins_doc.keylen = _doc.length.keylen;
+        if (!immediate_remove) {
+            file->getWal()->insert_Wal(txn, &cmp_info, &kv_ins_doc, offset,
+                       WAL_INS_WRITER);
+        } else {
+            file->getWal()->immediateRemove_Wal(txn, &cmp_info, &kv_ins_doc, offset,
+                                 WAL_INS_WRITER);
+        }
+    } else {
+        if (!immediate_remove) {
+            file->getWal()->insert_Wal(txn, &cmp_info, doc, offset, WAL_INS_WRITER);
+        } else {
+            file->getWal()->immediateRemove_Wal(txn, &cmp_info, doc, offset,
+                                           WAL_INS_WRITER);
         }
     }
 
+    wr = _fdb_wal_flush_on_threshold(handle, txn_enabled, &wal_flushed);
+    if (wr != FDB_RESULT_SUCCESS) {
+        file->mutexUnlock();
+        END_HANDLE_BUSY(handle);
+        return wr;
+    }
+
     file->mutexUnlock();
 
-    LATENCY_STAT_END(file, FDB_LATENCY_SETS);
+    LATENCY_STAT_END_KVS(handle, FDB_LATENCY_SETS);
 
     if (!doc->deleted) {
         handle->op_stats->num_sets++;
@@ -3832,6 +4920,237 @@ fdb_status FdbEngine::del(FdbKvsHandle *handle, fdb_doc *doc)
     return set(handle, &_doc);
 }
 
+fdb_status FdbEngine::applyWriteBatch(FdbKvsHandle *handle,
+                                      FdbWriteBatch *batch)
+{
+    if (!handle) {
+        return FDB_RESULT_INVALID_HANDLE;
+    }
+
+    if (!batch) {
+        return FDB_RESULT_INVALID_ARGS;
+    }
+
+    if (handle->config.flags & FDB_OPEN_FLAG_RDONLY) {
+        return fdb_log(&handle->log_callback, FDB_RESULT_RONLY_VIOLATION,
+                       "Warning: SET is not allowed on the read-only DB file '%s'.",
+                       handle->file->getFileName());
+    }
+
+    size_t i;
+    size_t num_ops = batch->getNumOps();
+    if (num_ops == 0) {
+        return FDB_RESULT_SUCCESS;
+    }
+
+    if (handle->kvs_config.custom_cmp) {
+        for (i = 0; i < num_ops; ++i) {
+            if (batch->getOp(i).doc.keylen >
+                handle->config.blocksize - HBTRIE_HEADROOM) {
+                return FDB_RESULT_INVALID_ARGS;
+            }
+        }
+    }
+
+    FileMgr *file;
+    DocioHandle *dhandle;
+    struct timeval tv;
+    bool txn_enabled = false;
+    bool sub_handle = false;
+    bool wal_flushed = false;
+    file_status_t fMgrStatus;
+    fdb_txn *txn = handle->fhandle->getRootHandle()->txn;
+    struct _fdb_key_cmp_info cmp_info;
+    fdb_status wr = FDB_RESULT_SUCCESS;
+    size_t num_appended = 0;
+
+    if (!BEGIN_HANDLE_BUSY(handle)) {
+        return FDB_RESULT_HANDLE_BUSY;
+    }
+
+    std::vector<struct docio_object> _docs(num_ops);
+    std::vector<fdb_doc> wal_docs(num_ops);
+    std::vector<struct wal_insert_req> reqs(num_ops);
+
+    int size_chunk = handle->config.chunksize;
+    for (i = 0; i < num_ops; ++i) {
+        fdb_doc *doc = &batch->getOp(i).doc;
+        struct docio_object *_doc = &_docs[i];
+        _doc->length.keylen = doc->keylen;
+        _doc->length.metalen = doc->metalen;
+        _doc->length.bodylen = doc->deleted ? 0 : doc->bodylen;
+        _doc->key = doc->key;
+        _doc->meta = doc->meta;
+        _doc->body = doc->deleted ? NULL : doc->body;
+
+        if (handle->kvs) {
+            // multi KV instance mode: prefix the key with KV store ID
+            _doc->length.keylen = doc->keylen + size_chunk;
+            _doc->key = malloc(_doc->length.keylen);
+            kvid2buf(size_chunk, handle->kvs->getKvsId(), _doc->key);
+            memcpy((uint8_t*)_doc->key + size_chunk, doc->key, doc->keylen);
+        }
+    }
+    if (handle->kvs && handle->kvs->getKvsType() == KVS_SUB) {
+        sub_handle = true;
+    }
+
+fdb_write_batch_start:
+    wr = fdb_check_file_reopen(handle, NULL);
+    if (wr != FDB_RESULT_SUCCESS) {
+        goto fdb_write_batch_end;
+    }
+
+    {
+        size_t throttling_delay = handle->file->getThrottlingDelay();
+        if (throttling_delay) {
+            usleep(throttling_delay);
+        }
+    }
+
+    cmp_info.kvs_config = handle->kvs_config;
+    cmp_info.kvs = handle->kvs;
+
+    handle->file->mutexLockForAppend();
+    fdb_sync_db_header(handle);
+
+    if (handle->file->isRollbackOn()) {
+        handle->file->mutexUnlock();
+        wr = FDB_RESULT_FAIL_BY_ROLLBACK;
+        goto fdb_write_batch_end;
+    }
+
+    file = handle->file;
+    dhandle = handle->dhandle;
+
+    fMgrStatus = file->getFileStatus();
+    if (fMgrStatus == FILE_REMOVED_PENDING) {
+        // we must not write into this file
+        // file status was changed by other thread .. start over
+        file->mutexUnlock();
+        goto fdb_write_batch_start;
+    }
+
+    if (txn) {
+        txn_enabled = true;
+    }
+
+    gettimeofday(&tv, NULL);
+
+    {
+        // Assign sequence numbers to all the docs in the batch, and then
+        // update the KV store's (or file's) sequence number only once.
+        fdb_seqnum_t kv_seqnum, prev_seqnum;
+        if (sub_handle) {
+            kv_seqnum = fdb_kvs_get_seqnum(file, handle->kvs->getKvsId());
+        } else {
+            // super handle OR single KV instance mode
+            kv_seqnum = file->getSeqnum();
+        }
+        prev_seqnum = kv_seqnum;
+
+        for (i = 0; i < num_ops; ++i) {
+            FdbWriteBatch::Op &op = batch->getOp(i);
+            if (op.doc.seqnum != SEQNUM_NOT_USED &&
+                op.doc.flags & FDB_CUSTOM_SEQNUM) { // User specified own seqnum
+                if (kv_seqnum < op.doc.seqnum) { // track highest seqnum
+                    kv_seqnum = op.doc.seqnum;
+                }
+                // clear flag for fdb_doc reuse
+                op.user_doc->flags &= ~FDB_CUSTOM_SEQNUM;
+            } else { // normal monotonically increasing sequence numbers..
+                op.doc.seqnum = ++kv_seqnum;
+            }
+            _docs[i].seqnum = op.doc.seqnum;
+            _docs[i].timestamp = op.doc.deleted ? (timestamp_t)tv.tv_sec : 0;
+        }
+
+        if (kv_seqnum != prev_seqnum) {
+            handle->seqnum = kv_seqnum;
+            if (sub_handle) {
+                fdb_kvs_set_seqnum(file, handle->kvs->getKvsId(),
+                                   handle->seqnum);
+            } else {
+                file->setSeqnum(handle->seqnum);
+            }
+        }
+    }
+
+    // Append all the docs in a single run under the file mutex.
+    for (i = 0; i < num_ops; ++i) {
+        FdbWriteBatch::Op &op = batch->getOp(i);
+        uint64_t offset = dhandle->appendDoc_Docio(&_docs[i], op.doc.deleted,
+                                                   txn_enabled);
+        if (offset == BLK_NOT_FOUND) {
+            wr = FDB_RESULT_WRITE_FAIL;
+            break;
+        }
+        if (!txn_enabled) {
+            wr = _fdb_append_commit_log(file, &_docs[i], op.doc.deleted);
+            if (wr != FDB_RESULT_SUCCESS) {
+                break;
+            }
+        }
+
+        op.doc.size_ondisk = _fdb_get_docsize(_docs[i].length);
+        op.doc.offset = offset;
+        op.user_doc->seqnum = op.doc.seqnum;
+        op.user_doc->size_ondisk = op.doc.size_ondisk;
+        op.user_doc->offset = offset;
+
+        wal_docs[i] = op.doc;
+        wal_docs[i].key = _docs[i].key;
+        wal_docs[i].keylen = _docs[i].length.keylen;
+        reqs[i].doc = &wal_docs[i];
+        reqs[i].offset = offset;
+        // immediately remove from hbtrie upon WAL flush
+        reqs[i].immediate_remove = op.doc.deleted &&
+                                   !handle->config.purging_interval;
+        ++num_appended;
+    }
+
+    // Index the appended docs (even if the batch failed in the middle, the
+    // docs written so far are applied as individual fdb_set calls would be).
+    if (!txn) {
+        txn = file->getGlobalTxn();
+    }
+    file->getWal()->insertMulti_Wal(txn, &cmp_info, &reqs[0], num_appended);
+
+    if (num_appended) {
+        fdb_status fs = _fdb_wal_flush_on_threshold(handle, txn_enabled,
+                                                    &wal_flushed);
+        if (wr == FDB_RESULT_SUCCESS) {
+            wr = fs;
+        }
+    }
+
+    file->mutexUnlock();
+
+    for (i = 0; i < num_appended; ++i) {
+        if (batch->getOp(i).doc.deleted) {
+            handle->op_stats->num_dels++;
+        } else {
+            handle->op_stats->num_sets++;
+        }
+    }
+
+fdb_write_batch_end:
+    if (handle->kvs) {
+        for (i = 0; i < num_ops; ++i) {
+            free(_docs[i].key);
+        }
+    }
+
+    if (wr == FDB_RESULT_SUCCESS && wal_flushed && handle->config.auto_commit) {
+        END_HANDLE_BUSY(handle);
+        return commitWithKVHandle(handle->fhandle->getRootHandle(), FDB_COMMIT_NORMAL,
+                                  false); // asynchronous commit only
+    }
+    END_HANDLE_BUSY(handle);
+
+    return wr;
+}
+
 fdb_status FdbEngine::commit(FdbFileHandle *fhandle, fdb_commit_opt_t opt)
 {
     if (!fhandle) {
@@ -3912,6 +5231,28 @@ fdb_commit_start:
             return fs;
         }
     }
+
+    if (sync && !txn && !handle->rollback_revnum &&
+        !(opt & FDB_COMMIT_MANUAL_WAL_FLUSH) &&
+        handle->config.durability_opt == FDB_DRB_COMMIT_LOG &&
+        handle->file->getCommitLog() &&
+        handle->file->getCommitLogBytes() < handle->config.commit_log_size) {
+        // Commit log mode: all non-transactional updates so far are already
+        // in the commit log, so appending a commit marker and syncing the log
+        // makes them durable. WAL flushing and DB header commit are deferred
+        // until the log grows beyond 'commit_log_size'.
+        handle->file->getWal()->commit_Wal(handle->file->getGlobalTxn(), NULL,
+                                           &handle->log_callback);
+        fs = handle->file->getCommitLog()->commitLog(
+                                handle->file->getHeaderRevnum(), 0);
+        handle->file->mutexUnlock();
+
+        LATENCY_STAT_END(handle->file, FDB_LATENCY_COMMITS);
+        handle->op_stats->num_commits++;
+        END_HANDLE_BUSY(handle);
+        return fs;
+    }
+
     // commit wal
     if (txn) {
         // transactional updates
@@ -3977,6 +5318,7 @@ fdb_commit_start:
         // multi KV instance mode .. append up-to-date KV header
         handle->kv_info_offset = fdb_kvs_header_append(handle);
     }
+    fdb_bloom_filter_append(handle);
 
     filemgr_header_revnum_t next_revnum;
     next_revnum = handle->file->getHeaderRevnum() + 1;
@@ -4105,9 +5447,32 @@ fdb_commit_start:
     }
 
     // file commit
+    // In group commit mode, the header is written here but its fsync is
+    // deferred until the file lock is released, so that commits from other
+    // handles can proceed and share the same fsync.
+    bool group_sync = sync && handle->config.group_commit &&
+                      !handle->file->getCommitLog();
+    filemgr_header_revnum_t committed_revnum = 0;
     fs = handle->file->commitBid(handle->last_hdr_bid,
-                                 cur_bmp_revnum, sync,
+                                 cur_bmp_revnum, sync && !group_sync,
                                  &handle->log_callback);
+    if (group_sync) {
+        committed_revnum = handle->file->getHeaderRevnum();
+    }
+    if (fs == FDB_RESULT_SUCCESS && sync && handle->file->getCommitLog()) {
+        // Every update in the commit log is now reflected in the durable DB
+        // header, so log files older than the current one can be discarded.
+        // (Entries left in the current log file are skipped on replay as
+        //  their seqnums are not greater than the committed ones.)
+        uint64_t log_id = 0;
+        CommitLog *commit_log = handle->file->getCommitLog();
+        if (commit_log->commitLog(handle->file->getHeaderRevnum(), 0,
+                                  log_id) == FDB_RESULT_SUCCESS &&
+            log_id > 0) {
+            commit_log->destroyLogUpto(log_id - 1);
+        }
+        handle->file->resetCommitLogBytes();
+    }
     if (wal_flushed) {
         handle->file->getWal()->releaseFlushedItems_Wal(&flush_items);
     }
@@ -4119,6 +5484,11 @@ fdb_commit_start:
     handle->dirty_updates = 0;
     handle->file->mutexUnlock();
 
+    if (group_sync && fs == FDB_RESULT_SUCCESS) {
+        fs = handle->file->syncGroupCommit(committed_revnum,
+                                           &handle->log_callback);
+    }
+
     LATENCY_STAT_END(handle->file, FDB_LATENCY_COMMITS);
     handle->op_stats->num_commits++;
     END_HANDLE_BUSY(handle);
@@ -4259,6 +5629,11 @@ fdb_snapshot_open_start:
             !handle_in->shandle) {
             handle->max_seqnum = handle_in->seqnum;
 
+            if (config.background_wal_flush) {
+                // A background WAL flush must not release its items from the
+                // WAL between syncing the dirty root and copying the WAL.
+                file->mutexLockForAppend();
+            }
             if (!ver_btreev2_format(handle->file->getVersion())) {
                 // synchronize dirty root nodes if exist
                 bid_t dirty_idtree_root = BLK_NOT_FOUND;
@@ -4290,6 +5665,9 @@ fdb_snapshot_open_start:
             }
             (void)kv_id;
 #endif // _MVCC_WAL_ENABLE
+            if (config.background_wal_flush) {
+                file->mutexUnlock();
+            }
         } else if (clone_snapshot) {
             // Snapshot is created on the other snapshot handle
 
@@ -4734,6 +6112,24 @@ size_t FdbEngine::getBufferCacheUsed() {
     return (size_t) FileMgr::getBcacheUsedSpace();
 }
 
+fdb_status FdbEngine::setIoRateLimit(fdb_io_class io_class,
+                                     uint64_t bytes_per_sec) {
+    IoRateLimiter *limiter = IoRateLimiter::getInstance();
+    if (!limiter) {
+        return FDB_RESULT_ENGINE_NOT_INSTANTIATED;
+    }
+    return limiter->setRate(io_class, bytes_per_sec);
+}
+
+fdb_status FdbEngine::getIoRateStats(fdb_io_class io_class,
+                                     fdb_io_rate_stats *stats) {
+    IoRateLimiter *limiter = IoRateLimiter::getInstance();
+    if (!limiter) {
+        return FDB_RESULT_ENGINE_NOT_INSTANTIATED;
+    }
+    return limiter->getStats(io_class, stats);
+}
+
 size_t FdbEngine::estimateSpaceUsedInternal(FdbKvsHandle *handle)
 {
     size_t ret = 0;
@@ -4973,6 +6369,58 @@ fdb_status FdbEngine::getLatencyStats(FdbFileHandle *fhandle,
     return FDB_RESULT_SUCCESS;
 }
 
+fdb_status FdbEngine::getLatencyPercentiles(FdbFileHandle *fhandle,
+                                            fdb_latency_percentiles *stats,
+                                            fdb_latency_stat_type type)
+{
+    if (!fhandle || !fhandle->getRootHandle()) {
+        return FDB_RESULT_INVALID_HANDLE;
+    }
+
+    if (!stats || type >= FDB_LATENCY_NUM_STATS) {
+        return FDB_RESULT_INVALID_ARGS;
+    }
+
+    if (!fhandle->getRootHandle()->file) {
+        return FDB_RESULT_FILE_NOT_OPEN;
+    }
+
+    memset(stats, 0, sizeof(fdb_latency_percentiles));
+#ifdef _LATENCY_STATS
+    LatencyStats::getPercentiles(fhandle->getRootHandle()->file, type, stats);
+#endif // _LATENCY_STATS
+
+    return FDB_RESULT_SUCCESS;
+}
+
+fdb_status FdbEngine::getKvsLatencyPercentiles(FdbKvsHandle *handle,
+                                               fdb_latency_percentiles *stats,
+                                               fdb_latency_stat_type type)
+{
+    if (!handle) {
+        return FDB_RESULT_INVALID_HANDLE;
+    }
+
+    if (!stats || type >= FDB_LATENCY_NUM_STATS) {
+        return FDB_RESULT_INVALID_ARGS;
+    }
+
+    if (!handle->file) {
+        return FDB_RESULT_FILE_NOT_OPEN;
+    }
+
+    memset(stats, 0, sizeof(fdb_latency_percentiles));
+#ifdef _LATENCY_STATS
+    if (!BEGIN_HANDLE_BUSY(handle)) {
+        return FDB_RESULT_HANDLE_BUSY;
+    }
+    LatencyStats::getPercentiles(handle, type, stats);
+    END_HANDLE_BUSY(handle);
+#endif // _LATENCY_STATS
+
+    return FDB_RESULT_SUCCESS;
+}
+
 fdb_status FdbEngine::getLatencyHistogram(FdbFileHandle *fhandle,
                                           char **stats,
                                           size_t *stats_length,
@@ -4990,7 +6438,7 @@ fdb_status FdbEngine::getLatencyHistogram(FdbFileHandle *fhandle,
         return FDB_RESULT_FILE_NOT_OPEN;
     }
 
-#if defined(_LATENCY_STATS) && defined(_PLATFORM_LIB_AVAILABLE)
+#ifdef _LATENCY_STATS
     LatencyStats::getHistogram(fhandle->getRootHandle()->file, type,
                                stats, stats_length);
 #else
@@ -5536,10 +6984,46 @@ fdb_status FdbEngine::fetchHandleStats(fdb_kvs_handle *handle,
     stat_callback(handle, "Block_cache_num_victims",
                   handle->file->getBCacheVictims(),
                   ctx);
+    stat_callback(handle, "Block_cache_num_evictions",
+                  handle->file->getBCacheEvictions(),
+                  ctx);
     stat_callback(handle, "Block_cache_num_immutables",
                   handle->file->getBCacheImmutables(),
                   ctx);
 
+    bcache_compressed_stats cstats;
+    if (handle->file->getBCache() &&
+        BlockCacheManager::getInstance()->getCompressedStats(cstats)) {
+        // global across all the files
+        stat_callback(handle, "Block_cache_compressed_items",
+                      cstats.num_items, ctx);
+        stat_callback(handle, "Block_cache_compressed_raw_bytes",
+                      cstats.raw_bytes, ctx);
+        stat_callback(handle, "Block_cache_compressed_bytes",
+                      cstats.compressed_bytes, ctx);
+        stat_callback(handle, "Block_cache_compressed_hits",
+                      cstats.num_hits, ctx);
+        stat_callback(handle, "Block_cache_compressed_misses",
+                      cstats.num_misses, ctx);
+        stat_callback(handle, "Block_cache_compressed_promotions",
+                      cstats.num_promotions, ctx);
+        stat_callback(handle, "Block_cache_compressed_rejects",
+                      cstats.num_rejects, ctx);
+        stat_callback(handle, "Block_cache_decompression_ns",
+                      cstats.decompression_ns, ctx);
+    }
+
+    SecondaryCache *scache = SecondaryCache::getInstance();
+    if (scache) {
+        // global across all the files
+        stat_callback(handle, "Secondary_cache_hits",
+                      scache->getNumHits(), ctx);
+        stat_callback(handle, "Secondary_cache_misses",
+                      scache->getNumMisses(), ctx);
+        stat_callback(handle, "Secondary_cache_inserts",
+                      scache->getNumInserts(), ctx);
+    }
+
     return FDB_RESULT_SUCCESS;
 }
 
@@ -5654,6 +7138,12 @@ fdb_status WalFlushCallbacks::flushItem(void *dbhandle,
         _offset = _endian_encode(item->offset);
         DocMetaForIndex old_meta;
 
+        BloomFilter *bloom_filter = file->getBloomFilter();
+        if (bloom_filter) {
+            // should be added before the item is removed from WAL
+            bloom_filter->add(item->header->key, item->header->keylen);
+        }
+
         if (btreev2) {
             uint8_t meta_flag = (item->action == WAL_ACT_REMOVE)?
                                 FDB_DOC_META_DELETED : 0x0;
@@ -18,6 +18,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <algorithm>
 
 #include "hbtrie.h"
 #include "list.h"
@@ -132,7 +133,8 @@ HBTrie::HBTrie() :
     chunksize(0), valuelen(0), flag(0x0), leaf_height_limit(0), btree_nodesize(0),
     root_bid(0), rootAddr(), btreeblk_handle(NULL), fileHB(NULL), doc_handle(NULL),
     btree_kv_ops(NULL), btree_leaf_kv_ops(NULL), readkey(NULL), map(NULL),
-    last_map_chunk(NULL), getCmpFuncCB(nullptr)
+    last_map_chunk(NULL), getCmpFuncCB(nullptr), bulkLoadMemUsage(0),
+    bulkLoadMemLimit(0), bulkLoadMode(false)
 {
     aux = &cmp_args;
 }
@@ -168,6 +170,7 @@ HBTrie::~HBTrie()
     delete btree_kv_ops;
     delete btree_leaf_kv_ops;
     freeLastMapChunk();
+    clearBulkLoadKvs();
 }
 
 void HBTrie::initTrie(int _chunksize, int _valuelen, int _btree_nodesize,
@@ -194,6 +197,9 @@ void HBTrie::initTrie(int _chunksize, int _valuelen, int _btree_nodesize,
     leaf_height_limit = 0;
     map = NULL;
     getCmpFuncCB = nullptr;
+    bulkLoadMemUsage = 0;
+    bulkLoadMemLimit = 0;
+    bulkLoadMode = false;
 
     // assign key-value operations
     if (ver_btreev2_format(fileHB->getVersion())) {
@@ -2397,6 +2403,20 @@ hbtrie_result HBTrie::insert_vlen(void *rawkey,
         return HBTRIE_RESULT_FAIL;
     }
 
+    if (bulkLoadMode) {
+        // keep a copy of the entry, and load it later.
+        BtreeKvPair kv(malloc(rawkeylen), rawkeylen,
+                       malloc(value_len), value_len);
+        memcpy(kv.key, rawkey, rawkeylen);
+        memcpy(kv.value, value, value_len);
+        bulkLoadKvs.push_back(kv);
+        bulkLoadMemUsage += sizeof(kv) + rawkeylen + value_len;
+        if (bulkLoadMemUsage > bulkLoadMemLimit) {
+            return endBulkLoad();
+        }
+        return HBTRIE_RESULT_SUCCESS;
+    }
+
     if (rootAddr.isEmpty) {
         // create root b-tree
         BtreeV2 cur_btree;
@@ -2435,6 +2455,238 @@ hbtrie_result HBTrie::insertPartial(void *rawkey, int rawkeylen,
     return _insert(rawkey, rawkeylen, value, oldvalue_out, HBTRIE_PARTIAL_UPDATE);
 }
 
+hbtrie_result HBTrie::bulkLoad(std::vector<BtreeKvPair>& kv_list)
+{
+    // V2 format is a must for this API
+    if (!ver_btreev2_format(fileHB->getVersion())) {
+        return HBTRIE_RESULT_FAIL;
+    }
+    if (kv_list.empty()) {
+        return HBTRIE_RESULT_SUCCESS;
+    }
+
+    bool bulk_load = rootAddr.isEmpty;
+    if (bulk_load && getCmpFuncCB) {
+        // Keys in a custom cmp mode B+tree are not split into chunks,
+        // so that they should be inserted through the normal path.
+        for (auto &kv: kv_list) {
+            if (getCmpFuncForGivenKey(kv.key)) {
+                bulk_load = false;
+                break;
+            }
+        }
+    }
+
+    if (!bulk_load) {
+        hbtrie_result hr = HBTRIE_RESULT_SUCCESS;
+        for (auto &kv: kv_list) {
+            hr = insert_vlen(kv.key, kv.keylen, kv.value, kv.valuelen,
+                             nullptr, nullptr);
+            if (hr != HBTRIE_RESULT_SUCCESS) {
+                break;
+            }
+        }
+        return hr;
+    }
+
+    BtreeNodeAddr root_addr;
+    hbtrie_result hr = _bulkLoadV2(kv_list, 0, kv_list.size(), 0, 0,
+                                   root_addr);
+    if (hr == HBTRIE_RESULT_SUCCESS) {
+        rootAddr = root_addr;
+    }
+    return hr;
+}
+
+// Recursive function.
+hbtrie_result HBTrie::_bulkLoadV2(std::vector<BtreeKvPair>& kv_list,
+                                  size_t start_idx,
+                                  size_t end_idx,
+                                  size_t cur_chunk_no,
+                                  size_t prefix_pos,
+                                  BtreeNodeAddr& root_addr_out)
+{
+    // All keys in the given range share the same prefix up to the current
+    // chunk, and they are grouped as follows (same as _insertV2()):
+    //
+    // 1. a key exactly same as the prefix:
+    //    => stored in the meta section of the current B+tree.
+    // 2. a key whose current chunk is not shared by any other key:
+    //    => stored in the current B+tree using its rest suffix.
+    // 3. keys sharing the current chunk:
+    //    => stored in a child B+tree, whose chunk number is the first
+    //       chunk where they differ. The chunks between the current chunk
+    //       and that chunk are stored as a skipped prefix of the child tree.
+
+    uint8_t hv_buf[HV_BUF_MAX_SIZE];
+    size_t cur_chunk_pos = cur_chunk_no * chunksize;
+    size_t i = start_idx;
+    hbtrie_result hr;
+    BtreeV2Result br;
+
+    auto doc_value = [](BtreeKvPair& kv) {
+        if (kv.valuelen != sizeof(uint64_t)) {
+            // document meta
+            return HBTrieValue(HV_DOC | HV_VLEN_DATA, kv.value, kv.valuelen);
+        }
+        // document offset
+        return HBTrieValue(HV_DOC, kv.value);
+    };
+
+    // 1) meta section
+    HBTrieValue hv_meta;
+    void *meta_value = nullptr;
+    if (kv_list[i].keylen == cur_chunk_pos) {
+        hv_meta = doc_value(kv_list[i]);
+        meta_value = hv_meta.toBinary(hv_buf);
+        ++i;
+    }
+
+    metasize_t metasize;
+    MPWrapper meta_buffer;
+    meta_buffer.allocate();
+    storeMeta( metasize, cur_chunk_no, HBMETA_NORMAL,
+               static_cast<uint8_t*>(kv_list[start_idx].key) + prefix_pos,
+               cur_chunk_pos - prefix_pos,
+               meta_value, hv_meta.size(),
+               meta_buffer.getAddr() );
+
+    // 2) entries of the current B+tree
+    std::vector<BtreeKvPair> entries;
+    // binary HB+trie values of 'entries', and their positions.
+    std::vector<uint8_t> hv_data;
+    std::vector<size_t> hv_pos;
+
+    while (i < end_idx) {
+        BtreeKvPair& kv = kv_list[i];
+        uint8_t *chunk = static_cast<uint8_t*>(kv.key) + cur_chunk_pos;
+        size_t suffix_len = kv.keylen - cur_chunk_pos;
+
+        // find the range of keys sharing the current chunk.
+        size_t j = i + 1;
+        if (suffix_len >= chunksize) {
+            while (j < end_idx &&
+                   kv_list[j].keylen >= cur_chunk_pos + chunksize &&
+                   !memcmp(static_cast<uint8_t*>(kv_list[j].key) +
+                               cur_chunk_pos,
+                           chunk, chunksize)) {
+                ++j;
+            }
+        }
+
+        HBTrieValue hv;
+        if (j - i == 1) {
+            // document
+            hv = doc_value(kv);
+        } else {
+            // sub-tree
+            // Common prefix of the first and the last keys in a key order
+            // is shared by all the keys between them.
+            BtreeKvPair& last = kv_list[j-1];
+            size_t first_diff = cur_chunk_pos + chunksize;
+            size_t shorter_len = std::min(kv.keylen, last.keylen);
+            for (; first_diff < shorter_len; ++first_diff) {
+                if (*(static_cast<uint8_t*>(kv.key) + first_diff) !=
+                    *(static_cast<uint8_t*>(last.key) + first_diff)) {
+                    break;
+                }
+            }
+
+            BtreeNodeAddr child_root;
+            hr = _bulkLoadV2(kv_list, i, j, first_diff / chunksize,
+                             cur_chunk_pos + chunksize, child_root);
+            if (hr != HBTRIE_RESULT_SUCCESS) {
+                return hr;
+            }
+            hv = HBTrieValue(child_root);
+            suffix_len = chunksize;
+        }
+
+        hv_pos.push_back(hv_data.size());
+        hv.toBinary(hv_buf);
+        hv_data.insert(hv_data.end(), hv_buf, hv_buf + hv.size());
+        entries.push_back(BtreeKvPair(chunk, suffix_len, nullptr, hv.size()));
+        i = j;
+    }
+    for (i = 0; i < entries.size(); ++i) {
+        entries[i].value = hv_data.data() + hv_pos[i];
+    }
+
+    // 3) build the current B+tree
+    BtreeV2 cur_btree;
+    cur_btree.init();
+    cur_btree.setBMgr(bnodeMgr);
+    br = cur_btree.updateMeta(BtreeV2Meta(metasize, meta_buffer.getAddr()));
+    if (br == BtreeV2Result::SUCCESS) {
+        br = cur_btree.bulkLoad(entries);
+    }
+    if (br == BtreeV2Result::SUCCESS) {
+        root_addr_out = cur_btree.getRootAddr();
+    }
+    return convertBtreeResult(br);
+}
+
+void HBTrie::beginBulkLoad(size_t mem_limit)
+{
+    if (!ver_btreev2_format(fileHB->getVersion()) || !rootAddr.isEmpty) {
+        return;
+    }
+    bulkLoadMode = true;
+    bulkLoadMemUsage = 0;
+    bulkLoadMemLimit = mem_limit;
+}
+
+hbtrie_result HBTrie::endBulkLoad()
+{
+    if (!bulkLoadMode) {
+        return HBTRIE_RESULT_SUCCESS;
+    }
+    bulkLoadMode = false;
+
+    // sort entries in a key order.
+    // if the same key is inserted multiple times, the latest one is kept.
+    std::stable_sort(bulkLoadKvs.begin(), bulkLoadKvs.end(),
+                     [](const BtreeKvPair& a, const BtreeKvPair& b) {
+        int cmp = memcmp(a.key, b.key, std::min(a.keylen, b.keylen));
+        if (cmp == 0) {
+            return a.keylen < b.keylen;
+        }
+        return cmp < 0;
+    });
+
+    std::vector<BtreeKvPair> kv_list;
+    kv_list.reserve(bulkLoadKvs.size());
+    for (size_t i = 0; i < bulkLoadKvs.size(); ++i) {
+        if (i + 1 < bulkLoadKvs.size() &&
+            bulkLoadKvs[i].keylen == bulkLoadKvs[i+1].keylen &&
+            !memcmp(bulkLoadKvs[i].key, bulkLoadKvs[i+1].key,
+                    bulkLoadKvs[i].keylen)) {
+            continue;
+        }
+        kv_list.push_back(bulkLoadKvs[i]);
+    }
+
+    hbtrie_result hr = bulkLoad(kv_list);
+    clearBulkLoadKvs();
+    return hr;
+}
+
+void HBTrie::abortBulkLoad()
+{
+    clearBulkLoadKvs();
+}
+
+void HBTrie::clearBulkLoadKvs()
+{
+    for (auto &kv: bulkLoadKvs) {
+        free(kv.key);
+        free(kv.value);
+    }
+    bulkLoadKvs.clear();
+    bulkLoadMemUsage = 0;
+    bulkLoadMode = false;
+}
+
 size_t HBTrie::readKey(uint64_t offset, void *buf)
 {
     // TODO: support seq-iterator can be executed without reading doc block
@@ -512,6 +512,44 @@ public:
     hbtrie_result insertPartial(void *rawkey, int rawkeylen,
                                 void *value, void *oldvalue_out);
 
+    /**
+     * Build an empty HB+trie bottom-up from a set of key-value pairs, by
+     * bulk-loading every B+tree in the hierarchy (see BtreeV2::bulkLoad()).
+     * The length of each value is interpreted in the same way as
+     * insert_vlen().
+     * Note that all pairs MUST be sorted in a key order without duplicates.
+     * If the trie is not empty, or any key belongs to a KV store using
+     * a custom compare function, pairs are inserted one by one instead.
+     *
+     * @param kv_list List of key-value pairs to load.
+     * @return HBTRIE_RESULT_SUCCESS on success.
+     */
+    hbtrie_result bulkLoad(std::vector<BtreeKvPair>& kv_list);
+
+    /**
+     * Start buffering insertions into an empty HB+trie, so that they are
+     * bulk-loaded by endBulkLoad() all at once. Buffered entries are not
+     * visible to other operations until then, and their old values are not
+     * returned. If the trie is not empty, insertions are served as usual.
+     *
+     * @param mem_limit Memory limit of buffered entries. Once it is exceeded,
+     *        buffered entries are loaded immediately, and the following
+     *        insertions are served as usual.
+     */
+    void beginBulkLoad(size_t mem_limit);
+
+    /**
+     * Bulk-load all the entries buffered since beginBulkLoad().
+     *
+     * @return HBTRIE_RESULT_SUCCESS on success.
+     */
+    hbtrie_result endBulkLoad();
+
+    /**
+     * Discard all the entries buffered since beginBulkLoad().
+     */
+    void abortBulkLoad();
+
     /**
      * Recursively write all dirty nodes in the HB+trie.
      *
@@ -669,6 +707,18 @@ private:
      */
     HBTrieV2GetCmpFunc *getCmpFuncCB;
 
+    /**
+     * Copies of entries inserted since beginBulkLoad(),
+     * which are not reflected in the trie yet.
+     */
+    std::vector<BtreeKvPair> bulkLoadKvs;
+    // Memory consumed by 'bulkLoadKvs'.
+    size_t bulkLoadMemUsage;
+    // Memory limit of 'bulkLoadKvs'.
+    size_t bulkLoadMemLimit;
+    // Flag that indicates if insertions are buffered into 'bulkLoadKvs'.
+    bool bulkLoadMode;
+
 
     /**
      * Internal common HBTrie constructor initialization
@@ -907,6 +957,33 @@ private:
                                  HBTrieV2Rets& rets,
                                  uint8_t flag);
 
+    /**
+     * Internal recursive function for bulkLoad(), which builds a B+tree
+     * for the given range of key-value pairs sharing the same prefix, and
+     * its child B+trees.
+     *
+     * @param kv_list List of key-value pairs.
+     * @param start_idx First index of the range.
+     * @param end_idx Last index of the range + 1.
+     * @param cur_chunk_no Chunk number of the B+tree.
+     * @param prefix_pos Position of the prefix skipped by the B+tree,
+     *        which ends at the position of the current chunk.
+     * @param root_addr_out Root address of the B+tree to be returned.
+     * @return HBTRIE_RESULT_SUCCESS on success.
+     */
+    hbtrie_result _bulkLoadV2(std::vector<BtreeKvPair>& kv_list,
+                              size_t start_idx,
+                              size_t end_idx,
+                              size_t cur_chunk_no,
+                              size_t prefix_pos,
+                              BtreeNodeAddr& root_addr_out);
+
+    /**
+     * Free the entries buffered since beginBulkLoad(), and leave
+     * the bulk-load mode.
+     */
+    void clearBulkLoadKvs();
+
     inline void getLeafKey(void *key, void *str, size_t& len)
     {
         btree_leaf_kv_ops->getVarKey(key, str, len);
@@ -496,6 +496,7 @@ struct stale_regions {
 #define FDB_FLAG_SEQTREE_USE (0x1)
 #define FDB_FLAG_ROOT_INITIALIZED (0x2)
 #define FDB_FLAG_ROOT_CUSTOM_CMP (0x4)
+#define FDB_FLAG_BLOOM_FILTER (0x8)
 
 
 #define FDB_DOC_META_DELETED (0x1)
@@ -393,7 +393,7 @@ fdb_status FdbIterator::initIterator(FdbKvsHandle *handle,
 
     iterator->iterateToNext(); // position cursor at first key
 
-    LATENCY_STAT_END(iterator->getHandle()->file, FDB_LATENCY_ITR_INIT);
+    LATENCY_STAT_END_KVS(iterator->getHandle(), FDB_LATENCY_ITR_INIT);
 
     return FDB_RESULT_SUCCESS;
 }
@@ -458,7 +458,7 @@ fdb_status FdbIterator::initSeqIterator(FdbKvsHandle *handle,
 
     iterator->iterateToNext(); // position cursor at first key
 
-    LATENCY_STAT_END(iterator->getHandle()->file, FDB_LATENCY_ITR_SEQ_INIT);
+    LATENCY_STAT_END_KVS(iterator->getHandle(), FDB_LATENCY_ITR_SEQ_INIT);
 
     return FDB_RESULT_SUCCESS;
 }
@@ -938,7 +938,7 @@ fetch_hbtrie:
         ret = FDB_RESULT_SUCCESS;
     }
 
-    LATENCY_STAT_END(iterHandle->file, FDB_LATENCY_ITR_SEEK);
+    LATENCY_STAT_END_KVS(iterHandle, FDB_LATENCY_ITR_SEEK);
     return ret;
 }
 
@@ -981,7 +981,7 @@ fdb_status FdbIterator::seekToMin() {
     }
 
     ret = iterateToNext();
-    LATENCY_STAT_END(iterHandle->file, FDB_LATENCY_ITR_SEEK_MIN);
+    LATENCY_STAT_END_KVS(iterHandle, FDB_LATENCY_ITR_SEEK_MIN);
     return ret;
 }
 
@@ -995,7 +995,7 @@ fdb_status FdbIterator::seekToMax() {
         ret = seekToMaxKey();
     }
 
-    LATENCY_STAT_END(iterHandle->file, FDB_LATENCY_ITR_SEEK_MAX);
+    LATENCY_STAT_END_KVS(iterHandle, FDB_LATENCY_ITR_SEEK_MAX);
     return ret;
 }
 
@@ -1027,7 +1027,7 @@ fdb_status FdbIterator::iterateToPrev() {
 
     END_HANDLE_BUSY(iterHandle);
     iterHandle->op_stats->num_iterator_moves++;
-    LATENCY_STAT_END(iterHandle->file, FDB_LATENCY_ITR_PREV);
+    LATENCY_STAT_END_KVS(iterHandle, FDB_LATENCY_ITR_PREV);
     return result;
 }
 
@@ -1059,7 +1059,7 @@ fdb_status FdbIterator::iterateToNext() {
 
     END_HANDLE_BUSY(iterHandle);
     iterHandle->op_stats->num_iterator_moves++;
-    LATENCY_STAT_END(iterHandle->file, FDB_LATENCY_ITR_NEXT);
+    LATENCY_STAT_END_KVS(iterHandle, FDB_LATENCY_ITR_NEXT);
     return result;
 }
 
@@ -1156,9 +1156,9 @@ fdb_status FdbIterator::get(fdb_doc **doc, bool metaOnly) {
     END_HANDLE_BUSY(iterHandle);
     iterHandle->op_stats->num_iterator_gets++;
     if (metaOnly) {
-        LATENCY_STAT_END(iterHandle->file, FDB_LATENCY_ITR_GET_META);
+        LATENCY_STAT_END_KVS(iterHandle, FDB_LATENCY_ITR_GET_META);
     } else {
-        LATENCY_STAT_END(iterHandle->file, FDB_LATENCY_ITR_GET);
+        LATENCY_STAT_END_KVS(iterHandle, FDB_LATENCY_ITR_GET);
     }
 
     return ret;
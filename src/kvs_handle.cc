@@ -29,8 +29,8 @@
 extern int _kvs_cmp_name(struct avl_node *a, struct avl_node *b, void *aux);
 
 FdbKvsHandle::FdbKvsHandle() :
-    kvs(NULL), op_stats(NULL), fhandle(NULL), trie(NULL), staletree(NULL),
-    seqtree(NULL), file(NULL), dhandle(NULL), bhandle(NULL),
+    kvs(NULL), op_stats(NULL), lat_stats_file(NULL), fhandle(NULL),
+    trie(NULL), staletree(NULL), seqtree(NULL), file(NULL), dhandle(NULL), bhandle(NULL),
     fileops(NULL), log_callback(), cur_header_revnum(0), rollback_revnum(0),
     last_hdr_bid(0), last_wal_flush_hdr_bid(0), kv_info_offset(0), shandle(NULL),
     seqnum(0), max_seqnum(0), txn(NULL), dirty_updates(0),
@@ -133,6 +133,8 @@ void FdbKvsHandle::copyFromOtherHandle(const FdbKvsHandle& kv_handle) {
     }
 
     op_stats = kv_handle.op_stats;
+    lat_stats = kv_handle.lat_stats;
+    lat_stats_file = kv_handle.lat_stats_file;
     fhandle = kv_handle.fhandle;
 
     trie = kv_handle.trie;
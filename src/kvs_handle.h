@@ -17,6 +17,7 @@
 
 #pragma once
 
+#include <memory>
 #include <string>
 
 #include "arch.h"
@@ -27,6 +28,7 @@ class BTreeBlkHandle;
 class BnodeMgr;
 class BTree;
 class BtreeV2;
+struct kvs_latency_stats;
 // Windows MSVC has a buggy standard library for std::atomic<const char *>
 // Any attempts to set a const char * using atomic::store()
 // method fails since atomic::store() is defined as
@@ -130,6 +132,13 @@ public:
      * Operational statistics for this kv store.
      */
     KvsOpsStat *op_stats;
+    /**
+     * Latency histograms of this kv store, and the file that they were
+     * looked up from (resolved on first use, and again once the handle
+     * moves to another file).
+     */
+    std::shared_ptr<kvs_latency_stats> lat_stats;
+    FileMgr *lat_stats_file;
     /**
      * Pointer to the corresponding file handle.
      */
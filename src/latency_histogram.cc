@@ -0,0 +1,258 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2016 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <string.h>
+
+#include <sstream>
+
+#include "latency_histogram.h"
+
+#include "memleak.h"
+
+static std::atomic<size_t> lat_hist_next_slot(0);
+
+// Shard slot of the calling thread, assigned round robin on first use.
+static size_t _lat_hist_thread_slot()
+{
+    static thread_local size_t slot =
+        lat_hist_next_slot.fetch_add(1, std::memory_order_relaxed) %
+        LatencyHistogram::LAT_HIST_SHARDS;
+    return slot;
+}
+
+// Position of the most significant bit set in val (val > 0).
+static int _lat_hist_msb(uint64_t val)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return 63 - __builtin_clzll(val);
+#else
+    int msb = 0;
+    while (val >>= 1) {
+        ++msb;
+    }
+    return msb;
+#endif
+}
+
+static void _lat_hist_atomic_min(std::atomic<uint64_t>& target, uint64_t val)
+{
+    uint64_t cur = target.load(std::memory_order_relaxed);
+    while (val < cur &&
+           !target.compare_exchange_weak(cur, val, std::memory_order_relaxed)) {
+    }
+}
+
+static void _lat_hist_atomic_max(std::atomic<uint64_t>& target, uint64_t val)
+{
+    uint64_t cur = target.load(std::memory_order_relaxed);
+    while (cur < val &&
+           !target.compare_exchange_weak(cur, val, std::memory_order_relaxed)) {
+    }
+}
+
+LatencyHistogram::Shard::Shard() :
+    count(0), sum(0), min(static_cast<uint64_t>(-1)), max(0)
+{
+    for (size_t i = 0; i < LAT_HIST_NUM_BUCKETS; ++i) {
+        buckets[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+LatencyHistogram::LatencyHistogram()
+{
+    for (size_t i = 0; i < LAT_HIST_SHARDS; ++i) {
+        shards[i].store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+LatencyHistogram::~LatencyHistogram()
+{
+    for (size_t i = 0; i < LAT_HIST_SHARDS; ++i) {
+        delete shards[i].load(std::memory_order_relaxed);
+    }
+}
+
+LatencyHistogram::Shard *LatencyHistogram::getShard(size_t slot)
+{
+    Shard *shard = shards[slot].load(std::memory_order_acquire);
+    if (!shard) {
+        Shard *new_shard = new Shard();
+        if (shards[slot].compare_exchange_strong(shard, new_shard,
+                                                 std::memory_order_acq_rel)) {
+            shard = new_shard;
+        } else {
+            // another thread sharing the same slot installed it first
+            delete new_shard;
+        }
+    }
+    return shard;
+}
+
+size_t LatencyHistogram::getBucketIndex(uint64_t val)
+{
+    if (val < LAT_HIST_SUB_BUCKETS) {
+        return val;
+    }
+    int msb = _lat_hist_msb(val);
+    if (msb >= LAT_HIST_MAX_BITS) {
+        return LAT_HIST_NUM_BUCKETS - 1;
+    }
+    size_t sub = (val >> (msb - LAT_HIST_SUB_BITS)) &
+                 (LAT_HIST_SUB_BUCKETS - 1);
+    return (msb - LAT_HIST_SUB_BITS + 1) * LAT_HIST_SUB_BUCKETS + sub;
+}
+
+uint64_t LatencyHistogram::getBucketStart(size_t idx)
+{
+    if (idx < LAT_HIST_SUB_BUCKETS) {
+        return idx;
+    }
+    int shift = idx / LAT_HIST_SUB_BUCKETS - 1;
+    uint64_t sub = idx % LAT_HIST_SUB_BUCKETS;
+    return (LAT_HIST_SUB_BUCKETS + sub) << shift;
+}
+
+uint64_t LatencyHistogram::getBucketEnd(size_t idx)
+{
+    if (idx < LAT_HIST_SUB_BUCKETS) {
+        return idx + 1;
+    }
+    int shift = idx / LAT_HIST_SUB_BUCKETS - 1;
+    return getBucketStart(idx) + (static_cast<uint64_t>(1) << shift);
+}
+
+void LatencyHistogram::add(uint64_t val)
+{
+    Shard *shard = getShard(_lat_hist_thread_slot());
+    shard->buckets[getBucketIndex(val)].fetch_add(1, std::memory_order_relaxed);
+    shard->sum.fetch_add(val, std::memory_order_relaxed);
+    _lat_hist_atomic_min(shard->min, val);
+    _lat_hist_atomic_max(shard->max, val);
+    // count is bumped last so that a reader never sees more samples
+    // than the buckets hold
+    shard->count.fetch_add(1, std::memory_order_release);
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other)
+{
+    for (size_t i = 0; i < LAT_HIST_SHARDS; ++i) {
+        Shard *src = other.shards[i].load(std::memory_order_acquire);
+        if (!src || !src->count.load(std::memory_order_acquire)) {
+            continue;
+        }
+        Shard *dst = getShard(i);
+        for (size_t b = 0; b < LAT_HIST_NUM_BUCKETS; ++b) {
+            uint64_t n = src->buckets[b].load(std::memory_order_relaxed);
+            if (n) {
+                dst->buckets[b].fetch_add(n, std::memory_order_relaxed);
+            }
+        }
+        dst->sum.fetch_add(src->sum.load(std::memory_order_relaxed),
+                           std::memory_order_relaxed);
+        _lat_hist_atomic_min(dst->min, src->min.load(std::memory_order_relaxed));
+        _lat_hist_atomic_max(dst->max, src->max.load(std::memory_order_relaxed));
+        dst->count.fetch_add(src->count.load(std::memory_order_relaxed),
+                             std::memory_order_release);
+    }
+}
+
+void LatencyHistogram::getSnapshot(LatencySnapshot& snap) const
+{
+    memset(&snap, 0, sizeof(LatencySnapshot));
+    snap.min = static_cast<uint64_t>(-1);
+    for (size_t i = 0; i < LAT_HIST_SHARDS; ++i) {
+        Shard *shard = shards[i].load(std::memory_order_acquire);
+        if (!shard) {
+            continue;
+        }
+        uint64_t count = shard->count.load(std::memory_order_acquire);
+        if (!count) {
+            continue;
+        }
+        uint64_t in_buckets = 0;
+        for (size_t b = 0; b < LAT_HIST_NUM_BUCKETS; ++b) {
+            uint64_t n = shard->buckets[b].load(std::memory_order_relaxed);
+            snap.buckets[b] += n;
+            in_buckets += n;
+        }
+        // Samples being recorded concurrently may already be in a bucket
+        // without being counted yet; keep count consistent with the buckets.
+        snap.count += in_buckets;
+        snap.sum += shard->sum.load(std::memory_order_relaxed);
+        uint64_t min = shard->min.load(std::memory_order_relaxed);
+        uint64_t max = shard->max.load(std::memory_order_relaxed);
+        if (min < snap.min) {
+            snap.min = min;
+        }
+        if (max > snap.max) {
+            snap.max = max;
+        }
+    }
+    if (!snap.count) {
+        snap.min = 0;
+    }
+}
+
+LatencySnapshot::LatencySnapshot() :
+    count(0), sum(0), min(0), max(0)
+{
+    memset(buckets, 0, sizeof(buckets));
+}
+
+uint64_t LatencySnapshot::getPercentile(double pct) const
+{
+    if (!count) {
+        return 0;
+    }
+    uint64_t rank = static_cast<uint64_t>(pct / 100.0 * count + 0.5);
+    if (rank < 1) {
+        rank = 1;
+    } else if (rank > count) {
+        rank = count;
+    }
+    uint64_t seen = 0;
+    for (size_t b = 0; b < LatencyHistogram::LAT_HIST_NUM_BUCKETS; ++b) {
+        seen += buckets[b];
+        if (seen >= rank) {
+            uint64_t val = LatencyHistogram::getBucketEnd(b) - 1;
+            return val < max ? val : max;
+        }
+    }
+    return max;
+}
+
+std::string LatencySnapshot::toString() const
+{
+    std::stringstream ss;
+    ss << "{count : " << count << "; ";
+    if (count) {
+        ss << "p50 : " << getPercentile(50.0) << "µs; ";
+        ss << "p90 : " << getPercentile(90.0) << "µs; ";
+        ss << "p99 : " << getPercentile(99.0) << "µs; ";
+        ss << "p99.9 : " << getPercentile(99.9) << "µs; ";
+        ss << "max : " << max << "µs; ";
+        for (size_t b = 0; b < LatencyHistogram::LAT_HIST_NUM_BUCKETS; ++b) {
+            if (buckets[b]) {
+                ss << "(" << LatencyHistogram::getBucketStart(b) << "µs - "
+                   << LatencyHistogram::getBucketEnd(b) << "µs) : "
+                   << buckets[b] << "; ";
+            }
+        }
+    }
+    ss << "}";
+    return ss.str();
+}
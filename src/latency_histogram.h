@@ -0,0 +1,139 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2016 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <string>
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Point-in-time copy of a LatencyHistogram, with all the per-thread shards
+ * merged together.
+ */
+struct LatencySnapshot;
+
+/**
+ * Log-linear histogram of latencies in microseconds.
+ *
+ * Every power of two range is split into 2^LAT_HIST_SUB_BITS linear
+ * sub-buckets, so that any recorded value is reported within 1/16 of its
+ * magnitude (values below 16us are exact) using a fixed number of buckets.
+ * Values of 2^32us or more fall into the last bucket; the exact maximum is
+ * tracked separately.
+ *
+ * Writers never take a lock: each thread is mapped to one of LAT_HIST_SHARDS
+ * shards, which is allocated on its first use, and only updates the relaxed
+ * atomic counters of its own shard. Readers merge all the shards.
+ */
+class LatencyHistogram {
+public:
+    static const int LAT_HIST_SUB_BITS = 4;
+    static const size_t LAT_HIST_SUB_BUCKETS = 1 << LAT_HIST_SUB_BITS;
+    static const int LAT_HIST_MAX_BITS = 32;
+    static const size_t LAT_HIST_NUM_BUCKETS =
+        LAT_HIST_SUB_BUCKETS * (LAT_HIST_MAX_BITS - LAT_HIST_SUB_BITS + 1);
+    static const size_t LAT_HIST_SHARDS = 16;
+
+    LatencyHistogram();
+
+    ~LatencyHistogram();
+
+    /**
+     * Record a latency value.
+     *
+     * @param val Latency in microseconds
+     */
+    void add(uint64_t val);
+
+    /**
+     * Add all the values recorded in another histogram to this one.
+     *
+     * @param other Histogram to be merged into this one
+     */
+    void merge(const LatencyHistogram& other);
+
+    /**
+     * Merge all the shards into a snapshot.
+     *
+     * @param snap Snapshot to be populated
+     */
+    void getSnapshot(LatencySnapshot& snap) const;
+
+    /**
+     * Return the index of the bucket that a given value belongs to.
+     */
+    static size_t getBucketIndex(uint64_t val);
+
+    /**
+     * Return the smallest value that belongs to a given bucket.
+     */
+    static uint64_t getBucketStart(size_t idx);
+
+    /**
+     * Return the smallest value that belongs to the next bucket.
+     */
+    static uint64_t getBucketEnd(size_t idx);
+
+private:
+    struct Shard {
+        Shard();
+
+        std::atomic<uint64_t> count;
+        std::atomic<uint64_t> sum;
+        std::atomic<uint64_t> min;
+        std::atomic<uint64_t> max;
+        std::atomic<uint64_t> buckets[LAT_HIST_NUM_BUCKETS];
+    };
+
+    Shard *getShard(size_t slot);
+
+    // Disallow copy: shards are owned by the histogram.
+    LatencyHistogram(const LatencyHistogram&) = delete;
+    LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+    std::atomic<Shard *> shards[LAT_HIST_SHARDS];
+};
+
+struct LatencySnapshot {
+    LatencySnapshot();
+
+    /**
+     * Return the smallest recorded value such that at least pct percent of
+     * the recorded values are less than or equal to it. As values are kept
+     * in buckets, this is the highest value of the bucket that contains it
+     * (but never more than the maximum recorded value).
+     *
+     * @param pct Percentile in the range of (0, 100]
+     */
+    uint64_t getPercentile(double pct) const;
+
+    /**
+     * Return the text representation of the histogram:
+     * {count : N; p50 : Xµs; ...; max : Xµs; (Xµs - Yµs) : N; ...}
+     * where only non-empty buckets are listed.
+     */
+    std::string toString() const;
+
+    uint64_t count;
+    uint64_t sum;
+    uint64_t min;
+    uint64_t max;
+    uint64_t buckets[LatencyHistogram::LAT_HIST_NUM_BUCKETS];
+};
@@ -0,0 +1,188 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2016 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "common.h"
+#include "rate_limiter.h"
+#include "time_utils.h"
+
+#include "memleak.h"
+
+std::atomic<IoRateLimiter *> IoRateLimiter::instance(nullptr);
+std::mutex IoRateLimiter::instanceMutex;
+
+static thread_local bool io_background_thread = false;
+
+static uint64_t _io_now_us()
+{
+    return get_monotonic_ts() / 1000;
+}
+
+IoTokenBucket::IoTokenBucket()
+    : rate(0), tokens(0), lastRefillUs(0), bytesRequested(0),
+      bytesThrottled(0), numThrottled(0), waitTimeUs(0) { }
+
+IoRateLimiter::BackgroundScope::BackgroundScope()
+{
+    prevState = io_background_thread;
+    io_background_thread = true;
+}
+
+IoRateLimiter::BackgroundScope::~BackgroundScope()
+{
+    io_background_thread = prevState;
+}
+
+IoRateLimiter::IoRateLimiter(const fdb_config &config) : fgWaiters(0)
+{
+    setRate(FDB_IO_FG_READ, config.fg_read_rate_limit);
+    setRate(FDB_IO_FG_COMMIT, config.fg_commit_rate_limit);
+    setRate(FDB_IO_BG_WRITE, config.bg_write_rate_limit);
+}
+
+IoRateLimiter *IoRateLimiter::init(const fdb_config &config)
+{
+    IoRateLimiter *tmp = instance.load();
+    if (tmp == nullptr) {
+        std::lock_guard<std::mutex> lock(instanceMutex);
+        tmp = instance.load();
+        if (tmp == nullptr) {
+            tmp = new IoRateLimiter(config);
+            instance.store(tmp);
+        }
+    }
+    return tmp;
+}
+
+IoRateLimiter *IoRateLimiter::getInstance()
+{
+    return instance.load();
+}
+
+void IoRateLimiter::destroyInstance()
+{
+    std::lock_guard<std::mutex> lock(instanceMutex);
+    IoRateLimiter *tmp = instance.load();
+    if (tmp != nullptr) {
+        delete tmp;
+        instance = nullptr;
+    }
+}
+
+bool IoRateLimiter::isBackgroundThread()
+{
+    return io_background_thread;
+}
+
+uint64_t IoRateLimiter::request(fdb_io_class io_class, uint64_t nbytes)
+{
+    IoRateLimiter *tmp = instance.load();
+    if (tmp == nullptr || nbytes == 0 || io_class >= FDB_IO_NUM_CLASSES) {
+        return 0;
+    }
+    return tmp->throttle(io_class, nbytes);
+}
+
+uint64_t IoRateLimiter::requestWrite(uint64_t nbytes)
+{
+    return request(io_background_thread ? FDB_IO_BG_WRITE : FDB_IO_FG_COMMIT,
+                   nbytes);
+}
+
+uint64_t IoRateLimiter::throttle(fdb_io_class io_class, uint64_t nbytes)
+{
+    IoTokenBucket &bucket = buckets[io_class];
+    bool foreground = (io_class != FDB_IO_BG_WRITE);
+    uint64_t wait_us = 0;
+
+    bucket.bytesRequested.fetch_add(nbytes, std::memory_order_relaxed);
+
+    uint64_t rate = bucket.rate.load(std::memory_order_relaxed);
+    if (rate) {
+        std::lock_guard<std::mutex> lock(bucket.lock);
+        // Refill the bucket, but never beyond its burst size.
+        uint64_t now = _io_now_us();
+        double burst = (double)rate * IO_RATE_LIMITER_BURST_US / 1000000;
+        bucket.tokens += (double)(now - bucket.lastRefillUs) * rate / 1000000;
+        if (bucket.tokens > burst) {
+            bucket.tokens = burst;
+        }
+        bucket.lastRefillUs = now;
+
+        bucket.tokens -= nbytes;
+        if (bucket.tokens < 0) {
+            wait_us = (uint64_t)(-bucket.tokens * 1000000 / rate);
+        }
+    }
+
+    if (wait_us) {
+        if (foreground) {
+            fgWaiters++;
+        }
+        usleep(wait_us);
+        if (foreground) {
+            fgWaiters--;
+        }
+    }
+
+    if (!foreground) {
+        // Give way to the foreground requests that are being throttled.
+        uint64_t yielded = 0;
+        while (fgWaiters.load() && yielded < IO_RATE_LIMITER_MAX_YIELD_US) {
+            usleep(IO_RATE_LIMITER_YIELD_SLICE_US);
+            yielded += IO_RATE_LIMITER_YIELD_SLICE_US;
+        }
+        wait_us += yielded;
+    }
+
+    if (wait_us) {
+        bucket.bytesThrottled.fetch_add(nbytes, std::memory_order_relaxed);
+        bucket.numThrottled.fetch_add(1, std::memory_order_relaxed);
+        bucket.waitTimeUs.fetch_add(wait_us, std::memory_order_relaxed);
+    }
+    return wait_us;
+}
+
+fdb_status IoRateLimiter::setRate(fdb_io_class io_class,
+                                  uint64_t bytes_per_sec)
+{
+    if (io_class >= FDB_IO_NUM_CLASSES) {
+        return FDB_RESULT_INVALID_ARGS;
+    }
+    IoTokenBucket &bucket = buckets[io_class];
+    std::lock_guard<std::mutex> lock(bucket.lock);
+    // Start over with an empty bucket so that a new limit neither inherits
+    // the debt nor the savings accumulated under the old one.
+    bucket.tokens = 0;
+    bucket.lastRefillUs = _io_now_us();
+    bucket.rate = bytes_per_sec;
+    return FDB_RESULT_SUCCESS;
+}
+
+fdb_status IoRateLimiter::getStats(fdb_io_class io_class,
+                                   fdb_io_rate_stats *stats)
+{
+    if (io_class >= FDB_IO_NUM_CLASSES || !stats) {
+        return FDB_RESULT_INVALID_ARGS;
+    }
+    IoTokenBucket &bucket = buckets[io_class];
+    stats->rate_limit = bucket.rate.load();
+    stats->bytes_requested = bucket.bytesRequested.load();
+    stats->bytes_throttled = bucket.bytesThrottled.load();
+    stats->num_throttled = bucket.numThrottled.load();
+    stats->wait_time_us = bucket.waitTimeUs.load();
+    return FDB_RESULT_SUCCESS;
+}
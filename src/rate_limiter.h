@@ -0,0 +1,143 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2016 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <mutex>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "libforestdb/fdb_types.h"
+
+// Maximum amount of unused budget that a bucket can accumulate while idle.
+#define IO_RATE_LIMITER_BURST_US (100000)
+// Upper bound on the extra time a background request yields to waiting
+// foreground requests, so that background work is never starved.
+#define IO_RATE_LIMITER_MAX_YIELD_US (100000)
+#define IO_RATE_LIMITER_YIELD_SLICE_US (1000)
+
+/**
+ * Token bucket that paces the I/O of one class of requests.
+ *
+ * A request reserves its bytes from the bucket right away, which may leave the
+ * bucket in debt; the caller then sleeps until the debt would have been paid
+ * off at the configured rate. Requests therefore never wait for each other
+ * inside the limiter, and the average throughput converges on the rate.
+ */
+struct IoTokenBucket {
+    IoTokenBucket();
+
+    std::mutex lock;
+    std::atomic<uint64_t> rate; // bytes per second, 0 if unlimited
+    double tokens;              // available bytes (negative if in debt)
+    uint64_t lastRefillUs;
+
+    std::atomic<uint64_t> bytesRequested;
+    std::atomic<uint64_t> bytesThrottled;
+    std::atomic<uint64_t> numThrottled;
+    std::atomic<uint64_t> waitTimeUs;
+};
+
+/**
+ * Process-wide I/O rate limiter shared by the foreground operations and the
+ * background tasks (compaction, background flushing).
+ *
+ * Each fdb_io_class has its own budget. Background requests additionally
+ * yield to foreground requests that are being throttled at the same time.
+ * Threads that run background tasks mark themselves with a BackgroundScope,
+ * so that the I/O they issue through the shared code paths is not charged to
+ * the foreground classes.
+ */
+class IoRateLimiter {
+public:
+    /**
+     * Marks the calling thread as running a background task for the lifetime
+     * of the instance.
+     */
+    class BackgroundScope {
+    public:
+        BackgroundScope();
+        ~BackgroundScope();
+    private:
+        bool prevState;
+    };
+
+    /**
+     * Create the global instance with the rate limits in a given config.
+     *
+     * @param config ForestDB global config
+     * @return Pointer to the global instance
+     */
+    static IoRateLimiter *init(const fdb_config &config);
+
+    static IoRateLimiter *getInstance();
+
+    static void destroyInstance();
+
+    /**
+     * Charge a request to the budget of a given class and sleep as long as
+     * the budget requires. Nothing happens if the limiter is not initialized.
+     *
+     * @param io_class Class of the request
+     * @param nbytes Number of bytes read or written by the request
+     * @return Time spent waiting in microseconds
+     */
+    static uint64_t request(fdb_io_class io_class, uint64_t nbytes);
+
+    /**
+     * Charge a write to the class of the calling thread: FDB_IO_BG_WRITE on
+     * background threads and FDB_IO_FG_COMMIT otherwise.
+     */
+    static uint64_t requestWrite(uint64_t nbytes);
+
+    /**
+     * Return true if the calling thread is inside a BackgroundScope.
+     */
+    static bool isBackgroundThread();
+
+    /**
+     * Change the rate limit of a class. Takes effect for the next request.
+     *
+     * @param io_class Class whose limit is changed
+     * @param bytes_per_sec New limit in bytes per second, 0 for unlimited
+     * @return FDB_RESULT_SUCCESS on success
+     */
+    fdb_status setRate(fdb_io_class io_class, uint64_t bytes_per_sec);
+
+    /**
+     * Retrieve the current limit and the throttling statistics of a class.
+     *
+     * @param io_class Class whose stats are retrieved
+     * @param stats Pointer to the stats to be populated
+     * @return FDB_RESULT_SUCCESS on success
+     */
+    fdb_status getStats(fdb_io_class io_class, fdb_io_rate_stats *stats);
+
+private:
+    IoRateLimiter(const fdb_config &config);
+
+    uint64_t throttle(fdb_io_class io_class, uint64_t nbytes);
+
+    IoTokenBucket buckets[FDB_IO_NUM_CLASSES];
+    // Number of foreground requests currently sleeping in the limiter.
+    std::atomic<uint64_t> fgWaiters;
+
+    static std::atomic<IoRateLimiter *> instance;
+    static std::mutex instanceMutex;
+};
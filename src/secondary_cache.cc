@@ -0,0 +1,216 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2016 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+
+#include "checksum.h"
+#include "common.h"
+#include "fdb_internal.h"
+#include "filemgr.h"
+#include "filemgr_ops.h"
+#include "secondary_cache.h"
+
+#include "memleak.h"
+
+std::atomic<SecondaryCache *> SecondaryCache::instance(nullptr);
+std::mutex SecondaryCache::instanceMutex;
+std::atomic<uint64_t> SecondaryCache::lastFileId(0);
+
+SecondaryCache::SecondaryCache(const std::string &_path,
+                               struct filemgr_ops *_ops,
+                               fdb_fileops_handle _fops_handle,
+                               size_t slot_size,
+                               size_t num_slots)
+    : path(_path), ops(_ops), fopsHandle(_fops_handle), slotSize(slot_size),
+      slots(num_slots), cursor(0), numHits(0), numMisses(0), numInserts(0)
+{ }
+
+SecondaryCache::~SecondaryCache()
+{
+    FileMgr::fileClose(ops, fopsHandle);
+    remove(path.c_str());
+}
+
+SecondaryCache *SecondaryCache::init(const fdb_config &config)
+{
+    SecondaryCache *tmp = instance.load();
+    if (tmp == nullptr && config.secondary_cache_path &&
+        config.secondary_cache_size >= config.blocksize) {
+        std::lock_guard<std::mutex> lock(instanceMutex);
+        tmp = instance.load();
+        if (tmp == nullptr) {
+            // The content of the cache does not survive a restart.
+            struct filemgr_ops *ops = get_filemgr_ops();
+            fdb_fileops_handle fops_handle;
+            fdb_status status = FileMgr::fileOpen(
+                                    config.secondary_cache_path, ops,
+                                    &fops_handle, O_RDWR | O_CREAT | O_TRUNC,
+                                    0666);
+            if (status != FDB_RESULT_SUCCESS) {
+                fdb_log(NULL, status,
+                        "Failed to create the secondary cache file '%s'; "
+                        "the secondary cache is disabled.",
+                        config.secondary_cache_path);
+                return nullptr;
+            }
+            tmp = new SecondaryCache(config.secondary_cache_path, ops,
+                                     fops_handle, config.blocksize,
+                                     config.secondary_cache_size /
+                                     config.blocksize);
+            instance.store(tmp);
+        }
+    }
+    return tmp;
+}
+
+SecondaryCache *SecondaryCache::getInstance()
+{
+    return instance.load(std::memory_order_relaxed);
+}
+
+void SecondaryCache::destroyInstance()
+{
+    std::lock_guard<std::mutex> lock(instanceMutex);
+    SecondaryCache *tmp = instance.load();
+    if (tmp != nullptr) {
+        delete tmp;
+        instance = nullptr;
+    }
+}
+
+uint64_t SecondaryCache::newFileId()
+{
+    return ++lastFileId;
+}
+
+void SecondaryCache::unmapSlot(size_t idx)
+{
+    Slot &slot = slots[idx];
+    if (slot.mapped) {
+        index.erase(slot.key);
+        slot.mapped = false;
+    }
+    slot.valid = false;
+    slot.gen++;
+}
+
+void SecondaryCache::insert(uint64_t file_id, uint64_t pos,
+                            const void *buf, size_t len)
+{
+    if (len > slotSize || len == 0) {
+        return;
+    }
+
+    scache_key_t key(file_id, pos);
+    uint32_t crc = get_checksum(reinterpret_cast<const uint8_t *>(buf), len);
+    size_t idx;
+    uint64_t gen;
+    {
+        std::lock_guard<std::mutex> lh(lock);
+        auto entry = index.find(key);
+        if (entry != index.end()) {
+            // drop the previous copy of the data
+            unmapSlot(entry->second);
+        }
+        idx = cursor;
+        cursor = (cursor + 1) % slots.size();
+        unmapSlot(idx);
+
+        // Map the slot right away, so that an invalidation of the entry
+        // while it is being written is not missed.
+        Slot &slot = slots[idx];
+        slot.key = key;
+        slot.len = len;
+        slot.crc = crc;
+        slot.mapped = true;
+        gen = slot.gen;
+        index[key] = idx;
+    }
+
+    ssize_t r = ops->pwrite(fopsHandle, const_cast<void *>(buf), len,
+                            static_cast<cs_off_t>(idx) * slotSize);
+
+    std::lock_guard<std::mutex> lh(lock);
+    Slot &slot = slots[idx];
+    if (slot.gen != gen) {
+        // reassigned or invalidated in the meantime
+        return;
+    }
+    if (r != static_cast<ssize_t>(len)) {
+        unmapSlot(idx);
+        return;
+    }
+    slot.valid = true;
+    numInserts++;
+}
+
+size_t SecondaryCache::read(uint64_t file_id, uint64_t pos,
+                            void *buf, size_t buf_size)
+{
+    size_t idx;
+    uint64_t gen;
+    uint32_t len, crc;
+    {
+        std::lock_guard<std::mutex> lh(lock);
+        auto entry = index.find(scache_key_t(file_id, pos));
+        if (entry == index.end() || !slots[entry->second].valid ||
+            slots[entry->second].len > buf_size) {
+            numMisses++;
+            return 0;
+        }
+        idx = entry->second;
+        gen = slots[idx].gen;
+        len = slots[idx].len;
+        crc = slots[idx].crc;
+    }
+
+    ssize_t r = ops->pread(fopsHandle, buf, len,
+                           static_cast<cs_off_t>(idx) * slotSize);
+    bool hit = r == static_cast<ssize_t>(len) &&
+               get_checksum(reinterpret_cast<uint8_t *>(buf), len) == crc;
+
+    std::lock_guard<std::mutex> lh(lock);
+    if (slots[idx].gen != gen) {
+        // overwritten by another entry while being read
+        hit = false;
+    } else if (!hit) {
+        // corrupted on the cache device; don't return it again
+        unmapSlot(idx);
+    }
+    if (hit) {
+        numHits++;
+        return len;
+    }
+    numMisses++;
+    return 0;
+}
+
+void SecondaryCache::invalidate(uint64_t file_id, uint64_t begin,
+                                uint64_t end)
+{
+    std::lock_guard<std::mutex> lh(lock);
+    auto entry = index.lower_bound(scache_key_t(file_id, begin));
+    while (entry != index.end() && entry->first.first == file_id &&
+           entry->first.second < end) {
+        Slot &slot = slots[entry->second];
+        slot.mapped = false;
+        slot.valid = false;
+        slot.gen++;
+        entry = index.erase(entry);
+    }
+}
@@ -0,0 +1,163 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2016 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "libforestdb/fdb_types.h"
+
+/**
+ * Second-level cache of the clean blocks and B+tree nodes evicted from the
+ * buffer cache, kept in a fixed-size local file (see
+ * fdb_config.secondary_cache_path).
+ *
+ * The file is divided into slots of the block size, which are written in a
+ * circular order so that the cache device only sees sequential overwrites.
+ * An entry is identified by the file manager instance that it belongs to
+ * and by its block ID (or bnode offset), and its checksum is verified on
+ * every read. The entries of a block are invalidated when the block is
+ * allocated again, since its content is about to change.
+ */
+class SecondaryCache {
+public:
+    /**
+     * Create the global instance if a given config enables it.
+     *
+     * @param config ForestDB global config
+     * @return Pointer to the global instance, or NULL if it is disabled or
+     *         its file cannot be created
+     */
+    static SecondaryCache *init(const fdb_config &config);
+
+    /**
+     * Return the global instance, or NULL if the cache is disabled.
+     */
+    static SecondaryCache *getInstance();
+
+    /**
+     * Close and remove the cache file, and destroy the global instance.
+     */
+    static void destroyInstance();
+
+    /**
+     * Return a new ID for a file manager instance. IDs are never reused, so
+     * that the entries of a closed file are never mistaken for those of a
+     * file opened later with the same name.
+     */
+    static uint64_t newFileId();
+
+    /**
+     * Cache a copy of a clean block or bnode, replacing the oldest entry if
+     * the cache is full. Entries larger than a slot are not cached.
+     *
+     * @param file_id ID of the file that the data belongs to
+     * @param pos Block ID (or bnode offset) of the data
+     * @param buf Pointer to the data
+     * @param len Length of the data
+     */
+    void insert(uint64_t file_id, uint64_t pos, const void *buf, size_t len);
+
+    /**
+     * Read a cached block or bnode.
+     *
+     * @param file_id ID of the file that the data belongs to
+     * @param pos Block ID (or bnode offset) of the data
+     * @param buf Pointer to the buffer to read the data into
+     * @param buf_size Size of the buffer
+     * @return Length of the data read, or 0 on a cache miss
+     */
+    size_t read(uint64_t file_id, uint64_t pos, void *buf, size_t buf_size);
+
+    /**
+     * Invalidate the entries of a file whose positions are in [begin, end).
+     */
+    void invalidate(uint64_t file_id, uint64_t begin, uint64_t end);
+
+    size_t getSlotSize() const {
+        return slotSize;
+    }
+
+    uint64_t getNumHits() const {
+        return numHits.load(std::memory_order_relaxed);
+    }
+
+    uint64_t getNumMisses() const {
+        return numMisses.load(std::memory_order_relaxed);
+    }
+
+    uint64_t getNumInserts() const {
+        return numInserts.load(std::memory_order_relaxed);
+    }
+
+private:
+    typedef std::pair<uint64_t, uint64_t> scache_key_t;
+
+    struct Slot {
+        Slot() : gen(0), len(0), crc(0), mapped(false), valid(false) { }
+
+        scache_key_t key;
+        // Incremented whenever the slot is reassigned or invalidated, so that
+        // in-flight reads and writes of its previous entry can tell.
+        uint64_t gen;
+        uint32_t len;
+        uint32_t crc;
+        // Is the slot referred to by the index?
+        bool mapped;
+        // Has the entry been written to the file?
+        bool valid;
+    };
+
+    SecondaryCache(const std::string &_path, struct filemgr_ops *_ops,
+                   fdb_fileops_handle _fops_handle, size_t slot_size,
+                   size_t num_slots);
+
+    ~SecondaryCache();
+
+    /**
+     * Drop the index entry of a given slot. Caller should hold the lock.
+     */
+    void unmapSlot(size_t idx);
+
+    std::string path;
+    struct filemgr_ops *ops;
+    fdb_fileops_handle fopsHandle;
+    size_t slotSize;
+
+    // guards 'slots', 'index', and 'cursor'
+    std::mutex lock;
+    std::vector<Slot> slots;
+    std::map<scache_key_t, size_t> index;
+    // Next slot to be written
+    size_t cursor;
+
+    std::atomic<uint64_t> numHits;
+    std::atomic<uint64_t> numMisses;
+    std::atomic<uint64_t> numInserts;
+
+    static std::atomic<SecondaryCache *> instance;
+    static std::mutex instanceMutex;
+    static std::atomic<uint64_t> lastFileId;
+};
@@ -0,0 +1,252 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2016 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <stdlib.h>
+
+#include <thread>
+
+#include "skiplist.h"
+
+#include "memleak.h"
+
+static std::atomic<size_t> skiplist_next_stripe(0);
+
+// Reader counter stripe of the calling thread, assigned round robin.
+static size_t _skiplist_thread_stripe()
+{
+    static thread_local size_t stripe =
+        skiplist_next_stripe.fetch_add(1, std::memory_order_relaxed) %
+        SKIPLIST_READER_STRIPES;
+    return stripe;
+}
+
+void skiplist_init(struct skiplist_raw *slist,
+                   skiplist_cmp_func *cmp,
+                   void *aux)
+{
+    slist->head.next = slist->head_next;
+    slist->head.is_removed = false;
+    slist->head.top_layer = SKIPLIST_MAX_LAYER - 1;
+    for (size_t i = 0; i < SKIPLIST_MAX_LAYER; ++i) {
+        slist->head_next[i].store(NULL, std::memory_order_relaxed);
+    }
+    slist->cmp = cmp;
+    slist->aux = aux;
+    spin_init(&slist->write_lock);
+    slist->rand_state = 0x9e3779b9;
+    slist->num_entries = 0;
+    slist->epoch = 0;
+    for (size_t i = 0; i < 2; ++i) {
+        for (size_t j = 0; j < SKIPLIST_READER_STRIPES; ++j) {
+            slist->readers[i][j].count = 0;
+        }
+    }
+}
+
+void skiplist_free(struct skiplist_raw *slist)
+{
+    spin_destroy(&slist->write_lock);
+}
+
+void skiplist_init_node(struct skiplist_node *node)
+{
+    node->next = NULL;
+    node->is_removed = false;
+    node->top_layer = 0;
+}
+
+void skiplist_free_node(struct skiplist_node *node)
+{
+    delete[] node->next;
+    node->next = NULL;
+}
+
+// Pick the height of a new node: each layer holds 1/4 of the layer below.
+// Called with the write lock held.
+static uint8_t _skiplist_rand_layer(struct skiplist_raw *slist)
+{
+    uint32_t x = slist->rand_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    slist->rand_state = x;
+
+    uint8_t layer = 0;
+    while (layer < SKIPLIST_MAX_LAYER - 1 && (x & 0x3) == 0) {
+        x >>= 2;
+        ++layer;
+    }
+    return layer;
+}
+
+// Find the last node smaller than the query at every layer.
+// Returns the first node not smaller than the query at the bottom layer.
+static struct skiplist_node* _skiplist_find_prevs(struct skiplist_raw *slist,
+                                                  struct skiplist_node *query,
+                                                  struct skiplist_node **prevs)
+{
+    struct skiplist_node *cur = &slist->head;
+    struct skiplist_node *next = NULL;
+    for (int layer = SKIPLIST_MAX_LAYER - 1; layer >= 0; --layer) {
+        next = cur->next[layer].load(std::memory_order_acquire);
+        while (next && slist->cmp(next, query, slist->aux) < 0) {
+            cur = next;
+            next = cur->next[layer].load(std::memory_order_acquire);
+        }
+        if (prevs) {
+            prevs[layer] = cur;
+        }
+    }
+    return next;
+}
+
+struct skiplist_node* skiplist_insert(struct skiplist_raw *slist,
+                                      struct skiplist_node *node)
+{
+    struct skiplist_node *prevs[SKIPLIST_MAX_LAYER];
+    struct skiplist_node *next;
+
+    spin_lock(&slist->write_lock);
+    next = _skiplist_find_prevs(slist, node, prevs);
+    if (next && slist->cmp(next, node, slist->aux) == 0) {
+        spin_unlock(&slist->write_lock);
+        return next;
+    }
+
+    if (!node->next) {
+        node->top_layer = _skiplist_rand_layer(slist);
+        node->next =
+            new std::atomic<struct skiplist_node *>[node->top_layer + 1];
+    }
+    node->is_removed.store(false, std::memory_order_relaxed);
+    for (int layer = 0; layer <= node->top_layer; ++layer) {
+        node->next[layer].store(
+            prevs[layer]->next[layer].load(std::memory_order_relaxed),
+            std::memory_order_relaxed);
+    }
+    // Link bottom-up, so that a node reachable at some layer is always
+    // reachable at all the layers below it.
+    for (int layer = 0; layer <= node->top_layer; ++layer) {
+        prevs[layer]->next[layer].store(node, std::memory_order_release);
+    }
+    slist->num_entries++;
+    spin_unlock(&slist->write_lock);
+    return NULL;
+}
+
+int skiplist_erase(struct skiplist_raw *slist,
+                   struct skiplist_node *node)
+{
+    struct skiplist_node *prevs[SKIPLIST_MAX_LAYER];
+    struct skiplist_node *cur;
+
+    spin_lock(&slist->write_lock);
+    // Equal nodes are unique, so walk the bottom layer from the first node
+    // not smaller than the given one to make sure it is this very node.
+    cur = _skiplist_find_prevs(slist, node, prevs);
+    if (cur != node || node->is_removed.load(std::memory_order_relaxed)) {
+        spin_unlock(&slist->write_lock);
+        return -1;
+    }
+    node->is_removed.store(true, std::memory_order_release);
+    // Unlink top-down; the node's own pointers are left as they are for the
+    // readers that are standing on it.
+    for (int layer = node->top_layer; layer >= 0; --layer) {
+        if (prevs[layer]->next[layer].load(std::memory_order_relaxed) == node) {
+            prevs[layer]->next[layer].store(
+                node->next[layer].load(std::memory_order_relaxed),
+                std::memory_order_release);
+        }
+    }
+    slist->num_entries--;
+    spin_unlock(&slist->write_lock);
+    return 0;
+}
+
+uint64_t skiplist_read_begin(struct skiplist_raw *slist)
+{
+    size_t stripe = _skiplist_thread_stripe();
+    while (true) {
+        uint64_t epoch = slist->epoch.load();
+        slist->readers[epoch & 1][stripe].count.fetch_add(1);
+        // Make sure the epoch did not change before the reader was
+        // registered, otherwise a synchronizer might have missed it.
+        if (slist->epoch.load() == epoch) {
+            return (epoch & 1) * SKIPLIST_READER_STRIPES + stripe;
+        }
+        slist->readers[epoch & 1][stripe].count.fetch_sub(1);
+    }
+}
+
+void skiplist_read_end(struct skiplist_raw *slist, uint64_t token)
+{
+    slist->readers[token / SKIPLIST_READER_STRIPES]
+                  [token % SKIPLIST_READER_STRIPES].count.fetch_sub(1);
+}
+
+void skiplist_synchronize(struct skiplist_raw *slist)
+{
+    std::lock_guard<std::mutex> lock(slist->sync_lock);
+    // New readers register in the other slot from now on; wait for the ones
+    // registered in the previous slot to leave. The readers of the slot
+    // before were waited for by the previous grace period.
+    uint64_t epoch = slist->epoch.fetch_add(1);
+    for (size_t i = 0; i < SKIPLIST_READER_STRIPES; ++i) {
+        while (slist->readers[epoch & 1][i].count.load()) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+struct skiplist_node* skiplist_find(struct skiplist_raw *slist,
+                                    struct skiplist_node *query)
+{
+    struct skiplist_node *node = skiplist_find_greater_or_equal(slist, query);
+    if (node && slist->cmp(node, query, slist->aux) == 0) {
+        return node;
+    }
+    return NULL;
+}
+
+struct skiplist_node* skiplist_find_greater_or_equal(struct skiplist_raw *slist,
+                                                     struct skiplist_node *query)
+{
+    struct skiplist_node *node = _skiplist_find_prevs(slist, query, NULL);
+    while (node && node->is_removed.load(std::memory_order_acquire)) {
+        node = node->next[0].load(std::memory_order_acquire);
+    }
+    return node;
+}
+
+struct skiplist_node* skiplist_first(struct skiplist_raw *slist)
+{
+    return skiplist_next(&slist->head);
+}
+
+struct skiplist_node* skiplist_next(struct skiplist_node *node)
+{
+    struct skiplist_node *next = node->next[0].load(std::memory_order_acquire);
+    while (next && next->is_removed.load(std::memory_order_acquire)) {
+        next = next->next[0].load(std::memory_order_acquire);
+    }
+    return next;
+}
+
+size_t skiplist_get_size(struct skiplist_raw *slist)
+{
+    return slist->num_entries.load();
+}
@@ -0,0 +1,131 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2016 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <mutex>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "arch.h"
+
+/**
+ * Ordered skiplist whose readers never take a lock.
+ *
+ * Writers (insert and erase) are serialized by a spin lock inside the list,
+ * and publish a new node bottom-up with release stores once it is fully
+ * initialized, so that a reader following the 'next' pointers always sees
+ * consistent nodes. An erased node is unlinked but its own pointers are kept
+ * intact, so a reader standing on it can still move forward.
+ *
+ * Readers wrap their accesses in skiplist_read_begin() / skiplist_read_end().
+ * A node that was erased may only be freed or re-inserted by its owner after
+ * skiplist_synchronize() returned, which waits for all the readers that might
+ * still reference it. The reader counters are striped by thread to avoid
+ * bouncing a single cache line between the readers.
+ */
+
+#define SKIPLIST_MAX_LAYER (12)
+#define SKIPLIST_READER_STRIPES (16)
+
+struct skiplist_node {
+    std::atomic<struct skiplist_node *> *next;
+    std::atomic<bool> is_removed;
+    uint8_t top_layer;
+};
+
+// *a < *b : return neg
+// *a == *b : return 0
+// *a > *b : return pos
+typedef int skiplist_cmp_func(struct skiplist_node *a,
+                              struct skiplist_node *b,
+                              void *aux);
+
+struct skiplist_reader_stripe {
+    std::atomic<uint64_t> count;
+    char pad[64 - sizeof(std::atomic<uint64_t>)];
+};
+
+struct skiplist_raw {
+    struct skiplist_node head;
+    std::atomic<struct skiplist_node *> head_next[SKIPLIST_MAX_LAYER];
+    skiplist_cmp_func *cmp;
+    void *aux;
+    spin_t write_lock;
+    // serializes the grace periods, as each of them only waits for one of
+    // the two reader slots
+    std::mutex sync_lock;
+    uint32_t rand_state;
+    std::atomic<size_t> num_entries;
+    std::atomic<uint64_t> epoch;
+    struct skiplist_reader_stripe readers[2][SKIPLIST_READER_STRIPES];
+};
+
+void skiplist_init(struct skiplist_raw *slist,
+                   skiplist_cmp_func *cmp,
+                   void *aux);
+void skiplist_free(struct skiplist_raw *slist);
+
+/**
+ * Initialize a node before its first insertion.
+ */
+void skiplist_init_node(struct skiplist_node *node);
+
+/**
+ * Release the memory of a node that is not (or no longer) in any list.
+ */
+void skiplist_free_node(struct skiplist_node *node);
+
+/**
+ * Insert a node. Nothing is inserted if an equal node already exists.
+ *
+ * @return The existing equal node, or NULL if the node was inserted
+ */
+struct skiplist_node* skiplist_insert(struct skiplist_raw *slist,
+                                      struct skiplist_node *node);
+
+/**
+ * Unlink a node from the list. The node must not be freed or re-inserted
+ * before skiplist_synchronize() returns.
+ *
+ * @return 0 if the node was unlinked, -1 if it was not in the list
+ */
+int skiplist_erase(struct skiplist_raw *slist,
+                   struct skiplist_node *node);
+
+/**
+ * Wait until no reader can reference a node erased before this call.
+ */
+void skiplist_synchronize(struct skiplist_raw *slist);
+
+/**
+ * Enter and leave a read-side critical section. The nodes returned by the
+ * lookup functions below can be accessed until skiplist_read_end().
+ */
+uint64_t skiplist_read_begin(struct skiplist_raw *slist);
+void skiplist_read_end(struct skiplist_raw *slist, uint64_t token);
+
+struct skiplist_node* skiplist_find(struct skiplist_raw *slist,
+                                    struct skiplist_node *query);
+struct skiplist_node* skiplist_find_greater_or_equal(struct skiplist_raw *slist,
+                                                     struct skiplist_node *query);
+struct skiplist_node* skiplist_first(struct skiplist_raw *slist);
+struct skiplist_node* skiplist_next(struct skiplist_node *node);
+
+size_t skiplist_get_size(struct skiplist_raw *slist);
@@ -0,0 +1,175 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2016 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <stdlib.h>
+
+#include "slab_arena.h"
+
+#include "memleak.h"
+
+// Offset of the first object in a slab.
+#define SLAB_HEADER_SIZE \
+    ((sizeof(struct slab) + SLAB_CLASS_UNIT - 1) & ~(SLAB_CLASS_UNIT - 1))
+
+static inline size_t _slab_class(size_t size)
+{
+    return (size - 1) / SLAB_CLASS_UNIT;
+}
+
+static inline size_t _slab_obj_size(size_t size_class)
+{
+    return (size_class + 1) * SLAB_CLASS_UNIT;
+}
+
+SlabArena::SlabArena() : reservedBytes(0), usedBytes(0)
+{
+    spin_init(&lock);
+    list_init(&slabs);
+    for (size_t i = 0; i < SLAB_NUM_CLASSES; ++i) {
+        list_init(&partial[i]);
+    }
+}
+
+SlabArena::~SlabArena()
+{
+    struct list_elem *e = list_begin(&slabs);
+    while (e) {
+        struct slab *s = _get_entry(e, struct slab, le_all);
+        e = list_next(e);
+        free_align(s);
+    }
+    spin_destroy(&lock);
+}
+
+void *SlabArena::alloc(size_t size)
+{
+    if (!size) {
+        size = 1;
+    }
+    if (size > SLAB_MAX_OBJ_SIZE) {
+        uint8_t *base = (uint8_t *)malloc(size + SLAB_LARGE_PREFIX);
+        *(SlabArena **)base = this;
+        reservedBytes.fetch_add(size + SLAB_LARGE_PREFIX,
+                                std::memory_order_relaxed);
+        usedBytes.fetch_add(size, std::memory_order_relaxed);
+        return base + SLAB_LARGE_PREFIX;
+    }
+
+    size_t size_class = _slab_class(size);
+    size_t obj_size = _slab_obj_size(size_class);
+    struct slab *s;
+    void *obj;
+
+    spin_lock(&lock);
+    struct list_elem *e = list_begin(&partial[size_class]);
+    if (e) {
+        s = _get_entry(e, struct slab, le_partial);
+    } else {
+        void *addr;
+        malloc_align(addr, SLAB_SIZE, SLAB_SIZE);
+        s = (struct slab *)addr;
+        s->arena = this;
+        s->free_objs = NULL;
+        s->unused_offset = SLAB_HEADER_SIZE;
+        s->num_live = 0;
+        s->size_class = size_class;
+        s->is_partial = true;
+        list_push_back(&slabs, &s->le_all);
+        list_push_front(&partial[size_class], &s->le_partial);
+        reservedBytes.fetch_add(SLAB_SIZE, std::memory_order_relaxed);
+    }
+
+    if (s->free_objs) {
+        obj = s->free_objs;
+        s->free_objs = *(void **)obj;
+    } else {
+        obj = (uint8_t *)s + s->unused_offset;
+        s->unused_offset += obj_size;
+    }
+    s->num_live++;
+    if (!s->free_objs && s->unused_offset + obj_size > SLAB_SIZE) {
+        // full
+        list_remove(&partial[size_class], &s->le_partial);
+        s->is_partial = false;
+    }
+    spin_unlock(&lock);
+
+    usedBytes.fetch_add(size, std::memory_order_relaxed);
+    return obj;
+}
+
+void SlabArena::release(void *ptr, size_t size)
+{
+    if (!size) {
+        size = 1;
+    }
+    if (size > SLAB_MAX_OBJ_SIZE) {
+        uint8_t *base = (uint8_t *)ptr - SLAB_LARGE_PREFIX;
+        SlabArena *arena = *(SlabArena **)base;
+        arena->reservedBytes.fetch_sub(size + SLAB_LARGE_PREFIX,
+                                       std::memory_order_relaxed);
+        arena->usedBytes.fetch_sub(size, std::memory_order_relaxed);
+        free(base);
+        return;
+    }
+
+    struct slab *s = (struct slab *)((uintptr_t)ptr & ~((uintptr_t)SLAB_SIZE - 1));
+    s->arena->releaseObj(ptr, size);
+}
+
+void SlabArena::releaseObj(void *ptr, size_t size)
+{
+    struct slab *s = (struct slab *)((uintptr_t)ptr & ~((uintptr_t)SLAB_SIZE - 1));
+
+    spin_lock(&lock);
+    *(void **)ptr = s->free_objs;
+    s->free_objs = ptr;
+    s->num_live--;
+    if (!s->is_partial) {
+        // Slabs that got room again go after the ones being filled, so that
+        // the allocations keep packing the same slabs.
+        list_push_back(&partial[s->size_class], &s->le_partial);
+        s->is_partial = true;
+    }
+    spin_unlock(&lock);
+
+    usedBytes.fetch_sub(size, std::memory_order_relaxed);
+}
+
+size_t SlabArena::releaseEmptySlabs()
+{
+    size_t released = 0;
+
+    spin_lock(&lock);
+    struct list_elem *e = list_begin(&slabs);
+    while (e) {
+        struct slab *s = _get_entry(e, struct slab, le_all);
+        e = list_next(e);
+        if (s->num_live) {
+            continue;
+        }
+        // an empty slab always has room
+        list_remove(&partial[s->size_class], &s->le_partial);
+        list_remove(&slabs, &s->le_all);
+        free_align(s);
+        released += SLAB_SIZE;
+    }
+    spin_unlock(&lock);
+
+    reservedBytes.fetch_sub(released, std::memory_order_relaxed);
+    return released;
+}
@@ -0,0 +1,115 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2016 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "common.h"
+#include "list.h"
+
+// Size of a slab; slabs are aligned on their size, so that the slab of an
+// object is found by masking its address.
+#define SLAB_SIZE (65536)
+// Objects are rounded up to a multiple of the unit; each multiple is a class.
+#define SLAB_CLASS_UNIT (16)
+// Larger objects are not worth packing and are allocated with malloc, behind
+// a prefix that records their arena.
+#define SLAB_MAX_OBJ_SIZE (512)
+#define SLAB_LARGE_PREFIX (16)
+#define SLAB_NUM_CLASSES (SLAB_MAX_OBJ_SIZE / SLAB_CLASS_UNIT)
+
+class SlabArena;
+
+/**
+ * Header at the beginning of every slab. A slab only holds objects of one
+ * size class.
+ */
+struct slab {
+    SlabArena *arena; // owner of the slab
+    struct list_elem le_all; // for the arena's list of all slabs
+    struct list_elem le_partial; // for the class's list of non-full slabs
+    void *free_objs; // singly-linked list of the freed objects
+    uint32_t unused_offset; // offset of the area never handed out yet
+    uint32_t num_live; // number of objects currently handed out
+    uint16_t size_class;
+    bool is_partial; // true if linked into its class's list
+};
+
+/**
+ * Slab allocator for the many small objects of a similar size that are
+ * allocated and released together, such as the WAL items and their keys.
+ *
+ * Objects are carved out of 64KB slabs, with one slab serving one size class
+ * at a time. Freeing an object only pushes it onto its slab's free list;
+ * slabs whose objects are all freed are kept for reuse until
+ * releaseEmptySlabs() hands them back to the system in bulk, which the owner
+ * calls at points where most objects have been freed (e.g. after a WAL
+ * flush). This avoids a malloc/free pair per object and keeps the resident
+ * memory from fragmenting.
+ */
+class SlabArena {
+public:
+    SlabArena();
+    ~SlabArena();
+
+    /**
+     * Allocate an object of a given size.
+     */
+    void *alloc(size_t size);
+
+    /**
+     * Free an object allocated by any arena. The size must be the one given
+     * to alloc().
+     */
+    static void release(void *ptr, size_t size);
+
+    /**
+     * Return the slabs that hold no object to the system.
+     *
+     * @return Number of bytes released
+     */
+    size_t releaseEmptySlabs();
+
+    /**
+     * Return the number of bytes held by the arena, including the room not
+     * handed out yet.
+     */
+    size_t getReservedBytes() const {
+        return reservedBytes.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Return the number of bytes currently handed out, as requested.
+     */
+    size_t getUsedBytes() const {
+        return usedBytes.load(std::memory_order_relaxed);
+    }
+
+private:
+    void releaseObj(void *ptr, size_t size);
+
+    spin_t lock;
+    struct list slabs; // all slabs
+    struct list partial[SLAB_NUM_CLASSES]; // slabs with room, per class
+    std::atomic<size_t> reservedBytes;
+    std::atomic<size_t> usedBytes;
+    DISALLOW_COPY_AND_ASSIGN(SlabArena);
+};
@@ -469,6 +469,16 @@ fdb_status Superblock::readGivenNum(size_t sb_no,
     crc = get_checksum(buf, offset, file->getCrcMode());
     memcpy(&_crc, buf + offset, sizeof(_crc));
     crc_file = _endian_decode(_crc);
+    if (crc != crc_file &&
+        !(file->getConfig()->getOptions() & FILEMGR_CREATE_CRC32)) {
+        // The file may have been written with another checksum mode than
+        // the one for new files; detect it unless legacy CRC is forced.
+        crc_mode_e crc_mode;
+        if (detect_and_check_crc(buf, offset, crc_file, &crc_mode)) {
+            file->setCrcMode(crc_mode);
+            crc = crc_file;
+        }
+    }
     if (crc != crc_file) {
         free(bmpDocOffset);
         free(bmpDocs);
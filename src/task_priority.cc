@@ -26,6 +26,7 @@
 // Priorities for Read-Write IO tasks
 const Priority Priority::CompactorPriority(COMPACTOR_ID, 2);
 const Priority Priority::BgFlusherPriority(BGFLUSHER_ID, 1);
+const Priority Priority::WalFlusherPriority(WAL_FLUSHER_ID, 1);
 
 // Priorities for NON-IO tasks
 
@@ -35,6 +36,8 @@ const char *Priority::getTypeName(const type_id_t i) {
             return "compactor_tasks";
         case BGFLUSHER_ID:
             return "bgflusher_tasks";
+        case WAL_FLUSHER_ID:
+            return "walflusher_tasks";
         default: break;
     }
 
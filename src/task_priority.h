@@ -23,6 +23,7 @@
 enum type_id_t {
     COMPACTOR_ID,
     BGFLUSHER_ID,
+    WAL_FLUSHER_ID,
     MAX_TYPE_ID // Keep this as the last enum value
 };
 
@@ -36,6 +37,7 @@ public:
     // Priorities for Read-Write tasks
     static const Priority CompactorPriority;
     static const Priority BgFlusherPriority;
+    static const Priority WalFlusherPriority;
 
     // Priorities for NON-IO tasks
 
@@ -18,6 +18,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#include <algorithm>
+#include <utility>
+#include <vector>
 
 #include "filemgr.h"
 #include "common.h"
@@ -27,6 +30,7 @@
 #include "hash_functions.h"
 #include "fdb_internal.h"
 #include "iterator.h"
+#include "wal_flusher.h"
 
 #include "memleak.h"
 #include "time_utils.h"
@@ -45,12 +49,6 @@
 #endif
 #endif
 
-INLINE uint32_t _wal_hash_bykey(struct hash *hash, struct hash_elem *e)
-{
-    struct wal_item_header *item = _get_entry(e, struct wal_item_header, he_key);
-    return item->checksum % static_cast<uint64_t>(hash->nbuckets);
-}
-
 INLINE int _wal_keycmp(void *key1, size_t keylen1, void *key2, size_t keylen2)
 {
     if (keylen1 == keylen2) {
@@ -100,11 +98,12 @@ INLINE int __wal_cmp_bykey(struct wal_item_header *aa,
     }
 }
 
-INLINE int _wal_cmp_bykey(struct hash_elem *a, struct hash_elem *b)
+static int _wal_cmp_bykey(struct skiplist_node *a, struct skiplist_node *b,
+                          void *aux)
 {
     struct wal_item_header *aa, *bb;
-    aa = _get_entry(a, struct wal_item_header, he_key);
-    bb = _get_entry(b, struct wal_item_header, he_key);
+    aa = _get_entry(a, struct wal_item_header, snode);
+    bb = _get_entry(b, struct wal_item_header, snode);
     return _wal_keycmp(aa->key, aa->keylen, bb->key, bb->keylen);
 }
 
@@ -132,12 +131,6 @@ INLINE int _snap_cmp_byseq(struct avl_node *a, struct avl_node *b, void *aux)
     return _CMP_U64(aa->seqnum, bb->seqnum);
 }
 
-INLINE uint32_t _wal_hash_byseq(struct hash *hash, struct hash_elem *e)
-{
-    struct wal_item *item = _get_entry(e, struct wal_item, he_seq);
-    return (item->seqnum) % static_cast<uint64_t>(hash->nbuckets);
-}
-
 INLINE int __wal_cmp_byseq(struct wal_item *aa, struct wal_item *bb) {
     if (aa->shandle->id < bb->shandle->id) {
         return -1;
@@ -148,12 +141,27 @@ INLINE int __wal_cmp_byseq(struct wal_item *aa, struct wal_item *bb) {
     }
 }
 
-INLINE int _wal_cmp_byseq(struct hash_elem *a, struct hash_elem *b)
+static int _wal_cmp_byseq(struct skiplist_node *a, struct skiplist_node *b,
+                          void *aux)
 {
     struct wal_item *aa, *bb;
-    aa = _get_entry(a, struct wal_item, he_seq);
-    bb = _get_entry(b, struct wal_item, he_seq);
-    return __wal_cmp_byseq(aa, bb);
+    aa = _get_entry(a, struct wal_item, snode_seq);
+    bb = _get_entry(b, struct wal_item, snode_seq);
+    if (aa->kv_id != bb->kv_id) {
+        return (aa->kv_id < bb->kv_id) ? -1 : 1;
+    }
+    if (aa->seqnum != bb->seqnum) {
+        return (aa->seqnum < bb->seqnum) ? -1 : 1;
+    }
+    // Items with the same seq num are told apart by their address, so that
+    // none of them is rejected by the index. A lookup query (which has no
+    // header) sorts before all of them.
+    if (aa == bb) {
+        return 0;
+    } else if (!aa->header || (bb->header && aa < bb)) {
+        return -1;
+    }
+    return 1;
 }
 
 INLINE int _merge_cmp_byseq(struct avl_node *a, struct avl_node *b, void *aux)
@@ -188,6 +196,7 @@ Wal::Wal(FileMgr *_file, size_t nbucket)
     isPopulated = false;
     wal_dirty = FDB_WAL_CLEAN;
     unFlushedTransactions = false;
+    snapsFrozen = false;
 
     list_init(&txn_list);
     spin_init(&lock);
@@ -199,25 +208,17 @@ Wal::Wal(FileMgr *_file, size_t nbucket)
     }
 
     key_shards = (wal_shard *)malloc(sizeof(struct wal_shard) * num_shards);
-
-    if (file->getConfig()->getSeqtreeOpt() == FDB_SEQTREE_USE) {
-        seq_shards = (wal_shard *)
-            malloc(sizeof(struct wal_shard) * num_shards);
-    } else {
-        seq_shards = NULL;
-    }
-
     for (int i = num_shards - 1; i >= 0; --i) {
-        hash_init(&key_shards[i]._map, nbucket, _wal_hash_bykey,
-                  _wal_cmp_bykey);
         list_init(&key_shards[i]._list);
         spin_init(&key_shards[i].lock);
-        if (file->getConfig()->getSeqtreeOpt() == FDB_SEQTREE_USE) {
-            hash_init(&seq_shards[i]._map, nbucket, _wal_hash_byseq,
-                      _wal_cmp_byseq);
-            spin_init(&seq_shards[i].lock);
-        }
     }
+    slab_arenas = new SlabArena[num_shards];
+
+    skiplist_init(&key_index, _wal_cmp_bykey, NULL);
+    skiplist_init(&seq_index, _wal_cmp_byseq, NULL);
+    list_init(&retired_headers);
+    list_init(&retired_items);
+    spin_init(&retire_lock);
 
     avl_init(&wal_kvs_snap_tree, NULL);
 
@@ -227,20 +228,17 @@ Wal::Wal(FileMgr *_file, size_t nbucket)
 Wal::~Wal()
 {
     size_t i = 0;
+    _wal_reclaim();
     // Free all WAL shards
     for (; i < num_shards; ++i) {
-        hash_free(&key_shards[i]._map);
         spin_destroy(&key_shards[i].lock);
-        if (file->getConfig()->getSeqtreeOpt() == FDB_SEQTREE_USE) {
-            hash_free(&seq_shards[i]._map);
-            spin_destroy(&seq_shards[i].lock);
-        }
     }
+    skiplist_free(&key_index);
+    skiplist_free(&seq_index);
+    delete[] slab_arenas;
+    spin_destroy(&retire_lock);
     spin_destroy(&lock);
     free(key_shards);
-    if (file->getConfig()->getSeqtreeOpt() == FDB_SEQTREE_USE) {
-        free(seq_shards);
-    }
 }
 
 inline
@@ -275,6 +273,7 @@ Snapshot::Snapshot() :
     snap_stop_idx(0), // Id of oldest Shared snapshot
     ref_cnt_kvs(0), // Number cloned snapshots at this point
     is_flushed(false), // Are my items reflected in main index
+    is_frozen(false), // Are my items handed over to a background flush
     is_persisted_snapshot(false), // Is is an exclusive snapshot
     num_prev_snaps(0), // number of previous shared snapshots
     wal_ndocs(0), // number of documents in this snapshot
@@ -301,6 +300,7 @@ Snapshot::Snapshot(fdb_kvs_id_t kvstore_id,
     snap_stop_idx(range_stop), // Id of oldest Shared snapshot
     ref_cnt_kvs(0), // Number cloned snapshots at this point
     is_flushed(false), // Are my items reflected in main index
+    is_frozen(false), // Are my items handed over to a background flush
     is_persisted_snapshot(false), // Is is an exclusive snapshot
     num_prev_snaps(0), // number of previous shared snapshots
     wal_ndocs(0), // number of documents in this snapshot
@@ -351,6 +351,7 @@ Snapshot * Wal::_wal_fetch_snapshot(fdb_kvs_id_t kv_id,
     open_snapshot = _wal_get_latest_snapshot(kvs_snapshots);
     if (!open_snapshot || // if first WAL item inserted for KV store
         _wal_snap_is_immutable(open_snapshot) ||//Write barrier (snapshot_open)
+        open_snapshot->is_frozen || // Write barrier (background flush)
         open_snapshot->is_flushed) { // flush_Waled (read-write barrier)
         if (!open_snapshot) {
             snap_id = 1; // begin snapshots id at 1
@@ -360,7 +361,7 @@ Snapshot * Wal::_wal_fetch_snapshot(fdb_kvs_id_t kv_id,
         } else { // read/write barrier means a new WAL snapshot gets created
             snap_id = open_snapshot->snap_tag_idx + 1;
             if (!open_snapshot->is_flushed) { // Write barrier only
-                snap_flush_id = open_snapshot->snap_stop_idx;
+                snap_flush_id = _wal_get_flushed_snap_idx(open_snapshot);
                 DBG("Write Barrier WAL KV id %" _F64 " Snapshot %" _F64
                     " - %" _F64 "\n", kv_id, snap_flush_id, snap_id);
             } else { // WAL flushed! Read & Write barrier
@@ -580,19 +581,49 @@ inline fdb_status Wal::_insert_Wal(fdb_txn *txn,
                                    uint64_t offset,
                                    wal_insert_by caller,
                                    bool immediate_remove)
+{
+    size_t chk_sum;
+    size_t shard_num;
+    LATENCY_STAT_START();
+
+    chk_sum = get_checksum((uint8_t*)doc->key, doc->keylen);
+    shard_num = chk_sum % num_shards;
+    if (caller == WAL_INS_WRITER) {
+        spin_lock(&key_shards[shard_num].lock);
+    }
+
+    _insertIntoShard_Wal(txn, cmp_info, doc, offset, caller,
+                         immediate_remove, chk_sum, shard_num);
+
+    if (caller == WAL_INS_WRITER) {
+        spin_unlock(&key_shards[shard_num].lock);
+    }
+
+    LATENCY_STAT_END(file, FDB_LATENCY_WAL_INS);
+    return FDB_RESULT_SUCCESS;
+}
+
+// Caller (if WAL_INS_WRITER) should grab the key shard lock.
+inline void Wal::_insertIntoShard_Wal(fdb_txn *txn,
+                                      struct _fdb_key_cmp_info *cmp_info,
+                                      fdb_doc *doc,
+                                      uint64_t offset,
+                                      wal_insert_by caller,
+                                      bool immediate_remove,
+                                      size_t chk_sum,
+                                      size_t shard_num)
 {
     struct wal_item *item;
     struct wal_item_header query, *header;
     Snapshot *shandle;
     struct list_elem *le;
-    struct hash_elem *he;
+    struct skiplist_node *snode;
+    uint64_t read_token;
     void *key = doc->key;
     size_t keylen = doc->keylen;
-    size_t chk_sum;
-    size_t shard_num;
     wal_snapid_t snap_tag;
     fdb_kvs_id_t kv_id;
-    LATENCY_STAT_START();
+    bool seqtree = file->getConfig()->getSeqtreeOpt() == FDB_SEQTREE_USE;
 
     if (file->getKVHeader_UNLOCKED()) { // multi KV instance mode
         buf2kvid(file->getConfig()->getChunkSize(), doc->key, &kv_id);
@@ -603,17 +634,16 @@ inline fdb_status Wal::_insert_Wal(fdb_txn *txn,
     snap_tag = shandle->snap_tag_idx;
     query.key = key;
     query.keylen = keylen;
-    chk_sum = get_checksum((uint8_t*)key, keylen);
-    shard_num = chk_sum % num_shards;
-    if (caller == WAL_INS_WRITER) {
-        spin_lock(&key_shards[shard_num].lock);
-    }
 
-    he = hash_find_by_hash_val(&key_shards[shard_num]._map, &query.he_key,
-                               (uint32_t)chk_sum);
-    if (he) {
+    // The headers of this shard are only un-indexed under the key shard lock,
+    // which the caller owns, so the header found here cannot go away. Still,
+    // the lookup passes by the headers of the other shards.
+    read_token = skiplist_read_begin(&key_index);
+    snode = skiplist_find(&key_index, &query.snode);
+    skiplist_read_end(&key_index, read_token);
+    if (snode) {
         // already exist .. retrieve header
-        header = _get_entry(he, struct wal_item_header, he_key);
+        header = _get_entry(snode, struct wal_item_header, snode);
 
         // find uncommitted item belonging to the same txn
         le = list_begin(&header->items);
@@ -625,28 +655,19 @@ inline fdb_status Wal::_insert_Wal(fdb_txn *txn,
             if (item->txn_id == txn->txn_id &&
                 !(is_committed || caller == WAL_INS_COMPACT_PHASE1) &&
                 same_snap) {
-                item->flag &= ~WAL_ITEM_FLUSH_READY;
+                if (seqtree) {
+                    // Un-index the item by its old sequence number, and wait
+                    // for the readers that may stand on it before it is
+                    // re-indexed below.
+                    skiplist_erase(&seq_index, &item->snode_seq);
+                    skiplist_synchronize(&seq_index);
+                }
 
-                if (file->getConfig()->getSeqtreeOpt() == FDB_SEQTREE_USE) {
-                    // Re-index the item by new sequence number..
-                    size_t seq_shard_num = item->seqnum % num_shards;
-                    if (caller == WAL_INS_WRITER) {
-                        spin_lock(&seq_shards[seq_shard_num].lock);
-                    }
-                    hash_remove(&seq_shards[seq_shard_num]._map, &item->he_seq);
-                    if (caller == WAL_INS_WRITER) {
-                        spin_unlock(&seq_shards[seq_shard_num].lock);
-                    }
+                spin_lock(&header->lock);
+                item->flag &= ~WAL_ITEM_FLUSH_READY;
 
+                if (seqtree) {
                     item->seqnum = doc->seqnum;
-                    seq_shard_num = doc->seqnum % num_shards;
-                    if (caller == WAL_INS_WRITER) {
-                        spin_lock(&seq_shards[seq_shard_num].lock);
-                    }
-                    hash_insert(&seq_shards[seq_shard_num]._map, &item->he_seq);
-                    if (caller == WAL_INS_WRITER) {
-                        spin_unlock(&seq_shards[seq_shard_num].lock);
-                    }
                     // Also need to re-index it by new seqnum in snapshot
                     // old and new items are the same
                     if (item->txn == file->getGlobalTxn()) {
@@ -702,6 +723,11 @@ inline fdb_status Wal::_insert_Wal(fdb_txn *txn,
                 // move the item to the front of the list (header)
                 list_remove(&header->items, &item->list_elem);
                 list_push_front(&header->items, &item->list_elem);
+                spin_unlock(&header->lock);
+
+                if (seqtree) {
+                    skiplist_insert(&seq_index, &item->snode_seq);
+                }
                 // Since this is an update, not an insert, correct the doc count
                 shandle->wal_ndocs--; // of parent snapshot
                 break;
@@ -713,7 +739,9 @@ inline fdb_status Wal::_insert_Wal(fdb_txn *txn,
         if (le == NULL) {
             // not exist
             // create new item
-            item = (struct wal_item *)calloc(1, sizeof(struct wal_item));
+            item = (struct wal_item *)
+                   slab_arenas[shard_num].alloc(sizeof(struct wal_item));
+            memset(item, 0, sizeof(struct wal_item));
 
             if (file->getKVHeader_UNLOCKED()) { // multi KV instance mode
                 item->flag |= WAL_ITEM_MULTI_KV_INS_MODE;
@@ -724,7 +752,9 @@ inline fdb_status Wal::_insert_Wal(fdb_txn *txn,
                 num_flushable++;
             }
             item->header = header;
+            item->kv_id = shandle->id;
             item->seqnum = doc->seqnum;
+            skiplist_init_node(&item->snode_seq);
 
             if (doc->deleted) {
                 if (item->txn_id == file->getGlobalTxn()->txn_id) {
@@ -770,18 +800,13 @@ inline fdb_status Wal::_insert_Wal(fdb_txn *txn,
                 // has been removed from the parent snapshot's tree
             }
 
-            if (file->getConfig()->getSeqtreeOpt() == FDB_SEQTREE_USE) {
-                size_t seq_shard_num = doc->seqnum % num_shards;
-                if (caller == WAL_INS_WRITER) {
-                    spin_lock(&seq_shards[seq_shard_num].lock);
-                }
-                hash_insert(&seq_shards[seq_shard_num]._map, &item->he_seq);
-                if (caller == WAL_INS_WRITER) {
-                    spin_unlock(&seq_shards[seq_shard_num].lock);
-                }
-            }
             // insert into header's list
+            spin_lock(&header->lock);
             list_push_front(&header->items, &item->list_elem);
+            spin_unlock(&header->lock);
+            if (seqtree) {
+                skiplist_insert(&seq_index, &item->snode_seq);
+            }
             // also insert into transaction's list
             list_push_back(txn->items, &item->list_elem_txn);
             size++;
@@ -791,20 +816,22 @@ inline fdb_status Wal::_insert_Wal(fdb_txn *txn,
     } else {
         // not exist .. create new one
         // create new header and new item
-        header = (struct wal_item_header*)malloc(sizeof(struct wal_item_header));
+        header = (struct wal_item_header*)
+                 slab_arenas[shard_num].alloc(sizeof(struct wal_item_header));
         list_init(&header->items);
+        spin_init(&header->lock);
+        skiplist_init_node(&header->snode);
         header->checksum = static_cast<uint32_t>(chk_sum);
         header->keylen = keylen;
-        header->key = (void *)malloc(header->keylen);
+        header->key = slab_arenas[shard_num].alloc(header->keylen);
         memcpy(header->key, key, header->keylen);
 
-        hash_insert_by_hash_val(&key_shards[shard_num]._map,
-                                &header->he_key, (uint32_t)chk_sum);
         // insert an item header into a WAL shard's list
         list_push_back(&key_shards[shard_num]._list,
                        &header->le_key);
 
-        item = (struct wal_item *)malloc(sizeof(struct wal_item));
+        item = (struct wal_item *)
+               slab_arenas[shard_num].alloc(sizeof(struct wal_item));
         // entries inserted by compactor is already committed
         if (caller == WAL_INS_COMPACT_PHASE1) {
             item->flag = WAL_ITEM_COMMITTED;
@@ -820,8 +847,10 @@ inline fdb_status Wal::_insert_Wal(fdb_txn *txn,
             num_flushable++;
         }
         item->header = header;
+        item->kv_id = shandle->id;
 
         item->seqnum = doc->seqnum;
+        skiplist_init_node(&item->snode_seq);
 
         if (doc->deleted) {
             if (item->txn_id == file->getGlobalTxn()->txn_id) {
@@ -853,22 +882,19 @@ inline fdb_status Wal::_insert_Wal(fdb_txn *txn,
                                std::memory_order_relaxed);
         }
 
-        if (file->getConfig()->getSeqtreeOpt() == FDB_SEQTREE_USE) {
-            size_t seq_shard_num = doc->seqnum % num_shards;
-            if (caller == WAL_INS_WRITER) {
-                spin_lock(&seq_shards[seq_shard_num].lock);
-            }
-            hash_insert(&seq_shards[seq_shard_num]._map, &item->he_seq);
-            if (caller == WAL_INS_WRITER) {
-                spin_unlock(&seq_shards[seq_shard_num].lock);
-            }
+        if (seqtree) {
             if (item->txn == file->getGlobalTxn()) {
                 shandle->snapAddItemBySeq(item, nullptr);
             }
         }
 
-        // insert into header's list
+        // insert into header's list, and publish the header and the item
+        // to the readers once they are fully initialized
         list_push_front(&header->items, &item->list_elem);
+        skiplist_insert(&key_index, &header->snode);
+        if (seqtree) {
+            skiplist_insert(&seq_index, &item->snode_seq);
+        }
         if (caller == WAL_INS_WRITER || caller == WAL_INS_COMPACT_PHASE2) {
             // also insert into transaction's list
             list_push_back(txn->items, &item->list_elem_txn);
@@ -882,13 +908,6 @@ inline fdb_status Wal::_insert_Wal(fdb_txn *txn,
             sizeof(struct wal_item) + sizeof(struct wal_item_header) + keylen,
             std::memory_order_relaxed);
     }
-
-    if (caller == WAL_INS_WRITER) {
-        spin_unlock(&key_shards[shard_num].lock);
-    }
-
-    LATENCY_STAT_END(file, FDB_LATENCY_WAL_INS);
-    return FDB_RESULT_SUCCESS;
 }
 
 fdb_status Wal::insert_Wal(fdb_txn *txn,
@@ -909,6 +928,46 @@ fdb_status Wal::immediateRemove_Wal(fdb_txn *txn,
     return _insert_Wal(txn, cmp_info, doc, offset, caller, true);
 }
 
+fdb_status Wal::insertMulti_Wal(fdb_txn *txn,
+                                struct _fdb_key_cmp_info *cmp_info,
+                                struct wal_insert_req *reqs,
+                                size_t num_reqs)
+{
+    size_t i, j;
+    LATENCY_STAT_START();
+
+    if (!num_reqs) {
+        return FDB_RESULT_SUCCESS;
+    }
+
+    // Group the requests by key shard so that each shard lock is grabbed
+    // only once. The sort is stable, so the mutations on the same key
+    // (which always belong to the same shard) are applied in order.
+    std::vector<std::pair<size_t, size_t> > shard_order(num_reqs);
+    std::vector<size_t> chk_sums(num_reqs);
+    for (i = 0; i < num_reqs; ++i) {
+        chk_sums[i] = get_checksum((uint8_t*)reqs[i].doc->key,
+                                   reqs[i].doc->keylen);
+        shard_order[i] = std::make_pair(chk_sums[i] % num_shards, i);
+    }
+    std::stable_sort(shard_order.begin(), shard_order.end());
+
+    for (i = 0; i < num_reqs; i = j) {
+        size_t shard_num = shard_order[i].first;
+        spin_lock(&key_shards[shard_num].lock);
+        for (j = i; j < num_reqs && shard_order[j].first == shard_num; ++j) {
+            struct wal_insert_req *req = &reqs[shard_order[j].second];
+            _insertIntoShard_Wal(txn, cmp_info, req->doc, req->offset,
+                                 WAL_INS_WRITER, req->immediate_remove,
+                                 chk_sums[shard_order[j].second], shard_num);
+        }
+        spin_unlock(&key_shards[shard_num].lock);
+    }
+
+    LATENCY_STAT_END(file, FDB_LATENCY_WAL_INS);
+    return FDB_RESULT_SUCCESS;
+}
+
 inline bool Wal::_wal_item_partially_committed(fdb_txn *global_txn,
                                                struct list *active_txn_list,
                                                fdb_txn *current_txn,
@@ -1019,24 +1078,26 @@ fdb_status Wal::_find_Wal(fdb_txn *txn,
     struct wal_item item_query, *item = NULL;
     struct wal_item_header query, *header = NULL;
     struct list_elem *le = NULL, *_le;
-    struct hash_elem *he = NULL;
+    struct skiplist_node *snode = NULL;
+    uint64_t read_token;
     void *key = doc->key;
     size_t keylen = doc->keylen;
     LATENCY_STAT_START();
 
+    // Readers never take the key shard locks; the indexes are traversed
+    // lock-free, and only the header lock of the key found is grabbed to
+    // examine its items.
     if (doc->seqnum == SEQNUM_NOT_USED || (key && keylen>0)) {
-        size_t chk_sum = get_checksum((uint8_t*)key, keylen);
-        size_t shard_num = chk_sum % num_shards;
-        spin_lock(&key_shards[shard_num].lock);
+        read_token = skiplist_read_begin(&key_index);
         // search by key
         query.key = key;
         query.keylen = keylen;
-        he = hash_find_by_hash_val(&key_shards[shard_num]._map,
-                                   &query.he_key, (uint32_t) chk_sum);
-        if (he) {
+        snode = skiplist_find(&key_index, &query.snode);
+        if (snode) {
             struct wal_item *committed_item = NULL;
             // retrieve header
-            header = _get_entry(he, struct wal_item_header, he_key);
+            header = _get_entry(snode, struct wal_item_header, snode);
+            spin_lock(&header->lock);
             if (shandle) {
                 item = _wal_get_snap_item(header, shandle);
             } else { // regular non-snapshot lookup
@@ -1099,52 +1160,66 @@ fdb_status Wal::_find_Wal(fdb_txn *txn,
                     }
                 }
                 doc->seqnum = item->seqnum;
-                spin_unlock(&key_shards[shard_num].lock);
+                spin_unlock(&header->lock);
+                skiplist_read_end(&key_index, read_token);
                 LATENCY_STAT_END(file, FDB_LATENCY_WAL_FIND);
                 return FDB_RESULT_SUCCESS;
             }
+            spin_unlock(&header->lock);
         }
-        spin_unlock(&key_shards[shard_num].lock);
+        skiplist_read_end(&key_index, read_token);
     } else {
         if (file->getConfig()->getSeqtreeOpt() != FDB_SEQTREE_USE) {
             return FDB_RESULT_INVALID_CONFIG;
         }
         // search by seqnum
-        Snapshot query_shandle;
-        query_shandle.id = kv_id;
-        item_query.shandle = &query_shandle;
+        item_query.header = NULL;
+        item_query.kv_id = kv_id;
         item_query.seqnum = doc->seqnum;
 
-        size_t shard_num = doc->seqnum % num_shards;
-        spin_lock(&seq_shards[shard_num].lock);
-        he = hash_find(&seq_shards[shard_num]._map, &item_query.he_seq);
-        if (he) {
-            item = _get_entry(he, struct wal_item, he_seq);
-            if ((item->flag & WAL_ITEM_COMMITTED) ||
-                (item->txn_id == txn->txn_id) ||
-                (txn->isolation == FDB_ISOLATION_READ_UNCOMMITTED)) {
-                *offset = item->offset;
-                if (item->action == WAL_ACT_INSERT) {
-                    doc->deleted = false;
-                } else {
-                    doc->deleted = true;
-                    if (item->action == WAL_ACT_REMOVE) {
-                        // Immediately deleted & purged doc have no real
-                        // presence on-disk. find_Wal must return SUCCESS
-                        // here to indicate that the doc was deleted to
-                        // prevent main index lookup. Also, it must set the
-                        // offset to BLK_NOT_FOUND to ensure that caller
-                        // does NOT attempt to fetch the doc OR its
-                        // metadata from file.
-                        *offset = BLK_NOT_FOUND;
-                    }
+        read_token = skiplist_read_begin(&seq_index);
+        snode = skiplist_find_greater_or_equal(&seq_index,
+                                               &item_query.snode_seq);
+        if (snode) {
+            item = _get_entry(snode, struct wal_item, snode_seq);
+        }
+        if (item && (item->kv_id != kv_id || item->seqnum != doc->seqnum)) {
+            item = NULL;
+        }
+        if (item) {
+            header = item->header;
+            spin_lock(&header->lock);
+        }
+        // the item might have been un-indexed before its header was locked
+        if (item && !item->snode_seq.is_removed &&
+            ((item->flag & WAL_ITEM_COMMITTED) ||
+             (item->txn_id == txn->txn_id) ||
+             (txn->isolation == FDB_ISOLATION_READ_UNCOMMITTED))) {
+            *offset = item->offset;
+            if (item->action == WAL_ACT_INSERT) {
+                doc->deleted = false;
+            } else {
+                doc->deleted = true;
+                if (item->action == WAL_ACT_REMOVE) {
+                    // Immediately deleted & purged doc have no real
+                    // presence on-disk. find_Wal must return SUCCESS
+                    // here to indicate that the doc was deleted to
+                    // prevent main index lookup. Also, it must set the
+                    // offset to BLK_NOT_FOUND to ensure that caller
+                    // does NOT attempt to fetch the doc OR its
+                    // metadata from file.
+                    *offset = BLK_NOT_FOUND;
                 }
-                spin_unlock(&seq_shards[shard_num].lock);
-                LATENCY_STAT_END(file, FDB_LATENCY_WAL_FIND);
-                return FDB_RESULT_SUCCESS;
             }
+            spin_unlock(&header->lock);
+            skiplist_read_end(&seq_index, read_token);
+            LATENCY_STAT_END(file, FDB_LATENCY_WAL_FIND);
+            return FDB_RESULT_SUCCESS;
         }
-        spin_unlock(&seq_shards[shard_num].lock);
+        if (item) {
+            spin_unlock(&header->lock);
+        }
+        skiplist_read_end(&seq_index, read_token);
     }
 
     LATENCY_STAT_END(file, FDB_LATENCY_WAL_FIND);
@@ -1203,10 +1278,75 @@ inline void Wal::_wal_free_item(struct wal_item *item, bool gotlock) {
             spin_unlock(&lock);
         }
     }
+    _wal_retire_item(item);
+}
+
+// Pre-condition: the header must be un-indexed and empty
+void Wal::_wal_retire_header(struct wal_item_header *header)
+{
+    spin_lock(&retire_lock);
+    list_push_back(&retired_headers, &header->le_key);
+    spin_unlock(&retire_lock);
+}
+
+// Pre-condition: the item must be un-indexed and removed from its header
+void Wal::_wal_retire_item(struct wal_item *item)
+{
+    spin_lock(&retire_lock);
+    list_push_back(&retired_items, &item->list_elem);
+    spin_unlock(&retire_lock);
+}
+
+// Free the retired headers and items once no lock-free reader can reference
+// them anymore. Must not be called with any header lock held, since the
+// readers being waited for may be spinning on it.
+void Wal::_wal_reclaim(void)
+{
+    struct list headers, items;
+    struct list_elem *e;
+
+    spin_lock(&retire_lock);
+    headers = retired_headers;
+    items = retired_items;
+    list_init(&retired_headers);
+    list_init(&retired_items);
+    spin_unlock(&retire_lock);
+
+    if (!list_begin(&headers) && !list_begin(&items)) {
+        return;
+    }
+    skiplist_synchronize(&key_index);
+    skiplist_synchronize(&seq_index);
+
+    e = list_begin(&items);
+    while (e) {
+        struct wal_item *item = _get_entry(e, struct wal_item, list_elem);
+        e = list_next(e);
+        skiplist_free_node(&item->snode_seq);
 #ifdef __DEBUG_WAL
-    memset(item, 0, sizeof(struct wal_item));
+        memset(item, 0, sizeof(struct wal_item));
 #endif // __DEBUG_WAL
-    free(item);
+        SlabArena::release(item, sizeof(struct wal_item));
+    }
+    e = list_begin(&headers);
+    while (e) {
+        struct wal_item_header *header = _get_entry(e, struct wal_item_header,
+                                                    le_key);
+        e = list_next(e);
+        skiplist_free_node(&header->snode);
+        spin_destroy(&header->lock);
+        SlabArena::release(header->key, header->keylen);
+        SlabArena::release(header, sizeof(struct wal_item_header));
+    }
+}
+
+// Hand the slabs emptied by the items released so far back to the system.
+// Called at flush boundaries, where most of the items have just been freed.
+void Wal::_wal_release_slabs(void)
+{
+    for (size_t i = 0; i < num_shards; ++i) {
+        slab_arenas[i].releaseEmptySlabs();
+    }
 }
 
 fdb_status Wal::migrateUncommittedTxns_Wal(void *dbhandle,
@@ -1223,7 +1363,8 @@ fdb_status Wal::migrateUncommittedTxns_Wal(void *dbhandle,
     struct wal_item *item;
     struct list_elem *e, *key_elem;
     size_t i = 0;
-    size_t num_shards = old_file->getWal()->num_shards;
+    Wal *old_wal = old_file->getWal();
+    size_t num_shards = old_wal->num_shards;
     uint64_t mem_overhead = 0;
     struct _fdb_key_cmp_info cmp_info;
 
@@ -1259,17 +1400,15 @@ fdb_status Wal::migrateUncommittedTxns_Wal(void *dbhandle,
                     new_file->getWal()->insert_Wal(item->txn, &cmp_info, &doc, offset,
                                WAL_INS_WRITER);
 
+                    spin_lock(&header->lock);
                     if (old_file->getConfig()->getSeqtreeOpt() == FDB_SEQTREE_USE) {
-                        // remove from seq map
-                        size_t shard_num = item->seqnum % num_shards;
-                        spin_lock(&old_file->getWal()->seq_shards[shard_num].lock);
-                        hash_remove(&old_file->getWal()->seq_shards[shard_num]._map,
-                                    &item->he_seq);
-                        spin_unlock(&old_file->getWal()->seq_shards[shard_num].lock);
+                        // remove from seq index
+                        skiplist_erase(&old_wal->seq_index, &item->snode_seq);
                     }
 
                     // remove from header's list
                     e = list_remove_reverse(&header->items, e);
+                    spin_unlock(&header->lock);
                     // remove from transaction's list
                     list_remove(item->txn->items, &item->list_elem_txn);
                     // decrease num_flushable of old_file if non-transactional update
@@ -1281,7 +1420,7 @@ fdb_status Wal::migrateUncommittedTxns_Wal(void *dbhandle,
                                                           std::memory_order_relaxed);
                     }
                     // free item
-                    free(item);
+                    old_wal->_wal_retire_item(item);
                     // free doc
                     free(doc.key);
                     free(doc.meta);
@@ -1299,12 +1438,10 @@ fdb_status Wal::migrateUncommittedTxns_Wal(void *dbhandle,
                 key_elem = list_next(key_elem);
                 list_remove(&old_file->getWal()->key_shards[i]._list,
                             &header->le_key);
-                hash_remove(&old_file->getWal()->key_shards[i]._map,
-                            &header->he_key);
+                skiplist_erase(&old_wal->key_index, &header->snode);
                 mem_overhead += header->keylen + sizeof(struct wal_item_header);
                 // free key & header
-                free(header->key);
-                free(header);
+                old_wal->_wal_retire_header(header);
             } else {
                 key_elem = list_next(key_elem);
             }
@@ -1313,6 +1450,7 @@ fdb_status Wal::migrateUncommittedTxns_Wal(void *dbhandle,
     }
     old_file->getWal()->mem_overhead.fetch_sub(mem_overhead,
                                           std::memory_order_relaxed);
+    old_wal->_wal_reclaim();
 
     spin_lock(&old_file->getWal()->lock);
 
@@ -1343,6 +1481,7 @@ fdb_status Wal::commit_Wal(fdb_txn *txn, wal_commit_mark_func *func,
 {
     int can_overwrite;
     struct wal_item *item, *_item;
+    struct wal_item_header *header;
     struct list_elem *e1, *e2;
     fdb_kvs_id_t kv_id;
     fdb_status status = FDB_RESULT_SUCCESS;
@@ -1361,9 +1500,12 @@ fdb_status Wal::commit_Wal(fdb_txn *txn, wal_commit_mark_func *func,
     while(e1) {
         item = _get_entry(e1, struct wal_item, list_elem_txn);
         fdb_assert(item->txn_id == txn->txn_id, item->txn_id, txn->txn_id);
-        // Grab the WAL key shard lock.
-        shard_num = item->header->checksum % num_shards;
+        // Grab the WAL key shard lock, and the header lock to keep the
+        // readers from seeing the items being reordered.
+        header = item->header;
+        shard_num = header->checksum % num_shards;
         spin_lock(&key_shards[shard_num].lock);
+        spin_lock(&header->lock);
 
         if (!(item->flag & WAL_ITEM_COMMITTED)) {
             // get KVS ID
@@ -1389,9 +1531,11 @@ fdb_status Wal::commit_Wal(fdb_txn *txn, wal_commit_mark_func *func,
                             _F64 " in "
                             "a database file '%s'", item->offset,
                             file->getFileName());
+                    spin_unlock(&header->lock);
                     spin_unlock(&key_shards[shard_num].lock);
                     mem_overhead.fetch_sub(_mem_overhead,
                                            std::memory_order_relaxed);
+                    _wal_reclaim();
                     return status;
                 }
             }
@@ -1418,14 +1562,10 @@ fdb_status Wal::commit_Wal(fdb_txn *txn, wal_commit_mark_func *func,
                 // committed but not flush-ready
                 // (flush-readied item will be removed by flushing)
                 if (!(_item->flag & WAL_ITEM_FLUSH_READY)) {
-                    // remove from list & hash
+                    // remove from list & index
                     list_remove(&item->header->items, &_item->list_elem);
                     if (file->getConfig()->getSeqtreeOpt() == FDB_SEQTREE_USE) {
-                        size_t seq_shard_num = _item->seqnum % num_shards;
-                        spin_lock(&seq_shards[seq_shard_num].lock);
-                        hash_remove(&seq_shards[seq_shard_num]._map,
-                                    &_item->he_seq);
-                        spin_unlock(&seq_shards[seq_shard_num].lock);
+                        skiplist_erase(&seq_index, &_item->snode_seq);
                     }
 
                     // mark previous doc region as stale
@@ -1468,9 +1608,11 @@ fdb_status Wal::commit_Wal(fdb_txn *txn, wal_commit_mark_func *func,
 
         // remove from transaction's list
         e1 = list_remove(txn->items, e1);
+        spin_unlock(&header->lock);
         spin_unlock(&key_shards[shard_num].lock);
     }
     mem_overhead.fetch_sub(_mem_overhead, std::memory_order_relaxed);
+    _wal_reclaim();
 
     LATENCY_STAT_END(file, FDB_LATENCY_WAL_COMMIT);
     return status;
@@ -1512,16 +1654,13 @@ static int _wal_flush_cmp(struct avl_node *a, struct avl_node *b, void *aux)
     }
 }
 
+// Pre-condition: the item's header lock must be held
 void Wal::releaseItem_Wal(size_t shard_num, fdb_kvs_id_t kv_id,
                           struct wal_item *item)
 {
     list_remove(&item->header->items, &item->list_elem);
     if (file->getConfig()->getSeqtreeOpt() == FDB_SEQTREE_USE) {
-        size_t seq_shard_num;
-        seq_shard_num = item->seqnum % num_shards;
-        spin_lock(&seq_shards[seq_shard_num].lock);
-        hash_remove(&seq_shards[seq_shard_num]._map, &item->he_seq);
-        spin_unlock(&seq_shards[seq_shard_num].lock);
+        skiplist_erase(&seq_index, &item->snode_seq);
     }
 
     if (item->action == WAL_ACT_LOGICAL_REMOVE ||
@@ -1544,6 +1683,7 @@ list_elem *Wal::_releaseItems_Wal(size_t shard_num, struct wal_item *item)
     struct list_elem *le = &item->list_elem;
     struct wal_item_header *header = item->header;
 
+    spin_lock(&header->lock);
     item->flag |= WAL_ITEM_FLUSHED_OUT;
 
     // get KVS ID
@@ -1573,15 +1713,14 @@ list_elem *Wal::_releaseItems_Wal(size_t shard_num, struct wal_item *item)
             item->flag &= ~WAL_ITEM_FLUSH_READY;
         }
     }
+    spin_unlock(&header->lock);
     if (list_begin(&header->items) == NULL) {
         // wal_item_header becomes empty
-        // free header and remove from key map
+        // free header and remove from key index
         list_remove(&key_shards[shard_num]._list, &header->le_key);
-        hash_remove(&key_shards[shard_num]._map,
-                    &header->he_key);
+        skiplist_erase(&key_index, &header->snode);
         _mem_overhead = sizeof(wal_item_header) + header->keylen;
-        free(header->key);
-        free(header);
+        _wal_retire_header(header);
         le = NULL;
     }
     mem_overhead.fetch_sub(_mem_overhead + sizeof(struct wal_item),
@@ -1589,8 +1728,44 @@ list_elem *Wal::_releaseItems_Wal(size_t shard_num, struct wal_item *item)
     return le;
 }
 
+// Returns the stop index of a snapshot created behind a write barrier on the
+// given snapshot: the tag of the latest snapshot flushed since the given one
+// was created, if any, so that the items already in the main index are hidden
+inline wal_snapid_t Wal::_wal_get_flushed_snap_idx(Snapshot *shandle)
+{
+    for (struct list_elem *e = list_prev(&shandle->snaplist_elem);
+         e; e = list_prev(e)) {
+        Snapshot *prev = _get_entry(e, Snapshot, snaplist_elem);
+        if (prev->is_flushed) {
+            if (prev->snap_tag_idx > shandle->snap_stop_idx) {
+                return prev->snap_tag_idx;
+            }
+            break;
+        }
+    }
+    return shandle->snap_stop_idx;
+}
+
+void Wal::freezeSnapshots_Wal(void)
+{
+    struct avl_node *a;
+    spin_lock(&lock);
+    for (a = avl_first(&wal_kvs_snap_tree); a; a = avl_next(a)) {
+        struct wal_kvs_snaps *kvs_snapshots = _get_entry(a, struct wal_kvs_snaps,
+                                                         avl_id);
+        Snapshot *shandle = _wal_get_latest_snapshot(kvs_snapshots);
+        if (shandle && !shandle->is_flushed) {
+            shandle->is_frozen = true;
+        }
+    }
+    snapsFrozen = true;
+    spin_unlock(&lock);
+}
+
 // Mark all snapshots are flushed to indicate that all items have been
 // reflected in the main index and future snapshots must not access these
+// If the snapshots were frozen for a background flush, only the frozen ones
+// and those before them are marked, as the later ones carry newer items
 inline void Wal::_wal_snap_mark_flushed(void)
 {
     struct avl_node *a;
@@ -1598,8 +1773,16 @@ inline void Wal::_wal_snap_mark_flushed(void)
     for (a = avl_first(&wal_kvs_snap_tree); a; a = avl_next(a)) {
         struct wal_kvs_snaps *kvs_snapshots = _get_entry(a, struct wal_kvs_snaps,
                                                          avl_id);
-        for (struct list_elem *e = list_end(&kvs_snapshots->snap_list);
-             e; e = list_prev(e)) {
+        struct list_elem *e = list_end(&kvs_snapshots->snap_list);
+        if (snapsFrozen) { // skip the snapshots created after the freeze
+            for (; e; e = list_prev(e)) {
+                Snapshot *shandle = _get_entry(e, Snapshot, snaplist_elem);
+                if (shandle->is_frozen || shandle->is_flushed) {
+                    break;
+                }
+            }
+        }
+        for (; e; e = list_prev(e)) {
             Snapshot *shandle = _get_entry(e, Snapshot, snaplist_elem);
             if (shandle->is_flushed) {
                 break; // all previous snapshots are already flushed before
@@ -1607,6 +1790,7 @@ inline void Wal::_wal_snap_mark_flushed(void)
             shandle->is_flushed = true;
         }
     }
+    snapsFrozen = false;
 
     // Since all committed transactions are now reflected in main index, until
     // the next transactional commit, we can still safely do MVCC for snapshots
@@ -1667,6 +1851,8 @@ fdb_status Wal::releaseFlushedItems_Wal(union wal_flush_items *flush_items)
             spin_unlock(&key_shards[shard_num].lock);
         }
     }
+    _wal_reclaim();
+    _wal_release_slabs();
 
     LATENCY_STAT_END(file, FDB_LATENCY_WAL_RELEASE);
     return FDB_RESULT_SUCCESS;
@@ -1693,12 +1879,6 @@ inline fdb_status Wal::_wal_do_flush(struct wal_item *item,
     return FDB_RESULT_SUCCESS;
 }
 
-struct fdb_root_info {
-    bid_t orig_id_root;
-    bid_t orig_seq_root;
-    bid_t orig_stale_root;
-};
-
 INLINE void _wal_backup_root_info(void *voidhandle,
                                   struct fdb_root_info *root_info)
 {
@@ -1735,6 +1915,23 @@ INLINE void _wal_restore_root_info(void *voidhandle,
     }
 }
 
+void Wal::_wal_get_old_offsets(void *dbhandle,
+                               wal_get_old_offset_func *get_old_offset,
+                               std::vector<struct wal_item *> &items)
+{
+    FdbKvsHandle *handle = reinterpret_cast<FdbKvsHandle *>(dbhandle);
+    size_t num_threads = handle->config.num_wal_flush_threads;
+
+    if (num_threads > 1 &&
+        items.size() >= 2 * WAL_FLUSH_PARTITION_MIN_ITEMS) {
+        WalOldOffsetLookup::lookup(handle, get_old_offset, items, num_threads);
+        return;
+    }
+    for (auto &entry: items) {
+        entry->old_offset = get_old_offset(dbhandle, entry);
+    }
+}
+
 static int _wal_flush_cmp_v2(struct avl_node *a, struct avl_node *b, void *aux)
 {
     struct wal_item *aa, *bb;
@@ -1760,13 +1957,11 @@ static int _wal_flush_cmp_v2(struct avl_node *a, struct avl_node *b, void *aux)
 
 }
 
-fdb_status Wal::_flush_Wal(void *dbhandle,
-                           wal_flush_func *flush_func,
-                           wal_get_old_offset_func *get_old_offset,
-                           wal_flush_seq_purge_func *seq_purge_func,
-                           wal_flush_kvs_delta_stats_func *delta_stats_func,
-                           union wal_flush_items *flush_items,
-                           bool by_compactor)
+fdb_status Wal::beginFlush_Wal(void *dbhandle,
+                               wal_get_old_offset_func *get_old_offset,
+                               union wal_flush_items *flush_items,
+                               struct wal_flush_cursor *cursor,
+                               bool by_compactor)
 {
     struct avl_tree *tree = &flush_items->tree;
     struct list *list_head = &flush_items->list;
@@ -1774,11 +1969,13 @@ fdb_status Wal::_flush_Wal(void *dbhandle,
     struct list_elem *hdr_e, *save_next_hdr;
     struct wal_item *item;
     struct wal_item_header *header;
-    struct fdb_root_info root_info;
     size_t i = 0;
-    LATENCY_STAT_START();
     bool btreev2 = ver_btreev2_format(file->getVersion());
     bool do_sort = !file->isFullyResident();
+    // items whose old offsets are to be looked up, and the end of each
+    // shard's items in that array
+    std::vector<struct wal_item *> lookup_items;
+    std::vector<size_t> lookup_shard_ends(num_shards);
 
     if (btreev2) {
         // With new B+tree, we don't need to get old offset.
@@ -1792,8 +1989,8 @@ fdb_status Wal::_flush_Wal(void *dbhandle,
         list_init(list_head);
     }
 
-    memset(&root_info, 0xff, sizeof(root_info));
-    _wal_backup_root_info(dbhandle, &root_info);
+    memset(&cursor->root_info, 0xff, sizeof(cursor->root_info));
+    _wal_backup_root_info(dbhandle, &cursor->root_info);
 
     for (; i < num_shards; ++i) {
         spin_lock(&key_shards[i].lock);
@@ -1834,37 +2031,10 @@ fdb_status Wal::_flush_Wal(void *dbhandle,
                             list_push_back(list_head, &item->list_elem_flush);
                         }
                     } else {
-                        spin_unlock(&key_shards[i].lock);
-                        if (btreev2) {
-                            // With new B+tree, we don't need to read old offset.
-                            item->old_offset = BLK_NOT_FOUND;
-                        } else {
-                            item->old_offset = get_old_offset(dbhandle, item);
-                        }
-                        spin_lock(&key_shards[i].lock);
-
-                        if (item->old_offset == item->offset) {
-                            // Sometimes if there are uncommitted transactional
-                            // items along with flushed committed items when
-                            // file was closed, wal_restore can end up inserting
-                            // already flushed items back into WAL.
-                            // We should not try to flush them back again
-                            item->flag |= WAL_ITEM_FLUSHED_OUT;
-                        }
-                        if (item->old_offset == 0 && // doc not in main index
-                            item->action == WAL_ACT_REMOVE) {// insert & delete
-                            item->old_offset = BLK_NOT_FOUND;
-                            item->flag |= WAL_ITEM_FLUSHED_OUT;
-                        }
-                        if (do_sort) {
-                            if (btreev2) {
-                                avl_insert(tree, &item->avl_flush, _wal_flush_cmp_v2);
-                            } else {
-                                avl_insert(tree, &item->avl_flush, _wal_flush_cmp);
-                            }
-                        } else {
-                            list_push_back(list_head, &item->list_elem_flush);
-                        }
+                        // The old offsets are looked up once all the items
+                        // are collected, so that they can be looked up by
+                        // multiple threads.
+                        lookup_items.push_back(item);
                         break; // only pick one item per key
                     }
                 }
@@ -1873,55 +2043,158 @@ fdb_status Wal::_flush_Wal(void *dbhandle,
             hdr_e = save_next_hdr;
         }
         spin_unlock(&key_shards[i].lock);
+        lookup_shard_ends[i] = lookup_items.size();
     }
+    // free the items released above
+    _wal_reclaim();
 
-    file->setIoInprog(); // MB-16622:prevent parallel writes by flusher
+    if (btreev2) {
+        // With new B+tree, we don't need to read old offset.
+        for (auto &entry: lookup_items) {
+            entry->old_offset = BLK_NOT_FOUND;
+        }
+    } else {
+        _wal_get_old_offsets(dbhandle, get_old_offset, lookup_items);
+    }
+
+    size_t pos = 0;
+    for (i = 0; i < num_shards; ++i) {
+        if (pos == lookup_shard_ends[i]) {
+            continue;
+        }
+        spin_lock(&key_shards[i].lock);
+        for (; pos < lookup_shard_ends[i]; ++pos) {
+            item = lookup_items[pos];
+            if (item->old_offset == item->offset) {
+                // Sometimes if there are uncommitted transactional
+                // items along with flushed committed items when
+                // file was closed, wal_restore can end up inserting
+                // already flushed items back into WAL.
+                // We should not try to flush them back again
+                item->flag |= WAL_ITEM_FLUSHED_OUT;
+            }
+            if (item->old_offset == 0 && // doc not in main index
+                item->action == WAL_ACT_REMOVE) {// insert & delete
+                item->old_offset = BLK_NOT_FOUND;
+                item->flag |= WAL_ITEM_FLUSHED_OUT;
+            }
+            if (do_sort) {
+                if (btreev2) {
+                    avl_insert(tree, &item->avl_flush, _wal_flush_cmp_v2);
+                } else {
+                    avl_insert(tree, &item->avl_flush, _wal_flush_cmp);
+                }
+            } else {
+                list_push_back(list_head, &item->list_elem_flush);
+            }
+        }
+        spin_unlock(&key_shards[i].lock);
+    }
+
+    cursor->flush_items = flush_items;
+    if (do_sort) {
+        cursor->next_node = avl_first(tree);
+    } else {
+        cursor->next_elem = list_begin(list_head);
+    }
+    avl_init(&cursor->stale_seqnum_list, NULL);
+    avl_init(&cursor->kvs_delta_stats, NULL);
+    return FDB_RESULT_SUCCESS;
+}
+
+fdb_status Wal::flushBatch_Wal(void *dbhandle,
+                               wal_flush_func *flush_func,
+                               struct wal_flush_cursor *cursor,
+                               size_t max_items,
+                               bool *done)
+{
+    struct wal_item *item;
+    size_t num_items = 0;
     fdb_status fs = FDB_RESULT_SUCCESS;
-    struct avl_tree stale_seqnum_list;
-    struct avl_tree kvs_delta_stats;
-    avl_init(&stale_seqnum_list, NULL);
-    avl_init(&kvs_delta_stats, NULL);
+
+    file->setIoInprog(); // MB-16622:prevent parallel writes by flusher
 
     // scan and flush entries in the avl-tree or list
-    if (do_sort) {
-        struct avl_node *a = avl_first(tree);
-        while (a) {
+    if (_wal_are_items_sorted(cursor->flush_items)) {
+        struct avl_node *a = cursor->next_node;
+        while (a && num_items < max_items) {
             item = _get_entry(a, struct wal_item, avl_flush);
             a = avl_next(a);
             if (item->flag & WAL_ITEM_FLUSHED_OUT) {
                 continue; // need not flush this item into main index..
             } // item exists solely for in-memory snapshots
             fs = _wal_do_flush(item, flush_func, dbhandle,
-                               &stale_seqnum_list, &kvs_delta_stats);
+                               &cursor->stale_seqnum_list,
+                               &cursor->kvs_delta_stats);
             if (fs != FDB_RESULT_SUCCESS) {
-                _wal_restore_root_info(dbhandle, &root_info);
+                _wal_restore_root_info(dbhandle, &cursor->root_info);
+                a = NULL;
                 break;
             }
+            num_items++;
         }
+        cursor->next_node = a;
+        *done = (a == NULL);
     } else {
-        struct list_elem *a = list_begin(list_head);
-        while (a) {
+        struct list_elem *a = cursor->next_elem;
+        while (a && num_items < max_items) {
             item = _get_entry(a, struct wal_item, list_elem_flush);
             a = list_next(a);
             if (item->flag & WAL_ITEM_FLUSHED_OUT) {
                 continue; // need not flush this item into main index..
             } // item exists solely for in-memory snapshots
             fs = _wal_do_flush(item, flush_func, dbhandle,
-                               &stale_seqnum_list, &kvs_delta_stats);
+                               &cursor->stale_seqnum_list,
+                               &cursor->kvs_delta_stats);
             if (fs != FDB_RESULT_SUCCESS) {
-                _wal_restore_root_info(dbhandle, &root_info);
+                _wal_restore_root_info(dbhandle, &cursor->root_info);
+                a = NULL;
                 break;
             }
+            num_items++;
         }
+        cursor->next_elem = a;
+        *done = (a == NULL);
     }
 
+    file->clearIoInprog();
+    return fs;
+}
+
+void Wal::endFlush_Wal(void *dbhandle,
+                       wal_flush_seq_purge_func *seq_purge_func,
+                       wal_flush_kvs_delta_stats_func *delta_stats_func,
+                       struct wal_flush_cursor *cursor)
+{
+    file->setIoInprog();
     // Remove all stale seq entries from the seq tree
-    seq_purge_func(dbhandle, &stale_seqnum_list, &kvs_delta_stats);
+    seq_purge_func(dbhandle, &cursor->stale_seqnum_list,
+                   &cursor->kvs_delta_stats);
     // Update each KV store stats after WAL flush
-    delta_stats_func(file, &kvs_delta_stats);
-
+    delta_stats_func(file, &cursor->kvs_delta_stats);
     file->clearIoInprog();
-    LATENCY_STAT_END(file, FDB_LATENCY_WAL_FLUSH);
+}
+
+fdb_status Wal::_flush_Wal(void *dbhandle,
+                           wal_flush_func *flush_func,
+                           wal_get_old_offset_func *get_old_offset,
+                           wal_flush_seq_purge_func *seq_purge_func,
+                           wal_flush_kvs_delta_stats_func *delta_stats_func,
+                           union wal_flush_items *flush_items,
+                           bool by_compactor)
+{
+    struct wal_flush_cursor cursor;
+    bool done;
+    LATENCY_STAT_START();
+
+    beginFlush_Wal(dbhandle, get_old_offset, flush_items, &cursor,
+                   by_compactor);
+    fdb_status fs = flushBatch_Wal(dbhandle, flush_func, &cursor,
+                                   (size_t)-1, &done);
+    endFlush_Wal(dbhandle, seq_purge_func, delta_stats_func, &cursor);
+
+    LATENCY_STAT_END(file, by_compactor ? FDB_LATENCY_WAL_FLUSH_COMPACT
+                                        : FDB_LATENCY_WAL_FLUSH);
     return fs;
 }
 
@@ -2335,14 +2608,12 @@ WalItr::WalItr(FileMgr *file,
 {
     // If key_cmp_info is non-null it implies key-range iteration
     if (by_key) {
-        map_shards = file->getWal()->key_shards;
         avl_init(&mergeTree, &shandle->cmp_info);
         this->by_key = true;
     } else {
         // Otherwise wal iteration is requested over sequence range
         fdb_assert(file->getConfig()->getSeqtreeOpt() == FDB_SEQTREE_USE,
                    file->getConfig()->getSeqtreeOpt(), FDB_SEQTREE_USE);
-        map_shards = file->getWal()->seq_shards;
         avl_init(&mergeTree, NULL);
         this->by_key = false;
     }
@@ -2961,37 +3232,37 @@ WalItr::~WalItr()
 fdb_status Wal::discardTxnEntries_Wal(fdb_txn *txn)
 {
     struct wal_item *item;
+    struct wal_item_header *header;
     struct list_elem *e;
-    size_t shard_num, seq_shard_num;
+    size_t shard_num;
     uint64_t _mem_overhead = 0;
 
     e = list_begin(txn->items);
     while(e) {
         item = _get_entry(e, struct wal_item, list_elem_txn);
-        shard_num = item->header->checksum % num_shards;
+        header = item->header;
+        shard_num = header->checksum % num_shards;
         spin_lock(&key_shards[shard_num].lock);
 
+        spin_lock(&header->lock);
         if (file->getConfig()->getSeqtreeOpt() == FDB_SEQTREE_USE) {
-            // remove from seq map
-            seq_shard_num = item->seqnum % num_shards;
-            spin_lock(&seq_shards[seq_shard_num].lock);
-            hash_remove(&seq_shards[seq_shard_num]._map, &item->he_seq);
-            spin_unlock(&seq_shards[seq_shard_num].lock);
+            // remove from seq index
+            skiplist_erase(&seq_index, &item->snode_seq);
         }
 
         // remove from header's list
-        list_remove(&item->header->items, &item->list_elem);
+        list_remove(&header->items, &item->list_elem);
+        spin_unlock(&header->lock);
         // remove header if empty
-        if (list_begin(&item->header->items) == NULL) {
-            //remove from key map
-            hash_remove(&key_shards[shard_num]._map, &item->header->he_key);
+        if (list_begin(&header->items) == NULL) {
+            //remove from key index
+            skiplist_erase(&key_index, &header->snode);
             // remove from shard's key list
-            list_remove(&key_shards[shard_num]._list, &item->header->le_key);
+            list_remove(&key_shards[shard_num]._list, &header->le_key);
             _mem_overhead += sizeof(struct wal_item_header) +
-                             item->header->keylen;
+                             header->keylen;
             // free key and header
-            free(item->header->key);
-            free(item->header);
+            _wal_retire_header(header);
         }
         // remove from txn's list
         e = list_remove(txn->items, e);
@@ -3006,12 +3277,13 @@ fdb_status Wal::discardTxnEntries_Wal(fdb_txn *txn)
         }
 
         // free
-        free(item);
+        _wal_retire_item(item);
         size--;
         _mem_overhead += sizeof(struct wal_item);
         spin_unlock(&key_shards[shard_num].lock);
     }
     mem_overhead.fetch_sub(_mem_overhead, std::memory_order_relaxed);
+    _wal_reclaim();
 
     return FDB_RESULT_SUCCESS;
 }
@@ -3026,7 +3298,7 @@ fdb_status Wal::_close_Wal(wal_discard_t type, void *aux,
     Snapshot *shandle;
     fdb_kvs_id_t kv_id, kv_id_req = 0;
     bool committed;
-    size_t i = 0, seq_shard_num;
+    size_t i = 0;
     uint64_t _mem_overhead = 0;
     struct wal_kvs_snaps query;
 
@@ -3102,6 +3374,7 @@ fdb_status Wal::_close_Wal(wal_discard_t type, void *aux,
             }
 
             committed = false;
+            spin_lock(&header->lock);
             while (e) {
                 item = _get_entry(e, struct wal_item, list_elem);
                 if ( type == WAL_DISCARD_ALL ||
@@ -3123,12 +3396,8 @@ fdb_status Wal::_close_Wal(wal_discard_t type, void *aux,
                     }
 
                     if (file->getConfig()->getSeqtreeOpt() == FDB_SEQTREE_USE) {
-                        // remove from seq hash table
-                        seq_shard_num = item->seqnum % num_shards;
-                        spin_lock(&seq_shards[seq_shard_num].lock);
-                        hash_remove(&seq_shards[seq_shard_num]._map,
-                                    &item->he_seq);
-                        spin_unlock(&seq_shards[seq_shard_num].lock);
+                        // remove from seq index
+                        skiplist_erase(&seq_index, &item->snode_seq);
                     }
 
                     if (item->action != WAL_ACT_REMOVE) {
@@ -3143,30 +3412,32 @@ fdb_status Wal::_close_Wal(wal_discard_t type, void *aux,
                         }
                         num_flushable--;
                     }
-                    free(item);
+                    _wal_retire_item(item);
                     size--;
                     _mem_overhead += sizeof(struct wal_item);
                 } else {
                     e = list_next(e);
                 }
             }
+            spin_unlock(&header->lock);
             hdr_e = list_next(hdr_e);
 
             if (list_begin(&header->items) == NULL) {
                 // wal_item_header becomes empty
-                // free header and remove from key map
-                hash_remove(&key_shards[i]._map, &header->he_key);
+                // free header and remove from key index
+                skiplist_erase(&key_index, &header->snode);
                 // remove from wal key shard list
                 list_remove(&key_shards[i]._list, &header->le_key);
                 _mem_overhead += sizeof(struct wal_item_header) +
                                  header->keylen;
-                free(header->key);
-                free(header);
+                _wal_retire_header(header);
             }
         }
         spin_unlock(&key_shards[i].lock);
     }
     mem_overhead.fetch_sub(_mem_overhead, std::memory_order_relaxed);
+    _wal_reclaim();
+    _wal_release_slabs();
 
     return FDB_RESULT_SUCCESS;
 }
@@ -3226,7 +3497,17 @@ size_t Wal::getDataSize_Wal(void)
 
 size_t Wal::getMemOverhead_Wal(void)
 {
-    return mem_overhead.load(std::memory_order_relaxed);
+    // The overhead of the entries themselves, plus the room that the slab
+    // arenas hold but have not handed out.
+    size_t slab_idle = 0;
+    for (size_t i = 0; i < num_shards; ++i) {
+        size_t reserved = slab_arenas[i].getReservedBytes();
+        size_t used = slab_arenas[i].getUsedBytes();
+        if (reserved > used) {
+            slab_idle += reserved - used;
+        }
+    }
+    return mem_overhead.load(std::memory_order_relaxed) + slab_idle;
 }
 
 void Wal::setDirtyStatus_Wal(wal_dirty_t status,
@@ -18,11 +18,14 @@
 #pragma once
 
 #include <stdint.h>
+#include <vector>
+
 #include "internal_types.h"
-#include "hash.h"
 #include "list.h"
 #include "avltree.h"
 #include "atomic.h"
+#include "skiplist.h"
+#include "slab_arena.h"
 #include "libforestdb/fdb_errors.h"
 
 typedef uint8_t wal_item_action;
@@ -38,12 +41,23 @@ enum {
     WAL_INS_COMPACT_PHASE2 // compactor in delta phase (catchup, uncommitted)
 };
 
+/**
+ * A single mutation to be indexed by Wal::insertMulti_Wal
+ */
+struct wal_insert_req {
+    fdb_doc *doc;
+    uint64_t offset;
+    bool immediate_remove;
+};
+
 struct wal_item_header{
-    struct list_elem le_key;
-    struct hash_elem he_key;
+    struct list_elem le_key; // for wal_shard's list, or the retired list
+    struct skiplist_node snode; // for Wal's key index
     void *key;
     uint16_t keylen;
     uint32_t checksum; // cache key's checksum to avoid recomputation
+    // guards 'items' and the fields of the items against lock-free readers
+    spin_t lock;
     struct list items;
 };
 
@@ -170,6 +184,11 @@ struct Snapshot {
      * Did flush_Wal make me inaccessible to later snapshots, (Read-Write Barrier)
      */
     bool is_flushed;
+    /**
+     * Did freezeSnapshots_Wal hand my items over to a background flush,
+     * (Write barrier until that flush marks me flushed)
+     */
+    bool is_frozen;
     /**
      * Is this a persistent snapshot completely separate from WAL.
      */
@@ -245,13 +264,14 @@ struct wal_kvs_snaps {
 #define WAL_ITEM_IN_SNAP_TREE (0x10)
 
 struct wal_item{
-    struct list_elem list_elem; // for wal_item_header's 'items'
-    struct hash_elem he_seq; // used for indexing by sequence number
+    struct list_elem list_elem; // for wal_item_header's 'items', or retired list
+    struct skiplist_node snode_seq; // used for indexing by sequence number
     struct avl_node avl_keysnap; // for durable snapshot unique key lookup
     struct avl_node avl_seqsnap; // for durable snapshot unique seqnum lookup
     struct wal_item_header *header;
     fdb_txn *txn;
     uint64_t txn_id; // used to track closed transactions
+    fdb_kvs_id_t kv_id; // id of the KV store, for the sequence number index
     Snapshot *shandle; // Pointer into item's parent snapshot
     wal_item_action action;
     std::atomic<uint8_t> flag;
@@ -301,7 +321,6 @@ enum {
 };
 
 struct wal_shard {
-    struct hash _map;
     struct list _list;
     spin_t lock;
 };
@@ -340,6 +359,16 @@ public:
                                    uint64_t offset,
                                    wal_insert_by caller);
 
+    /**
+     * Index a batch of mutations into the Write Ahead Log by normal writer,
+     * grabbing each key shard lock only once for all the mutations that
+     * belong to the shard.
+     */
+    fdb_status insertMulti_Wal(fdb_txn *txn,
+                               struct _fdb_key_cmp_info *cmp_info,
+                               struct wal_insert_req *reqs,
+                               size_t num_reqs);
+
     /**
      * Search WAL item in default or single KV instance mode
      */
@@ -385,6 +414,14 @@ public:
      */
     fdb_status releaseFlushedItems_Wal(union wal_flush_items *flush_items);
 
+    /**
+     * Put a barrier on the latest snapshot of every KV store before the
+     * committed items are handed over to a background flush, so that the
+     * items inserted meanwhile go to later snapshots which the flush does not
+     * mark as flushed when it releases its items.
+     */
+    void freezeSnapshots_Wal(void);
+
     /**
      * Flush WAL entries into the main indexes (i.e., hbtrie and sequence tree)
      *
@@ -428,6 +465,60 @@ public:
                                     wal_flush_seq_purge_func *seq_purge_func,
                                     wal_flush_kvs_delta_stats_func *delta_stats_func,
                                     union wal_flush_items *flush_items);
+    /**
+     * Start a WAL flush that is applied to the main indexes in several steps,
+     * so that the file lock can be released in between. The committed items
+     * are collected as in flush_Wal(), and become immutable until they are
+     * released.
+     *
+     * @param dbhandle Pointer to the KV store handle
+     * @param get_old_offset Pointer of function that retrieves an offset of the
+     *                       old KV item from the hbtrie
+     * @param flush_items Pointer to the list that receives all the WAL entries
+     *                    to be flushed
+     * @param cursor Progress of the flush, to be passed to the calls below
+     * @param by_compactor True if called by the compactor
+     * @return FDB_RESULT_SUCCESS on success
+     */
+    fdb_status beginFlush_Wal(void *dbhandle,
+                              wal_get_old_offset_func *get_old_offset,
+                              union wal_flush_items *flush_items,
+                              struct wal_flush_cursor *cursor,
+                              bool by_compactor);
+
+    /**
+     * Flush the next collected WAL entries into the main indexes.
+     *
+     * @param dbhandle Pointer to the KV store handle
+     * @param flush_func Pointer of function that flushes each WAL entry into the
+     *                   main indexes
+     * @param cursor Progress of the flush
+     * @param max_items Maximum number of entries to flush
+     * @param done Set to true once all the entries are flushed, or if the flush
+     *             failed
+     * @return FDB_RESULT_SUCCESS on success
+     */
+    fdb_status flushBatch_Wal(void *dbhandle,
+                              wal_flush_func *flush_func,
+                              struct wal_flush_cursor *cursor,
+                              size_t max_items,
+                              bool *done);
+
+    /**
+     * Finish a WAL flush started by beginFlush_Wal(): purge the stale entries
+     * from the sequence tree and update the KV store stats.
+     *
+     * @param dbhandle Pointer to the KV store handle
+     * @param seq_purge_func Pointer of function that purges an old entry with the
+     *                       same key from the sequence tree
+     * @param delta_stats_func Pointer of function that updates each KV store's stats
+     * @param cursor Progress of the flush
+     */
+    void endFlush_Wal(void *dbhandle,
+                      wal_flush_seq_purge_func *seq_purge_func,
+                      wal_flush_kvs_delta_stats_func *delta_stats_func,
+                      struct wal_flush_cursor *cursor);
+
     /**
      * Create a WAL snapshot for a specific KV Store
      * @param file - the underlying file for the database
@@ -538,6 +629,14 @@ private:
                            uint64_t offset,
                            wal_insert_by caller,
                            bool immediate_remove);
+    void _insertIntoShard_Wal(fdb_txn *txn,
+                              struct _fdb_key_cmp_info *cmp_info,
+                              fdb_doc *doc,
+                              uint64_t offset,
+                              wal_insert_by caller,
+                              bool immediate_remove,
+                              size_t chk_sum,
+                              size_t shard_num);
     fdb_status _find_Wal(fdb_txn *txn,
                          fdb_kvs_id_t kv_id,
                          struct _fdb_key_cmp_info *cmp_info,
@@ -564,6 +663,7 @@ private:
     Snapshot * _wal_get_latest_snapshot(struct wal_kvs_snaps *slist);
 
     void _wal_snap_mark_flushed(void);
+    wal_snapid_t _wal_get_flushed_snap_idx(Snapshot *shandle);
 
     // When a snapshot reader has called snapshotOpen_Wal(), the ref count
     // on the snapshot handle will be incremented
@@ -595,6 +695,10 @@ private:
                                         Snapshot *shandle);
 
     void _wal_free_item(struct wal_item *item, bool gotlock);
+    void _wal_retire_header(struct wal_item_header *header);
+    void _wal_retire_item(struct wal_item *item);
+    void _wal_reclaim(void);
+    void _wal_release_slabs(void);
     /*
      * Given a key, return the version of the key which was valid at the
      * time of the given snapshot creation
@@ -603,6 +707,9 @@ private:
                                         Snapshot *shandle);
 
     bool _wal_are_items_sorted(union wal_flush_items *flush_items);
+    void _wal_get_old_offsets(void *dbhandle,
+                              wal_get_old_offset_func *get_old_offset,
+                              std::vector<struct wal_item *> &items);
     fdb_status _wal_do_flush(struct wal_item *item,
                              wal_flush_func *flush_func,
                              void *dbhandle,
@@ -618,13 +725,24 @@ private:
     wal_dirty_t wal_dirty;
     // Are there uncommitted or, committed but not flushed, Transactions..
     std::atomic<bool> unFlushedTransactions; //TODO:Transactional Snapshots
-    // tree of all 'wal_item_header' (keys) in shard
+    // list of all 'wal_item_header' (keys) in shard, serializes the writers
     struct wal_shard *key_shards;
-    // indexes 'wal_item's seq num in WAL shard
-    struct wal_shard *seq_shards;
     size_t num_shards;
+    // slab arenas of the items, headers and keys, one per key shard
+    SlabArena *slab_arenas;
+    // ordered index of all 'wal_item_header's by key, shared by all shards
+    struct skiplist_raw key_index;
+    // ordered index of 'wal_item's by KV store id and seq num
+    struct skiplist_raw seq_index;
+    // headers and items removed from the indexes, waiting for the readers
+    // that may still reference them before being freed
+    struct list retired_headers;
+    struct list retired_items;
+    spin_t retire_lock;
     // Global shared WAL Snapshot Data
     struct avl_tree wal_kvs_snap_tree;
+    // Set while the frozen snapshots wait for their background flush
+    bool snapsFrozen;
     spin_t lock;
     FileMgr *file;
     DISALLOW_COPY_AND_ASSIGN(Wal);
@@ -702,7 +820,6 @@ private:
     struct wal_item * _lastBySeq_WalItr(void);
 
     Wal *_wal; // Pointer to global WAL
-    struct wal_shard *map_shards; // pointer to the shared WAL key/seq shards
     Snapshot *shandle; // Pointer to KVS snapshot handle.
     bool by_key; // if not set means iteration is by sequence number range
     bool multi_kvs; // single kv mode vs multi kv instance mode
@@ -737,3 +854,26 @@ union wal_flush_items {
     struct avl_tree tree; // if WAL items are to be sorted by offset
     struct list list; // if WAL items need not be sorted
 };
+
+/**
+ * Index roots saved before a WAL flush, restored if the flush fails.
+ */
+struct fdb_root_info {
+    bid_t orig_id_root;
+    bid_t orig_seq_root;
+    bid_t orig_stale_root;
+};
+
+/**
+ * Progress of a WAL flush that is applied in several steps.
+ */
+struct wal_flush_cursor {
+    union wal_flush_items *flush_items;
+    union {
+        struct avl_node *next_node; // next item to flush if sorted
+        struct list_elem *next_elem; // next item to flush otherwise
+    };
+    struct avl_tree stale_seqnum_list;
+    struct avl_tree kvs_delta_stats;
+    struct fdb_root_info root_info;
+};
@@ -0,0 +1,439 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2016 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <algorithm>
+#include <sstream>
+
+#include "wal_flusher.h"
+#include "fdb_engine.h"
+#include "fdb_internal.h"
+#include "hbtrie.h"
+#include "btree.h"
+#include "btree_new.h"
+#include "btree_kv.h"
+#include "btreeblock.h"
+#include "bnodemgr.h"
+#include "docio.h"
+#include "executorpool.h"
+#include "rate_limiter.h"
+#include "task_priority.h"
+
+#include "memleak.h"
+
+fdb_status BgWalFlush::start(FdbKvsHandle *handle)
+{
+    FileMgr *file = handle->file;
+
+    // commit only for non-transactional WAL entries; they become the frozen
+    // generation, while the new insertions go to the next one.
+    fdb_status fs = file->getWal()->commit_Wal(file->getGlobalTxn(), NULL,
+                                               &handle->log_callback);
+    if (fs != FDB_RESULT_SUCCESS) {
+        return fs;
+    }
+    file->getWal()->freezeSnapshots_Wal();
+
+    BgWalFlush *flush = new BgWalFlush(handle,
+                                       file->getWal()->getNumFlushable_Wal());
+    file->setPendingWalFlush(flush);
+
+    ExTask task = new WalFlushTask(file);
+    file->scheduleTask(task);
+    return FDB_RESULT_SUCCESS;
+}
+
+BgWalFlush::BgWalFlush(FdbKvsHandle *_handle, size_t num_items)
+    : isBtreeV2(ver_btreev2_format(_handle->file->getVersion())),
+      begun(false), numItems(num_items), prevNode(NULL), newNode(NULL),
+      dirtyIdtreeRoot(BLK_NOT_FOUND), dirtySeqtreeRoot(BLK_NOT_FOUND)
+{
+    handle = *_handle;
+    handle.staletree = NULL;
+    handle.staletreeV2 = NULL;
+    handle.seqtree = NULL;
+    handle.seqtrie = NULL;
+    handle.seqtreeV2 = NULL;
+    handle.bhandle = NULL;
+    handle.bnodeMgr = NULL;
+
+    FileMgr *file = handle.file;
+
+    // Private index handles, starting from the roots of the writer's handle.
+    handle.dhandle = new DocioHandle(file, handle.config.compress_document_body,
+                                     &handle.log_callback);
+    if (isBtreeV2) {
+        handle.bnodeMgr = new BnodeMgr();
+        handle.bnodeMgr->setFile(file);
+        handle.bnodeMgr->setLogCallback(&handle.log_callback);
+        handle.trie = new HBTrie(handle.config.chunksize, file->getBlockSize(),
+                                 _handle->trie->getRootAddr(),
+                                 handle.bnodeMgr, file);
+        if (handle.kvs) {
+            handle.trie->setCmpFuncCB(FdbEngine::getCmpFuncCB);
+        }
+    } else {
+        handle.bhandle = new BTreeBlkHandle(file, file->getBlockSize());
+        handle.bhandle->setLogCallback(&handle.log_callback);
+        handle.trie = new HBTrie(handle.config.chunksize, OFFSET_SIZE,
+                                 file->getBlockSize(),
+                                 _handle->trie->getRootBid(),
+                                 handle.bhandle, (void *)handle.dhandle,
+                                 _fdb_readkey_wrap);
+        handle.trie->setLeafHeightLimit(0xff);
+        handle.trie->setLeafCmp(_fdb_custom_cmp_wrap);
+        if (handle.kvs) {
+            handle.trie->setMapFunction(fdb_kvs_find_cmp_chunk);
+        }
+    }
+
+    if (handle.config.seqtree_opt == FDB_SEQTREE_USE) {
+        if (handle.kvs) {
+            if (isBtreeV2) {
+                handle.seqtrie = new HBTrie(sizeof(fdb_kvs_id_t),
+                                            file->getBlockSize(),
+                                            _handle->seqtrie->getRootAddr(),
+                                            handle.bnodeMgr, file);
+            } else {
+                handle.seqtrie = new HBTrie(sizeof(fdb_kvs_id_t), OFFSET_SIZE,
+                                            file->getBlockSize(),
+                                            _handle->seqtrie->getRootBid(),
+                                            handle.bhandle,
+                                            (void *)handle.dhandle,
+                                            _fdb_readseq_wrap);
+            }
+        } else {
+            if (isBtreeV2) {
+                handle.seqtreeV2 = new BtreeV2();
+                handle.seqtreeV2->setBMgr(handle.bnodeMgr);
+                handle.seqtreeV2->initFromAddr(
+                                      _handle->seqtreeV2->getRootAddr());
+            } else {
+                BTreeKVOps *seq_kv_ops =
+                    new FixedKVOps(8, 8, _cmp_uint64_t_endian_safe);
+                handle.seqtree = new BTree(handle.bhandle, seq_kv_ops,
+                                           handle.config.blocksize,
+                                           _handle->seqtree->getRootBid());
+            }
+        }
+    }
+
+    // Apply the flush on top of the latest dirty updates.
+    _fdb_dirty_update_ready(&handle, &prevNode, &newNode,
+                            &dirtyIdtreeRoot, &dirtySeqtreeRoot, true);
+}
+
+BgWalFlush::~BgWalFlush()
+{
+    if (isBtreeV2) {
+        handle.bnodeMgr->releaseCleanNodes();
+    } else {
+        handle.bhandle->flushBuffer();
+    }
+
+    delete handle.trie;
+    if (handle.config.seqtree_opt == FDB_SEQTREE_USE) {
+        if (handle.kvs) {
+            delete handle.seqtrie;
+        } else if (isBtreeV2) {
+            delete handle.seqtreeV2;
+        } else {
+            delete handle.seqtree->getKVOps();
+            delete handle.seqtree;
+        }
+    }
+    if (isBtreeV2) {
+        delete handle.bnodeMgr;
+    } else {
+        delete handle.bhandle;
+    }
+    delete handle.dhandle;
+}
+
+bool BgWalFlush::step()
+{
+    Wal *wal = handle.file->getWal();
+    bool done = false;
+
+    if (!begun) {
+        wal->beginFlush_Wal((void *)&handle, WalFlushCallbacks::getOldOffset,
+                            &flushItems, &cursor, false);
+        begun = true;
+    }
+
+    fdb_status fs = wal->flushBatch_Wal((void *)&handle,
+                                        WalFlushCallbacks::flushItem,
+                                        &cursor, BG_WAL_FLUSH_BATCH_SIZE,
+                                        &done);
+    if (done) {
+        wal->endFlush_Wal((void *)&handle,
+                          WalFlushCallbacks::purgeSeqTreeEntry,
+                          WalFlushCallbacks::updateKvsDeltaStats, &cursor);
+        finish(fs);
+    }
+    return done;
+}
+
+void BgWalFlush::finish(fdb_status status)
+{
+    FileMgr *file = handle.file;
+
+    if (status != FDB_RESULT_SUCCESS) {
+        if (!isBtreeV2) {
+            handle.bhandle->clearDirtyUpdate();
+            FileMgr::dirtyUpdateCloseNode(prevNode);
+            file->dirtyUpdateRemoveNode(newNode);
+        }
+        fdb_log(&handle.log_callback, status,
+                "Background WAL flush failed in a database file '%s'",
+                file->getFileName());
+        return;
+    }
+
+    _fdb_dirty_update_finalize(&handle, prevNode, newNode,
+                               &dirtyIdtreeRoot, &dirtySeqtreeRoot, false);
+
+    file->getWal()->setDirtyStatus_Wal(FDB_WAL_PENDING);
+    // The flushed items are not visible from the main index until the next
+    // commit, so they can be released now as in the foreground flush.
+    file->getWal()->releaseFlushedItems_Wal(&flushItems);
+
+    if (!isBtreeV2) {
+        handle.bhandle->resetSubblockInfo();
+    }
+}
+
+WalFlushTask::WalFlushTask(FileMgr *_file)
+    : GlobalTask(*_file->getTaskable(), Priority::WalFlusherPriority,
+                 0, false),
+      file(_file) { }
+
+bool WalFlushTask::run()
+{
+    IoRateLimiter::BackgroundScope bg_scope;
+
+    file->mutexLockForAppend();
+    bool more = file->stepPendingWalFlush();
+    file->mutexUnlock();
+    return more;
+}
+
+std::string WalFlushTask::getDescription()
+{
+    std::stringstream ss;
+    ss << "Flushing the WAL of file " << file->getFileName();
+    return ss.str();
+}
+
+static bool _wal_lookup_key_less(struct wal_item *a, struct wal_item *b)
+{
+    size_t len = MIN(a->header->keylen, b->header->keylen);
+    int cmp = memcmp(a->header->key, b->header->key, len);
+    if (cmp != 0) {
+        return cmp < 0;
+    }
+    return a->header->keylen < b->header->keylen;
+}
+
+static bool _wal_lookup_same_chunk(struct wal_item *a, struct wal_item *b,
+                                   size_t chunksize)
+{
+    if (a->header->keylen < chunksize || b->header->keylen < chunksize) {
+        return a->header->keylen == b->header->keylen &&
+               !memcmp(a->header->key, b->header->key, a->header->keylen);
+    }
+    return !memcmp(a->header->key, b->header->key, chunksize);
+}
+
+// Create the index handles of a lookup worker, starting from the flushing
+// handle's root; only the by-key trie is needed to find the old offsets.
+static FdbKvsHandle *_wal_lookup_handle_create(FdbKvsHandle *handle)
+{
+    FileMgr *file = handle->file;
+    FdbKvsHandle *lhandle = new FdbKvsHandle();
+
+    *lhandle = *handle;
+    lhandle->staletree = NULL;
+    lhandle->seqtree = NULL;
+    lhandle->seqtrie = NULL;
+    lhandle->dhandle = new DocioHandle(file,
+                                       handle->config.compress_document_body,
+                                       &lhandle->log_callback);
+    lhandle->bhandle = new BTreeBlkHandle(file, file->getBlockSize());
+    lhandle->bhandle->setLogCallback(&lhandle->log_callback);
+    // read the index blocks updated by the previous WAL flushes
+    lhandle->bhandle->setDirtyUpdate(handle->bhandle->getDirtyUpdate());
+    lhandle->trie = new HBTrie(handle->config.chunksize, OFFSET_SIZE,
+                               file->getBlockSize(),
+                               handle->trie->getRootBid(),
+                               lhandle->bhandle, (void *)lhandle->dhandle,
+                               _fdb_readkey_wrap);
+    lhandle->trie->setLeafHeightLimit(handle->trie->getLeafHeightLimit());
+    lhandle->trie->setLeafCmp(_fdb_custom_cmp_wrap);
+    if (lhandle->kvs) {
+        lhandle->trie->setMapFunction(fdb_kvs_find_cmp_chunk);
+    }
+    return lhandle;
+}
+
+static void _wal_lookup_handle_free(FdbKvsHandle *lhandle)
+{
+    lhandle->bhandle->clearDirtyUpdate();
+    delete lhandle->trie;
+    delete lhandle->bhandle;
+    delete lhandle->dhandle;
+    delete lhandle;
+}
+
+void WalOldOffsetLookup::lookup(FdbKvsHandle *handle,
+                                wal_get_old_offset_func *get_old_offset,
+                                std::vector<struct wal_item *> &items,
+                                size_t num_threads)
+{
+    FileMgr *file = handle->file;
+    size_t num_workers = num_threads - 1;
+    std::vector<FdbKvsHandle *> worker_handles(num_workers);
+    size_t i;
+
+    // One reference for the flushing thread, and one for each worker task.
+    WalOldOffsetLookup *job = new WalOldOffsetLookup(get_old_offset, items,
+                                                     num_workers + 1);
+    job->partition(handle->config.chunksize, num_threads);
+    if (job->partitions.size() < 2) {
+        num_workers = 0;
+    }
+
+    for (i = 0; i < num_workers; ++i) {
+        worker_handles[i] = _wal_lookup_handle_create(handle);
+        ExTask task = new WalLookupTask(file, job, worker_handles[i]);
+        file->scheduleTask(task);
+    }
+    for (; i < worker_handles.size(); ++i) {
+        worker_handles[i] = NULL;
+        job->release();
+    }
+
+    job->lookupPartitions((void *)handle);
+
+    // Wait for the workers that are still looking up their partitions;
+    // those that didn't start yet will find the lookup closed.
+    {
+        UniqueLock lh(job->syncObj);
+        job->closed = true;
+        while (job->numActive) {
+            job->syncObj.wait(lh);
+        }
+    }
+    job->release();
+
+    for (i = 0; i < num_workers; ++i) {
+        _wal_lookup_handle_free(worker_handles[i]);
+    }
+}
+
+WalOldOffsetLookup::WalOldOffsetLookup(wal_get_old_offset_func *get_old_offset,
+                                       const std::vector<struct wal_item *> &_items,
+                                       size_t ref_count)
+    : getOldOffset(get_old_offset), items(_items), nextPartition(0),
+      refCount(ref_count), closed(false), numActive(0) { }
+
+void WalOldOffsetLookup::partition(size_t chunksize, size_t num_threads)
+{
+    size_t num_items = items.size();
+    size_t target = num_items / (num_threads * WAL_FLUSH_PARTITIONS_PER_THREAD);
+    size_t begin = 0;
+
+    if (target < WAL_FLUSH_PARTITION_MIN_ITEMS) {
+        target = WAL_FLUSH_PARTITION_MIN_ITEMS;
+    }
+
+    // Items of the same KV store (or the same first chunk) are contiguous
+    // once sorted by key; cut the partitions at chunk boundaries, unless a
+    // single chunk holds too many items. The caller's array keeps its order.
+    std::sort(items.begin(), items.end(), _wal_lookup_key_less);
+    for (size_t i = 1; i <= num_items; ++i) {
+        if (i == num_items ||
+            (i - begin >= target &&
+             (i - begin >= 2 * target ||
+              !_wal_lookup_same_chunk(items[i - 1], items[i], chunksize)))) {
+            partitions.push_back(std::make_pair(begin, i));
+            begin = i;
+        }
+    }
+}
+
+bool WalOldOffsetLookup::enter()
+{
+    LockHolder lh(syncObj);
+    if (closed) {
+        return false;
+    }
+    numActive++;
+    return true;
+}
+
+void WalOldOffsetLookup::leave()
+{
+    LockHolder lh(syncObj);
+    if (--numActive == 0) {
+        syncObj.notify_all();
+    }
+}
+
+void WalOldOffsetLookup::lookupPartitions(void *dbhandle)
+{
+    size_t p;
+    while ((p = nextPartition.fetch_add(1)) < partitions.size()) {
+        for (size_t i = partitions[p].first; i < partitions[p].second; ++i) {
+            items[i]->old_offset = getOldOffset(dbhandle, items[i]);
+        }
+    }
+}
+
+void WalOldOffsetLookup::release()
+{
+    if (refCount.fetch_sub(1) == 1) {
+        delete this;
+    }
+}
+
+WalLookupTask::WalLookupTask(FileMgr *_file, WalOldOffsetLookup *_lookup,
+                             FdbKvsHandle *_handle)
+    : GlobalTask(*_file->getTaskable(), Priority::WalFlusherPriority,
+                 0, false),
+      file(_file), lookup(_lookup), handle(_handle) { }
+
+WalLookupTask::~WalLookupTask()
+{
+    // also reached when the task is cancelled without having run
+    lookup->release();
+}
+
+bool WalLookupTask::run()
+{
+    if (lookup->enter()) {
+        lookup->lookupPartitions((void *)handle);
+        lookup->leave();
+    }
+    return false;
+}
+
+std::string WalLookupTask::getDescription()
+{
+    std::stringstream ss;
+    ss << "Looking up the WAL items to flush in file " << file->getFileName();
+    return ss.str();
+}
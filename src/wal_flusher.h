@@ -0,0 +1,190 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2016 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "filemgr.h"
+#include "globaltask.h"
+#include "kvs_handle.h"
+#include "sync_object.h"
+#include "wal.h"
+
+// Number of WAL items flushed per grab of the file mutex
+#define BG_WAL_FLUSH_BATCH_SIZE (256)
+
+// Minimum number of WAL items in a partition looked up by a single thread
+#define WAL_FLUSH_PARTITION_MIN_ITEMS (256)
+// Number of partitions per lookup thread, to balance their load
+#define WAL_FLUSH_PARTITIONS_PER_THREAD (4)
+
+/**
+ * WAL flush applied in the background (see fdb_config.background_wal_flush).
+ *
+ * The committed WAL items are frozen into an immutable generation when the
+ * WAL hits its threshold; the writers keep inserting new items into the WAL,
+ * and the lookups keep finding both generations there until the frozen one
+ * is released at the end of the flush. The flush works on a private copy of
+ * the writer's handle with its own index handles, so that the writer's
+ * handle can be used again as soon as the flush is handed over.
+ */
+class BgWalFlush : public PendingWalFlush {
+public:
+    /**
+     * Freeze the WAL items of the handle's file and schedule their flush.
+     * Should be called with the file mutex held and no flush pending.
+     *
+     * @param handle Pointer to the writer's KV store handle
+     * @return FDB_RESULT_SUCCESS on success
+     */
+    static fdb_status start(FdbKvsHandle *handle);
+
+    ~BgWalFlush();
+
+    bool step();
+
+    size_t getNumItems() {
+        return numItems;
+    }
+
+private:
+    BgWalFlush(FdbKvsHandle *handle, size_t num_items);
+
+    void finish(fdb_status status);
+
+    FdbKvsHandle handle;
+    bool isBtreeV2;
+    bool begun;
+    size_t numItems;
+    union wal_flush_items flushItems;
+    struct wal_flush_cursor cursor;
+    struct filemgr_dirty_update_node *prevNode;
+    struct filemgr_dirty_update_node *newNode;
+    bid_t dirtyIdtreeRoot;
+    bid_t dirtySeqtreeRoot;
+};
+
+/**
+ * Executor pool task that applies the pending WAL flush of a file, one batch
+ * per run.
+ */
+class WalFlushTask : public GlobalTask {
+public:
+    WalFlushTask(FileMgr *_file);
+
+    bool run();
+
+    std::string getDescription();
+
+private:
+    FileMgr *file;
+};
+
+/**
+ * Lookup of the old offsets of the WAL items to be flushed, shared by the
+ * flushing thread and executor pool workers (see
+ * fdb_config.num_wal_flush_threads).
+ *
+ * The items are sorted by key and cut into partitions of whole top-level
+ * HB+trie chunks, i.e., of whole KV stores in multi KV instance mode, so
+ * that each thread walks sub-tries of its own. Each worker looks up its
+ * partitions through its own index handles, as the readers do, while the
+ * index is not modified. The flushing thread takes part in the lookup, so
+ * that a busy pool only delays the partitions that no thread picked up yet.
+ */
+class WalOldOffsetLookup {
+public:
+    /**
+     * Look up the old offsets of the given WAL items.
+     *
+     * @param handle Pointer to the flushing KV store handle
+     * @param get_old_offset Callback that looks up an item's old offset
+     * @param items WAL items whose old_offset is to be set
+     * @param num_threads Number of threads including the calling one
+     */
+    static void lookup(FdbKvsHandle *handle,
+                       wal_get_old_offset_func *get_old_offset,
+                       std::vector<struct wal_item *> &items,
+                       size_t num_threads);
+
+    /**
+     * Called by a worker before looking up any partition.
+     *
+     * @return false if the lookup is already over
+     */
+    bool enter();
+
+    /**
+     * Called by a worker that entered once it runs out of partitions.
+     */
+    void leave();
+
+    /**
+     * Look up partitions until there is none left.
+     *
+     * @param dbhandle Pointer to the KV store handle of the calling thread
+     */
+    void lookupPartitions(void *dbhandle);
+
+    /**
+     * Drop a reference; the last one frees the lookup.
+     */
+    void release();
+
+private:
+    WalOldOffsetLookup(wal_get_old_offset_func *get_old_offset,
+                       const std::vector<struct wal_item *> &_items,
+                       size_t ref_count);
+
+    void partition(size_t chunksize, size_t num_threads);
+
+    wal_get_old_offset_func *getOldOffset;
+    // copy of the items to look up, sorted by key
+    std::vector<struct wal_item *> items;
+    // [begin, end) of each partition in the items array
+    std::vector<std::pair<size_t, size_t> > partitions;
+    std::atomic<size_t> nextPartition;
+    std::atomic<size_t> refCount;
+    // guards 'closed' and 'numActive'
+    SyncObject syncObj;
+    bool closed;
+    size_t numActive;
+};
+
+/**
+ * Executor pool task that helps a WAL flush look up its partitions.
+ */
+class WalLookupTask : public GlobalTask {
+public:
+    WalLookupTask(FileMgr *_file, WalOldOffsetLookup *_lookup,
+                  FdbKvsHandle *_handle);
+
+    ~WalLookupTask();
+
+    bool run();
+
+    std::string getDescription();
+
+private:
+    FileMgr *file;
+    WalOldOffsetLookup *lookup;
+    // Index handles of this task, owned by the flushing thread
+    FdbKvsHandle *handle;
+};
@@ -0,0 +1,89 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2016 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "common.h"
+#include "libforestdb/fdb_types.h"
+#include "libforestdb/fdb_errors.h"
+
+/**
+ * ForestDB write batch definition.
+ * A write batch collects set and delete operations on user-owned fdb_doc
+ * instances, which are then applied to a KV store at once by
+ * FdbEngine::applyWriteBatch. Docs are not copied, so they should remain
+ * valid until the batch is applied.
+ */
+class FdbWriteBatch {
+public:
+    /**
+     * A single mutation in the batch. 'doc' is a shallow copy of the user's
+     * doc (with the body removed for deletions), and 'user_doc' is the doc
+     * whose seqnum, offset and on-disk size are updated when applied.
+     */
+    struct Op {
+        fdb_doc doc;
+        fdb_doc *user_doc;
+    };
+
+    FdbWriteBatch() { }
+
+    fdb_status addSet(fdb_doc *doc) {
+        if (!doc || doc->key == NULL ||
+            doc->keylen == 0 || doc->keylen > FDB_MAX_KEYLEN ||
+            (doc->metalen > 0 && doc->meta == NULL) ||
+            (doc->bodylen > 0 && doc->body == NULL)) {
+            return FDB_RESULT_INVALID_ARGS;
+        }
+        Op op;
+        op.doc = *doc;
+        op.user_doc = doc;
+        ops.push_back(op);
+        return FDB_RESULT_SUCCESS;
+    }
+
+    fdb_status addDel(fdb_doc *doc) {
+        if (!doc || doc->key == NULL ||
+            doc->keylen == 0 || doc->keylen > FDB_MAX_KEYLEN ||
+            (doc->metalen > 0 && doc->meta == NULL)) {
+            return FDB_RESULT_INVALID_ARGS;
+        }
+        doc->deleted = true;
+        Op op;
+        op.doc = *doc;
+        op.doc.bodylen = 0;
+        op.doc.body = NULL;
+        op.user_doc = doc;
+        ops.push_back(op);
+        return FDB_RESULT_SUCCESS;
+    }
+
+    size_t getNumOps() const {
+        return ops.size();
+    }
+
+    Op &getOp(size_t idx) {
+        return ops[idx];
+    }
+
+private:
+    std::vector<Op> ops;
+
+    DISALLOW_COPY_AND_ASSIGN(FdbWriteBatch);
+};
@@ -3687,10 +3687,104 @@ void compact_upto_last_wal_flush_bid_check()
     TEST_RESULT("compact upto last WAL flush bid check test");
 }
 
+void compact_parallel_copy_test()
+{
+    TEST_INIT();
+    memleak_start();
+    int i, r;
+    int n = 20000;
+    fdb_file_handle *dbfile;
+    fdb_kvs_handle *db, *kv1;
+    fdb_kvs_handle *handles[2];
+    fdb_kvs_info kvs_info;
+    fdb_doc *rdoc;
+    fdb_status s;
+    char keybuf[256], bodybuf[8192];
+
+    // remove previous compact_test files
+    r = system(SHELL_DEL " compact_test* > errorlog.txt");
+    (void)r;
+
+    fdb_config fconfig = fdb_get_default_config();
+    fdb_kvs_config kvs_config = fdb_get_default_kvs_config();
+    fconfig.flags = FDB_OPEN_FLAG_CREATE;
+    fconfig.purging_interval = 0;
+
+    // invalid number of copy threads
+    fconfig.num_compaction_copy_threads = 0;
+    s = fdb_open(&dbfile, "./compact_test1", &fconfig);
+    TEST_CHK(s == FDB_RESULT_INVALID_CONFIG);
+    fconfig.num_compaction_copy_threads = 4;
+
+    s = fdb_open(&dbfile, "./compact_test1", &fconfig);
+    TEST_CHK(s == FDB_RESULT_SUCCESS);
+    fdb_kvs_open_default(dbfile, &db, &kvs_config);
+    fdb_kvs_open(dbfile, &kv1, "kv1", &kvs_config);
+    handles[0] = db;
+    handles[1] = kv1;
+
+    // docs of various sizes, some of them spanning multiple blocks
+    memset(bodybuf, 'b', sizeof(bodybuf));
+    for (i=0;i<n;++i){
+        sprintf(keybuf, "key%08d", i);
+        s = fdb_set_kv(handles[i % 2], keybuf, strlen(keybuf),
+                       bodybuf, 16 + (i % 97) * (i % 89 == 0 ? 80 : 1));
+        TEST_CHK(s == FDB_RESULT_SUCCESS);
+    }
+    // delete every 5th doc so that the copiers drop them
+    for (i=0;i<n;i+=5){
+        sprintf(keybuf, "key%08d", i);
+        s = fdb_del_kv(handles[i % 2], keybuf, strlen(keybuf));
+        TEST_CHK(s == FDB_RESULT_SUCCESS);
+    }
+    fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
+
+    s = fdb_compact(dbfile, "compact_test2");
+    TEST_CHK(s == FDB_RESULT_SUCCESS);
+
+    for (r=0;r<2;++r) {
+        for (i=0;i<n;++i){
+            sprintf(keybuf, "key%08d", i);
+            fdb_doc_create(&rdoc, keybuf, strlen(keybuf), NULL, 0, NULL, 0);
+            s = fdb_get(handles[i % 2], rdoc);
+            if (i % 5 == 0) {
+                TEST_CHK(s == FDB_RESULT_KEY_NOT_FOUND);
+            } else {
+                TEST_CHK(s == FDB_RESULT_SUCCESS);
+                TEST_CHK(rdoc->bodylen ==
+                         (size_t)(16 + (i % 97) * (i % 89 == 0 ? 80 : 1)));
+                TEST_CMP(rdoc->body, bodybuf, rdoc->bodylen);
+                TEST_CHK(rdoc->seqnum == (fdb_seqnum_t)(i / 2 + 1));
+            }
+            fdb_doc_free(rdoc);
+        }
+        for (i=0;i<2;++i){
+            fdb_get_kvs_info(handles[i], &kvs_info);
+            TEST_CHK(kvs_info.doc_count == (size_t)(n / 2 - n / 10));
+        }
+        if (r == 0) {
+            // verify again after reopening the compacted file
+            fdb_close(dbfile);
+            s = fdb_open(&dbfile, "./compact_test2", &fconfig);
+            TEST_CHK(s == FDB_RESULT_SUCCESS);
+            fdb_kvs_open_default(dbfile, &db, &kvs_config);
+            fdb_kvs_open(dbfile, &kv1, "kv1", &kvs_config);
+            handles[0] = db;
+            handles[1] = kv1;
+        }
+    }
+
+    fdb_close(dbfile);
+    fdb_shutdown();
+    memleak_end();
+    TEST_RESULT("compact parallel copy test");
+}
+
 int main(){
     int i;
 
     compact_deleted_doc_test();
+    compact_parallel_copy_test();
     open_newfile_before_compact_done();
     compact_upto_test(false); // single kv instance in file
     compact_upto_test(true); // multiple kv instance in file
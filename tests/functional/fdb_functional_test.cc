@@ -629,6 +629,963 @@ void deleted_doc_get_api_test()
     TEST_RESULT("deleted doc get api test");
 }
 
+void get_multi_test(bool multi_kv)
+{
+    TEST_INIT();
+    memleak_start();
+
+    int i, r;
+    int n = 100;
+    fdb_file_handle *dbfile;
+    fdb_kvs_handle *db;
+    fdb_doc **rdoc = alca(fdb_doc*, n + 1);
+    fdb_status *results = alca(fdb_status, n + 1);
+    fdb_status status;
+    char keybuf[256], bodybuf[256];
+
+    // remove previous func_test files
+    r = system(SHELL_DEL" func_test* > errorlog.txt");
+    (void)r;
+
+    fdb_config fconfig = fdb_get_default_config();
+    fdb_kvs_config kvs_config = fdb_get_default_kvs_config();
+    fconfig.wal_threshold = 1024;
+    fconfig.flags = FDB_OPEN_FLAG_CREATE;
+    fconfig.multi_kv_instances = multi_kv;
+
+    status = fdb_open(&dbfile, "./func_test1", &fconfig);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    if (multi_kv) {
+        status = fdb_kvs_open(dbfile, &db, "kv1", &kvs_config);
+    } else {
+        status = fdb_kvs_open_default(dbfile, &db, &kvs_config);
+    }
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    // first half is flushed into the main index, second half stays in WAL
+    for (i = 0; i < n; ++i) {
+        sprintf(keybuf, "key%d", i);
+        sprintf(bodybuf, "body%d", i);
+        status = fdb_set_kv(db, keybuf, strlen(keybuf),
+                            bodybuf, strlen(bodybuf) + 1);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        if (i == n / 2) {
+            status = fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
+            TEST_CHK(status == FDB_RESULT_SUCCESS);
+        }
+    }
+    // delete every 10th key
+    for (i = 0; i < n; i += 10) {
+        sprintf(keybuf, "key%d", i);
+        status = fdb_del_kv(db, keybuf, strlen(keybuf));
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+    }
+    status = fdb_commit(dbfile, FDB_COMMIT_NORMAL);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    // request keys in reverse order, plus one that doesn't exist
+    for (i = 0; i < n; ++i) {
+        sprintf(keybuf, "key%d", n - 1 - i);
+        fdb_doc_create(&rdoc[i], keybuf, strlen(keybuf), NULL, 0, NULL, 0);
+    }
+    sprintf(keybuf, "nonexistent");
+    fdb_doc_create(&rdoc[n], keybuf, strlen(keybuf), NULL, 0, NULL, 0);
+
+    status = fdb_get_multi(db, rdoc, n + 1, results);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    for (i = 0; i < n; ++i) {
+        int k = n - 1 - i;
+        if (k % 10 == 0) {
+            TEST_CHK(results[i] == FDB_RESULT_KEY_NOT_FOUND);
+            continue;
+        }
+        TEST_CHK(results[i] == FDB_RESULT_SUCCESS);
+        sprintf(bodybuf, "body%d", k);
+        TEST_CMP(rdoc[i]->body, bodybuf, rdoc[i]->bodylen);
+        TEST_CHK(rdoc[i]->offset != 0);
+    }
+    TEST_CHK(results[n] == FDB_RESULT_KEY_NOT_FOUND);
+
+    for (i = 0; i <= n; ++i) {
+        fdb_doc_free(rdoc[i]);
+    }
+
+    status = fdb_get_multi(db, NULL, n, results);
+    TEST_CHK(status == FDB_RESULT_INVALID_ARGS);
+
+    status = fdb_kvs_close(db);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_close(dbfile);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    fdb_shutdown();
+    memleak_end();
+
+    if (multi_kv) {
+        TEST_RESULT("get multi test (multi kv mode)");
+    } else {
+        TEST_RESULT("get multi test (single kv mode)");
+    }
+}
+
+void io_uring_backend_test()
+{
+    TEST_INIT();
+    memleak_start();
+
+    int i, r;
+    int n = 1000;
+    fdb_file_handle *dbfile;
+    fdb_kvs_handle *db;
+    fdb_doc **rdoc = alca(fdb_doc*, n);
+    fdb_status *results = alca(fdb_status, n);
+    fdb_status status;
+    char keybuf[256], bodybuf[256];
+
+    // remove previous func_test files
+    r = system(SHELL_DEL" func_test* > errorlog.txt");
+    (void)r;
+
+    fdb_config fconfig = fdb_get_default_config();
+    fdb_kvs_config kvs_config = fdb_get_default_kvs_config();
+
+    // unknown backend should be rejected
+    fconfig.io_backend = 0xff;
+    status = fdb_init(&fconfig);
+    TEST_CHK(status == FDB_RESULT_INVALID_CONFIG);
+
+    // io_uring backend falls back to the default one if the kernel
+    // doesn't support it, so that the results should be the same.
+    fconfig.io_backend = FDB_IO_BACKEND_IO_URING;
+    fconfig.wal_threshold = 1024;
+    fconfig.flags = FDB_OPEN_FLAG_CREATE;
+    status = fdb_init(&fconfig);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    status = fdb_open(&dbfile, "./func_test1", &fconfig);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_kvs_open_default(dbfile, &db, &kvs_config);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    for (i = 0; i < n; ++i) {
+        sprintf(keybuf, "key%d", i);
+        sprintf(bodybuf, "body%d", i);
+        status = fdb_set_kv(db, keybuf, strlen(keybuf),
+                            bodybuf, strlen(bodybuf) + 1);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+    }
+    status = fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    // compaction reads docs in batches through the async I/O backend
+    status = fdb_compact(dbfile, (char *) "./func_test2");
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    for (i = 0; i < n; ++i) {
+        sprintf(keybuf, "key%d", n - 1 - i);
+        fdb_doc_create(&rdoc[i], keybuf, strlen(keybuf), NULL, 0, NULL, 0);
+    }
+    status = fdb_get_multi(db, rdoc, n, results);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    for (i = 0; i < n; ++i) {
+        TEST_CHK(results[i] == FDB_RESULT_SUCCESS);
+        sprintf(bodybuf, "body%d", n - 1 - i);
+        TEST_CMP(rdoc[i]->body, bodybuf, rdoc[i]->bodylen);
+        fdb_doc_free(rdoc[i]);
+    }
+
+    status = fdb_kvs_close(db);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_close(dbfile);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    fdb_shutdown();
+    memleak_end();
+
+    TEST_RESULT("io_uring backend test");
+}
+
+void write_batch_test(bool multi_kv)
+{
+    TEST_INIT();
+    memleak_start();
+
+    int i, r;
+    int n = 1000;
+    fdb_file_handle *dbfile;
+    fdb_kvs_handle *db;
+    fdb_doc **doc = alca(fdb_doc*, n);
+    fdb_doc *rdoc;
+    fdb_write_batch *batch;
+    fdb_seqnum_t seqnum;
+    fdb_status status;
+    char keybuf[256], bodybuf[256];
+
+    // remove previous func_test files
+    r = system(SHELL_DEL" func_test* > errorlog.txt");
+    (void)r;
+
+    fdb_config fconfig = fdb_get_default_config();
+    fdb_kvs_config kvs_config = fdb_get_default_kvs_config();
+    fconfig.wal_threshold = 256;
+    fconfig.seqtree_opt = FDB_SEQTREE_USE;
+    fconfig.flags = FDB_OPEN_FLAG_CREATE;
+    fconfig.multi_kv_instances = multi_kv;
+
+    status = fdb_open(&dbfile, "./func_test1", &fconfig);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    if (multi_kv) {
+        status = fdb_kvs_open(dbfile, &db, "kv1", &kvs_config);
+    } else {
+        status = fdb_kvs_open_default(dbfile, &db, &kvs_config);
+    }
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    status = fdb_write_batch_create(&batch);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    for (i = 0; i < n; ++i) {
+        sprintf(keybuf, "key%d", i);
+        sprintf(bodybuf, "body%d", i);
+        fdb_doc_create(&doc[i], keybuf, strlen(keybuf), NULL, 0,
+                       bodybuf, strlen(bodybuf) + 1);
+        status = fdb_write_batch_set(batch, doc[i]);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+    }
+    // the batch exceeds the WAL threshold, so it is flushed in the middle
+    status = fdb_write_batch_apply(db, batch);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    fdb_write_batch_free(batch);
+
+    for (i = 0; i < n; ++i) {
+        TEST_CHK(doc[i]->seqnum == (fdb_seqnum_t)i + 1);
+    }
+    status = fdb_get_kvs_seqnum(db, &seqnum);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    TEST_CHK(seqnum == (fdb_seqnum_t)n);
+
+    // delete even keys and update odd keys in another batch
+    status = fdb_write_batch_create(&batch);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    for (i = 0; i < n; ++i) {
+        if (i % 2 == 0) {
+            status = fdb_write_batch_del(batch, doc[i]);
+        } else {
+            sprintf(bodybuf, "updated%d", i);
+            fdb_doc_update(&doc[i], NULL, 0, bodybuf, strlen(bodybuf) + 1);
+            status = fdb_write_batch_set(batch, doc[i]);
+        }
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+    }
+    status = fdb_write_batch_apply(db, batch);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    fdb_write_batch_free(batch);
+
+    status = fdb_commit(dbfile, FDB_COMMIT_NORMAL);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    for (i = 0; i < n; ++i) {
+        sprintf(keybuf, "key%d", i);
+        fdb_doc_create(&rdoc, keybuf, strlen(keybuf), NULL, 0, NULL, 0);
+        status = fdb_get(db, rdoc);
+        if (i % 2 == 0) {
+            TEST_CHK(status == FDB_RESULT_KEY_NOT_FOUND);
+        } else {
+            TEST_CHK(status == FDB_RESULT_SUCCESS);
+            sprintf(bodybuf, "updated%d", i);
+            TEST_CMP(rdoc->body, bodybuf, rdoc->bodylen);
+            TEST_CHK(rdoc->seqnum == (fdb_seqnum_t)(n + i + 1));
+        }
+        fdb_doc_free(rdoc);
+        fdb_doc_free(doc[i]);
+    }
+
+    // apply with invalid args
+    status = fdb_write_batch_apply(db, NULL);
+    TEST_CHK(status == FDB_RESULT_INVALID_ARGS);
+    status = fdb_write_batch_create(&batch);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_write_batch_set(batch, NULL);
+    TEST_CHK(status == FDB_RESULT_INVALID_ARGS);
+    fdb_write_batch_free(batch);
+
+    status = fdb_kvs_close(db);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_close(dbfile);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    fdb_shutdown();
+    memleak_end();
+
+    if (multi_kv) {
+        TEST_RESULT("write batch test (multi kv mode)");
+    } else {
+        TEST_RESULT("write batch test (single kv mode)");
+    }
+}
+
+struct group_commit_args {
+    int tid;
+    int ndocs;
+    int commit_unit;
+    fdb_config *config;
+};
+
+static void *_group_commit_thread(void *voidargs)
+{
+    TEST_INIT();
+
+    struct group_commit_args *args = (struct group_commit_args *)voidargs;
+    int i;
+    fdb_file_handle *dbfile;
+    fdb_kvs_handle *db;
+    fdb_kvs_config kvs_config = fdb_get_default_kvs_config();
+    fdb_status status;
+    char keybuf[256], bodybuf[256];
+
+    // each thread commits through its own file handle
+    status = fdb_open(&dbfile, "./func_test1", args->config);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_kvs_open_default(dbfile, &db, &kvs_config);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    for (i = 0; i < args->ndocs; ++i) {
+        sprintf(keybuf, "t%d_key%d", args->tid, i);
+        sprintf(bodybuf, "t%d_body%d", args->tid, i);
+        status = fdb_set_kv(db, keybuf, strlen(keybuf),
+                            bodybuf, strlen(bodybuf) + 1);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        if ((i + 1) % args->commit_unit == 0) {
+            status = fdb_commit(dbfile, FDB_COMMIT_NORMAL);
+            TEST_CHK(status == FDB_RESULT_SUCCESS);
+        }
+    }
+    status = fdb_commit(dbfile, FDB_COMMIT_NORMAL);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    status = fdb_close(dbfile);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    thread_exit(0);
+    return NULL;
+}
+
+void group_commit_test()
+{
+    TEST_INIT();
+    memleak_start();
+
+    int i, j, r;
+    int nthreads = 8;
+    int n = 200;
+    fdb_file_handle *dbfile;
+    fdb_kvs_handle *db;
+    fdb_kvs_config kvs_config = fdb_get_default_kvs_config();
+    fdb_status status;
+    thread_t *tid = alca(thread_t, nthreads);
+    void **thread_ret = alca(void *, nthreads);
+    struct group_commit_args *args = alca(struct group_commit_args, nthreads);
+    void *value;
+    size_t valuelen;
+    char keybuf[256], bodybuf[256];
+
+    r = system(SHELL_DEL" func_test* > errorlog.txt");
+    (void)r;
+
+    fdb_config fconfig = fdb_get_default_config();
+    fconfig.wal_threshold = 1024;
+    fconfig.compaction_threshold = 0;
+    fconfig.group_commit = true;
+
+    status = fdb_open(&dbfile, "./func_test1", &fconfig);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    for (i = 0; i < nthreads; ++i) {
+        args[i].tid = i;
+        args[i].ndocs = n;
+        args[i].commit_unit = 10;
+        args[i].config = &fconfig;
+        thread_create(&tid[i], _group_commit_thread, &args[i]);
+    }
+    for (i = 0; i < nthreads; ++i) {
+        thread_join(tid[i], &thread_ret[i]);
+    }
+    status = fdb_close(dbfile);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    // reopen the file without group commit and verify all committed docs
+    fconfig.group_commit = false;
+    status = fdb_open(&dbfile, "./func_test1", &fconfig);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_kvs_open_default(dbfile, &db, &kvs_config);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    for (i = 0; i < nthreads; ++i) {
+        for (j = 0; j < n; ++j) {
+            sprintf(keybuf, "t%d_key%d", i, j);
+            sprintf(bodybuf, "t%d_body%d", i, j);
+            status = fdb_get_kv(db, keybuf, strlen(keybuf),
+                                &value, &valuelen);
+            TEST_CHK(status == FDB_RESULT_SUCCESS);
+            TEST_CMP(value, bodybuf, valuelen);
+            fdb_free_block(value);
+        }
+    }
+
+    status = fdb_close(dbfile);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    fdb_shutdown();
+    memleak_end();
+    TEST_RESULT("group commit test");
+}
+
+void commit_log_test()
+{
+    TEST_INIT();
+    memleak_start();
+
+    int i, r;
+    int n = 100;
+    fdb_file_handle *dbfile;
+    fdb_kvs_handle *db;
+    fdb_kvs_config kvs_config = fdb_get_default_kvs_config();
+    fdb_kvs_info kvs_info;
+    fdb_status status;
+    void *value;
+    size_t valuelen;
+    char keybuf[256], bodybuf[256];
+
+    r = system(SHELL_DEL" func_test* > errorlog.txt");
+    (void)r;
+
+    fdb_config fconfig = fdb_get_default_config();
+    fconfig.wal_threshold = 1024;
+    fconfig.compaction_threshold = 0;
+    fconfig.durability_opt = FDB_DRB_COMMIT_LOG;
+
+    status = fdb_open(&dbfile, "./func_test1", &fconfig);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_kvs_open_default(dbfile, &db, &kvs_config);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    // insert docs, and then delete the first 10 docs
+    for (i = 0; i < n; ++i) {
+        sprintf(keybuf, "key%d", i);
+        sprintf(bodybuf, "body%d", i);
+        status = fdb_set_kv(db, keybuf, strlen(keybuf),
+                            bodybuf, strlen(bodybuf));
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        if ((i+1) % 10 == 0) {
+            // commits are persisted only in the commit log
+            status = fdb_commit(dbfile, FDB_COMMIT_NORMAL);
+            TEST_CHK(status == FDB_RESULT_SUCCESS);
+        }
+    }
+    for (i = 0; i < 10; ++i) {
+        sprintf(keybuf, "key%d", i);
+        status = fdb_del_kv(db, keybuf, strlen(keybuf));
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+    }
+    status = fdb_commit(dbfile, FDB_COMMIT_NORMAL);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    // uncommitted update should not be recovered
+    sprintf(keybuf, "key%d", n);
+    status = fdb_set_kv(db, keybuf, strlen(keybuf), (void*)"body", 4);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    status = fdb_close(dbfile);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    fdb_shutdown();
+
+    // reopen the file, the committed updates should be replayed from the log
+    status = fdb_open(&dbfile, "./func_test1", &fconfig);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_kvs_open_default(dbfile, &db, &kvs_config);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    for (i = 0; i < n; ++i) {
+        sprintf(keybuf, "key%d", i);
+        sprintf(bodybuf, "body%d", i);
+        status = fdb_get_kv(db, keybuf, strlen(keybuf), &value, &valuelen);
+        if (i < 10) {
+            TEST_CHK(status == FDB_RESULT_KEY_NOT_FOUND);
+        } else {
+            TEST_CHK(status == FDB_RESULT_SUCCESS);
+            TEST_CMP(value, bodybuf, valuelen);
+            fdb_free_block(value);
+        }
+    }
+    sprintf(keybuf, "key%d", n);
+    status = fdb_get_kv(db, keybuf, strlen(keybuf), &value, &valuelen);
+    TEST_CHK(status == FDB_RESULT_KEY_NOT_FOUND);
+
+    status = fdb_get_kvs_info(db, &kvs_info);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    TEST_CHK(kvs_info.last_seqnum == (fdb_seqnum_t)(n + 10));
+
+    status = fdb_close(dbfile);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    // destroy should remove the commit log files as well
+    status = fdb_destroy("./func_test1", &fconfig);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    status = fdb_open(&dbfile, "./func_test1", &fconfig);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_kvs_open_default(dbfile, &db, &kvs_config);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    sprintf(keybuf, "key%d", n - 1);
+    status = fdb_get_kv(db, keybuf, strlen(keybuf), &value, &valuelen);
+    TEST_CHK(status == FDB_RESULT_KEY_NOT_FOUND);
+
+    status = fdb_close(dbfile);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    fdb_shutdown();
+    memleak_end();
+    TEST_RESULT("commit log test");
+}
+
+void bloom_filter_test()
+{
+    TEST_INIT();
+    memleak_start();
+
+    int i, r;
+    int n = 10000;
+    fdb_file_handle *dbfile;
+    fdb_kvs_handle *db, *kv1;
+    fdb_kvs_config kvs_config = fdb_get_default_kvs_config();
+    fdb_status status;
+    void *value;
+    size_t valuelen;
+    char keybuf[256], bodybuf[256];
+
+    r = system(SHELL_DEL" func_test* > errorlog.txt");
+    (void)r;
+
+    fdb_config fconfig = fdb_get_default_config();
+    fconfig.wal_threshold = 1024;
+    fconfig.compaction_threshold = 0;
+    fconfig.bloom_filter_bits_per_key = 10;
+
+    status = fdb_open(&dbfile, "./func_test1", &fconfig);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_kvs_open_default(dbfile, &db, &kvs_config);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_kvs_open(dbfile, &kv1, "kv1", &kvs_config);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    // keys are flushed from WAL several times, which grows the filter
+    for (i = 0; i < n; ++i) {
+        sprintf(keybuf, "key%d", i);
+        sprintf(bodybuf, "body%d", i);
+        status = fdb_set_kv(db, keybuf, strlen(keybuf),
+                            bodybuf, strlen(bodybuf));
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        if (i % 10 == 0) {
+            sprintf(keybuf, "kv1_key%d", i);
+            status = fdb_set_kv(kv1, keybuf, strlen(keybuf),
+                                bodybuf, strlen(bodybuf));
+            TEST_CHK(status == FDB_RESULT_SUCCESS);
+        }
+    }
+    for (i = 0; i < 100; ++i) {
+        sprintf(keybuf, "key%d", i);
+        status = fdb_del_kv(db, keybuf, strlen(keybuf));
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+    }
+    status = fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    for (int round = 0; round < 3; ++round) {
+        if (round == 1) {
+            // the filter should be loaded from the file
+            status = fdb_close(dbfile);
+            TEST_CHK(status == FDB_RESULT_SUCCESS);
+            fdb_shutdown();
+        } else if (round == 2) {
+            // the filter should be rebuilt in the new file
+            status = fdb_compact(dbfile, "./func_test2");
+            TEST_CHK(status == FDB_RESULT_SUCCESS);
+            status = fdb_close(dbfile);
+            TEST_CHK(status == FDB_RESULT_SUCCESS);
+            fdb_shutdown();
+        }
+        if (round > 0) {
+            status = fdb_open(&dbfile, round == 1 ? "./func_test1"
+                                                  : "./func_test2",
+                              &fconfig);
+            TEST_CHK(status == FDB_RESULT_SUCCESS);
+            status = fdb_kvs_open_default(dbfile, &db, &kvs_config);
+            TEST_CHK(status == FDB_RESULT_SUCCESS);
+            status = fdb_kvs_open(dbfile, &kv1, "kv1", &kvs_config);
+            TEST_CHK(status == FDB_RESULT_SUCCESS);
+        }
+
+        for (i = 0; i < n; ++i) {
+            sprintf(keybuf, "key%d", i);
+            sprintf(bodybuf, "body%d", i);
+            status = fdb_get_kv(db, keybuf, strlen(keybuf), &value, &valuelen);
+            if (i < 100) {
+                TEST_CHK(status == FDB_RESULT_KEY_NOT_FOUND);
+            } else {
+                TEST_CHK(status == FDB_RESULT_SUCCESS);
+                TEST_CMP(value, bodybuf, valuelen);
+                fdb_free_block(value);
+            }
+            // keys that have never been inserted
+            sprintf(keybuf, "nokey%d", i);
+            status = fdb_get_kv(db, keybuf, strlen(keybuf), &value, &valuelen);
+            TEST_CHK(status == FDB_RESULT_KEY_NOT_FOUND);
+
+            // keys of other KV store
+            sprintf(keybuf, "kv1_key%d", i);
+            status = fdb_get_kv(db, keybuf, strlen(keybuf), &value, &valuelen);
+            TEST_CHK(status == FDB_RESULT_KEY_NOT_FOUND);
+            status = fdb_get_kv(kv1, keybuf, strlen(keybuf), &value, &valuelen);
+            if (i % 10 == 0) {
+                TEST_CHK(status == FDB_RESULT_SUCCESS);
+                TEST_CMP(value, bodybuf, valuelen);
+                fdb_free_block(value);
+            } else {
+                TEST_CHK(status == FDB_RESULT_KEY_NOT_FOUND);
+            }
+        }
+
+        // insert more keys after each step
+        sprintf(keybuf, "newkey%d", round);
+        status = fdb_set_kv(db, keybuf, strlen(keybuf), (void*)"body", 4);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        status = fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        for (int j = 0; j <= round; ++j) {
+            sprintf(keybuf, "newkey%d", j);
+            status = fdb_get_kv(db, keybuf, strlen(keybuf),
+                                &value, &valuelen);
+            TEST_CHK(status == FDB_RESULT_SUCCESS);
+            fdb_free_block(value);
+        }
+    }
+    status = fdb_close(dbfile);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    // a file created without the filter should work with the filter enabled,
+    // and start to maintain the filter after compaction
+    fconfig.bloom_filter_bits_per_key = 0;
+    status = fdb_open(&dbfile, "./func_test3", &fconfig);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_kvs_open_default(dbfile, &db, &kvs_config);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    for (i = 0; i < 1000; ++i) {
+        sprintf(keybuf, "key%d", i);
+        status = fdb_set_kv(db, keybuf, strlen(keybuf), (void*)"body", 4);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+    }
+    status = fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_close(dbfile);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    fdb_shutdown();
+
+    fconfig.bloom_filter_bits_per_key = 10;
+    for (int round = 0; round < 2; ++round) {
+        status = fdb_open(&dbfile, round == 0 ? "./func_test3"
+                                              : "./func_test4",
+                          &fconfig);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        status = fdb_kvs_open_default(dbfile, &db, &kvs_config);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        sprintf(keybuf, "key%d", 1000 + round);
+        status = fdb_set_kv(db, keybuf, strlen(keybuf), (void*)"body", 4);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        status = fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        for (i = 0; i < 1001 + round; ++i) {
+            sprintf(keybuf, "key%d", i);
+            status = fdb_get_kv(db, keybuf, strlen(keybuf),
+                                &value, &valuelen);
+            TEST_CHK(status == FDB_RESULT_SUCCESS);
+            fdb_free_block(value);
+        }
+        sprintf(keybuf, "nokey");
+        status = fdb_get_kv(db, keybuf, strlen(keybuf), &value, &valuelen);
+        TEST_CHK(status == FDB_RESULT_KEY_NOT_FOUND);
+        if (round == 0) {
+            status = fdb_compact(dbfile, "./func_test4");
+            TEST_CHK(status == FDB_RESULT_SUCCESS);
+        }
+        status = fdb_close(dbfile);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        fdb_shutdown();
+    }
+
+    memleak_end();
+    TEST_RESULT("bloom filter test");
+}
+
+void checksum_mode_test()
+{
+    TEST_INIT();
+    memleak_start();
+
+    int i, r;
+    int n = 1000;
+    fdb_file_handle *dbfile;
+    fdb_kvs_handle *db;
+    fdb_kvs_config kvs_config = fdb_get_default_kvs_config();
+    fdb_status status;
+    fdb_pinned_doc pdoc;
+    void *value;
+    size_t valuelen;
+    char keybuf[256], metabuf[256], bodybuf[256];
+
+    r = system(SHELL_DEL" func_test* > errorlog.txt");
+    (void)r;
+
+    fdb_config fconfig = fdb_get_default_config();
+    fconfig.wal_threshold = 1024;
+    fconfig.compaction_threshold = 0;
+
+    // legacy CRC and XXH3 are mutually exclusive
+    fconfig.flags = FDB_OPEN_FLAG_CREATE | FDB_OPEN_WITH_LEGACY_CRC |
+                    FDB_OPEN_WITH_XXH3_CHECKSUM;
+    status = fdb_open(&dbfile, "./func_test1", &fconfig);
+    TEST_CHK(status == FDB_RESULT_INVALID_CONFIG);
+
+    fconfig.flags = FDB_OPEN_FLAG_CREATE | FDB_OPEN_WITH_XXH3_CHECKSUM;
+    status = fdb_open(&dbfile, "./func_test1", &fconfig);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_kvs_open_default(dbfile, &db, &kvs_config);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    for (i = 0; i < n; ++i) {
+        fdb_doc *doc;
+        sprintf(keybuf, "key%d", i);
+        sprintf(metabuf, "meta%d", i);
+        sprintf(bodybuf, "body%d", i);
+        fdb_doc_create(&doc, keybuf, strlen(keybuf), metabuf, strlen(metabuf),
+                       bodybuf, strlen(bodybuf));
+        status = fdb_set(db, doc);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        fdb_doc_free(doc);
+    }
+    status = fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    // compaction keeps XXH3 for the new file
+    status = fdb_compact(dbfile, "./func_test2");
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_close(dbfile);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    fdb_shutdown();
+
+    // the checksum mode is detected when the file is reopened without the
+    // flag; docs are verified both through the copying and the pinned paths
+    fconfig.flags = FDB_OPEN_FLAG_CREATE;
+    status = fdb_open(&dbfile, "./func_test2", &fconfig);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_kvs_open_default(dbfile, &db, &kvs_config);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    for (i = 0; i < n; ++i) {
+        sprintf(keybuf, "key%d", i);
+        sprintf(metabuf, "meta%d", i);
+        sprintf(bodybuf, "body%d", i);
+        status = fdb_get_kv(db, keybuf, strlen(keybuf), &value, &valuelen);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        TEST_CMP(value, bodybuf, valuelen);
+        fdb_free_block(value);
+        status = fdb_get_pinned(db, keybuf, strlen(keybuf), &pdoc);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        TEST_CMP(pdoc.meta, metabuf, pdoc.metalen);
+        TEST_CMP(pdoc.body, bodybuf, pdoc.bodylen);
+        fdb_pinned_release(&pdoc);
+    }
+    // new updates to the existing file keep using XXH3
+    status = fdb_set_kv(db, (void*)"newkey", 6, (void*)"newbody", 7);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_close(dbfile);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    status = fdb_open(&dbfile, "./func_test2", &fconfig);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_kvs_open_default(dbfile, &db, &kvs_config);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_get_kv(db, (void*)"newkey", 6, &value, &valuelen);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    TEST_CMP(value, "newbody", valuelen);
+    fdb_free_block(value);
+    status = fdb_close(dbfile);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    // files written with the legacy CRC32 should still be readable now that
+    // new files use CRC32-C by default
+    fconfig.flags = FDB_OPEN_FLAG_CREATE | FDB_OPEN_WITH_LEGACY_CRC;
+    status = fdb_open(&dbfile, "./func_test3", &fconfig);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_kvs_open_default(dbfile, &db, &kvs_config);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_set_kv(db, (void*)"oldkey", 6, (void*)"oldbody", 7);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_close(dbfile);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    fconfig.flags = FDB_OPEN_FLAG_CREATE;
+    status = fdb_open(&dbfile, "./func_test3", &fconfig);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_kvs_open_default(dbfile, &db, &kvs_config);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_get_kv(db, (void*)"oldkey", 6, &value, &valuelen);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    TEST_CMP(value, "oldbody", valuelen);
+    fdb_free_block(value);
+    status = fdb_close(dbfile);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    fdb_shutdown();
+
+    memleak_end();
+    TEST_RESULT("checksum mode test");
+}
+
+void pinned_get_test()
+{
+    TEST_INIT();
+    memleak_start();
+
+    int i, r;
+    int n = 1000;
+    fdb_file_handle *dbfile;
+    fdb_kvs_handle *db, *kv1;
+    fdb_kvs_config kvs_config = fdb_get_default_kvs_config();
+    fdb_status status;
+    fdb_pinned_doc pdoc, pdoc_held;
+    char keybuf[256], metabuf[256], bodybuf[256];
+    char *bigbody;
+    size_t bigbody_len = 20000;
+
+    r = system(SHELL_DEL" func_test* > errorlog.txt");
+    (void)r;
+
+    fdb_config fconfig = fdb_get_default_config();
+    fconfig.buffercache_size = 64 * fconfig.blocksize;
+    fconfig.wal_threshold = 1024;
+    fconfig.compaction_threshold = 0;
+
+    status = fdb_open(&dbfile, "./func_test1", &fconfig);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_kvs_open_default(dbfile, &db, &kvs_config);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_kvs_open(dbfile, &kv1, "kv1", &kvs_config);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    for (i = 0; i < n; ++i) {
+        fdb_doc *doc;
+        sprintf(keybuf, "key%d", i);
+        sprintf(metabuf, "meta%d", i);
+        sprintf(bodybuf, "body%d", i);
+        fdb_doc_create(&doc, keybuf, strlen(keybuf), metabuf, strlen(metabuf),
+                       bodybuf, strlen(bodybuf));
+        status = fdb_set(db, doc);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        status = fdb_set(kv1, doc);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        fdb_doc_free(doc);
+    }
+    // a doc spanning multiple blocks
+    bigbody = (char*)malloc(bigbody_len);
+    for (size_t j = 0; j < bigbody_len; ++j) {
+        bigbody[j] = 'a' + j % 26;
+    }
+    status = fdb_set_kv(db, (void*)"bigkey", 6, bigbody, bigbody_len);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_del_kv(db, (void*)"key0", 4);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    for (i = 1; i < n; ++i) {
+        sprintf(keybuf, "key%d", i);
+        sprintf(metabuf, "meta%d", i);
+        sprintf(bodybuf, "body%d", i);
+        status = fdb_get_pinned(i % 2 ? db : kv1, keybuf, strlen(keybuf),
+                                &pdoc);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        TEST_CHK(pdoc.keylen == strlen(keybuf));
+        TEST_CMP(pdoc.key, keybuf, pdoc.keylen);
+        TEST_CHK(pdoc.metalen == strlen(metabuf));
+        TEST_CMP(pdoc.meta, metabuf, pdoc.metalen);
+        TEST_CHK(pdoc.bodylen == strlen(bodybuf));
+        TEST_CMP(pdoc.body, bodybuf, pdoc.bodylen);
+        status = fdb_pinned_release(&pdoc);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+    }
+
+    // the doc is read in place once its block is cached
+    status = fdb_get_pinned(db, (void*)"key1", 4, &pdoc);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    TEST_CHK(pdoc.zero_copy);
+    fdb_pinned_release(&pdoc);
+
+    // a doc spanning multiple blocks is copied
+    status = fdb_get_pinned(db, (void*)"bigkey", 6, &pdoc);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    TEST_CHK(!pdoc.zero_copy);
+    TEST_CHK(pdoc.bodylen == bigbody_len);
+    TEST_CMP(pdoc.body, bigbody, bigbody_len);
+    fdb_pinned_release(&pdoc);
+
+    status = fdb_get_pinned(db, (void*)"key0", 4, &pdoc);
+    TEST_CHK(status == FDB_RESULT_KEY_NOT_FOUND);
+    status = fdb_get_pinned(db, (void*)"nokey", 5, &pdoc);
+    TEST_CHK(status == FDB_RESULT_KEY_NOT_FOUND);
+
+    // docs not yet flushed from WAL
+    status = fdb_set_kv(db, (void*)"walkey", 6, (void*)"walbody", 7);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_get_pinned(db, (void*)"walkey", 6, &pdoc);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    TEST_CHK(pdoc.bodylen == 7);
+    TEST_CMP(pdoc.body, "walbody", 7);
+    fdb_pinned_release(&pdoc);
+
+    // the pinned view should not change while the doc is updated and
+    // its block is evicted from the cache
+    status = fdb_get_pinned(db, (void*)"key1", 4, &pdoc_held);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    TEST_CHK(pdoc_held.zero_copy);
+    status = fdb_set_kv(db, (void*)"key1", 4, (void*)"newbody", 7);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    for (i = 0; i < n; ++i) {
+        sprintf(keybuf, "morekey%d", i);
+        status = fdb_set_kv(db, keybuf, strlen(keybuf), bigbody, 1000);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+    }
+    status = fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    for (i = 1; i < n; ++i) {
+        void *value;
+        size_t valuelen;
+        sprintf(keybuf, "key%d", i);
+        status = fdb_get_kv(kv1, keybuf, strlen(keybuf), &value, &valuelen);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        fdb_free_block(value);
+    }
+    TEST_CHK(pdoc_held.bodylen == 5);
+    TEST_CMP(pdoc_held.body, "body1", 5);
+    TEST_CMP(pdoc_held.meta, "meta1", 5);
+
+    status = fdb_get_pinned(db, (void*)"key1", 4, &pdoc);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    TEST_CHK(pdoc.bodylen == 7);
+    TEST_CMP(pdoc.body, "newbody", 7);
+    fdb_pinned_release(&pdoc);
+    fdb_pinned_release(&pdoc_held);
+
+    free(bigbody);
+    status = fdb_close(dbfile);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    fdb_shutdown();
+
+    memleak_end();
+    TEST_RESULT("pinned get test");
+}
+
 void deleted_doc_stat_test()
 {
     TEST_INIT();
@@ -4891,59 +5848,150 @@ void dirty_index_consistency_test()
     (void)r;
 
     config = fdb_get_default_config();
-    config.buffercache_size = 0;
-    config.wal_threshold = 100;
+    config.buffercache_size = 0;
+    config.wal_threshold = 100;
+    kvs_config = fdb_get_default_kvs_config();
+
+    // create a file
+    s = fdb_open(&dbfile, "func_test", &config);
+    TEST_CHK(s == FDB_RESULT_SUCCESS);
+
+    s = fdb_kvs_open(dbfile, &db[0], NULL, &kvs_config);
+    TEST_CHK(s == FDB_RESULT_SUCCESS);
+
+    s = fdb_kvs_open(dbfile, &db[1], NULL, &kvs_config);
+    TEST_CHK(s == FDB_RESULT_SUCCESS);
+
+    memset(keybuf, 0x0, 256);
+    memset(valuebuf, 0x0, 256);
+
+    // insert docs & dirty WAL flushing
+    for (i=0; i<1000; i++) {
+        sprintf(keybuf, "k%06d", i);
+        sprintf(valuebuf, "v%06d", i);
+        fdb_doc_create(&doc, keybuf, 8, NULL, 0, valuebuf, 9);
+        s = fdb_set(db[1], doc);
+        TEST_CHK(s == FDB_RESULT_SUCCESS);
+        fdb_doc_free(doc);
+    }
+
+    // get docks
+    for (i=0; i<1000; i++) {
+        sprintf(keybuf, "k%06d", i);
+        fdb_doc_create(&doc, keybuf, 8, NULL, 0, valuebuf, 9);
+        s = fdb_get(db[0], doc);
+        TEST_CHK(s == FDB_RESULT_SUCCESS);
+        fdb_doc_free(doc);
+    }
+    // now dirty blocks are cached in db[0]'s (default) bhandle
+
+    // more dirty WAL flushing
+    for (i=1000; i<3000; i++) {
+        sprintf(keybuf, "k%06d", i);
+        sprintf(valuebuf, "v%06d", i);
+        fdb_doc_create(&doc, keybuf, 8, NULL, 0, valuebuf, 9);
+        s = fdb_set(db[1], doc);
+        TEST_CHK(s == FDB_RESULT_SUCCESS);
+        fdb_doc_free(doc);
+    }
+
+    // commit - WAL flushing is executed on the default handle
+    s = fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
+    TEST_CHK(s == FDB_RESULT_SUCCESS);
+
+    // count # docs
+    s = fdb_iterator_init(db[1], &fit, NULL, 0, NULL, 0, FDB_ITR_NONE);
+    TEST_CHK(s == FDB_RESULT_SUCCESS);
+    r = 0;
+    do {
+        rdoc = NULL;
+        s = fdb_iterator_get(fit, &rdoc);
+        if (s != FDB_RESULT_SUCCESS) break;
+        r++;
+        fdb_doc_free(rdoc);
+    } while (fdb_iterator_next(fit) == FDB_RESULT_SUCCESS);
+    fdb_iterator_close(fit);
+
+    TEST_CHK(r == 3000);
+
+    s = fdb_close(dbfile);
+    TEST_CHK(s == FDB_RESULT_SUCCESS);
+
+    fdb_shutdown();
+    memleak_end();
+
+    TEST_RESULT("dirty index consistency test");
+}
+
+void background_wal_flush_test()
+{
+    TEST_INIT();
+    int i, r;
+    int n = 5000;
+    fdb_file_handle *dbfile;
+    fdb_kvs_handle *db[2];
+    fdb_iterator *fit;
+    fdb_config config;
+    fdb_kvs_config kvs_config;
+    fdb_doc *doc, *rdoc;
+    fdb_status s; (void)s;
+    char keybuf[256], valuebuf[256];
+
+    memleak_start();
+
+    // remove previous func_test files
+    r = system(SHELL_DEL" func_test* > errorlog.txt");
+    (void)r;
+
+    config = fdb_get_default_config();
+    config.wal_threshold = 256;
+    config.background_wal_flush = true;
     kvs_config = fdb_get_default_kvs_config();
 
-    // create a file
     s = fdb_open(&dbfile, "func_test", &config);
     TEST_CHK(s == FDB_RESULT_SUCCESS);
-
     s = fdb_kvs_open(dbfile, &db[0], NULL, &kvs_config);
     TEST_CHK(s == FDB_RESULT_SUCCESS);
-
-    s = fdb_kvs_open(dbfile, &db[1], NULL, &kvs_config);
+    s = fdb_kvs_open(dbfile, &db[1], "kvs", &kvs_config);
     TEST_CHK(s == FDB_RESULT_SUCCESS);
 
-    memset(keybuf, 0x0, 256);
-    memset(valuebuf, 0x0, 256);
-
-    // insert docs & dirty WAL flushing
-    for (i=0; i<1000; i++) {
+    // insert docs across many WAL generations, and read docs back while
+    // their generation may be being flushed
+    for (i=0; i<n; i++) {
         sprintf(keybuf, "k%06d", i);
         sprintf(valuebuf, "v%06d", i);
-        fdb_doc_create(&doc, keybuf, 8, NULL, 0, valuebuf, 9);
-        s = fdb_set(db[1], doc);
+        fdb_doc_create(&doc, keybuf, 8, NULL, 0, valuebuf, 8);
+        s = fdb_set(db[i % 2], doc);
         TEST_CHK(s == FDB_RESULT_SUCCESS);
         fdb_doc_free(doc);
-    }
 
-    // get docks
-    for (i=0; i<1000; i++) {
-        sprintf(keybuf, "k%06d", i);
-        fdb_doc_create(&doc, keybuf, 8, NULL, 0, valuebuf, 9);
-        s = fdb_get(db[0], doc);
-        TEST_CHK(s == FDB_RESULT_SUCCESS);
-        fdb_doc_free(doc);
+        if (i >= 300) {
+            sprintf(keybuf, "k%06d", i - 300);
+            sprintf(valuebuf, "v%06d", i - 300);
+            fdb_doc_create(&rdoc, keybuf, 8, NULL, 0, NULL, 0);
+            s = fdb_get(db[i % 2], rdoc);
+            TEST_CHK(s == FDB_RESULT_SUCCESS);
+            TEST_CMP(rdoc->body, valuebuf, 8);
+            fdb_doc_free(rdoc);
+        }
     }
-    // now dirty blocks are cached in db[0]'s (default) bhandle
 
-    // more dirty WAL flushing
-    for (i=1000; i<3000; i++) {
+    // update and delete docs that were frozen into earlier generations
+    for (i=0; i<n; i+=10) {
         sprintf(keybuf, "k%06d", i);
-        sprintf(valuebuf, "v%06d", i);
-        fdb_doc_create(&doc, keybuf, 8, NULL, 0, valuebuf, 9);
-        s = fdb_set(db[1], doc);
+        sprintf(valuebuf, "u%06d", i);
+        fdb_doc_create(&doc, keybuf, 8, NULL, 0, valuebuf, 8);
+        if (i % 20 == 0) {
+            s = fdb_del(db[i % 2], doc);
+        } else {
+            s = fdb_set(db[i % 2], doc);
+        }
         TEST_CHK(s == FDB_RESULT_SUCCESS);
         fdb_doc_free(doc);
     }
 
-    // commit - WAL flushing is executed on the default handle
-    s = fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
-    TEST_CHK(s == FDB_RESULT_SUCCESS);
-
-    // count # docs
-    s = fdb_iterator_init(db[1], &fit, NULL, 0, NULL, 0, FDB_ITR_NONE);
+    // count # docs before commit
+    s = fdb_iterator_init(db[0], &fit, NULL, 0, NULL, 0, FDB_ITR_NONE);
     TEST_CHK(s == FDB_RESULT_SUCCESS);
     r = 0;
     do {
@@ -4954,8 +6002,34 @@ void dirty_index_consistency_test()
         fdb_doc_free(rdoc);
     } while (fdb_iterator_next(fit) == FDB_RESULT_SUCCESS);
     fdb_iterator_close(fit);
+    TEST_CHK(r == n / 2 - n / 20);
 
-    TEST_CHK(r == 3000);
+    s = fdb_commit(dbfile, FDB_COMMIT_NORMAL);
+    TEST_CHK(s == FDB_RESULT_SUCCESS);
+    s = fdb_close(dbfile);
+    TEST_CHK(s == FDB_RESULT_SUCCESS);
+
+    // reopen and verify
+    s = fdb_open(&dbfile, "func_test", &config);
+    TEST_CHK(s == FDB_RESULT_SUCCESS);
+    s = fdb_kvs_open(dbfile, &db[0], NULL, &kvs_config);
+    TEST_CHK(s == FDB_RESULT_SUCCESS);
+    s = fdb_kvs_open(dbfile, &db[1], "kvs", &kvs_config);
+    TEST_CHK(s == FDB_RESULT_SUCCESS);
+
+    for (i=0; i<n; i++) {
+        sprintf(keybuf, "k%06d", i);
+        fdb_doc_create(&rdoc, keybuf, 8, NULL, 0, NULL, 0);
+        s = fdb_get(db[i % 2], rdoc);
+        if (i % 20 == 0) {
+            TEST_CHK(s == FDB_RESULT_KEY_NOT_FOUND);
+        } else {
+            TEST_CHK(s == FDB_RESULT_SUCCESS);
+            sprintf(valuebuf, "%c%06d", (i % 10 == 0) ? 'u' : 'v', i);
+            TEST_CMP(rdoc->body, valuebuf, 8);
+        }
+        fdb_doc_free(rdoc);
+    }
 
     s = fdb_close(dbfile);
     TEST_CHK(s == FDB_RESULT_SUCCESS);
@@ -4963,7 +6037,111 @@ void dirty_index_consistency_test()
     fdb_shutdown();
     memleak_end();
 
-    TEST_RESULT("dirty index consistency test");
+    TEST_RESULT("background WAL flush test");
+}
+
+void parallel_wal_flush_test()
+{
+    TEST_INIT();
+    int i, j, r;
+    int n = 3000;
+    const int num_kvs = 16;
+    fdb_file_handle *dbfile;
+    fdb_kvs_handle *db[num_kvs];
+    fdb_kvs_info kvs_info;
+    fdb_config config;
+    fdb_kvs_config kvs_config;
+    fdb_doc *doc, *rdoc;
+    fdb_status s; (void)s;
+    char keybuf[256], valuebuf[256], kvsname[32];
+
+    memleak_start();
+
+    // remove previous func_test files
+    r = system(SHELL_DEL" func_test* > errorlog.txt");
+    (void)r;
+
+    config = fdb_get_default_config();
+    config.wal_threshold = 1024;
+    config.wal_flush_before_commit = true;
+    config.num_wal_flush_threads = 4;
+    kvs_config = fdb_get_default_kvs_config();
+
+    s = fdb_open(&dbfile, "func_test", &config);
+    TEST_CHK(s == FDB_RESULT_SUCCESS);
+    for (j = 0; j < num_kvs; ++j) {
+        sprintf(kvsname, "kvs%d", j);
+        s = fdb_kvs_open(dbfile, &db[j], kvsname, &kvs_config);
+        TEST_CHK(s == FDB_RESULT_SUCCESS);
+    }
+
+    // insert docs into all the KV stores, then update every 3rd doc and
+    // delete every 5th doc across several WAL flushes
+    for (i = 0; i < n * 3; i++) {
+        int k = i % n;
+        sprintf(keybuf, "k%06d", k);
+        sprintf(valuebuf, "%c%06d", (i < n) ? 'v' : 'u', k);
+        fdb_doc_create(&doc, keybuf, 8, NULL, 0, valuebuf, 8);
+        if (i < n || k % 3 == 0) {
+            s = fdb_set(db[k % num_kvs], doc);
+            TEST_CHK(s == FDB_RESULT_SUCCESS);
+        } else if (i >= n * 2 && k % 5 == 0) {
+            s = fdb_del(db[k % num_kvs], doc);
+            TEST_CHK(s == FDB_RESULT_SUCCESS);
+        }
+        fdb_doc_free(doc);
+        if (i % 1000 == 999) {
+            s = fdb_commit(dbfile, FDB_COMMIT_NORMAL);
+            TEST_CHK(s == FDB_RESULT_SUCCESS);
+        }
+    }
+    s = fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
+    TEST_CHK(s == FDB_RESULT_SUCCESS);
+    s = fdb_close(dbfile);
+    TEST_CHK(s == FDB_RESULT_SUCCESS);
+
+    // reopen and verify the docs and the per KV store doc counts
+    s = fdb_open(&dbfile, "func_test", &config);
+    TEST_CHK(s == FDB_RESULT_SUCCESS);
+    for (j = 0; j < num_kvs; ++j) {
+        sprintf(kvsname, "kvs%d", j);
+        s = fdb_kvs_open(dbfile, &db[j], kvsname, &kvs_config);
+        TEST_CHK(s == FDB_RESULT_SUCCESS);
+    }
+
+    for (i = 0; i < n; i++) {
+        sprintf(keybuf, "k%06d", i);
+        fdb_doc_create(&rdoc, keybuf, 8, NULL, 0, NULL, 0);
+        s = fdb_get(db[i % num_kvs], rdoc);
+        if (i % 5 == 0 && i % 3 != 0) {
+            TEST_CHK(s == FDB_RESULT_KEY_NOT_FOUND);
+        } else {
+            TEST_CHK(s == FDB_RESULT_SUCCESS);
+            sprintf(valuebuf, "%c%06d", (i % 3 == 0) ? 'u' : 'v', i);
+            TEST_CMP(rdoc->body, valuebuf, 8);
+        }
+        fdb_doc_free(rdoc);
+    }
+
+    for (j = 0; j < num_kvs; ++j) {
+        int ndocs = 0;
+        for (i = j; i < n; i += num_kvs) {
+            if (!(i % 5 == 0 && i % 3 != 0)) {
+                ndocs++;
+            }
+        }
+        s = fdb_get_kvs_info(db[j], &kvs_info);
+        TEST_CHK(s == FDB_RESULT_SUCCESS);
+        TEST_CHK(kvs_info.doc_count == (size_t)ndocs);
+    }
+
+    s = fdb_close(dbfile);
+    TEST_CHK(s == FDB_RESULT_SUCCESS);
+
+    fdb_shutdown();
+    memleak_end();
+
+    TEST_RESULT("parallel WAL flush test");
 }
 
 void apis_with_invalid_handles_test() {
@@ -5327,109 +6505,386 @@ void kvs_deletion_without_commit()
         TEST_CHK(s == FDB_RESULT_SUCCESS);
     }
 
-    s = fdb_commit(dbfile, FDB_COMMIT_NORMAL);
-    TEST_CHK(s == FDB_RESULT_SUCCESS);
-
-    s = fdb_kvs_close(db[0]);
-    TEST_CHK(s == FDB_RESULT_SUCCESS);
+    s = fdb_commit(dbfile, FDB_COMMIT_NORMAL);
+    TEST_CHK(s == FDB_RESULT_SUCCESS);
+
+    s = fdb_kvs_close(db[0]);
+    TEST_CHK(s == FDB_RESULT_SUCCESS);
+
+    sprintf(keybuf, "partition%d\n", 0);
+    s = fdb_kvs_remove(dbfile, keybuf);
+    TEST_CHK(s == FDB_RESULT_SUCCESS);
+
+    // close without commit
+    s = fdb_close(dbfile);
+    TEST_CHK(s == FDB_RESULT_SUCCESS);
+
+    // reopen file
+    s = fdb_open(&dbfile, "func_test", &config);
+    TEST_CHK(s == FDB_RESULT_SUCCESS);
+
+    i = 0;
+    sprintf(keybuf, "partition%d\n", i);
+    s = fdb_kvs_open(dbfile, &db[i], keybuf, &kvs_config);
+    TEST_CHK(s == FDB_RESULT_SUCCESS);
+
+    sprintf(keybuf, "k%06d", i);
+    s = fdb_doc_create(&doc, keybuf, strlen(keybuf)+1, NULL, 0, NULL, 0);
+    TEST_CHK(s == FDB_RESULT_SUCCESS);
+    s = fdb_get(db[i], doc);
+    // should fail
+    TEST_CHK(s != FDB_RESULT_SUCCESS);
+
+    fdb_doc_free(doc);
+
+    s = fdb_close(dbfile);
+    TEST_CHK(s == FDB_RESULT_SUCCESS);
+
+    s = fdb_shutdown();
+    TEST_CHK(s == FDB_RESULT_SUCCESS);
+    memleak_end();
+
+    TEST_RESULT("KVS deletion without commit test");
+}
+
+void latency_stats_histogram_test() {
+    TEST_INIT();
+
+    fdb_file_handle *dbfile;
+    fdb_kvs_handle *db;
+    fdb_config fconfig = fdb_get_default_config();
+    fdb_kvs_config kvs_config = fdb_get_default_kvs_config();
+    fdb_status status;
+
+    char keybuf[128], bodybuf[128];
+
+    memleak_start();
+
+    // remove previous func_test files
+    int r = system(SHELL_DEL" func_test* > errorlog.txt");
+    (void)r;
+
+    // open db
+    status = fdb_open(&dbfile, "./func_test1", &fconfig);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_kvs_open_default(dbfile, &db, &kvs_config);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    int count = 100;
+    for (int i = 0; i < count; ++i) {
+        sprintf(keybuf, "key%d", i);
+        sprintf(bodybuf, "val%d", i);
+        status = fdb_set_kv(db, keybuf, strlen(keybuf), bodybuf, strlen(bodybuf));
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+    }
+
+    fdb_latency_stat stat;
+    memset(&stat, 0, sizeof(fdb_latency_stat));
+    status = fdb_get_latency_stats(dbfile, &stat, FDB_LATENCY_SETS);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    fdb_assert(count == static_cast<int>(stat.lat_count),
+               count, static_cast<int>(stat.lat_count));
+
+    char *histogram;
+    size_t length;
+    status = fdb_get_latency_histogram(dbfile, &histogram, &length, FDB_LATENCY_SETS);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    // Sample output: {count : 100; p50 : 1µs; p90 : 2µs; p99 : 3µs;
+    //                 p99.9 : 3µs; max : 3µs; (0µs - 1µs) : 40;
+    //                 (1µs - 2µs) : 50; (2µs - 3µs) : 10; }
+    TEST_CHK(length != 0);
+    TEST_CHK(histogram != nullptr);
+    TEST_CHK(strlen(histogram) == length);
+    TEST_CHK(strstr(histogram, "count : 100;") != nullptr);
+    TEST_CHK(strstr(histogram, "p99.9 : ") != nullptr);
+    free(histogram);
+
+    // no sample yet
+    status = fdb_get_latency_histogram(dbfile, &histogram, &length,
+                                       FDB_LATENCY_ITR_SEEK_MAX);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    TEST_CHK(length == 0);
+    TEST_CHK(histogram == nullptr);
+
+    fdb_kvs_close(db);
+    fdb_close(dbfile);
+
+    fdb_shutdown();
+
+    memleak_end();
+
+    TEST_RESULT("latency stats with histogram test");
+}
+
+struct latency_percentiles_args {
+    fdb_kvs_handle *db;
+    int tid;
+    int ndocs;
+};
+
+static void *_latency_percentiles_thread(void *voidargs)
+{
+    struct latency_percentiles_args *args =
+        (struct latency_percentiles_args *)voidargs;
+    char keybuf[64], bodybuf[64];
+
+    for (int i = 0; i < args->ndocs; ++i) {
+        sprintf(keybuf, "t%d_key%d", args->tid, i);
+        sprintf(bodybuf, "t%d_body%d", args->tid, i);
+        fdb_set_kv(args->db, keybuf, strlen(keybuf),
+                   bodybuf, strlen(bodybuf));
+    }
+    thread_exit(0);
+    return NULL;
+}
+
+void latency_percentiles_test() {
+    TEST_INIT();
+
+    int nthreads = 4;
+    int n = 500;
+    fdb_file_handle *dbfile;
+    fdb_kvs_handle *kv1, *kv2;
+    fdb_kvs_handle **db = alca(fdb_kvs_handle *, nthreads);
+    fdb_config fconfig = fdb_get_default_config();
+    fdb_kvs_config kvs_config = fdb_get_default_kvs_config();
+    fdb_latency_percentiles lat;
+    fdb_status status;
+    thread_t *tid = alca(thread_t, nthreads);
+    void **thread_ret = alca(void *, nthreads);
+    struct latency_percentiles_args *args =
+        alca(struct latency_percentiles_args, nthreads);
+    char keybuf[64];
+    void *value;
+    size_t valuelen;
+
+    memleak_start();
+
+    int r = system(SHELL_DEL" func_test* > errorlog.txt");
+    (void)r;
+
+    fconfig.compaction_threshold = 0;
+    fconfig.durability_opt = FDB_DRB_NONE;
+    status = fdb_open(&dbfile, "./func_test1", &fconfig);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_kvs_open(dbfile, &kv1, "kv1", &kvs_config);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_kvs_open(dbfile, &kv2, "kv2", &kvs_config);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    for (int i = 0; i < n; ++i) {
+        sprintf(keybuf, "kv2_key%d", i);
+        status = fdb_set_kv(kv2, keybuf, strlen(keybuf), keybuf,
+                            strlen(keybuf));
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+    }
+
+    // concurrent writers on separate handles of the same KV store
+    for (int i = 0; i < nthreads; ++i) {
+        status = fdb_kvs_open(dbfile, &db[i], "kv1", &kvs_config);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        args[i].db = db[i];
+        args[i].tid = i;
+        args[i].ndocs = n;
+        thread_create(&tid[i], _latency_percentiles_thread, &args[i]);
+    }
+    for (int i = 0; i < nthreads; ++i) {
+        thread_join(tid[i], &thread_ret[i]);
+    }
+    status = fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    for (int i = 0; i < n; ++i) {
+        sprintf(keybuf, "t0_key%d", i);
+        status = fdb_get_kv(kv1, keybuf, strlen(keybuf), &value, &valuelen);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        fdb_free_block(value);
+        sprintf(keybuf, "kv2_key%d", i);
+        status = fdb_get_kv(kv2, keybuf, strlen(keybuf), &value, &valuelen);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        fdb_free_block(value);
+    }
 
-    sprintf(keybuf, "partition%d\n", 0);
-    s = fdb_kvs_remove(dbfile, keybuf);
-    TEST_CHK(s == FDB_RESULT_SUCCESS);
+    // file level: samples from all the threads are merged
+    status = fdb_get_latency_percentiles(dbfile, &lat, FDB_LATENCY_SETS);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    TEST_CHK(lat.lat_count == (uint64_t)((nthreads + 1) * n));
+    TEST_CHK(lat.lat_p50 <= lat.lat_p90);
+    TEST_CHK(lat.lat_p90 <= lat.lat_p99);
+    TEST_CHK(lat.lat_p99 <= lat.lat_p999);
+    TEST_CHK(lat.lat_p999 <= lat.lat_max);
 
-    // close without commit
-    s = fdb_close(dbfile);
-    TEST_CHK(s == FDB_RESULT_SUCCESS);
+    status = fdb_get_latency_percentiles(dbfile, &lat, FDB_LATENCY_GETS);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    TEST_CHK(lat.lat_count == (uint64_t)(2 * n));
 
-    // reopen file
-    s = fdb_open(&dbfile, "func_test", &config);
-    TEST_CHK(s == FDB_RESULT_SUCCESS);
+    // internal operations
+    status = fdb_get_latency_percentiles(dbfile, &lat,
+                                         FDB_LATENCY_HEADER_COMMIT);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    TEST_CHK(lat.lat_count > 0);
+    status = fdb_get_latency_percentiles(dbfile, &lat, FDB_LATENCY_FSYNC);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    TEST_CHK(lat.lat_count > 0);
+    TEST_CHK(lat.lat_p50 <= lat.lat_max);
 
-    i = 0;
-    sprintf(keybuf, "partition%d\n", i);
-    s = fdb_kvs_open(dbfile, &db[i], keybuf, &kvs_config);
-    TEST_CHK(s == FDB_RESULT_SUCCESS);
+    // KV store level: the writes of all the handles of kv1 are accounted
+    // to kv1
+    status = fdb_get_kvs_latency_percentiles(kv1, &lat, FDB_LATENCY_SETS);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    TEST_CHK(lat.lat_count == (uint64_t)(nthreads * n));
+    status = fdb_get_kvs_latency_percentiles(kv1, &lat, FDB_LATENCY_GETS);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    TEST_CHK(lat.lat_count == (uint64_t)n);
+    status = fdb_get_kvs_latency_percentiles(kv2, &lat, FDB_LATENCY_GETS);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    TEST_CHK(lat.lat_count == (uint64_t)n);
+    status = fdb_get_kvs_latency_percentiles(kv2, &lat, FDB_LATENCY_SETS);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    TEST_CHK(lat.lat_count == (uint64_t)n);
+    status = fdb_get_kvs_latency_percentiles(kv2, &lat, FDB_LATENCY_COMMITS);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    TEST_CHK(lat.lat_count == 0);
 
-    sprintf(keybuf, "k%06d", i);
-    s = fdb_doc_create(&doc, keybuf, strlen(keybuf)+1, NULL, 0, NULL, 0);
-    TEST_CHK(s == FDB_RESULT_SUCCESS);
-    s = fdb_get(db[i], doc);
-    // should fail
-    TEST_CHK(s != FDB_RESULT_SUCCESS);
+    // per-KV store stats survive compaction
+    status = fdb_compact(dbfile, "./func_test2");
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_get_kvs_latency_percentiles(kv1, &lat, FDB_LATENCY_SETS);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    TEST_CHK(lat.lat_count == (uint64_t)(nthreads * n));
+    status = fdb_get_latency_percentiles(dbfile, &lat, FDB_LATENCY_SETS);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    TEST_CHK(lat.lat_count == (uint64_t)((nthreads + 1) * n));
 
-    fdb_doc_free(doc);
+    status = fdb_get_latency_percentiles(dbfile, &lat, FDB_LATENCY_NUM_STATS);
+    TEST_CHK(status == FDB_RESULT_INVALID_ARGS);
+    TEST_CHK(fdb_latency_stat_name(FDB_LATENCY_FSYNC) != NULL);
 
-    s = fdb_close(dbfile);
-    TEST_CHK(s == FDB_RESULT_SUCCESS);
+    for (int i = 0; i < nthreads; ++i) {
+        fdb_kvs_close(db[i]);
+    }
+    fdb_kvs_close(kv1);
+    fdb_kvs_close(kv2);
+    fdb_close(dbfile);
+    fdb_shutdown();
 
-    s = fdb_shutdown();
-    TEST_CHK(s == FDB_RESULT_SUCCESS);
     memleak_end();
 
-    TEST_RESULT("KVS deletion without commit test");
+    TEST_RESULT("latency percentiles test");
 }
 
-void latency_stats_histogram_test() {
+void io_rate_limiter_test() {
     TEST_INIT();
 
+    int n = 2000;
+    uint64_t bg_rate = 4 * 1024 * 1024;
     fdb_file_handle *dbfile;
     fdb_kvs_handle *db;
     fdb_config fconfig = fdb_get_default_config();
     fdb_kvs_config kvs_config = fdb_get_default_kvs_config();
+    fdb_io_rate_stats stats;
     fdb_status status;
-
-    char keybuf[128], bodybuf[128];
+    char keybuf[64], bodybuf[256];
 
     memleak_start();
 
-    // remove previous func_test files
     int r = system(SHELL_DEL" func_test* > errorlog.txt");
     (void)r;
 
-    // open db
+    fconfig.compaction_threshold = 0;
+    fconfig.bg_write_rate_limit = bg_rate;
     status = fdb_open(&dbfile, "./func_test1", &fconfig);
     TEST_CHK(status == FDB_RESULT_SUCCESS);
-    status = fdb_kvs_open_default(dbfile, &db, &kvs_config);
+    status = fdb_kvs_open(dbfile, &db, NULL, &kvs_config);
     TEST_CHK(status == FDB_RESULT_SUCCESS);
 
-    int count = 100;
-    for (int i = 0; i < count; ++i) {
-        sprintf(keybuf, "key%d", i);
-        sprintf(bodybuf, "val%d", i);
-        status = fdb_set_kv(db, keybuf, strlen(keybuf), bodybuf, strlen(bodybuf));
+    memset(bodybuf, 'x', sizeof(bodybuf));
+    for (int i = 0; i < n; ++i) {
+        sprintf(keybuf, "key%06d", i);
+        status = fdb_set_kv(db, keybuf, strlen(keybuf), bodybuf,
+                            sizeof(bodybuf));
         TEST_CHK(status == FDB_RESULT_SUCCESS);
     }
+    status = fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
 
-    fdb_latency_stat stat;
-    memset(&stat, 0, sizeof(fdb_latency_stat));
-    status = fdb_get_latency_stats(dbfile, &stat, FDB_LATENCY_SETS);
+    // foreground commits are charged but never throttled when unlimited
+    status = fdb_get_io_rate_stats(FDB_IO_FG_COMMIT, &stats);
     TEST_CHK(status == FDB_RESULT_SUCCESS);
+    TEST_CHK(stats.rate_limit == 0);
+    TEST_CHK(stats.bytes_requested > 0);
+    TEST_CHK(stats.num_throttled == 0);
+    TEST_CHK(stats.wait_time_us == 0);
+    uint64_t fg_commit_bytes = stats.bytes_requested;
 
-    fdb_assert(count == static_cast<int>(stat.lat_count),
-               count, static_cast<int>(stat.lat_count));
+    // compaction is paced by the background write budget
+    status = fdb_get_io_rate_stats(FDB_IO_BG_WRITE, &stats);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    TEST_CHK(stats.rate_limit == bg_rate);
+    TEST_CHK(stats.bytes_requested == 0);
+    status = fdb_compact(dbfile, "./func_test2");
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_get_io_rate_stats(FDB_IO_BG_WRITE, &stats);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    TEST_CHK(stats.bytes_requested >= (uint64_t)n * sizeof(bodybuf));
+    TEST_CHK(stats.num_throttled > 0);
+    TEST_CHK(stats.bytes_throttled > 0);
+    TEST_CHK(stats.wait_time_us > 0);
 
-    char *histogram;
-    size_t length;
-    status = fdb_get_latency_histogram(dbfile, &histogram, &length, FDB_LATENCY_SETS);
+    // the compactor's commits are not charged to the foreground budget
+    fdb_io_rate_stats fg_stats;
+    status = fdb_get_io_rate_stats(FDB_IO_FG_COMMIT, &fg_stats);
     TEST_CHK(status == FDB_RESULT_SUCCESS);
-#ifdef _PLATFORM_LIB_AVAILABLE
-    // Sample output: {(0µs - 1µs) : 90; (1µs - 2µs) : 10; }
-    TEST_CHK(length != 0);
-    TEST_CHK(histogram != nullptr);
-    free(histogram);
-#else
-    TEST_CHK(length == 0);
-    TEST_CHK(histogram == nullptr);
-#endif
+    TEST_CHK(fg_stats.bytes_requested == fg_commit_bytes);
+
+    for (int i = 0; i < n; ++i) {
+        void *value;
+        size_t valuelen;
+        sprintf(keybuf, "key%06d", i);
+        status = fdb_get_kv(db, keybuf, strlen(keybuf), &value, &valuelen);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        TEST_CMP(value, bodybuf, valuelen);
+        fdb_free_block(value);
+    }
+
+    // limits can be changed at runtime
+    status = fdb_set_io_rate_limit(FDB_IO_FG_READ, 1024 * 1024);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_get_io_rate_stats(FDB_IO_FG_READ, &stats);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    TEST_CHK(stats.rate_limit == 1024 * 1024);
+    status = fdb_set_io_rate_limit(FDB_IO_FG_READ, 0);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_set_io_rate_limit(FDB_IO_BG_WRITE, 0);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_get_io_rate_stats(FDB_IO_BG_WRITE, &stats);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    TEST_CHK(stats.rate_limit == 0);
+
+    status = fdb_set_kv(db, "key", 3, bodybuf, sizeof(bodybuf));
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_get_io_rate_stats(FDB_IO_FG_COMMIT, &fg_stats);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    TEST_CHK(fg_stats.bytes_requested > fg_commit_bytes);
+
+    status = fdb_set_io_rate_limit(FDB_IO_NUM_CLASSES, 1024);
+    TEST_CHK(status == FDB_RESULT_INVALID_ARGS);
+    status = fdb_get_io_rate_stats(FDB_IO_NUM_CLASSES, &stats);
+    TEST_CHK(status == FDB_RESULT_INVALID_ARGS);
 
     fdb_kvs_close(db);
     fdb_close(dbfile);
-
     fdb_shutdown();
 
+    status = fdb_set_io_rate_limit(FDB_IO_BG_WRITE, 1024);
+    TEST_CHK(status == FDB_RESULT_ENGINE_NOT_INSTANTIATED);
+
     memleak_end();
 
-    TEST_RESULT("latency stats with histogram test");
+    TEST_RESULT("I/O rate limiter test");
 }
 
 struct stats_ctx {
@@ -5505,6 +6960,7 @@ void handle_stats_test() {
     TEST_CHK(cb_ctx.stats["Block_cache_hits"] + cb_ctx.stats["Block_cache_misses"] > 0);
     TEST_CHK(cb_ctx.stats["Block_cache_num_items"] > 0);
     TEST_CHK(cb_ctx.stats["Block_cache_num_victims"] > 0);
+    TEST_CHK(cb_ctx.stats["Block_cache_num_evictions"] > 0);
 
     // commit with wal flush
     status = fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
@@ -5526,6 +6982,281 @@ void handle_stats_test() {
     TEST_RESULT("KVS handle stats test");
 }
 
+void cache_warmup_test() {
+    TEST_INIT();
+
+    int i, r;
+    int n = 5000;
+    fdb_file_handle *dbfile;
+    fdb_kvs_handle *db;
+    fdb_config config;
+    fdb_kvs_config kvs_config;
+    fdb_status s; (void)s;
+    char keybuf[32], bodybuf[32];
+    void *value;
+    size_t valuesize;
+    FILE *fp;
+
+    // remove previous func_test files
+    r = system(SHELL_DEL" func_test* > errorlog.txt");
+    (void)r;
+
+    config = fdb_get_default_config();
+    config.cache_warmup_budget = 4 * 1024 * 1024;
+    kvs_config = fdb_get_default_kvs_config();
+
+    s = fdb_open(&dbfile, "./func_test", &config);
+    TEST_CHK(s == FDB_RESULT_SUCCESS);
+    s = fdb_kvs_open_default(dbfile, &db, &kvs_config);
+    TEST_CHK(s == FDB_RESULT_SUCCESS);
+    for (i = 0; i < n; ++i) {
+        sprintf(keybuf, "key%06d", i);
+        sprintf(bodybuf, "val%06d", i);
+        s = fdb_set_kv(db, keybuf, strlen(keybuf), bodybuf, strlen(bodybuf));
+        TEST_CHK(s == FDB_RESULT_SUCCESS);
+    }
+    s = fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
+    TEST_CHK(s == FDB_RESULT_SUCCESS);
+    s = fdb_close(dbfile);
+    TEST_CHK(s == FDB_RESULT_SUCCESS);
+
+    // the list of the cached blocks is saved at close
+    fp = fopen("./func_test.warm", "rb");
+    TEST_CHK(fp != NULL);
+    fclose(fp);
+    fdb_shutdown();
+
+    // reopen, and wait for the warm-up to be done
+    stats_ctx cb_ctx;
+    uint64_t num_items = 0;
+    s = fdb_open(&dbfile, "./func_test", &config);
+    TEST_CHK(s == FDB_RESULT_SUCCESS);
+    s = fdb_kvs_open_default(dbfile, &db, &kvs_config);
+    TEST_CHK(s == FDB_RESULT_SUCCESS);
+    cb_ctx.db = db;
+    for (i = 0; i < 500; ++i) {
+        s = fdb_fetch_handle_stats(db, stats_callback, &cb_ctx);
+        TEST_CHK(s == FDB_RESULT_SUCCESS);
+        if (num_items && cb_ctx.stats["Block_cache_num_items"] == num_items) {
+            break;
+        }
+        num_items = cb_ctx.stats["Block_cache_num_items"];
+        usleep(10000);
+    }
+    TEST_CHK(num_items > 0);
+
+    // all the docs are read from the warmed-up cache
+    uint64_t num_misses = cb_ctx.stats["Block_cache_misses"];
+    for (i = 0; i < n; ++i) {
+        sprintf(keybuf, "key%06d", i);
+        sprintf(bodybuf, "val%06d", i);
+        s = fdb_get_kv(db, keybuf, strlen(keybuf), &value, &valuesize);
+        TEST_CHK(s == FDB_RESULT_SUCCESS);
+        TEST_CMP(value, bodybuf, valuesize);
+        fdb_free_block(value);
+    }
+    s = fdb_fetch_handle_stats(db, stats_callback, &cb_ctx);
+    TEST_CHK(s == FDB_RESULT_SUCCESS);
+    TEST_CHK(cb_ctx.stats["Block_cache_misses"] == num_misses);
+    s = fdb_close(dbfile);
+    TEST_CHK(s == FDB_RESULT_SUCCESS);
+    fdb_shutdown();
+
+    // a corrupted list is ignored
+    fp = fopen("./func_test.warm", "r+b");
+    TEST_CHK(fp != NULL);
+    fseek(fp, 16, SEEK_SET);
+    fwrite("garbage", 1, 7, fp);
+    fclose(fp);
+    s = fdb_open(&dbfile, "./func_test", &config);
+    TEST_CHK(s == FDB_RESULT_SUCCESS);
+    s = fdb_kvs_open_default(dbfile, &db, &kvs_config);
+    TEST_CHK(s == FDB_RESULT_SUCCESS);
+    for (i = 0; i < n; i += 100) {
+        sprintf(keybuf, "key%06d", i);
+        sprintf(bodybuf, "val%06d", i);
+        s = fdb_get_kv(db, keybuf, strlen(keybuf), &value, &valuesize);
+        TEST_CHK(s == FDB_RESULT_SUCCESS);
+        TEST_CMP(value, bodybuf, valuesize);
+        fdb_free_block(value);
+    }
+    s = fdb_close(dbfile);
+    TEST_CHK(s == FDB_RESULT_SUCCESS);
+
+    // the list is removed along with the file
+    s = fdb_destroy("./func_test", &config);
+    TEST_CHK(s == FDB_RESULT_SUCCESS);
+    fp = fopen("./func_test.warm", "rb");
+    TEST_CHK(fp == NULL);
+
+    fdb_shutdown();
+
+    TEST_RESULT("cache warm-up test");
+}
+
+void secondary_cache_test() {
+    TEST_INIT();
+
+    int i, r, round;
+    int n = 20000;
+    fdb_file_handle *dbfile;
+    fdb_kvs_handle *db;
+    fdb_config config;
+    fdb_kvs_config kvs_config;
+    fdb_status s; (void)s;
+    char keybuf[32], bodybuf[32];
+    void *value;
+    size_t valuesize;
+    FILE *fp;
+
+    // remove previous func_test files
+    r = system(SHELL_DEL" func_test* > errorlog.txt");
+    (void)r;
+
+    // the buffer cache holds only a small part of the file
+    config = fdb_get_default_config();
+    config.buffercache_size = 64 * config.blocksize;
+    config.secondary_cache_path = "./func_test_scache";
+    config.secondary_cache_size = 16 * 1024 * 1024;
+    kvs_config = fdb_get_default_kvs_config();
+
+    s = fdb_open(&dbfile, "./func_test", &config);
+    TEST_CHK(s == FDB_RESULT_SUCCESS);
+    s = fdb_kvs_open_default(dbfile, &db, &kvs_config);
+    TEST_CHK(s == FDB_RESULT_SUCCESS);
+
+    fp = fopen("./func_test_scache", "rb");
+    TEST_CHK(fp != NULL);
+    fclose(fp);
+
+    stats_ctx cb_ctx;
+    cb_ctx.db = db;
+    for (round = 0; round < 2; ++round) {
+        // the second round updates all the docs
+        for (i = 0; i < n; ++i) {
+            sprintf(keybuf, "key%06d", i);
+            sprintf(bodybuf, "val%06d_%d", i, round);
+            s = fdb_set_kv(db, keybuf, strlen(keybuf),
+                           bodybuf, strlen(bodybuf));
+            TEST_CHK(s == FDB_RESULT_SUCCESS);
+        }
+        s = fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
+        TEST_CHK(s == FDB_RESULT_SUCCESS);
+
+        // the blocks evicted by the first pass are read back from the
+        // secondary cache by the second one
+        for (int pass = 0; pass < 2; ++pass) {
+            for (i = 0; i < n; ++i) {
+                sprintf(keybuf, "key%06d", i);
+                sprintf(bodybuf, "val%06d_%d", i, round);
+                s = fdb_get_kv(db, keybuf, strlen(keybuf), &value,
+                               &valuesize);
+                TEST_CHK(s == FDB_RESULT_SUCCESS);
+                TEST_CHK(valuesize == strlen(bodybuf));
+                TEST_CMP(value, bodybuf, valuesize);
+                fdb_free_block(value);
+            }
+        }
+    }
+
+    s = fdb_fetch_handle_stats(db, stats_callback, &cb_ctx);
+    TEST_CHK(s == FDB_RESULT_SUCCESS);
+    TEST_CHK(cb_ctx.stats["Secondary_cache_inserts"] > 0);
+    TEST_CHK(cb_ctx.stats["Secondary_cache_hits"] > 0);
+
+    s = fdb_close(dbfile);
+    TEST_CHK(s == FDB_RESULT_SUCCESS);
+    fdb_shutdown();
+
+    // the cache file is removed at shutdown
+    fp = fopen("./func_test_scache", "rb");
+    TEST_CHK(fp == NULL);
+
+    TEST_RESULT("secondary cache test");
+}
+
+void compressed_block_cache_test() {
+    TEST_INIT();
+
+    int i, r, round;
+    int n = 5000;
+    fdb_file_handle *dbfile;
+    fdb_kvs_handle *db;
+    fdb_config config;
+    fdb_kvs_config kvs_config;
+    fdb_status s; (void)s;
+    char keybuf[32], bodybuf[256];
+    void *value;
+    size_t valuesize;
+
+    // remove previous func_test files
+    r = system(SHELL_DEL" func_test* > errorlog.txt");
+    (void)r;
+
+    // the uncompressed tier holds only a small part of the file
+    config = fdb_get_default_config();
+    config.buffercache_size = 64 * config.blocksize;
+    config.compressed_buffercache_size = 4 * 1024 * 1024;
+    kvs_config = fdb_get_default_kvs_config();
+
+    s = fdb_open(&dbfile, "./func_test", &config);
+    TEST_CHK(s == FDB_RESULT_SUCCESS);
+    s = fdb_kvs_open_default(dbfile, &db, &kvs_config);
+    TEST_CHK(s == FDB_RESULT_SUCCESS);
+
+    for (round = 0; round < 2; ++round) {
+        // the second round updates every other doc
+        for (i = round; i < n; i += round + 1) {
+            sprintf(keybuf, "key%06d", i);
+            memset(bodybuf, 'a' + round, 200);
+            sprintf(bodybuf + 200, "val%06d", i);
+            s = fdb_set_kv(db, keybuf, strlen(keybuf),
+                           bodybuf, strlen(bodybuf));
+            TEST_CHK(s == FDB_RESULT_SUCCESS);
+        }
+        s = fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
+        TEST_CHK(s == FDB_RESULT_SUCCESS);
+
+        // the blocks evicted by the first pass are hit in the compressed
+        // tier by the next ones, and promoted as they are read repeatedly
+        for (int pass = 0; pass < 3; ++pass) {
+            for (i = 0; i < n; ++i) {
+                sprintf(keybuf, "key%06d", i);
+                memset(bodybuf, (round && i % 2) ? 'b' : 'a', 200);
+                sprintf(bodybuf + 200, "val%06d", i);
+                s = fdb_get_kv(db, keybuf, strlen(keybuf), &value,
+                               &valuesize);
+                TEST_CHK(s == FDB_RESULT_SUCCESS);
+                TEST_CHK(valuesize == strlen(bodybuf));
+                TEST_CMP(value, bodybuf, valuesize);
+                fdb_free_block(value);
+            }
+        }
+    }
+
+    stats_ctx cb_ctx;
+    cb_ctx.db = db;
+    s = fdb_fetch_handle_stats(db, stats_callback, &cb_ctx);
+    TEST_CHK(s == FDB_RESULT_SUCCESS);
+#ifdef _DOC_COMP
+    TEST_CHK(cb_ctx.stats["Block_cache_compressed_items"] > 0);
+    TEST_CHK(cb_ctx.stats["Block_cache_compressed_bytes"] <
+             cb_ctx.stats["Block_cache_compressed_raw_bytes"]);
+    TEST_CHK(cb_ctx.stats["Block_cache_compressed_hits"] > 0);
+    TEST_CHK(cb_ctx.stats["Block_cache_compressed_promotions"] > 0);
+#else
+    // the tier is not available without snappy
+    TEST_CHK(cb_ctx.stats.find("Block_cache_compressed_items") ==
+             cb_ctx.stats.end());
+#endif
+
+    s = fdb_close(dbfile);
+    TEST_CHK(s == FDB_RESULT_SUCCESS);
+    fdb_shutdown();
+
+    TEST_RESULT("compressed block cache test");
+}
+
 int main() {
 
     basic_test();
@@ -5534,6 +7265,16 @@ int main() {
     config_test();
     delete_reopen_test();
     deleted_doc_get_api_test();
+    get_multi_test(false);
+    get_multi_test(true);
+    io_uring_backend_test();
+    write_batch_test(false);
+    write_batch_test(true);
+    group_commit_test();
+    commit_log_test();
+    bloom_filter_test();
+    pinned_get_test();
+    checksum_mode_test();
     deleted_doc_stat_test();
     complete_delete_test();
     set_get_meta_test();
@@ -5582,6 +7323,8 @@ int main() {
     rekey_test();
     invalid_get_byoffset_test();
     dirty_index_consistency_test();
+    background_wal_flush_test();
+    parallel_wal_flush_test();
     kvs_deletion_without_commit();
     purge_logically_deleted_doc_test();
     large_batch_write_no_commit_test();
@@ -5594,7 +7337,12 @@ int main() {
     changes_since_test("kvs");
 
     latency_stats_histogram_test();
+    latency_percentiles_test();
     handle_stats_test();
+    cache_warmup_test();
+    secondary_cache_test();
+    compressed_block_cache_test();
+    io_rate_limiter_test();
 
     return 0;
 }
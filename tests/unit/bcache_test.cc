@@ -178,6 +178,62 @@ void * worker(void *voidargs)
     return NULL;
 }
 
+void scan_resistance_test()
+{
+    TEST_INIT();
+
+    FileMgr *file;
+    FileMgrConfig config(4096, 200, 1048576, 0x0, 0, FILEMGR_CREATE,
+                         FDB_SEQTREE_NOT_USE, 0, 8, 0, FDB_ENCRYPTION_NONE,
+                         0x00, 0, 0);
+    int i, j, r;
+    int nblocks = 2000;
+    int nhot = 50;
+    size_t hits;
+    uint8_t buf[4096];
+    std::string fname("./bcache_testfile");
+
+    r = system(SHELL_DEL " bcache_testfile");
+    (void)r;
+
+    filemgr_open_result result = FileMgr::open(fname, get_filemgr_ops(),
+                                               &config, NULL);
+    file = result.file;
+
+    memset(buf, 0, 4096);
+    for (i = 0; i < nblocks; ++i) {
+        file->alloc_FileMgr(NULL);
+        file->write_FileMgr(i, buf, NULL);
+    }
+    file->commit_FileMgr(true, NULL);
+
+    // make a small set of blocks hot
+    for (j = 0; j < 5; ++j) {
+        for (i = 0; i < nhot; ++i) {
+            file->read_FileMgr(i, buf, NULL, true);
+        }
+    }
+
+    // full scan over the other blocks
+    for (i = nhot; i < nblocks; ++i) {
+        file->read_FileMgr(i, buf, NULL, true);
+    }
+    TEST_CHK(file->getBCacheEvictions() > 0);
+
+    // most of the hot blocks should survive the scan
+    hits = file->fetchBlockCacheHits();
+    for (i = 0; i < nhot; ++i) {
+        file->read_FileMgr(i, buf, NULL, true);
+    }
+    hits = file->fetchBlockCacheHits() - hits;
+    TEST_CHK(hits >= (size_t)nhot * 9 / 10);
+
+    FileMgr::close(file, true, NULL, NULL);
+    FileMgr::shutdown();
+
+    TEST_RESULT("scan resistance test");
+}
+
 void multi_thread_test(int nblocks, int cachesize,
                        int blocksize, int time_sec,
                        int nwriters, int nreaders)
@@ -247,6 +303,7 @@ void multi_thread_test(int nblocks, int cachesize,
 int main()
 {
     basic_test2();
+    scan_resistance_test();
 #if !defined(THREAD_SANITIZER)
     /**
      * The following tests will be disabled when the code is run with
@@ -17,11 +17,18 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
 
 #include "bnode.h"
 #include "bnodecache.h"
 #include "filemgr.h"
+#include "configuration.h"
+#include "epoch_manager.h"
 #include "filemgr_ops.h"
+#include "secondary_cache.h"
 
 #include "stat_aggregator.h"
 #include "test.h"
@@ -396,8 +403,298 @@ void multi_threaded_read_write_test(int readers,
     TEST_RESULT(title.c_str());
 }
 
+void hot_bnodes_test() {
+    TEST_INIT();
+
+    int r = system(SHELL_DEL" bnodecache_testfile");
+    (void)r;
+
+    curBid = BLK_NOT_FOUND;
+    curOffset = 0;
+
+    BnodeCacheMgr::init(16777216, 1048576);
+
+    FileMgr *file;
+    FileMgrConfig config(4096, 48, 1048576, 0, 0, FILEMGR_CREATE,
+                         FDB_SEQTREE_NOT_USE, 0, 8,
+                         DEFAULT_NUM_BCACHE_PARTITIONS,
+                         FDB_ENCRYPTION_NONE, 0x55, 0, 0);
+    std::string fname("./bnodecache_testfile");
+    filemgr_open_result result = FileMgr::open(fname,
+                                               get_filemgr_ops(),
+                                               &config, nullptr);
+    file = result.file;
+    TEST_CHK(file != nullptr);
+    file->setVersion(FILEMGR_MAGIC_003);
+
+    int n = 20;
+    char keybuf[64], bodybuf[64];
+    std::vector<cs_off_t> offsets;
+    for (int i = 0; i < n; ++i) {
+        Bnode* bnode = new Bnode();
+        for (int j = 0; j < 10; ++j) {
+            sprintf(keybuf, "key_%d_%d", i, j);
+            sprintf(bodybuf, "body_%d_%d", i, j);
+            TEST_CHK(bnode->addKv((void*)keybuf, strlen(keybuf) + 1,
+                                  (void*)bodybuf, strlen(bodybuf) + 1,
+                                  nullptr, true) == BnodeResult::SUCCESS);
+        }
+        cs_off_t offset = assignDirtyNodeOffset(file, bnode);
+        bnode->setCurOffset(offset);
+        BnodeCacheMgr::get()->write(file, bnode, offset);
+        offsets.push_back(offset);
+    }
+    TEST_CHK(BnodeCacheMgr::get()->flush(file) == FDB_RESULT_SUCCESS);
+
+    // all the clean nodes are listed within a large enough budget
+    std::vector<cs_off_t> hot;
+    BnodeCacheMgr::get()->getHotBnodes(file, 16777216, hot);
+    TEST_CHK(hot.size() == offsets.size());
+    std::vector<cs_off_t> sorted(hot);
+    std::sort(sorted.begin(), sorted.end());
+    TEST_CHK(sorted == offsets);
+
+    // the budget limits the memory of the listed nodes
+    Bnode* node = nullptr;
+    BnodeCacheMgr::get()->read(file, &node, offsets[0]);
+    TEST_CHK(node != nullptr);
+    hot.clear();
+    // (the nodes are of about the same size)
+    BnodeCacheMgr::get()->getHotBnodes(file,
+                                       node->getMemConsumption() * 3 / 2,
+                                       hot);
+    node->decRefCount();
+    TEST_CHK(hot.size() == 1);
+
+    FileMgr::close(file, true, NULL, NULL);
+    FileMgr::shutdown();
+
+    TEST_RESULT("BnodeCache: Hot bnodes test");
+}
+
+void secondary_cache_test() {
+    TEST_INIT();
+
+    int r = system(SHELL_DEL" bnodecache_testfile bnodecache_scache");
+    (void)r;
+
+    curBid = BLK_NOT_FOUND;
+    curOffset = 0;
+
+    fdb_config fconfig = get_default_config();
+    fconfig.secondary_cache_path = "./bnodecache_scache";
+    fconfig.secondary_cache_size = 1048576;
+    SecondaryCache *scache = SecondaryCache::init(fconfig);
+    TEST_CHK(scache != nullptr);
+
+    // about a third of the nodes fit in the cache
+    BnodeCacheMgr::init(65536, 32768);
+
+    FileMgr *file;
+    FileMgrConfig config(4096, 48, 1048576, 0, 0, FILEMGR_CREATE,
+                         FDB_SEQTREE_NOT_USE, 0, 8,
+                         DEFAULT_NUM_BCACHE_PARTITIONS,
+                         FDB_ENCRYPTION_NONE, 0x55, 0, 0);
+    std::string fname("./bnodecache_testfile");
+    filemgr_open_result result = FileMgr::open(fname,
+                                               get_filemgr_ops(),
+                                               &config, nullptr);
+    file = result.file;
+    TEST_CHK(file != nullptr);
+    file->setVersion(FILEMGR_MAGIC_003);
+
+    int n = 100;
+    char keybuf[64], bodybuf[64], meta[64];
+    std::vector<cs_off_t> offsets;
+    for (int i = 0; i < n; ++i) {
+        Bnode* bnode = new Bnode();
+        for (int j = 0; j < 50; ++j) {
+            sprintf(keybuf, "key_%d_%d", i, j);
+            sprintf(bodybuf, "body_%d_%d", i, j);
+            TEST_CHK(bnode->addKv((void*)keybuf, strlen(keybuf) + 1,
+                                  (void*)bodybuf, strlen(bodybuf) + 1,
+                                  nullptr, true) == BnodeResult::SUCCESS);
+        }
+        sprintf(meta, "meta%d", i);
+        bnode->setMeta((void*)meta, strlen(meta) + 1);
+        cs_off_t offset = assignDirtyNodeOffset(file, bnode);
+        bnode->setCurOffset(offset);
+        BnodeCacheMgr::get()->write(file, bnode, offset);
+        offsets.push_back(offset);
+    }
+    TEST_CHK(BnodeCacheMgr::get()->flush(file) == FDB_RESULT_SUCCESS);
+    // only committed nodes are kept in the secondary cache
+    TEST_CHK(file->commit_FileMgr(false, nullptr) == FDB_RESULT_SUCCESS);
+
+    // the nodes evicted by the first pass are read back from the secondary
+    // cache by the second one
+    for (int pass = 0; pass < 2; ++pass) {
+        for (int i = 0; i < n; ++i) {
+            Bnode* node = nullptr;
+            int read = BnodeCacheMgr::get()->read(file, &node, offsets[i]);
+            TEST_CHK(node != nullptr);
+            TEST_CHK(read == static_cast<int>(node->getNodeSize()));
+            TEST_CHK(node->getNentry() == 50);
+            sprintf(meta, "meta%d", i);
+            TEST_CMP(node->getMeta(), meta, strlen(meta) + 1);
+            node->decRefCount();
+        }
+    }
+    TEST_CHK(scache->getNumInserts() > 0);
+    TEST_CHK(scache->getNumHits() > 0);
+
+    FileMgr::close(file, true, NULL, NULL);
+    FileMgr::shutdown();
+    SecondaryCache::destroyInstance();
+
+    TEST_RESULT("BnodeCache: Secondary cache test");
+}
+
+static std::atomic<int> numFreed(0);
+
+static void count_free(void *ptr) {
+    numFreed++;
+    free(ptr);
+}
+
+struct optimistic_read_args {
+    FileMgr* file;
+    std::vector<cs_off_t>* offsets;
+    std::atomic<bool>* failed;
+};
+
+void* optimistic_reader_ops(void* args) {
+    struct optimistic_read_args* ra =
+        static_cast<struct optimistic_read_args*>(args);
+    EpochManager::Participant pin(BnodeCacheMgr::getEpochManager());
+    char meta[64];
+    for (size_t i = 0; i < ra->offsets->size() * 20; ++i) {
+        size_t idx = i % ra->offsets->size();
+        cs_off_t off = ra->offsets->at(idx);
+        Bnode* node = nullptr;
+        pin.pin();
+        int read = BnodeCacheMgr::get()->readOptimistic(ra->file, &node, off);
+        // The node is still readable even if it has been evicted meanwhile
+        sprintf(meta, "meta%d", static_cast<int>(idx));
+        if (read != static_cast<int>(node->getNodeSize()) ||
+            off != static_cast<cs_off_t>(node->getCurOffset()) ||
+            node->getRefCount() != 0 ||
+            strcmp(static_cast<char*>(node->getMeta()), meta)) {
+            *ra->failed = true;
+        }
+        if (i % 8 == 7) {
+            pin.unpin();
+        }
+    }
+    return nullptr;
+}
+
+void optimistic_read_test() {
+    TEST_INIT();
+
+    // retired objects are freed only after the participants pinned before
+    // their retirement have unpinned
+    {
+        EpochManager mgr;
+        EpochManager::Participant p1(mgr), p2(mgr);
+        numFreed = 0;
+        p1.pin();
+        mgr.retire(malloc(16), count_free);
+        p2.pin();
+        mgr.retire(malloc(16), count_free);
+        TEST_CHK(mgr.reclaim() == 0);
+        p1.unpin();
+        TEST_CHK(mgr.reclaim() == 1);
+        TEST_CHK(mgr.getNumRetired() == 1);
+        p2.unpin();
+        TEST_CHK(mgr.reclaim() == 1);
+        TEST_CHK(numFreed == 2);
+        mgr.retire(malloc(16), count_free);
+    }
+    TEST_CHK(numFreed == 3);
+
+    int r = system(SHELL_DEL" bnodecache_testfile");
+    (void)r;
+
+    curBid = BLK_NOT_FOUND;
+    curOffset = 0;
+
+    // small enough to evict the nodes while they are read
+    BnodeCacheMgr::init(200000, 102400);
+
+    FileMgr *file;
+    FileMgrConfig config(4096, 48, 1048576, 0, 0, FILEMGR_CREATE,
+                         FDB_SEQTREE_NOT_USE, 0, 8,
+                         DEFAULT_NUM_BCACHE_PARTITIONS,
+                         FDB_ENCRYPTION_NONE, 0x55, 0, 0);
+    std::string fname("./bnodecache_testfile");
+    filemgr_open_result result = FileMgr::open(fname,
+                                               get_filemgr_ops(),
+                                               &config, nullptr);
+    file = result.file;
+    TEST_CHK(file != nullptr);
+    file->setVersion(FILEMGR_MAGIC_003);
+
+    int n = 100;
+    char keybuf[64], bodybuf[64], meta[64];
+    std::vector<cs_off_t> offsets;
+    for (int i = 0; i < n; ++i) {
+        Bnode* bnode = new Bnode();
+        for (int j = 0; j < n; ++j) {
+            sprintf(keybuf, "key_%d_%d", i, j);
+            sprintf(bodybuf, "body_%d_%d", i, j);
+            TEST_CHK(bnode->addKv((void*)keybuf, strlen(keybuf) + 1,
+                                  (void*)bodybuf, strlen(bodybuf) + 1,
+                                  nullptr, true) == BnodeResult::SUCCESS);
+        }
+        sprintf(meta, "meta%d", i);
+        bnode->setMeta((void*)meta, strlen(meta) + 1);
+        cs_off_t offset = assignDirtyNodeOffset(file, bnode);
+        bnode->setCurOffset(offset);
+        BnodeCacheMgr::get()->write(file, bnode, offset);
+        offsets.push_back(offset);
+    }
+    TEST_CHK(BnodeCacheMgr::get()->flush(file) == FDB_RESULT_SUCCESS);
+
+    // a cache hit doesn't take a reference
+    {
+        EpochManager::Participant pin(BnodeCacheMgr::getEpochManager());
+        Bnode* node = nullptr;
+        pin.pin();
+        BnodeCacheMgr::get()->readOptimistic(file, &node, offsets[0]);
+        TEST_CHK(node != nullptr);
+        Bnode* again = nullptr;
+        BnodeCacheMgr::get()->readOptimistic(file, &again, offsets[0]);
+        TEST_CHK(again == node);
+        TEST_CHK(node->getRefCount() == 0);
+        pin.unpin();
+    }
+
+    uint64_t victims = file->getBCacheVictims();
+    std::atomic<bool> failed(false);
+    struct optimistic_read_args args = {file, &offsets, &failed};
+    const int num_readers = 4;
+    thread_t threads[num_readers];
+    for (int i = 0; i < num_readers; ++i) {
+        thread_create(&threads[i], optimistic_reader_ops, &args);
+    }
+    for (int i = 0; i < num_readers; ++i) {
+        thread_join(threads[i], nullptr);
+    }
+    TEST_CHK(!failed);
+    TEST_CHK(file->getBCacheVictims() > victims);
+
+    FileMgr::close(file, true, NULL, NULL);
+    FileMgr::shutdown();
+
+    TEST_RESULT("BnodeCache: Optimistic read test");
+}
+
 int main() {
     basic_read_write_test();
+    hot_bnodes_test();
+    secondary_cache_test();
+    optimistic_read_test();
     multi_threaded_read_write_test(4        /* readers */,
                                    false    /* writer in parallel */);
     multi_threaded_read_write_test(4        /* readers */,
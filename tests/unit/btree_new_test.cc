@@ -18,6 +18,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <map>
+#include <string>
+#include <vector>
 
 #include "test.h"
 #include "common.h"
@@ -672,6 +675,104 @@ void bnode_clone_test()
     TEST_RESULT("bnode clone test");
 }
 
+void bnode_prefix_compression_test()
+{
+    TEST_INIT();
+
+    Bnode *bnode = new Bnode();
+    Bnode *bnode_copy;
+    BnodeResult ret;
+    size_t i;
+    size_t n = 100;
+    size_t keylen, raw_size;
+    char keybuf[64], valuebuf[64];
+    size_t valuelen_out;
+    void *value_out;
+    Bnode *bnode_out;
+
+    // keys sharing a long prefix
+    raw_size = Bnode::getDiskSpaceOfEmptyNode();
+    for (i=0; i<n; ++i) {
+        keylen = sprintf(keybuf, "tenant_0042/path/to/object/%07d", (int)i);
+        sprintf(valuebuf, "v%07d", (int)i);
+        ret = bnode->addKv(keybuf, keylen, valuebuf, 8, nullptr, true);
+        TEST_CHK(ret == BnodeResult::SUCCESS);
+        raw_size += sizeof(uint16_t) * 2 + keylen + 8;
+    }
+    char metabuf[64];
+    sprintf(metabuf, "meta_data");
+    bnode->setMeta(metabuf, 9);
+    raw_size += 9;
+
+    // the common prefix is stored only once
+    TEST_CHK(bnode->getNodeSize() < raw_size / 2);
+
+    void *temp_buf = bnode->exportRaw();
+    size_t node_size = bnode->getNodeSize();
+    TEST_CHK(Bnode::readNodeSize(temp_buf) == node_size);
+
+    uint32_t enc32;
+    memcpy(&enc32, (uint8_t*)temp_buf + sizeof(uint32_t) + sizeof(uint16_t) * 2,
+           sizeof(enc32));
+    TEST_CHK(_endian_decode(enc32) & BNODE_FLAG_PREFIX_COMPRESSED);
+
+    // import restores the full keys
+    bnode_copy = new Bnode();
+    void *temp_read_buf = (void*)malloc(node_size);
+    memcpy(temp_read_buf, temp_buf, node_size);
+    bnode_copy->importRaw(temp_read_buf, node_size);
+    TEST_CHK(bnode_copy->getNodeSize() == node_size);
+    TEST_CHK(bnode_copy->getFlags() == bnode->getFlags());
+    TEST_CMP(bnode_copy->getMeta(), metabuf, 9);
+
+    for (i=0; i<n; ++i) {
+        keylen = sprintf(keybuf, "tenant_0042/path/to/object/%07d", (int)i);
+        sprintf(valuebuf, "v%07d", (int)i);
+        ret = bnode_copy->findKv(keybuf, keylen, value_out, valuelen_out,
+                                 bnode_out);
+        TEST_CHK(ret == BnodeResult::SUCCESS);
+        TEST_CMP(value_out, valuebuf, valuelen_out);
+    }
+
+    // exporting the imported node gives the same image
+    TEST_CMP(bnode_copy->exportRaw(), temp_buf, node_size);
+    delete bnode_copy;
+
+    // a key with a different prefix disables the compression
+    ret = bnode->addKv((void*)"x", 1, valuebuf, 8, nullptr, true);
+    TEST_CHK(ret == BnodeResult::SUCCESS);
+    raw_size += sizeof(uint16_t) * 2 + 1 + 8;
+    TEST_CHK(bnode->getNodeSize() == raw_size);
+    temp_buf = bnode->exportRaw();
+    memcpy(&enc32, (uint8_t*)temp_buf + sizeof(uint32_t) + sizeof(uint16_t) * 2,
+           sizeof(enc32));
+    TEST_CHK(!(_endian_decode(enc32) & BNODE_FLAG_PREFIX_COMPRESSED));
+
+    // and removing it enables the compression again
+    ret = bnode->removeKv((void*)"x", 1);
+    TEST_CHK(ret == BnodeResult::SUCCESS);
+    TEST_CHK(bnode->getNodeSize() == node_size);
+    temp_buf = bnode->exportRaw();
+
+    bnode_copy = new Bnode();
+    temp_read_buf = (void*)malloc(node_size);
+    memcpy(temp_read_buf, temp_buf, node_size);
+    bnode_copy->importRaw(temp_read_buf, node_size);
+    for (i=0; i<n; ++i) {
+        keylen = sprintf(keybuf, "tenant_0042/path/to/object/%07d", (int)i);
+        sprintf(valuebuf, "v%07d", (int)i);
+        ret = bnode_copy->findKv(keybuf, keylen, value_out, valuelen_out,
+                                 bnode_out);
+        TEST_CHK(ret == BnodeResult::SUCCESS);
+        TEST_CMP(value_out, valuebuf, valuelen_out);
+    }
+
+    delete bnode;
+    delete bnode_copy;
+
+    TEST_RESULT("bnode prefix compression test");
+}
+
 void btree_basic_test()
 {
     TEST_INIT();
@@ -1022,6 +1123,146 @@ void btree_multiple_block_test()
     TEST_RESULT("btree multiple block test");
 }
 
+static size_t btree_check_swizzled_children(Bnode *parent)
+{
+    size_t num_swizzled = 0;
+    BsArray& kv_arr = parent->getKvArr();
+    for (BsaItem item = kv_arr.first(); !item.isEmpty();
+         item = kv_arr.next(item)) {
+        Bnode *child = parent->getSwizzledChild(item.idx);
+        if (child) {
+            BtreeNodeAddr addr(item);
+            if (child->getCurOffset() != addr.offset) {
+                return static_cast<size_t>(-1);
+            }
+            num_swizzled++;
+        }
+    }
+    return num_swizzled;
+}
+
+void btree_swizzle_test()
+{
+    TEST_INIT();
+
+    BtreeV2 *btree;
+    BtreeV2Result br;
+    BnodeMgr *b_mgr;
+    FileMgrConfig config(4096, 3906, 1048576, 0, 0, FILEMGR_CREATE,
+                         FDB_SEQTREE_NOT_USE, 0, 8, 0, FDB_ENCRYPTION_NONE,
+                         0x00, 0, 0);
+    filemgr_open_result fr;
+    std::string fname("./btree_new_testfile");
+
+    int r = system(SHELL_DEL" btree_new_testfile");
+    (void)r;
+
+    fr = FileMgr::open(fname, get_filemgr_ops(), &config, NULL);
+
+    size_t i;
+    size_t n = 1000;
+    char keybuf[64], valuebuf[64], valuebuf_chk[64];
+
+    std::vector<BtreeKvPair> kv_list(n);
+
+    for (i=0; i<n; ++i) {
+        kv_list[i].keylen = kv_list[i].valuelen = 8;
+        kv_list[i].key = (void*)malloc( kv_list[i].keylen+1 );
+        kv_list[i].value = (void*)malloc( kv_list[i].valuelen+1 );
+        sprintf((char*)kv_list[i].key, "k%07d", (int)i*2 + 10);
+        sprintf((char*)kv_list[i].value, "v%07d", (int)i*2 + 10);
+    }
+
+    BnodeCacheMgr::init(16000000, 16000000);
+    BnodeCacheMgr::get()->createFileBnodeCache(fr.file);
+    b_mgr = new BnodeMgr();
+    b_mgr->setFile(fr.file);
+    btree = new BtreeV2();
+    btree->setBMgr(b_mgr);
+
+    btree->insertMulti( kv_list );
+    btree->writeDirtyNodes();
+    b_mgr->moveDirtyNodesToBcache();
+    TEST_CHK(btree->getHeight() > 1);
+
+    BtreeKvPair kv;
+    kv.value = (void*)valuebuf_chk;
+
+    // the first traversal swizzles the child pointers of the root node,
+    // and the second one follows them
+    Bnode *root = b_mgr->readNode(btree->getRootAddr().offset);
+    TEST_CHK(btree_check_swizzled_children(root) == 0);
+    for (int pass = 0; pass < 2; ++pass) {
+        for (i=0; i<n; ++i) {
+            kv.key = kv_list[i].key;
+            kv.keylen = kv_list[i].keylen;
+            br = btree->find(kv);
+            TEST_CHK(br == BtreeV2Result::SUCCESS);
+            TEST_CMP(kv.value, kv_list[i].value, kv.valuelen);
+        }
+        TEST_CHK(btree_check_swizzled_children(root) == root->getNentry());
+    }
+    b_mgr->releaseCleanNodes();
+
+    // updates replace the root node and some of its children: the pointers
+    // to the invalidated children are cleared
+    for (i=0; i<n; i+=100) {
+        sprintf(keybuf, "k%07d", (int)i*2 + 10);
+        sprintf(valuebuf, "X%07d", (int)i*2 + 10);
+        kv.key = keybuf;
+        kv.value = valuebuf;
+        kv.keylen = kv.valuelen = 8;
+        btree->insert( kv );
+    }
+    b_mgr->releaseCleanNodes();
+
+    // evict most of the nodes, including those being traversed
+    BnodeCacheMgr::get()->updateBnodeCacheLimit(8192);
+    btree->writeDirtyNodes();
+    b_mgr->moveDirtyNodesToBcache();
+
+    kv.value = (void*)valuebuf_chk;
+    for (int pass = 0; pass < 2; ++pass) {
+        for (i=0; i<n; ++i) {
+            sprintf(keybuf, "k%07d", (int)i*2 + 10);
+            if (i % 100 == 0) {
+                sprintf(valuebuf, "X%07d", (int)i*2 + 10);
+            } else {
+                sprintf(valuebuf, "v%07d", (int)i*2 + 10);
+            }
+            kv.key = keybuf;
+            kv.keylen = 8;
+            br = btree->find(kv);
+            TEST_CHK(br == BtreeV2Result::SUCCESS);
+            TEST_CMP(kv.value, valuebuf, kv.valuelen);
+            if (i % 10 == 0) {
+                b_mgr->releaseCleanNodes();
+            }
+        }
+        root = b_mgr->readNode(btree->getRootAddr().offset);
+        TEST_CHK(btree_check_swizzled_children(root) !=
+                 static_cast<size_t>(-1));
+        b_mgr->releaseCleanNodes();
+    }
+    TEST_CHK(fr.file->getBCacheVictims() > 0);
+
+    for (i=0; i<n; ++i) {
+        free(kv_list[i].key);
+        free(kv_list[i].value);
+    }
+
+    delete btree;
+    delete b_mgr;
+
+    FileMgr::close(fr.file, true, NULL, NULL);
+
+    BnodeCacheMgr::destroyInstance();
+
+    FileMgr::shutdown();
+
+    TEST_RESULT("btree swizzle test");
+}
+
 void btree_metadata_test()
 {
     TEST_INIT();
@@ -1430,6 +1671,156 @@ void btree_custom_cmp_test()
     TEST_RESULT("btree custom compare function test");
 }
 
+void btree_bulk_load_test()
+{
+    TEST_INIT();
+
+    BtreeV2 *btree;
+    BtreeV2Result br;
+    BnodeMgr *b_mgr;
+    FileMgrConfig config(4096, 3906, 1048576, 0, 0, FILEMGR_CREATE,
+                         FDB_SEQTREE_NOT_USE, 0, 8, 0, FDB_ENCRYPTION_NONE,
+                         0x00, 0, 0);
+    filemgr_open_result fr;
+    std::string fname("./btree_new_testfile");
+
+    int r = system(SHELL_DEL" btree_new_testfile");
+    (void)r;
+
+    fr = FileMgr::open(fname, get_filemgr_ops(), &config, NULL);
+
+    size_t i;
+    size_t n = 10000;
+    char keybuf[64], valuebuf[64], valuebuf_chk[64];
+    char metabuf[64], metabuf_chk[64];
+
+    std::vector<BtreeKvPair> kv_list(n);
+
+    for (i=0; i<n; ++i) {
+        kv_list[i].keylen = kv_list[i].valuelen = 8;
+        kv_list[i].key = (void*)malloc( kv_list[i].keylen+1 );
+        kv_list[i].value = (void*)malloc( kv_list[i].valuelen+1 );
+        sprintf((char*)kv_list[i].key, "k%07d", (int)i*2);
+        sprintf((char*)kv_list[i].value, "v%07d", (int)i*2);
+    }
+
+    BnodeCacheMgr::init(16000000, 16000000);
+    BnodeCacheMgr::get()->createFileBnodeCache(fr.file);
+    b_mgr = new BnodeMgr();
+    b_mgr->setFile(fr.file);
+    btree = new BtreeV2();
+    btree->setBMgr(b_mgr);
+
+    // meta data of an empty tree should be preserved.
+    sprintf(metabuf, "meta_data");
+    btree->updateMeta(BtreeV2Meta(10, metabuf));
+
+    br = btree->bulkLoad( kv_list );
+    TEST_CHK(br == BtreeV2Result::SUCCESS);
+    TEST_CHK(btree->getNentry() == n);
+    TEST_CHK(btree->getHeight() > 1);
+    // all nodes are written, thus the tree is clean.
+    TEST_CHK(!btree->getRootAddr().isDirty);
+
+    BtreeV2Meta meta(0, metabuf_chk);
+    btree->readMeta(meta);
+    b_mgr->releaseCleanNodes();
+    TEST_CHK(meta.size == 10);
+    TEST_CMP(metabuf_chk, metabuf, meta.size);
+
+    BtreeKvPair kv;
+    kv.value = (void*)valuebuf_chk;
+
+    // retrieval check
+    for (i=0; i<n; ++i) {
+        kv.key = kv_list[i].key;
+        kv.keylen = kv_list[i].keylen;
+        br = btree->find(kv);
+        b_mgr->releaseCleanNodes();
+        TEST_CHK(br == BtreeV2Result::SUCCESS);
+        TEST_CMP(kv.value, kv_list[i].value, kv.valuelen);
+    }
+
+    // iteration check
+    BtreeIteratorV2 *bit = new BtreeIteratorV2(btree);
+    i = 0;
+    do {
+        kv = bit->getKvBT();
+        if (!kv.key) {
+            break;
+        }
+        TEST_CMP(kv.key, kv_list[i].key, kv.keylen);
+        ++i;
+    } while (bit->nextBT() == BnodeIteratorResult::SUCCESS);
+    delete bit;
+    b_mgr->releaseCleanNodes();
+    TEST_CHK(i == n);
+
+    // bulk-loaded tree should serve normal updates:
+    // insert keys between existing ones.
+    for (i=0; i<n; i+=10) {
+        sprintf(keybuf, "k%07d", (int)i*2 + 1);
+        sprintf(valuebuf, "v%07d", (int)i*2 + 1);
+        kv.key = keybuf;
+        kv.value = valuebuf;
+        kv.keylen = kv.valuelen = 8;
+        btree->insert( kv );
+    }
+    b_mgr->releaseCleanNodes();
+
+    // flush dirty nodes
+    btree->writeDirtyNodes();
+    b_mgr->moveDirtyNodesToBcache();
+
+    kv.value = (void*)valuebuf_chk;
+    for (i=0; i<n*2; ++i) {
+        sprintf(keybuf, "k%07d", (int)i);
+        sprintf(valuebuf, "v%07d", (int)i);
+        kv.key = keybuf;
+        kv.keylen = 8;
+        br = btree->find(kv);
+        b_mgr->releaseCleanNodes();
+        if (i % 2 == 0 || (i / 2) % 10 == 0) {
+            TEST_CHK(br == BtreeV2Result::SUCCESS);
+            TEST_CMP(kv.value, valuebuf, kv.valuelen);
+        } else {
+            TEST_CHK(br != BtreeV2Result::SUCCESS);
+        }
+    }
+
+    // bulk-loading into a non-empty tree: fall back to the normal insertion.
+    for (i=0; i<n; ++i) {
+        sprintf((char*)kv_list[i].value, "X%07d", (int)i*2);
+    }
+    br = btree->bulkLoad( kv_list );
+    b_mgr->releaseCleanNodes();
+    TEST_CHK(br == BtreeV2Result::SUCCESS);
+    for (i=0; i<n; ++i) {
+        kv.key = kv_list[i].key;
+        kv.keylen = kv_list[i].keylen;
+        br = btree->find(kv);
+        b_mgr->releaseCleanNodes();
+        TEST_CHK(br == BtreeV2Result::SUCCESS);
+        TEST_CMP(kv.value, kv_list[i].value, kv.valuelen);
+    }
+
+    for (i=0; i<n; ++i) {
+        free(kv_list[i].key);
+        free(kv_list[i].value);
+    }
+
+    delete btree;
+    delete b_mgr;
+
+    FileMgr::close(fr.file, true, NULL, NULL);
+
+    BnodeCacheMgr::destroyInstance();
+
+    FileMgr::shutdown();
+
+    TEST_RESULT("btree bulk load test");
+}
+
 void bsa_seq_insert_test()
 {
     TEST_INIT();
@@ -1728,6 +2119,121 @@ void bsa_base_offset_test()
     TEST_RESULT("Bs Array base offset test");
 }
 
+static void bsa_check_search(BsArray& bsa,
+                             std::map<std::string, std::string>& ref,
+                             std::string& key)
+{
+    TEST_INIT();
+    BsaItem query((void*)key.data(), key.size());
+    BsaItem item;
+    std::map<std::string, std::string>::iterator it;
+
+    item = bsa.find(query);
+    it = ref.find(key);
+    if (it == ref.end()) {
+        TEST_CHK(item.isEmpty());
+    } else {
+        TEST_CHK(!item.isEmpty());
+        TEST_CMP(item.value, it->second.data(), item.valuelen);
+    }
+
+    item = bsa.findSmallerOrEqual(query);
+    it = ref.upper_bound(key);
+    if (it == ref.begin()) {
+        TEST_CHK(item.isEmpty());
+    } else {
+        --it;
+        TEST_CHK(!item.isEmpty());
+        TEST_CHK(std::string((char*)item.key, item.keylen) == it->first);
+    }
+
+    item = bsa.findGreaterOrEqual(query);
+    it = ref.lower_bound(key);
+    if (it == ref.end()) {
+        TEST_CHK(item.isEmpty());
+    } else {
+        TEST_CHK(!item.isEmpty());
+        TEST_CHK(std::string((char*)item.key, item.keylen) == it->first);
+    }
+}
+
+void bsa_key_prefix_test()
+{
+    TEST_INIT();
+
+    BsArray bsa, bsa_copy;
+    BsaItem query, item, start_item, end_item;
+    std::map<std::string, std::string> ref;
+    std::vector<std::string> keys;
+    std::string key, value;
+    size_t i, idx;
+    size_t n = 60;
+    char keybuf[64];
+
+    // keys sharing the first 8 bytes or more, keys shorter than 8 bytes,
+    // and keys differing only in trailing zero bytes.
+    for (i=0; i<n/3; ++i) {
+        sprintf(keybuf, "common_prefix_%04d", (int)i);
+        keys.push_back(keybuf);
+        sprintf(keybuf, "k%d", (int)i);
+        keys.push_back(keybuf);
+        key = std::string(keybuf) + std::string(i % 4 + 1, '\0');
+        keys.push_back(key);
+    }
+
+    idx = 0;
+    for (i=0; i<n; ++i) {
+        idx = (idx + 7) % n;
+        value = "v" + keys[idx];
+        ref[keys[idx]] = value;
+        query = BsaItem((void*)keys[idx].data(), keys[idx].size(),
+                        (void*)value.data(), value.size());
+        bsa.insert(query);
+    }
+    TEST_CHK(bsa.getNumElems() == n);
+
+    for (i=0; i<n; ++i) {
+        bsa_check_search(bsa, ref, keys[i]);
+        // non-existing keys around the existing ones
+        key = keys[i] + "0";
+        bsa_check_search(bsa, ref, key);
+        key = keys[i].substr(0, keys[i].size() - 1);
+        bsa_check_search(bsa, ref, key);
+    }
+
+    // remove
+    for (i=0; i<n; i+=2) {
+        query = BsaItem((void*)keys[i].data(), keys[i].size());
+        item = bsa.remove(query);
+        TEST_CHK(!item.isEmpty());
+        ref.erase(keys[i]);
+    }
+    for (i=0; i<n; ++i) {
+        bsa_check_search(bsa, ref, keys[i]);
+    }
+
+    // copy the items in the middle into another array
+    start_item = bsa.first();
+    for (i=0; i<5; ++i) {
+        start_item = bsa.next(start_item);
+    }
+    end_item = start_item;
+    for (i=0; i<10; ++i) {
+        end_item = bsa.next(end_item);
+    }
+    bsa_copy.copyFromOtherArray(bsa, start_item, end_item);
+    key = std::string((char*)start_item.key, start_item.keylen);
+    ref.erase(ref.begin(), ref.find(key));
+    key = std::string((char*)end_item.key, end_item.keylen);
+    ref.erase(++ref.find(key), ref.end());
+    TEST_CHK(bsa_copy.getNumElems() == ref.size());
+    for (i=0; i<n; ++i) {
+        bsa_check_search(bsa_copy, ref, keys[i]);
+    }
+
+    TEST_RESULT("Bs Array key prefix test");
+}
+
 void bnodemgr_basic_test()
 {
     TEST_INIT();
@@ -2606,6 +3112,183 @@ void hbtriev2_variable_length_value_test()
     TEST_RESULT("hb+trie V2 variable length value test");
 }
 
+void hbtriev2_bulk_load_test()
+{
+    TEST_INIT();
+
+    HBTrie *hbtrie;
+    hbtrie_result hr;
+    BnodeMgr *b_mgr;
+    FileMgrConfig config(4096, 3906, 1048576, 0, 0, FILEMGR_CREATE,
+                         FDB_SEQTREE_NOT_USE, 0, 8, 0, FDB_ENCRYPTION_NONE,
+                         0x00, 0, 0);
+    filemgr_open_result fr;
+    std::string fname("./hbtrie_new_testfile");
+
+    int r = system(SHELL_DEL" hbtrie_new_testfile");
+    (void)r;
+
+    fr = FileMgr::open(fname, get_filemgr_ops(), &config, NULL);
+    // set file version to 003
+    fr.file->setVersion(FILEMGR_MAGIC_003);
+
+    size_t i;
+    size_t n = 5000;
+    uint64_t offset;
+    char keybuf[64];
+
+    // key structure (chunk size: 8):
+    // ________a1234                  (unique chunk)
+    // ________bbbbbbbbbbbbbbbb1234   (skipped prefix)
+    // ________bbbbbbbb00001234       (shared chunk)
+    // ________bbbbbbbb               (same as the prefix)
+    // ________c0001234               (variable length)
+    std::map<std::string, uint64_t> keys;
+    memset(keybuf, '_', sizeof(keybuf));
+    for (i=0; i<n; ++i) {
+        switch (i % 4) {
+        case 0:
+            sprintf(keybuf+8, "a%d", (int)i);
+            break;
+        case 1:
+            sprintf(keybuf+8, "bbbbbbbbbbbbbbbb%d", (int)i);
+            break;
+        case 2:
+            sprintf(keybuf+8, "bbbbbbbb%08d", (int)i);
+            break;
+        case 3:
+            sprintf(keybuf+8, "c%0*d", (int)(i % 20), (int)i);
+            break;
+        }
+        keys[std::string(keybuf)] = i;
+    }
+    keys[std::string("________bbbbbbbb")] = n;
+    keys[std::string("________bbbbbbbbbbbbbbbb")] = n+1;
+    keys[std::string("________bbbb")] = n+2;
+
+    std::vector<BtreeKvPair> kv_list;
+    std::vector<uint64_t> offsets(keys.size());
+    for (auto &entry: keys) {
+        offsets[kv_list.size()] = _endian_encode(entry.second);
+        kv_list.push_back(BtreeKvPair((void*)entry.first.data(),
+                                      entry.first.size(),
+                                      &offsets[kv_list.size()],
+                                      sizeof(uint64_t)));
+    }
+
+    BnodeCacheMgr::init(16000000, 16000000);
+    BnodeCacheMgr::get()->createFileBnodeCache(fr.file);
+    b_mgr = new BnodeMgr();
+    b_mgr->setFile(fr.file);
+
+    BtreeNodeAddr init_root;
+    hbtrie = new HBTrie(8, 4096, init_root, b_mgr, fr.file);
+
+    hr = hbtrie->bulkLoad(kv_list);
+    TEST_CHK(hr == HBTRIE_RESULT_SUCCESS);
+    TEST_CHK(!hbtrie->getRootAddr().isDirty);
+
+    // retrieval check
+    for (auto &entry: keys) {
+        offset = 0;
+        hr = hbtrie->find((void*)entry.first.data(), entry.first.size(),
+                          &offset);
+        b_mgr->releaseCleanNodes();
+        TEST_CHK(hr == HBTRIE_RESULT_SUCCESS);
+        offset = _endian_decode(offset);
+        TEST_CHK(offset == entry.second);
+    }
+
+    // retrieval check using non-existing keys
+    const char *non_existing[] = {"________b", "________bbbbbbbbbbbb",
+                                  "________bbbbbbbbbbbbbbbbx",
+                                  "________bbbbbbbb0000000x", "________d"};
+    for (i=0; i<sizeof(non_existing)/sizeof(non_existing[0]); ++i) {
+        hr = hbtrie->find((void*)non_existing[i], strlen(non_existing[i]),
+                          &offset);
+        b_mgr->releaseCleanNodes();
+        TEST_CHK(hr != HBTRIE_RESULT_SUCCESS);
+    }
+
+    // bulk-loaded trie should serve normal updates.
+    for (i=0; i<n; i+=10) {
+        sprintf(keybuf+8, "bbbbbbbbbbbbbbbb%dx", (int)i);
+        offset = _endian_encode(i + n*2);
+        hr = hbtrie->insert(keybuf, strlen(keybuf), &offset, nullptr);
+        b_mgr->releaseCleanNodes();
+        TEST_CHK(hr == HBTRIE_RESULT_SUCCESS);
+        keys[std::string(keybuf)] = i + n*2;
+    }
+    hbtrie->writeDirtyNodes();
+    b_mgr->moveDirtyNodesToBcache();
+
+    for (auto &entry: keys) {
+        offset = 0;
+        hr = hbtrie->find((void*)entry.first.data(), entry.first.size(),
+                          &offset);
+        b_mgr->releaseCleanNodes();
+        TEST_CHK(hr == HBTRIE_RESULT_SUCCESS);
+        offset = _endian_decode(offset);
+        TEST_CHK(offset == entry.second);
+    }
+    delete hbtrie;
+
+    // buffered insertions in a random order, including duplicate keys,
+    // and the memory limit that is exceeded in the middle.
+    size_t limits[] = {(size_t)64*1024*1024, 16384};
+    for (auto limit: limits) {
+        hbtrie = new HBTrie(8, 4096, init_root, b_mgr, fr.file);
+        hbtrie->beginBulkLoad(limit);
+        std::vector<std::string> key_vec;
+        for (auto &entry: keys) {
+            key_vec.push_back(entry.first);
+        }
+        for (i=0; i<key_vec.size(); ++i) {
+            // stale value, overwritten below.
+            const std::string& key = key_vec[(i * 7919) % key_vec.size()];
+            offset = _endian_encode((uint64_t)0);
+            hr = hbtrie->insert((void*)key.data(), key.size(),
+                                &offset, nullptr);
+            b_mgr->releaseCleanNodes();
+            TEST_CHK(hr == HBTRIE_RESULT_SUCCESS);
+        }
+        for (i=key_vec.size(); i>0; --i) {
+            const std::string& key = key_vec[i-1];
+            offset = _endian_encode(keys[key]);
+            hr = hbtrie->insert((void*)key.data(), key.size(),
+                                &offset, nullptr);
+            b_mgr->releaseCleanNodes();
+            TEST_CHK(hr == HBTRIE_RESULT_SUCCESS);
+        }
+        hr = hbtrie->endBulkLoad();
+        b_mgr->releaseCleanNodes();
+        TEST_CHK(hr == HBTRIE_RESULT_SUCCESS);
+
+        for (auto &entry: keys) {
+            offset = 0;
+            hr = hbtrie->find((void*)entry.first.data(), entry.first.size(),
+                              &offset);
+            b_mgr->releaseCleanNodes();
+            TEST_CHK(hr == HBTRIE_RESULT_SUCCESS);
+            offset = _endian_decode(offset);
+            TEST_CHK(offset == entry.second);
+        }
+        hbtrie->writeDirtyNodes();
+        b_mgr->moveDirtyNodesToBcache();
+        delete hbtrie;
+    }
+
+    delete b_mgr;
+
+    FileMgr::close(fr.file, true, NULL, NULL);
+
+    BnodeCacheMgr::destroyInstance();
+
+    FileMgr::shutdown();
+
+    TEST_RESULT("hb+trie V2 bulk load test");
+}
+
 int main()
 {
     bnode_basic_test();
@@ -2613,12 +3296,14 @@ int main()
     bnode_split_test();
     bnode_custom_cmp_test();
     bnode_clone_test();
+    bnode_prefix_compression_test();
 
     bsa_seq_insert_test();
     bsa_rand_insert_test();
     bsa_insert_ptr_test();
     bsa_iteration_test();
     bsa_base_offset_test();
+    bsa_key_prefix_test();
 
     bnodemgr_basic_test();
 
@@ -2626,10 +3311,12 @@ int main()
     btree_remove_test();
     btree_iterator_test();
     btree_multiple_block_test();
+    btree_swizzle_test();
     btree_metadata_test();
     btree_smaller_greater_test();
     btree_smaller_greater_edge_case_test();
     btree_custom_cmp_test();
+    btree_bulk_load_test();
 
     hbtriev2_basic_test();
     hbtriev2_substring_test();
@@ -2638,6 +3325,7 @@ int main()
     hbtriev2_partial_update_test();
     hbtriev2_custom_cmp_test();
     hbtriev2_variable_length_value_test();
+    hbtriev2_bulk_load_test();
     return 0;
 }
 
@@ -20,9 +20,13 @@
 #include <string.h>
 
 #include "hash.h"
+#include "skiplist.h"
 #include "test.h"
 #include "common.h"
 #include "hash_functions.h"
+#include "checksum.h"
+#include "crc32c.h"
+#include "xxhash3.h"
 
 struct item {
     int val;
@@ -174,10 +178,262 @@ void twohash_test()
     TEST_RESULT("two-integer hash test");
 }
 
+void checksum_test()
+{
+    TEST_INIT();
+
+    size_t i, off, len;
+    uint8_t buf[65536 + 8];
+    uint8_t seq[512];
+    char temp[256];
+    crc_mode_e mode;
+
+    // known answers
+    TEST_CHK(crc32c_8("123456789", 9, 0) == 0xe3069283);
+    TEST_CHK(crc32c_8_sw("123456789", 9, 0) == 0xe3069283);
+    for (i = 0; i < sizeof(seq); ++i) {
+        seq[i] = i;
+    }
+    TEST_CHK(xxh3_64_with_seed(NULL, 0, 0) == 0x2d06800538d394c2ULL);
+    TEST_CHK(xxh3_64_with_seed("abc", 3, 0) == 0x78af5f94892f3950ULL);
+    TEST_CHK(xxh3_64_with_seed("123456789", 9, 0x1234) ==
+             0x06b6e57be41338d0ULL);
+    TEST_CHK(xxh3_64_with_seed(seq, sizeof(seq), 0) == 0x1059105ad19bfa09ULL);
+    TEST_CHK(xxh3_64_with_seed(seq, sizeof(seq), 0x1234) ==
+             0xec4aa532060ed7b3ULL);
+
+    // the dispatched CRC32-C should match the table-based one for any
+    // alignment and length, including the interleaved paths
+    for (i = 0; i < sizeof(buf); ++i) {
+        buf[i] = rand();
+    }
+    for (off = 0; off < 8; ++off) {
+        for (len = 0; len + off <= 65536; len += (len < 1024 ? 1 : 1021)) {
+            uint32_t crc = crc32c_8(buf + off, len, 0x1234);
+            TEST_CHK(crc == crc32c_8_sw(buf + off, len, 0x1234));
+            // chaining the pre value
+            TEST_CHK(crc == crc32c_8(buf + off + len / 3, len - len / 3,
+                                     crc32c_8(buf + off, len / 3, 0x1234)));
+        }
+    }
+
+    // every mode should be detected
+    crc_mode_e modes[] = {CRC32, CRC32C, XXH3};
+    for (i = 0; i < 3; ++i) {
+        uint32_t crc = get_checksum(buf, 4096, modes[i]);
+        TEST_CHK(perform_integrity_check(buf, 4096, crc, modes[i]));
+        TEST_CHK(perform_integrity_check(buf, 4096, crc, CRC_UNKNOWN));
+        TEST_CHK(detect_and_check_crc(buf, 4096, crc, &mode));
+        TEST_CHK(mode == modes[i]);
+        TEST_CHK(!detect_and_check_crc(buf, 4096, crc + 1, &mode));
+        TEST_CHK(mode == CRC_UNKNOWN);
+    }
+
+    sprintf(temp, "checksum test (crc32c: %s)", crc32c_impl_name());
+    TEST_RESULT(temp);
+}
+
+struct sl_item {
+    int val;
+    struct skiplist_node snode;
+};
+
+int skiplist_cmp(struct skiplist_node *a, struct skiplist_node *b, void *aux)
+{
+    struct sl_item *aa, *bb;
+    aa = _get_entry(a, struct sl_item, snode);
+    bb = _get_entry(b, struct sl_item, snode);
+    if (aa->val < bb->val) return -1;
+    else if (aa->val > bb->val) return 1;
+    else return 0;
+}
+
+void skiplist_basic_test()
+{
+    TEST_INIT();
+
+    struct skiplist_raw slist;
+    struct sl_item item[256], dup, query, *result;
+    struct skiplist_node *node;
+    int i, n = 256;
+
+    skiplist_init(&slist, skiplist_cmp, NULL);
+
+    // insert in a scrambled order
+    for (i=0;i<n;++i){
+        item[i].val = (i * 37) % n;
+        skiplist_init_node(&item[i].snode);
+        TEST_CHK(skiplist_insert(&slist, &item[i].snode) == NULL);
+    }
+    TEST_CHK(skiplist_get_size(&slist) == (size_t)n);
+
+    // an equal node is rejected
+    dup.val = 10;
+    skiplist_init_node(&dup.snode);
+    node = skiplist_insert(&slist, &dup.snode);
+    TEST_CHK(node && _get_entry(node, struct sl_item, snode)->val == 10);
+    TEST_CHK(node != &dup.snode);
+
+    // in-order traversal
+    i = 0;
+    for (node = skiplist_first(&slist); node; node = skiplist_next(node)) {
+        result = _get_entry(node, struct sl_item, snode);
+        TEST_CHK(result->val == i);
+        ++i;
+    }
+    TEST_CHK(i == n);
+
+    // remove the odd values
+    for (i=0;i<n;++i){
+        if (item[i].val % 2) {
+            TEST_CHK(skiplist_erase(&slist, &item[i].snode) == 0);
+            TEST_CHK(skiplist_erase(&slist, &item[i].snode) == -1);
+        }
+    }
+    skiplist_synchronize(&slist);
+    TEST_CHK(skiplist_get_size(&slist) == (size_t)n / 2);
+
+    for (i=0;i<n;++i){
+        query.val = i;
+        node = skiplist_find(&slist, &query.snode);
+        TEST_CHK((i%2==1 && node==NULL) || (i%2==0 && node));
+        // the next even value
+        node = skiplist_find_greater_or_equal(&slist, &query.snode);
+        if (i < n - 1) {
+            result = _get_entry(node, struct sl_item, snode);
+            TEST_CHK(result->val == i + (i % 2));
+        } else {
+            TEST_CHK(node == NULL);
+        }
+    }
+
+    // re-insert the odd values
+    for (i=0;i<n;++i){
+        if (item[i].val % 2) {
+            TEST_CHK(skiplist_insert(&slist, &item[i].snode) == NULL);
+        }
+    }
+    TEST_CHK(skiplist_get_size(&slist) == (size_t)n);
+    for (i=0;i<n;++i){
+        query.val = i;
+        TEST_CHK(skiplist_find(&slist, &query.snode) != NULL);
+    }
+
+    for (i=0;i<n;++i){
+        skiplist_erase(&slist, &item[i].snode);
+        skiplist_free_node(&item[i].snode);
+    }
+    skiplist_free_node(&dup.snode);
+    TEST_CHK(skiplist_first(&slist) == NULL);
+    skiplist_free(&slist);
+
+    TEST_RESULT("skiplist basic test");
+}
+
+struct skiplist_reader_args {
+    struct skiplist_raw *slist;
+    std::atomic<bool> *stop;
+    int nkeys;
+    bool ok;
+};
+
+static void *skiplist_reader(void *voidargs)
+{
+    struct skiplist_reader_args *args =
+        (struct skiplist_reader_args *)voidargs;
+    struct sl_item query, *result;
+    struct skiplist_node *node;
+    uint64_t token;
+    int i = 0, prev;
+
+    args->ok = true;
+    while (!args->stop->load()) {
+        token = skiplist_read_begin(args->slist);
+        // the even keys are never removed
+        query.val = (i * 2) % args->nkeys;
+        node = skiplist_find(args->slist, &query.snode);
+        if (!node ||
+            _get_entry(node, struct sl_item, snode)->val != query.val) {
+            args->ok = false;
+        }
+        // a scan always sees the keys in order
+        prev = -1;
+        for (node = skiplist_first(args->slist); node;
+             node = skiplist_next(node)) {
+            result = _get_entry(node, struct sl_item, snode);
+            if (result->val <= prev) {
+                args->ok = false;
+            }
+            prev = result->val;
+        }
+        skiplist_read_end(args->slist, token);
+        ++i;
+    }
+    return NULL;
+}
+
+void skiplist_concurrent_test()
+{
+    TEST_INIT();
+
+    struct skiplist_raw slist;
+    struct sl_item *items;
+    std::atomic<bool> stop(false);
+    int i, r, round, n = 1024, nreaders = 4;
+    thread_t tid[4];
+    struct skiplist_reader_args args[4];
+
+    items = (struct sl_item *)calloc(n, sizeof(struct sl_item));
+    skiplist_init(&slist, skiplist_cmp, NULL);
+    for (i=0;i<n;++i){
+        items[i].val = i;
+        skiplist_init_node(&items[i].snode);
+        skiplist_insert(&slist, &items[i].snode);
+    }
+
+    for (r=0;r<nreaders;++r){
+        args[r].slist = &slist;
+        args[r].stop = &stop;
+        args[r].nkeys = n;
+        thread_create(&tid[r], skiplist_reader, &args[r]);
+    }
+
+    // the odd keys are removed, changed and re-inserted while the readers
+    // are running
+    for (round=0;round<50;++round){
+        for (i=1;i<n;i+=2){
+            TEST_CHK(skiplist_erase(&slist, &items[i].snode) == 0);
+        }
+        skiplist_synchronize(&slist);
+        for (i=1;i<n;i+=2){
+            TEST_CHK(skiplist_insert(&slist, &items[i].snode) == NULL);
+        }
+    }
+
+    stop = true;
+    for (r=0;r<nreaders;++r){
+        thread_join(tid[r], NULL);
+        TEST_CHK(args[r].ok);
+    }
+
+    TEST_CHK(skiplist_get_size(&slist) == (size_t)n);
+    for (i=0;i<n;++i){
+        skiplist_erase(&slist, &items[i].snode);
+        skiplist_free_node(&items[i].snode);
+    }
+    skiplist_free(&slist);
+    free(items);
+
+    TEST_RESULT("skiplist concurrent test");
+}
+
 int main()
 {
     basic_test();
     string_hash_test();
+    checksum_test();
+    skiplist_basic_test();
+    skiplist_concurrent_test();
     //twohash_test();
 
     return 0;
@@ -23,6 +23,7 @@
 
 #include "atomic.h"
 #include "memory_pool.h"
+#include "slab_arena.h"
 
 #include "test.h"
 #include "stat_aggregator.h"
@@ -147,9 +148,68 @@ void multi_thread_test(int num_threads, int iterations, int num_bins,
     TEST_RESULT(res);
 }
 
+void slab_arena_test()
+{
+    TEST_INIT();
+
+    SlabArena arena;
+    size_t i, n = 10000;
+    size_t sizes[] = {1, 16, 17, 100, 200, 512, 513, 4000};
+    size_t nsizes = sizeof(sizes) / sizeof(sizes[0]);
+    uint8_t **objs = (uint8_t **)malloc(n * sizeof(uint8_t *));
+    size_t used = 0;
+
+    for (i = 0; i < n; ++i) {
+        size_t size = sizes[i % nsizes];
+        objs[i] = (uint8_t *)arena.alloc(size);
+        // aligned on the class unit, and not shared with any other object
+        TEST_CHK((uintptr_t)objs[i] % sizeof(void *) == 0);
+        memset(objs[i], (int)(i & 0xff), size);
+        used += size;
+    }
+    TEST_CHK(arena.getUsedBytes() == used);
+    TEST_CHK(arena.getReservedBytes() >= used);
+    size_t reserved = arena.getReservedBytes();
+    for (i = 0; i < n; ++i) {
+        size_t size = sizes[i % nsizes];
+        TEST_CHK(objs[i][0] == (i & 0xff) && objs[i][size - 1] == (i & 0xff));
+    }
+
+    // nothing can be released while every slab holds live objects
+    for (i = 0; i < n; ++i) {
+        if ((i / nsizes) % 2 == 0) {
+            SlabArena::release(objs[i], sizes[i % nsizes]);
+            used -= sizes[i % nsizes];
+        }
+    }
+    TEST_CHK(arena.getUsedBytes() == used);
+    TEST_CHK(arena.releaseEmptySlabs() == 0);
+
+    // freed objects are reused before any new slab is allocated
+    for (i = 0; i < n; ++i) {
+        if ((i / nsizes) % 2 == 0) {
+            objs[i] = (uint8_t *)arena.alloc(sizes[i % nsizes]);
+            used += sizes[i % nsizes];
+        }
+    }
+    TEST_CHK(arena.getReservedBytes() == reserved);
+
+    // everything is released in bulk
+    for (i = 0; i < n; ++i) {
+        SlabArena::release(objs[i], sizes[i % nsizes]);
+    }
+    TEST_CHK(arena.getUsedBytes() == 0);
+    TEST_CHK(arena.releaseEmptySlabs() > 0);
+    TEST_CHK(arena.getReservedBytes() == 0);
+
+    free(objs);
+    TEST_RESULT("slab arena test");
+}
+
 int main()
 {
     basic_test(10000, 8, 10485760); //1000 runs of 8 x 10MB buffers
     multi_thread_test(8, 10000, 8, 10485760); // repeat with 8 threads
+    slab_arena_test();
     return 0;
 }
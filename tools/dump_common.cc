@@ -130,6 +130,18 @@ void print_header(fdb_kvs_handle *db)
             printf("    DB header BID of the last WAL flush: not exist\n");
         }
 
+        if (header_flags & FDB_FLAG_BLOOM_FILTER) {
+            uint64_t bloom_filter_offset;
+            bloom_filter_offset = fdb_fetch_header_bloom_filter_offset(version,
+                                                                       header_buf);
+            if (bloom_filter_offset != BLK_NOT_FOUND) {
+                printf("    Bloom filter offset: %" _F64 " (0x%" _X64 ")\n",
+                       bloom_filter_offset, bloom_filter_offset);
+            } else {
+                printf("    Bloom filter offset: empty filter\n");
+            }
+        }
+
         if (db->config.multi_kv_instances) {
             // multi KV instance mode
             uint64_t i;
@@ -0,0 +1,240 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2016 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * CRC32-C (Castagnoli) with runtime CPU dispatch.
+ *
+ * On x86-64 CPUs with SSE4.2, the crc32 instruction processes 8 bytes per
+ * call. Its latency is 3 cycles but it can issue every cycle, so large
+ * buffers are split into three streams whose CRCs are computed in parallel
+ * and then merged: the CRC of a stream is shifted over the bytes that follow
+ * it by a carry-less multiplication (PCLMULQDQ) with a precomputed constant
+ * x^(8n-33) mod P, followed by a single crc32 instruction that reduces the
+ * 64-bit product modulo P.
+ *
+ * Other CPUs use the slicing-by-8 table algorithm.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "crc32c.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define _CRC32C_X86_64
+#include <nmmintrin.h>
+#include <wmmintrin.h>
+#endif
+
+// Reflected Castagnoli polynomial
+#define CRC32C_POLY (0x82f63b78)
+// Bytes per stream in the three-way interleaved loops
+#define CRC32C_LONG (8192)
+#define CRC32C_SHORT (256)
+
+typedef uint32_t (*crc32c_update_func)(uint32_t crc,
+                                       const uint8_t *data,
+                                       size_t len);
+
+static uint32_t crc32c_table[8][256];
+
+static void crc32c_init_table()
+{
+    for (uint32_t n = 0; n < 256; ++n) {
+        uint32_t crc = n;
+        for (int k = 0; k < 8; ++k) {
+            crc = (crc & 1) ? (crc >> 1) ^ CRC32C_POLY : crc >> 1;
+        }
+        crc32c_table[0][n] = crc;
+    }
+    for (uint32_t n = 0; n < 256; ++n) {
+        uint32_t crc = crc32c_table[0][n];
+        for (int k = 1; k < 8; ++k) {
+            crc = crc32c_table[0][crc & 0xff] ^ (crc >> 8);
+            crc32c_table[k][n] = crc;
+        }
+    }
+}
+
+static uint32_t crc32c_sw_update(uint32_t crc, const uint8_t *p, size_t len)
+{
+#ifndef _BIG_ENDIAN
+    while (len && ((uintptr_t)p & 7)) {
+        crc = crc32c_table[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+        --len;
+    }
+    while (len >= 8) {
+        uint64_t word;
+        memcpy(&word, p, sizeof(word));
+        word ^= crc;
+        crc = crc32c_table[7][word & 0xff] ^
+              crc32c_table[6][(word >> 8) & 0xff] ^
+              crc32c_table[5][(word >> 16) & 0xff] ^
+              crc32c_table[4][(word >> 24) & 0xff] ^
+              crc32c_table[3][(word >> 32) & 0xff] ^
+              crc32c_table[2][(word >> 40) & 0xff] ^
+              crc32c_table[1][(word >> 48) & 0xff] ^
+              crc32c_table[0][word >> 56];
+        p += 8;
+        len -= 8;
+    }
+#endif
+    while (len--) {
+        crc = crc32c_table[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+#ifdef _CRC32C_X86_64
+
+// Constants to shift a CRC over CRC32C_LONG and CRC32C_SHORT bytes (index 0),
+// and over twice as many bytes (index 1).
+static uint64_t crc32c_k_long[2];
+static uint64_t crc32c_k_short[2];
+
+// x^n mod P in the reflected representation (bit 31 is x^0).
+static uint32_t crc32c_xpow(uint64_t n)
+{
+    uint32_t p = 0x80000000;
+    while (n--) {
+        p = (p & 1) ? (p >> 1) ^ CRC32C_POLY : p >> 1;
+    }
+    return p;
+}
+
+static void crc32c_init_shift_constants()
+{
+    crc32c_k_long[0] = crc32c_xpow(8 * CRC32C_LONG - 33);
+    crc32c_k_long[1] = crc32c_xpow(8 * 2 * CRC32C_LONG - 33);
+    crc32c_k_short[0] = crc32c_xpow(8 * CRC32C_SHORT - 33);
+    crc32c_k_short[1] = crc32c_xpow(8 * 2 * CRC32C_SHORT - 33);
+}
+
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_hw_update(uint32_t crc, const uint8_t *p, size_t len)
+{
+    uint64_t crc64;
+
+    while (len && ((uintptr_t)p & 7)) {
+        crc = _mm_crc32_u8(crc, *p++);
+        --len;
+    }
+    crc64 = crc;
+    while (len >= 8) {
+        uint64_t word;
+        memcpy(&word, p, sizeof(word));
+        crc64 = _mm_crc32_u64(crc64, word);
+        p += 8;
+        len -= 8;
+    }
+    crc = (uint32_t)crc64;
+    while (len--) {
+        crc = _mm_crc32_u8(crc, *p++);
+    }
+    return crc;
+}
+
+/*
+ * Return crc0 shifted over 2n bytes XOR crc1 shifted over n bytes, where
+ * k = {x^(8n-33), x^(16n-33)} mod P.
+ */
+__attribute__((target("sse4.2,pclmul")))
+static inline uint32_t crc32c_shift2(uint32_t crc0, uint32_t crc1,
+                                     const uint64_t *k)
+{
+    __m128i a = _mm_clmulepi64_si128(_mm_cvtsi32_si128((int)crc0),
+                                     _mm_cvtsi64_si128((long long)k[1]),
+                                     0x00);
+    __m128i b = _mm_clmulepi64_si128(_mm_cvtsi32_si128((int)crc1),
+                                     _mm_cvtsi64_si128((long long)k[0]),
+                                     0x00);
+    uint64_t product = (uint64_t)_mm_cvtsi128_si64(_mm_xor_si128(a, b));
+    return (uint32_t)_mm_crc32_u64(0, product);
+}
+
+#define CRC32C_3WAY_LOOP(stream_len, k)                                 \
+    while (len >= 3 * (stream_len)) {                                   \
+        uint64_t crc0 = crc, crc1 = 0, crc2 = 0;                        \
+        const uint8_t *end = p + (stream_len);                          \
+        do {                                                            \
+            uint64_t w0, w1, w2;                                        \
+            memcpy(&w0, p, sizeof(w0));                                 \
+            memcpy(&w1, p + (stream_len), sizeof(w1));                  \
+            memcpy(&w2, p + 2 * (stream_len), sizeof(w2));              \
+            crc0 = _mm_crc32_u64(crc0, w0);                             \
+            crc1 = _mm_crc32_u64(crc1, w1);                             \
+            crc2 = _mm_crc32_u64(crc2, w2);                             \
+            p += 8;                                                     \
+        } while (p < end);                                              \
+        crc = crc32c_shift2((uint32_t)crc0, (uint32_t)crc1, (k)) ^      \
+              (uint32_t)crc2;                                           \
+        p += 2 * (stream_len);                                          \
+        len -= 3 * (stream_len);                                        \
+    }
+
+__attribute__((target("sse4.2,pclmul")))
+static uint32_t crc32c_hw_pclmul_update(uint32_t crc, const uint8_t *p,
+                                        size_t len)
+{
+    while (len && ((uintptr_t)p & 7)) {
+        crc = _mm_crc32_u8(crc, *p++);
+        --len;
+    }
+    CRC32C_3WAY_LOOP(CRC32C_LONG, crc32c_k_long);
+    CRC32C_3WAY_LOOP(CRC32C_SHORT, crc32c_k_short);
+    return crc32c_hw_update(crc, p, len);
+}
+
+#endif // _CRC32C_X86_64
+
+static const char *crc32c_selected_name = "sw";
+
+static crc32c_update_func crc32c_select()
+{
+    crc32c_init_table();
+#ifdef _CRC32C_X86_64
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.2")) {
+        if (__builtin_cpu_supports("pclmul")) {
+            crc32c_init_shift_constants();
+            crc32c_selected_name = "sse4.2+pclmul";
+            return crc32c_hw_pclmul_update;
+        }
+        crc32c_selected_name = "sse4.2";
+        return crc32c_hw_update;
+    }
+#endif
+    return crc32c_sw_update;
+}
+
+static const crc32c_update_func crc32c_update = crc32c_select();
+
+uint32_t crc32c_8(const void* data, size_t len, uint32_t prev_value)
+{
+    return ~crc32c_update(~prev_value, (const uint8_t *)data, len);
+}
+
+uint32_t crc32c_8_sw(const void* data, size_t len, uint32_t prev_value)
+{
+    return ~crc32c_sw_update(~prev_value, (const uint8_t *)data, len);
+}
+
+const char* crc32c_impl_name(void)
+{
+    return crc32c_selected_name;
+}
@@ -0,0 +1,48 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2016 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * CRC32-C (Castagnoli) of data for len bytes, continuing from prev_value.
+ *
+ * The implementation is selected at runtime: SSE4.2 crc32 instructions with
+ * three interleaved streams combined by PCLMULQDQ for large buffers, SSE4.2
+ * only, or the portable slicing-by-8 table.
+ */
+uint32_t crc32c_8(const void* data, size_t len, uint32_t prev_value);
+
+/*
+ * Portable table-based CRC32-C, regardless of the CPU features.
+ */
+uint32_t crc32c_8_sw(const void* data, size_t len, uint32_t prev_value);
+
+/*
+ * Return the name of the CRC32-C implementation selected for this CPU.
+ */
+const char* crc32c_impl_name(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,372 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2016 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * Portable implementation of the 64-bit XXH3 hash
+ * (xxHash by Yann Collet, BSD 2-Clause License).
+ *
+ * Only the one-shot seeded variant is provided. The accumulation loop over
+ * 64-byte stripes is written so that compilers can auto-vectorize it.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "xxhash3.h"
+
+#define XXH_PRIME32_1 0x9E3779B1U
+#define XXH_PRIME32_2 0x85EBCA77U
+#define XXH_PRIME32_3 0xC2B2AE3DU
+#define XXH_PRIME64_1 0x9E3779B185EBCA87ULL
+#define XXH_PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define XXH_PRIME64_3 0x165667B19E3779F9ULL
+#define XXH_PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define XXH_PRIME64_5 0x27D4EB2F165667C5ULL
+
+#define XXH3_SECRET_SIZE (192)
+#define XXH3_SECRET_SIZE_MIN (136)
+#define XXH3_STRIPE_LEN (64)
+#define XXH3_SECRET_CONSUME_RATE (8)
+#define XXH3_ACC_NB (8)
+#define XXH3_MIDSIZE_MAX (240)
+#define XXH3_SECRET_MERGEACCS_START (11)
+#define XXH3_SECRET_LASTACC_START (7)
+
+static const uint8_t xxh3_default_secret[XXH3_SECRET_SIZE] = {
+    0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe,
+    0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+    0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb,
+    0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+    0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78,
+    0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+    0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e,
+    0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+    0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb,
+    0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+    0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e,
+    0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+    0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f,
+    0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+    0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31,
+    0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+    0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3,
+    0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+    0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49,
+    0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+    0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc,
+    0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+    0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28,
+    0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+};
+
+static inline uint32_t xxh_read32(const uint8_t *p)
+{
+#ifdef _BIG_ENDIAN
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+           ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+#else
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+#endif
+}
+
+static inline uint64_t xxh_read64(const uint8_t *p)
+{
+#ifdef _BIG_ENDIAN
+    return (uint64_t)xxh_read32(p) | ((uint64_t)xxh_read32(p + 4) << 32);
+#else
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+#endif
+}
+
+static inline void xxh_write64(uint8_t *p, uint64_t v)
+{
+    for (int i = 0; i < 8; ++i) {
+        p[i] = (uint8_t)(v >> (8 * i));
+    }
+}
+
+static inline uint32_t xxh_swap32(uint32_t x)
+{
+    return ((x << 24) & 0xff000000) | ((x << 8) & 0x00ff0000) |
+           ((x >> 8) & 0x0000ff00) | ((x >> 24) & 0x000000ff);
+}
+
+static inline uint64_t xxh_swap64(uint64_t x)
+{
+    return ((uint64_t)xxh_swap32((uint32_t)x) << 32) |
+           xxh_swap32((uint32_t)(x >> 32));
+}
+
+static inline uint64_t xxh_rotl64(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t xxh_mult128_fold64(uint64_t lhs, uint64_t rhs)
+{
+#if defined(__SIZEOF_INT128__)
+    __uint128_t product = (__uint128_t)lhs * rhs;
+    return (uint64_t)product ^ (uint64_t)(product >> 64);
+#else
+    uint64_t lo_lo = (lhs & 0xffffffff) * (rhs & 0xffffffff);
+    uint64_t hi_lo = (lhs >> 32) * (rhs & 0xffffffff);
+    uint64_t lo_hi = (lhs & 0xffffffff) * (rhs >> 32);
+    uint64_t hi_hi = (lhs >> 32) * (rhs >> 32);
+    uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xffffffff) + lo_hi;
+    uint64_t upper = (hi_lo >> 32) + (cross >> 32) + hi_hi;
+    uint64_t lower = (cross << 32) | (lo_lo & 0xffffffff);
+    return lower ^ upper;
+#endif
+}
+
+static inline uint64_t xxh64_avalanche(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= XXH_PRIME64_2;
+    h ^= h >> 29;
+    h *= XXH_PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+static inline uint64_t xxh3_avalanche(uint64_t h)
+{
+    h ^= h >> 37;
+    h *= 0x165667919E3779F9ULL;
+    h ^= h >> 32;
+    return h;
+}
+
+static inline uint64_t xxh3_rrmxmx(uint64_t h, uint64_t len)
+{
+    h ^= xxh_rotl64(h, 49) ^ xxh_rotl64(h, 24);
+    h *= 0x9FB21C651E98DF25ULL;
+    h ^= (h >> 35) + len;
+    h *= 0x9FB21C651E98DF25ULL;
+    h ^= h >> 28;
+    return h;
+}
+
+static uint64_t xxh3_len_1to3(const uint8_t *input, size_t len,
+                              const uint8_t *secret, uint64_t seed)
+{
+    uint8_t c1 = input[0];
+    uint8_t c2 = input[len >> 1];
+    uint8_t c3 = input[len - 1];
+    uint32_t combined = ((uint32_t)c1 << 16) | ((uint32_t)c2 << 24) |
+                        ((uint32_t)c3 << 0) | ((uint32_t)len << 8);
+    uint64_t bitflip = (xxh_read32(secret) ^ xxh_read32(secret + 4)) + seed;
+    return xxh64_avalanche((uint64_t)combined ^ bitflip);
+}
+
+static uint64_t xxh3_len_4to8(const uint8_t *input, size_t len,
+                              const uint8_t *secret, uint64_t seed)
+{
+    seed ^= (uint64_t)xxh_swap32((uint32_t)seed) << 32;
+    uint32_t input1 = xxh_read32(input);
+    uint32_t input2 = xxh_read32(input + len - 4);
+    uint64_t bitflip = (xxh_read64(secret + 8) ^ xxh_read64(secret + 16)) -
+                       seed;
+    uint64_t input64 = input2 + ((uint64_t)input1 << 32);
+    return xxh3_rrmxmx(input64 ^ bitflip, len);
+}
+
+static uint64_t xxh3_len_9to16(const uint8_t *input, size_t len,
+                               const uint8_t *secret, uint64_t seed)
+{
+    uint64_t bitflip1 = (xxh_read64(secret + 24) ^ xxh_read64(secret + 32)) +
+                        seed;
+    uint64_t bitflip2 = (xxh_read64(secret + 40) ^ xxh_read64(secret + 48)) -
+                        seed;
+    uint64_t input_lo = xxh_read64(input) ^ bitflip1;
+    uint64_t input_hi = xxh_read64(input + len - 8) ^ bitflip2;
+    uint64_t acc = len + xxh_swap64(input_lo) + input_hi +
+                   xxh_mult128_fold64(input_lo, input_hi);
+    return xxh3_avalanche(acc);
+}
+
+static uint64_t xxh3_len_0to16(const uint8_t *input, size_t len,
+                               const uint8_t *secret, uint64_t seed)
+{
+    if (len > 8) {
+        return xxh3_len_9to16(input, len, secret, seed);
+    }
+    if (len >= 4) {
+        return xxh3_len_4to8(input, len, secret, seed);
+    }
+    if (len) {
+        return xxh3_len_1to3(input, len, secret, seed);
+    }
+    return xxh64_avalanche(seed ^ (xxh_read64(secret + 56) ^
+                                   xxh_read64(secret + 64)));
+}
+
+static inline uint64_t xxh3_mix16(const uint8_t *input, const uint8_t *secret,
+                                  uint64_t seed)
+{
+    uint64_t input_lo = xxh_read64(input);
+    uint64_t input_hi = xxh_read64(input + 8);
+    return xxh_mult128_fold64(input_lo ^ (xxh_read64(secret) + seed),
+                              input_hi ^ (xxh_read64(secret + 8) - seed));
+}
+
+static uint64_t xxh3_len_17to128(const uint8_t *input, size_t len,
+                                 const uint8_t *secret, uint64_t seed)
+{
+    uint64_t acc = len * XXH_PRIME64_1;
+    if (len > 32) {
+        if (len > 64) {
+            if (len > 96) {
+                acc += xxh3_mix16(input + 48, secret + 96, seed);
+                acc += xxh3_mix16(input + len - 64, secret + 112, seed);
+            }
+            acc += xxh3_mix16(input + 32, secret + 64, seed);
+            acc += xxh3_mix16(input + len - 48, secret + 80, seed);
+        }
+        acc += xxh3_mix16(input + 16, secret + 32, seed);
+        acc += xxh3_mix16(input + len - 32, secret + 48, seed);
+    }
+    acc += xxh3_mix16(input, secret, seed);
+    acc += xxh3_mix16(input + len - 16, secret + 16, seed);
+    return xxh3_avalanche(acc);
+}
+
+static uint64_t xxh3_len_129to240(const uint8_t *input, size_t len,
+                                  const uint8_t *secret, uint64_t seed)
+{
+    const size_t start_offset = 3;
+    const size_t last_offset = 17;
+    uint64_t acc = len * XXH_PRIME64_1;
+    size_t nb_rounds = len / 16;
+    size_t i;
+
+    for (i = 0; i < 8; ++i) {
+        acc += xxh3_mix16(input + 16 * i, secret + 16 * i, seed);
+    }
+    acc = xxh3_avalanche(acc);
+    for (i = 8; i < nb_rounds; ++i) {
+        acc += xxh3_mix16(input + 16 * i,
+                          secret + 16 * (i - 8) + start_offset, seed);
+    }
+    acc += xxh3_mix16(input + len - 16,
+                      secret + XXH3_SECRET_SIZE_MIN - last_offset, seed);
+    return xxh3_avalanche(acc);
+}
+
+static inline void xxh3_accumulate_512(uint64_t *acc, const uint8_t *input,
+                                       const uint8_t *secret)
+{
+    for (size_t i = 0; i < XXH3_ACC_NB; ++i) {
+        uint64_t data_val = xxh_read64(input + 8 * i);
+        uint64_t data_key = data_val ^ xxh_read64(secret + 8 * i);
+        acc[i ^ 1] += data_val;
+        acc[i] += (data_key & 0xffffffff) * (data_key >> 32);
+    }
+}
+
+static inline void xxh3_scramble_acc(uint64_t *acc, const uint8_t *secret)
+{
+    for (size_t i = 0; i < XXH3_ACC_NB; ++i) {
+        uint64_t key64 = xxh_read64(secret + 8 * i);
+        uint64_t acc64 = acc[i];
+        acc64 ^= acc64 >> 47;
+        acc64 ^= key64;
+        acc64 *= XXH_PRIME32_1;
+        acc[i] = acc64;
+    }
+}
+
+static uint64_t xxh3_hash_long(const uint8_t *input, size_t len,
+                               const uint8_t *secret, size_t secret_size)
+{
+    uint64_t acc[XXH3_ACC_NB] = {
+        XXH_PRIME32_3, XXH_PRIME64_1, XXH_PRIME64_2, XXH_PRIME64_3,
+        XXH_PRIME64_4, XXH_PRIME32_2, XXH_PRIME64_5, XXH_PRIME32_1
+    };
+    size_t nb_stripes_per_block = (secret_size - XXH3_STRIPE_LEN) /
+                                  XXH3_SECRET_CONSUME_RATE;
+    size_t block_len = XXH3_STRIPE_LEN * nb_stripes_per_block;
+    size_t nb_blocks = (len - 1) / block_len;
+    size_t n, s;
+
+    for (n = 0; n < nb_blocks; ++n) {
+        for (s = 0; s < nb_stripes_per_block; ++s) {
+            xxh3_accumulate_512(acc,
+                                input + n * block_len + s * XXH3_STRIPE_LEN,
+                                secret + s * XXH3_SECRET_CONSUME_RATE);
+        }
+        xxh3_scramble_acc(acc, secret + secret_size - XXH3_STRIPE_LEN);
+    }
+
+    // last partial block
+    size_t nb_stripes = ((len - 1) - (block_len * nb_blocks)) /
+                        XXH3_STRIPE_LEN;
+    for (s = 0; s < nb_stripes; ++s) {
+        xxh3_accumulate_512(acc,
+                            input + nb_blocks * block_len +
+                            s * XXH3_STRIPE_LEN,
+                            secret + s * XXH3_SECRET_CONSUME_RATE);
+    }
+    // last stripe
+    xxh3_accumulate_512(acc, input + len - XXH3_STRIPE_LEN,
+                        secret + secret_size - XXH3_STRIPE_LEN -
+                        XXH3_SECRET_LASTACC_START);
+
+    // merge accumulators
+    const uint8_t *merge_secret = secret + XXH3_SECRET_MERGEACCS_START;
+    uint64_t result = len * XXH_PRIME64_1;
+    for (size_t i = 0; i < 4; ++i) {
+        result += xxh_mult128_fold64(
+                        acc[2 * i] ^ xxh_read64(merge_secret + 16 * i),
+                        acc[2 * i + 1] ^ xxh_read64(merge_secret + 16 * i + 8));
+    }
+    return xxh3_avalanche(result);
+}
+
+uint64_t xxh3_64_with_seed(const void* data, size_t len, uint64_t seed)
+{
+    const uint8_t *input = (const uint8_t *)data;
+    const uint8_t *secret = xxh3_default_secret;
+
+    if (len <= 16) {
+        return xxh3_len_0to16(input, len, secret, seed);
+    }
+    if (len <= 128) {
+        return xxh3_len_17to128(input, len, secret, seed);
+    }
+    if (len <= XXH3_MIDSIZE_MAX) {
+        return xxh3_len_129to240(input, len, secret, seed);
+    }
+    if (seed == 0) {
+        return xxh3_hash_long(input, len, secret, XXH3_SECRET_SIZE);
+    }
+
+    // derive a secret from the seed
+    uint8_t custom_secret[XXH3_SECRET_SIZE];
+    for (size_t i = 0; i < XXH3_SECRET_SIZE / 16; ++i) {
+        xxh_write64(custom_secret + 16 * i,
+                    xxh_read64(secret + 16 * i) + seed);
+        xxh_write64(custom_secret + 16 * i + 8,
+                    xxh_read64(secret + 16 * i + 8) - seed);
+    }
+    return xxh3_hash_long(input, len, custom_secret, XXH3_SECRET_SIZE);
+}